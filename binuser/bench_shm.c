@@ -0,0 +1,197 @@
+#include <string.h>
+#include <sys/syscall.h>
+
+// Compares the throughput of a shared memory object and a pipe to transfer 4 MiB
+// from one process to another.
+//
+// Usage: bench_shm
+//   The benchmark spawns itself (with the PID of the parent as argument) to get
+//   a consumer process for the shared memory transfer.
+
+#define TRANSFER_SIZE (4 * 1024 * 1024)
+#define PIPE_CHUNK_SIZE 4096
+#define SHM_NAME "bench_shm"
+#define PIPE_NAME "bench_pipe"
+
+enum { STATE_INIT, STATE_CONSUMER_READY, STATE_DATA_READY, STATE_DATA_CONSUMED };
+
+// Stored at the beginning of the shared memory, followed by the transferred data.
+typedef struct {
+  uint32_t state;
+  uint32_t checksum;
+} header_t;
+
+#define DATA_OFFSET 64
+
+static char* append_str(char* it, const char* str) {
+  const size_t length = strlen(str);
+  memcpy(it, str, length);
+  return it + length;
+}
+
+static char* append_uint(char* it, uint64_t value) {
+  char digits[20];
+  int size = 0;
+  do {
+    digits[size++] = '0' + (value % 10);
+    value /= 10;
+  } while (value != 0);
+
+  while (size > 0)
+    *it++ = digits[--size];
+  return it;
+}
+
+static sys_pid_t parse_pid(const char* str) {
+  sys_pid_t pid = 0;
+  while (*str >= '0' && *str <= '9')
+    pid = pid * 10 + (*str++ - '0');
+  return pid;
+}
+
+static uint32_t checksum(const uint32_t* data, size_t count) {
+  uint32_t sum = 0;
+  for (size_t i = 0; i < count; ++i)
+    sum = (sum ^ data[i]) * 16777619u;
+  return sum;
+}
+
+static void fill(uint32_t* data, size_t count) {
+  for (size_t i = 0; i < count; ++i)
+    data[i] = (uint32_t)i * 2654435761u;
+}
+
+static void set_state(header_t* header, uint32_t state) {
+  __atomic_store_n(&header->state, state, __ATOMIC_RELEASE);
+}
+
+static void wait_state(header_t* header, uint32_t state) {
+  while (__atomic_load_n(&header->state, __ATOMIC_ACQUIRE) != state)
+    sys_yield();
+}
+
+static void print_result(const char* name, uint64_t elapsed_us) {
+  if (elapsed_us == 0)
+    elapsed_us = 1;
+
+  char buffer[128];
+  char* it = append_str(buffer, name);
+  it = append_str(it, ": 4 MiB in ");
+  it = append_uint(it, elapsed_us);
+  it = append_str(it, " us (");
+  it = append_uint(it, (uint64_t)TRANSFER_SIZE * 1000000 / elapsed_us / 1024);
+  it = append_str(it, " KiB/s)");
+  *it = '\0';
+  sys_print(buffer);
+}
+
+static int run_consumer(sys_pid_t producer) {
+  sys_shm_t* shm = sys_shm_get(producer, SHM_NAME);
+  if (shm == NULL) {
+    sys_print("bench_shm: failed to get the shared memory");
+    return 1;
+  }
+
+  void* address;
+  if (!SYS_IS_OK(sys_shm_map(shm, &address, NULL))) {
+    sys_print("bench_shm: failed to map the shared memory");
+    return 1;
+  }
+
+  header_t* header = address;
+  set_state(header, STATE_CONSUMER_READY);
+  wait_state(header, STATE_DATA_READY);
+
+  header->checksum = checksum((const uint32_t*)((char*)address + DATA_OFFSET), TRANSFER_SIZE / sizeof(uint32_t));
+  set_state(header, STATE_DATA_CONSUMED);
+
+  sys_shm_unmap(shm);
+  return 0;
+}
+
+static int run_shm_producer() {
+  sys_shm_t* shm = sys_shm_create(SHM_NAME, DATA_OFFSET + TRANSFER_SIZE);
+  if (shm == NULL) {
+    sys_print("bench_shm: failed to create the shared memory");
+    return 1;
+  }
+
+  void* address;
+  if (!SYS_IS_OK(sys_shm_map(shm, &address, NULL))) {
+    sys_print("bench_shm: failed to map the shared memory");
+    return 1;
+  }
+
+  header_t* header = address;
+  uint32_t* data = (uint32_t*)((char*)address + DATA_OFFSET);
+
+  char pid_buffer[16];
+  *append_uint(pid_buffer, sys_getpid()) = '\0';
+  const char* argv[] = {"/bin/bench_shm", pid_buffer};
+  if (!SYS_IS_OK(sys_spawn2(argv[0], 2, argv))) {
+    sys_print("bench_shm: failed to spawn the consumer");
+    return 1;
+  }
+
+  wait_state(header, STATE_CONSUMER_READY);
+
+  // Time from the first written byte until the consumer has read everything.
+  const uint64_t start = sys_get_time_us();
+  fill(data, TRANSFER_SIZE / sizeof(uint32_t));
+  set_state(header, STATE_DATA_READY);
+  wait_state(header, STATE_DATA_CONSUMED);
+  const uint64_t elapsed = sys_get_time_us() - start;
+
+  if (header->checksum != checksum(data, TRANSFER_SIZE / sizeof(uint32_t)))
+    sys_print("bench_shm: shared memory checksum mismatch");
+
+  print_result("shm", elapsed);
+  sys_shm_unmap(shm);
+  return 0;
+}
+
+// Pipes can not be read by another process than their owner yet, so both ends are
+// used by this process. This still does the two copies through the kernel buffer
+// (and the system calls) that a real transfer would do, minus the context switches.
+static int run_pipe() {
+  static uint32_t src[PIPE_CHUNK_SIZE / sizeof(uint32_t)];
+  static uint32_t dst[PIPE_CHUNK_SIZE / sizeof(uint32_t)];
+
+  sys_pipe_t* pipe = sys_pipe_open(PIPE_NAME);
+  if (pipe == NULL) {
+    sys_print("bench_shm: failed to open the pipe");
+    return 1;
+  }
+
+  uint32_t sum = 0;
+  const uint64_t start = sys_get_time_us();
+  for (size_t offset = 0; offset < TRANSFER_SIZE; offset += PIPE_CHUNK_SIZE) {
+    fill(src, PIPE_CHUNK_SIZE / sizeof(uint32_t));
+
+    size_t written, read;
+    if (!SYS_IS_OK(sys_pipe_write(pipe, src, PIPE_CHUNK_SIZE, &written)) ||
+        !SYS_IS_OK(sys_pipe_read(pipe, dst, written, &read))) {
+      sys_print("bench_shm: pipe transfer failed");
+      return 1;
+    }
+
+    sum ^= checksum(dst, read / sizeof(uint32_t));
+  }
+  const uint64_t elapsed = sys_get_time_us() - start;
+
+  (void)sum;
+  print_result("pipe", elapsed);
+  sys_pipe_close(pipe);
+  return 0;
+}
+
+int main() {
+  if (sys_get_argc() > 1)
+    return run_consumer(parse_pid(sys_get_argv()[1]));
+
+  const int result = run_shm_producer();
+  if (result != 0)
+    return result;
+
+  return run_pipe();
+}
@@ -5,7 +5,6 @@
 #include <sys/window.h>
 
 #define INDENT 25
-#define TITLE_BAR_HEIGHT 30
 #define PADDING 10
 
 #define ICON_SIZE 16
@@ -104,7 +103,7 @@ static void draw(sys_window_t* window) {
   sys_gfx_clear(window, 0xff000000);
   current_idx = 0;
   current_x = PADDING + 10;
-  current_y = TITLE_BAR_HEIGHT + PADDING;
+  current_y = SYS_WINDOW_TITLE_BAR_HEIGHT + PADDING;
   draw_dir(window, "/");
   sys_window_present(window);
 }
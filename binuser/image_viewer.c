@@ -1,41 +1,74 @@
-#include <sys/file.h>
+#include <stdlib.h>
 #include <sys/syscall.h>
 #include <sys/window.h>
-#include <assert.h>
 
-#include "stb_image.h"
+#include "imgdec.h"
 
-static uint8_t* read_file(const char* path, int* buffer_length) {
-  sys_print("Reading file...");
-  sys_print(path);
-  sys_file_t* file = sys_open_file(path, SYS_FM_READ);
-  if (file == NULL)
-    return NULL;
+// The window is opened at the image size, but at most at this size (the image is shrunk to fit).
+#define MAX_WINDOW_WIDTH 1024
+#define MAX_WINDOW_HEIGHT 640
 
-  const size_t file_size = sys_get_file_size(file);
-  uint8_t* buffer = malloc(sizeof(uint8_t) * file_size);
-  assert(buffer != NULL);
+static img_decoder_t* image = NULL;
 
-  size_t read_bytes;
-  sys_file_read(file, buffer, file_size, &read_bytes);
-  assert(read_bytes == file_size);
+// The image decoded at the size it is drawn, kept by the kernel so a redraw at the same size does not
+// decode it again (for example when the window is resized while larger than the image).
+static sys_surface_t* image_surface = NULL;
+static uint32_t image_width = 0, image_height = 0;
 
-  *buffer_length = file_size;
+// Decodes the image at @a width x @a height into image_surface, unless it is already done.
+static bool update_image_surface(sys_window_t* window, uint32_t width, uint32_t height) {
+  if (image_surface != NULL && width == image_width && height == image_height)
+    return true;
 
-  sys_close_file(file);
-  sys_print("Done.");
+  sys_surface_destroy(image_surface);
+  image_surface = NULL;
 
-  return buffer;
+  uint32_t* pixels = malloc(sizeof(uint32_t) * width * height);
+  if (pixels == NULL)
+    return false;
+
+  bool success = img_decode(image, pixels, width, width, height);
+  if (success) {
+    // The blit is submitted immediately, the pixels can be freed afterwards.
+    image_surface = sys_surface_create(width, height, SYS_SF_DEFAULT);
+    success = image_surface != NULL && SYS_IS_OK(sys_gfx_set_target(window, image_surface)) &&
+              SYS_IS_OK(sys_gfx_blit(window, 0, 0, width, height, pixels));
+    sys_gfx_set_target(window, NULL);
+  }
+
+  free(pixels);
+  if (!success) {
+    sys_surface_destroy(image_surface);
+    image_surface = NULL;
+    return false;
+  }
+
+  image_width = width;
+  image_height = height;
+  return true;
 }
 
-static void convert_to_argb(uint32_t* pixels, int width, int height) {
-  for (int x = 0; x < width; ++x) {
-    for (int y = 0; y < height; ++y) {
-      // The image is in RGBA, we expect ABGR.
-      const uint32_t color = __builtin_bswap32(pixels[x + width * y]);
-      pixels[x + width * y] = color >> 8;
-    }
+static void draw(sys_window_t* window) {
+  uint32_t win_width, win_height;
+  sys_window_get_geometry(window, NULL, NULL, &win_width, &win_height);
+  if (win_width == 0 || win_height <= SYS_WINDOW_TITLE_BAR_HEIGHT)
+    return;
+
+  const uint32_t area_width = win_width;
+  const uint32_t area_height = win_height - SYS_WINDOW_TITLE_BAR_HEIGHT;
+  sys_gfx_fill_rect(window, 0, SYS_WINDOW_TITLE_BAR_HEIGHT, area_width, area_height, 0xff000000);
+
+  // The image is shrunk if needed, and centered.
+  uint32_t width, height;
+  img_fit_size(image, area_width, area_height, false, &width, &height);
+  if (update_image_surface(window, width, height)) {
+    sys_gfx_blit_surface(window, image_surface, (area_width - width) / 2,
+                         SYS_WINDOW_TITLE_BAR_HEIGHT + (area_height - height) / 2);
+  } else {
+    sys_print("ERROR: failed to decode the image.");
   }
+
+  sys_window_present2(window, 0, SYS_WINDOW_TITLE_BAR_HEIGHT, area_width, area_height);
 }
 
 int main() {
@@ -48,33 +81,23 @@ int main() {
   }
 
   const char* image_path = argv[1];
-  int image_length = 0;
-  const uint8_t* image_data = read_file(image_path, &image_length);
-  if (image_data == NULL) {
-    sys_print("ERROR: failed to read image file.");
+  image = img_open(image_path);
+  if (image == NULL) {
+    sys_print("ERROR: failed to open image (maybe not a valid image).");
     return 1;
   }
 
-  int width, height;
-  const uint32_t* image_pixels =
-      (const uint32_t*)stbi_load_from_memory(image_data, image_length, &width, &height, NULL, 4);
-  free(image_data);
-  if (image_pixels == NULL) {
-    sys_print("ERROR: failed to load image data (maybe not a valid image).");
-    return 1;
-  }
-
-  sys_window_t* window =
-      sys_window_create("Image viewer", SYS_POS_DEFAULT, SYS_POS_DEFAULT, width, height, SYS_WF_DEFAULT);
+  uint32_t width, height;
+  img_fit_size(image, MAX_WINDOW_WIDTH, MAX_WINDOW_HEIGHT, false, &width, &height);
+  sys_window_t* window = sys_window_create("Image viewer", SYS_POS_DEFAULT, SYS_POS_DEFAULT, width,
+                                           height + SYS_WINDOW_TITLE_BAR_HEIGHT, SYS_WF_DEFAULT);
   if (window == NULL) {
-    free(image_pixels);
+    img_close(image);
     sys_print("ERROR: failed to create window.");
     return 1;
   }
 
-  convert_to_argb(image_pixels, width, height);
-  sys_gfx_blit(window, 0, 0, width, height, image_pixels);
-  sys_window_present(window);
+  draw(window);
 
   bool should_close = false;
   while (!should_close) {
@@ -84,11 +107,16 @@ int main() {
       case SYS_MSG_CLOSE:
         should_close = true;
         break;
+      case SYS_MSG_RESIZE:
+        draw(window);
+        break;
       default:
         break;
     }
   }
 
+  sys_surface_destroy(image_surface);
   sys_window_destroy(window);
+  img_close(image);
   return 0;
 }
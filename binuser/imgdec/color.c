@@ -0,0 +1,75 @@
+#include "internal.h"
+
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif  // __ARM_NEON
+
+// The JFIF conversion coefficients, with 14 fractional bits (so they fit in 16-bit lanes):
+//   R = Y + 1.402 (Cr - 128)
+//   G = Y - 0.344136 (Cb - 128) - 0.714136 (Cr - 128)
+//   B = Y + 1.772 (Cb - 128)
+#define CR_TO_R 22970
+#define CB_TO_G 5638
+#define CR_TO_G 11700
+#define CB_TO_B 29032
+#define COEF_BITS 14
+
+static inline uint32_t clamp_u8(int32_t value) {
+  return value < 0 ? 0 : (value > 255 ? 255 : value);
+}
+
+void img_ycbcr_to_argb(uint32_t* dst, const uint8_t* y, const uint8_t* cb, const uint8_t* cr, size_t n) {
+#ifdef __ARM_NEON
+  // 8 pixels per iteration: the products are computed on 32 bits and rounded as the scalar code does,
+  // so both give the same results.
+  const uint8x8_t bias = vdup_n_u8(128);
+  const uint8x8_t alpha = vdup_n_u8(0xff);
+  for (; n >= 8; n -= 8, dst += 8, y += 8, cb += 8, cr += 8) {
+    const int16x8_t luma = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(y)));
+    const int16x8_t cb16 = vreinterpretq_s16_u16(vsubl_u8(vld1_u8(cb), bias));
+    const int16x8_t cr16 = vreinterpretq_s16_u16(vsubl_u8(vld1_u8(cr), bias));
+
+    const int16x8_t r_offset = vcombine_s16(vrshrn_n_s32(vmull_n_s16(vget_low_s16(cr16), CR_TO_R), COEF_BITS),
+                                            vrshrn_n_s32(vmull_high_n_s16(cr16, CR_TO_R), COEF_BITS));
+    int32x4_t g_low = vmull_n_s16(vget_low_s16(cb16), CB_TO_G);
+    g_low = vmlal_n_s16(g_low, vget_low_s16(cr16), CR_TO_G);
+    int32x4_t g_high = vmull_high_n_s16(cb16, CB_TO_G);
+    g_high = vmlal_high_n_s16(g_high, cr16, CR_TO_G);
+    const int16x8_t g_offset = vcombine_s16(vrshrn_n_s32(g_low, COEF_BITS), vrshrn_n_s32(g_high, COEF_BITS));
+    const int16x8_t b_offset = vcombine_s16(vrshrn_n_s32(vmull_n_s16(vget_low_s16(cb16), CB_TO_B), COEF_BITS),
+                                            vrshrn_n_s32(vmull_high_n_s16(cb16, CB_TO_B), COEF_BITS));
+
+    uint8x8x4_t pixels;  // blue, green, red and alpha channels
+    pixels.val[0] = vqmovun_s16(vaddq_s16(luma, b_offset));
+    pixels.val[1] = vqmovun_s16(vsubq_s16(luma, g_offset));
+    pixels.val[2] = vqmovun_s16(vaddq_s16(luma, r_offset));
+    pixels.val[3] = alpha;
+    vst4_u8((uint8_t*)dst, pixels);
+  }
+#endif  // __ARM_NEON
+
+  const int32_t round = 1 << (COEF_BITS - 1);
+  for (size_t i = 0; i < n; ++i) {
+    const int32_t luma = y[i];
+    const int32_t cb_value = (int32_t)cb[i] - 128;
+    const int32_t cr_value = (int32_t)cr[i] - 128;
+    const uint32_t r = clamp_u8(luma + ((CR_TO_R * cr_value + round) >> COEF_BITS));
+    const uint32_t g = clamp_u8(luma - ((CB_TO_G * cb_value + CR_TO_G * cr_value + round) >> COEF_BITS));
+    const uint32_t b = clamp_u8(luma + ((CB_TO_B * cb_value + round) >> COEF_BITS));
+    dst[i] = 0xff000000 | (r << 16) | (g << 8) | b;
+  }
+}
+
+void img_gray_to_argb(uint32_t* dst, const uint8_t* y, size_t n) {
+#ifdef __ARM_NEON
+  const uint8x8_t alpha = vdup_n_u8(0xff);
+  for (; n >= 8; n -= 8, dst += 8, y += 8) {
+    const uint8x8_t luma = vld1_u8(y);
+    const uint8x8x4_t pixels = {{luma, luma, luma, alpha}};
+    vst4_u8((uint8_t*)dst, pixels);
+  }
+#endif  // __ARM_NEON
+
+  for (size_t i = 0; i < n; ++i)
+    dst[i] = 0xff000000 | ((uint32_t)y[i] * 0x010101);
+}
@@ -0,0 +1,258 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "internal.h"
+#include "stb_image.h"
+
+typedef enum img_format_t {
+  IMG_FORMAT_JPEG,
+  IMG_FORMAT_PNG,
+  IMG_FORMAT_OTHER,  // decoded by stb_image
+} img_format_t;
+
+struct img_decoder_t {
+  char* path;
+  img_format_t format;
+  uint32_t width, height;
+};
+
+// ========================================================================
+// Reader
+
+bool img_reader_open(img_reader_t* reader, const char* path) {
+  reader->file = sys_open_file(path, SYS_FM_READ);
+  reader->position = 0;
+  reader->size = 0;
+  reader->eof = false;
+  return reader->file != NULL;
+}
+
+void img_reader_close(img_reader_t* reader) {
+  if (reader->file != NULL)
+    sys_close_file(reader->file);
+  reader->file = NULL;
+}
+
+bool img_reader_refill(img_reader_t* reader) {
+  size_t read_bytes = 0;
+  reader->position = 0;
+  reader->size = 0;
+  if (!reader->eof && SYS_IS_OK(sys_file_read(reader->file, reader->buffer, IMG_READER_BUFFER_SIZE, &read_bytes)))
+    reader->size = read_bytes;
+
+  reader->eof = reader->size == 0;
+  return !reader->eof;
+}
+
+size_t img_reader_read(img_reader_t* reader, void* dst, size_t n) {
+  size_t total = 0;
+  while (total < n) {
+    if (reader->position == reader->size && !img_reader_refill(reader))
+      break;
+
+    size_t chunk = reader->size - reader->position;
+    if (chunk > n - total)
+      chunk = n - total;
+
+    memcpy((uint8_t*)dst + total, reader->buffer + reader->position, chunk);
+    reader->position += chunk;
+    total += chunk;
+  }
+
+  return total;
+}
+
+bool img_reader_skip(img_reader_t* reader, size_t n) {
+  while (n > 0) {
+    if (reader->position == reader->size && !img_reader_refill(reader))
+      return false;
+
+    size_t chunk = reader->size - reader->position;
+    if (chunk > n)
+      chunk = n;
+
+    reader->position += chunk;
+    n -= chunk;
+  }
+
+  return true;
+}
+
+// ========================================================================
+// stb_image fallback
+
+static int stbi_read(void* user, char* data, int size) {
+  return (int)img_reader_read(user, data, size);
+}
+
+static void stbi_skip(void* user, int n) {
+  if (n > 0)
+    img_reader_skip(user, n);
+}
+
+static int stbi_eof(void* user) {
+  img_reader_t* reader = user;
+  return reader->position == reader->size && !img_reader_refill(reader);
+}
+
+static const stbi_io_callbacks STBI_CALLBACKS = {stbi_read, stbi_skip, stbi_eof};
+
+static img_result_t stbi_decode(img_reader_t* reader, uint32_t* dst, uint32_t pitch, uint32_t width, uint32_t height) {
+  int image_width, image_height;
+  uint32_t* pixels = (uint32_t*)stbi_load_from_callbacks(&STBI_CALLBACKS, reader, &image_width, &image_height, NULL, 4);
+  if (pixels == NULL)
+    return IMG_ERROR;
+
+  img_scaler_t scaler;
+  if (!img_scaler_init(&scaler, image_width, image_height, dst, pitch, width, height)) {
+    stbi_image_free(pixels);
+    return IMG_ERROR;
+  }
+
+  for (int y = 0; y < image_height; ++y) {
+    // The image is in RGBA, we expect ARGB.
+    uint32_t* row = pixels + (size_t)image_width * y;
+    for (int x = 0; x < image_width; ++x)
+      row[x] = (row[x] & 0xff000000) | (__builtin_bswap32(row[x]) >> 8);
+
+    img_scaler_push_row(&scaler, row);
+  }
+
+  img_scaler_free(&scaler);
+  stbi_image_free(pixels);
+  return IMG_OK;
+}
+
+// ========================================================================
+// Decoder
+
+img_decoder_t* img_open(const char* path) {
+  img_reader_t* reader = malloc(sizeof(img_reader_t));
+  img_decoder_t* image = malloc(sizeof(img_decoder_t));
+  const size_t path_length = strlen(path);
+  char* path_copy = malloc(path_length + 1);
+  if (reader == NULL || image == NULL || path_copy == NULL) {
+    free(reader);
+    free(image);
+    free(path_copy);
+    return NULL;
+  }
+
+  // The reader is closed on error, so it must be opened before any jump to the error path.
+  if (!img_reader_open(reader, path))
+    goto error;
+
+  memcpy(path_copy, path, path_length + 1);
+  image->path = path_copy;
+
+  // The format is detected from the magic number.
+  const uint8_t first_byte = img_reader_byte(reader);
+  const uint8_t second_byte = img_reader_byte(reader);
+  reader->position = 0;
+
+  img_result_t result = IMG_UNSUPPORTED;
+  if (first_byte == 0xff && second_byte == 0xd8) {
+    image->format = IMG_FORMAT_JPEG;
+    result = img_jpeg_read_size(reader, &image->width, &image->height);
+  } else if (first_byte == 0x89 && second_byte == 'P') {
+    image->format = IMG_FORMAT_PNG;
+    result = img_png_read_size(reader, &image->width, &image->height);
+  }
+
+  if (result == IMG_UNSUPPORTED) {
+    // The header may have been read further than the first buffer.
+    img_reader_close(reader);
+    int width, height;
+    if (!img_reader_open(reader, path) || !stbi_info_from_callbacks(&STBI_CALLBACKS, reader, &width, &height, NULL))
+      goto error;
+
+    image->format = IMG_FORMAT_OTHER;
+    image->width = width;
+    image->height = height;
+    result = IMG_OK;
+  }
+
+  if (result != IMG_OK || image->width == 0 || image->height == 0)
+    goto error;
+
+  img_reader_close(reader);
+  free(reader);
+  return image;
+
+error:
+  img_reader_close(reader);
+  free(reader);
+  free(image);
+  free(path_copy);
+  return NULL;
+}
+
+void img_close(img_decoder_t* image) {
+  if (image == NULL)
+    return;
+
+  free(image->path);
+  free(image);
+}
+
+void img_get_size(const img_decoder_t* image, uint32_t* width, uint32_t* height) {
+  if (width != NULL)
+    *width = image->width;
+  if (height != NULL)
+    *height = image->height;
+}
+
+sys_bool_t img_decode(img_decoder_t* image, uint32_t* pixels, uint32_t pitch, uint32_t width, uint32_t height) {
+  if (width == 0 || height == 0)
+    return true;
+
+  img_reader_t* reader = malloc(sizeof(img_reader_t));
+  if (reader == NULL || !img_reader_open(reader, image->path)) {
+    free(reader);
+    return false;
+  }
+
+  img_result_t result = IMG_UNSUPPORTED;
+  if (image->format == IMG_FORMAT_JPEG)
+    result = img_jpeg_decode(reader, pixels, pitch, width, height);
+  else if (image->format == IMG_FORMAT_PNG)
+    result = img_png_decode(reader, pixels, pitch, width, height);
+
+  if (result == IMG_UNSUPPORTED) {
+    // The decoders stop as soon as they find an unsupported feature, the file is read again.
+    img_reader_close(reader);
+    if (img_reader_open(reader, image->path))
+      result = stbi_decode(reader, pixels, pitch, width, height);
+    else
+      result = IMG_ERROR;
+  }
+
+  img_reader_close(reader);
+  free(reader);
+  return result == IMG_OK;
+}
+
+void img_fit_size(const img_decoder_t* image,
+                  uint32_t max_width,
+                  uint32_t max_height,
+                  sys_bool_t upscale,
+                  uint32_t* width,
+                  uint32_t* height) {
+  if (!upscale && image->width <= max_width && image->height <= max_height) {
+    *width = image->width;
+    *height = image->height;
+    return;
+  }
+
+  *width = max_width;
+  *height = max_height;
+  if ((uint64_t)image->width * max_height > (uint64_t)image->height * max_width)
+    *height = (uint64_t)image->height * max_width / image->width;
+  else
+    *width = (uint64_t)image->width * max_height / image->height;
+
+  if (*width == 0)
+    *width = 1;
+  if (*height == 0)
+    *height = 1;
+}
@@ -0,0 +1,46 @@
+#ifndef IMGDEC_IMGDEC_H
+#define IMGDEC_IMGDEC_H
+
+#include <sys/__types.h>
+#include <sys/__utils.h>
+
+__SYS_EXTERN_C_BEGIN
+
+/*
+ * Image decoding library.
+ *
+ * The images are decoded while they are read from the file and written row by row, already scaled, into
+ * the destination pixels (typically a window surface). Baseline JPEG images are downscaled by 2, 4 or 8
+ * directly by the IDCT, then to the requested size. PNG images are decoded and scaled row by row. So the
+ * memory used depends on the destination size and the image width, but not on the image height.
+ *
+ * Progressive JPEG and interlaced PNG images are decoded with stb_image, which needs the whole image in
+ * memory (and is limited to 2000 x 2000 images).
+ */
+
+typedef struct img_decoder_t img_decoder_t;
+
+/* Opens the image file at path and reads its header. Returns NULL if the file cannot be opened or is not
+ * a supported image. */
+img_decoder_t* img_open(const char* path);
+void img_close(img_decoder_t* image);
+
+/* Gets the size of the image, in pixels. */
+void img_get_size(const img_decoder_t* image, uint32_t* width, uint32_t* height);
+
+/* Decodes the image scaled to width * height ARGB pixels (with straight alpha) into pixels, pitch being
+ * the number of pixels between two rows. The image can be decoded several times, at different sizes. */
+sys_bool_t img_decode(img_decoder_t* image, uint32_t* pixels, uint32_t pitch, uint32_t width, uint32_t height);
+
+/* Computes the largest size keeping the aspect ratio of the image that fits in max_width * max_height.
+ * If upscale is false, the image is never enlarged. */
+void img_fit_size(const img_decoder_t* image,
+                  uint32_t max_width,
+                  uint32_t max_height,
+                  sys_bool_t upscale,
+                  uint32_t* width,
+                  uint32_t* height);
+
+__SYS_EXTERN_C_END
+
+#endif  // !IMGDEC_IMGDEC_H
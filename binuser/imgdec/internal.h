@@ -0,0 +1,91 @@
+#ifndef IMGDEC_INTERNAL_H
+#define IMGDEC_INTERNAL_H
+
+#include <sys/file.h>
+#include <sys/syscall.h>
+
+#include "imgdec.h"
+
+#define IMG_READER_BUFFER_SIZE 4096
+
+// The file is read by blocks, so the decoders can read it byte by byte.
+typedef struct img_reader_t {
+  sys_file_t* file;
+  uint8_t buffer[IMG_READER_BUFFER_SIZE];
+  size_t position;
+  size_t size;
+  bool eof;
+} img_reader_t;
+
+bool img_reader_open(img_reader_t* reader, const char* path);
+void img_reader_close(img_reader_t* reader);
+// Refills the buffer, returns false at the end of the file.
+bool img_reader_refill(img_reader_t* reader);
+// Reads up to n bytes, returns the number of bytes read.
+size_t img_reader_read(img_reader_t* reader, void* dst, size_t n);
+bool img_reader_skip(img_reader_t* reader, size_t n);
+
+// Reads a byte, 0 at the end of the file (then reader->eof is set).
+static inline uint8_t img_reader_byte(img_reader_t* reader) {
+  if (reader->position == reader->size && !img_reader_refill(reader))
+    return 0;
+
+  return reader->buffer[reader->position++];
+}
+
+static inline uint32_t img_reader_u16be(img_reader_t* reader) {
+  const uint32_t high = img_reader_byte(reader);
+  return (high << 8) | img_reader_byte(reader);
+}
+
+static inline uint32_t img_reader_u32be(img_reader_t* reader) {
+  const uint32_t high = img_reader_u16be(reader);
+  return (high << 16) | img_reader_u16be(reader);
+}
+
+// Scales the rows of an image as they are decoded, and writes them into the destination pixels.
+// Each destination pixel is the average of the source pixels it covers when shrinking, and a bilinear
+// interpolation when enlarging (independently in each direction). Only two rows of the destination width are allocated.
+typedef struct img_scaler_t {
+  uint32_t src_width, src_height;
+  uint32_t* dst;
+  uint32_t dst_pitch;
+  uint32_t dst_width, dst_height;
+  uint32_t src_y;  // the next source row
+  uint32_t dst_y;  // the next destination row
+  uint32_t* row;       // the last source row, scaled horizontally
+  uint32_t* prev_row;  // the previous one (when enlarging vertically)
+  uint32_t* sums;      // the sums of the channels (when shrinking vertically)
+} img_scaler_t;
+
+bool img_scaler_init(img_scaler_t* scaler,
+                     uint32_t src_width,
+                     uint32_t src_height,
+                     uint32_t* dst,
+                     uint32_t dst_pitch,
+                     uint32_t dst_width,
+                     uint32_t dst_height);
+void img_scaler_free(img_scaler_t* scaler);
+// Pushes the next source row (src_width ARGB pixels).
+void img_scaler_push_row(img_scaler_t* scaler, const uint32_t* argb);
+
+typedef enum img_result_t {
+  IMG_OK,
+  IMG_ERROR,
+  IMG_UNSUPPORTED,  // valid, but must be decoded by stb_image
+} img_result_t;
+
+// The decoders read the header (and the image size) with xxx_read_size(), and decode the image from the
+// start of the file with xxx_decode(). The destination size is given to the JPEG decoder so it can select
+// the IDCT scale.
+img_result_t img_jpeg_read_size(img_reader_t* reader, uint32_t* width, uint32_t* height);
+img_result_t img_jpeg_decode(img_reader_t* reader, uint32_t* dst, uint32_t pitch, uint32_t width, uint32_t height);
+img_result_t img_png_read_size(img_reader_t* reader, uint32_t* width, uint32_t* height);
+img_result_t img_png_decode(img_reader_t* reader, uint32_t* dst, uint32_t pitch, uint32_t width, uint32_t height);
+
+// Converts n YCbCr (JFIF) pixels to opaque ARGB.
+void img_ycbcr_to_argb(uint32_t* dst, const uint8_t* y, const uint8_t* cb, const uint8_t* cr, size_t n);
+// Converts n gray pixels to opaque ARGB.
+void img_gray_to_argb(uint32_t* dst, const uint8_t* y, size_t n);
+
+#endif  // !IMGDEC_INTERNAL_H
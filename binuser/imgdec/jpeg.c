@@ -0,0 +1,746 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "internal.h"
+
+// Baseline JPEG decoder (Huffman coding, 8-bit samples, grayscale or YCbCr, in a single scan).
+//
+// The image is decoded one MCU row at a time. To decode at 1/2, 1/4 or 1/8 scale, each 8x8 block
+// is directly transformed into a 4x4, 2x2 or 1x1 block by an IDCT reduced to its low frequencies,
+// so the skipped pixels are never computed. The chroma components are upsampled by replicating their
+// pixels (the sampling factors are kept at the reduced scale).
+
+#define MAX_COMPONENTS 3
+#define FAST_BITS 9
+#define NO_SYMBOL 0xffff
+
+#define MARKER_SOF0 0xc0
+#define MARKER_SOF1 0xc1
+#define MARKER_DHT 0xc4
+#define MARKER_RST0 0xd0
+#define MARKER_RST7 0xd7
+#define MARKER_SOI 0xd8
+#define MARKER_EOI 0xd9
+#define MARKER_SOS 0xda
+#define MARKER_DQT 0xdb
+#define MARKER_DRI 0xdd
+#define MARKER_APP14 0xee
+
+// The natural index of the coefficients, in the zigzag order of the file.
+static const uint8_t ZIGZAG[64] = {
+    0,  1,  8,  16, 9,  2,  3,  10, 17, 24, 32, 25, 18, 11, 4,  5,  12, 19, 26, 33, 40, 48,
+    41, 34, 27, 20, 13, 6,  7,  14, 21, 28, 35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23,
+    30, 37, 44, 51, 58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63,
+};
+
+typedef struct huffman_t {
+  uint16_t fast[1 << FAST_BITS];  // the symbol index of the codes of at most FAST_BITS bits, or NO_SYMBOL
+  uint8_t sizes[256];
+  uint8_t values[256];
+  uint32_t maxcode[18];  // the codes of each length are below this bound (aligned on 16 bits)
+  int32_t delta[17];     // the symbol index minus the code, for each length
+} huffman_t;
+
+typedef struct component_t {
+  uint8_t id;
+  uint8_t h, v;  // sampling factors
+  uint8_t quantization_table;
+  uint8_t dc_table, ac_table;
+  int32_t dc_prediction;
+  uint8_t* plane;  // the pixels of the current MCU row, at the output scale
+  uint32_t plane_width;
+  uint8_t* row;  // an upsampled row, if the component is subsampled
+} component_t;
+
+typedef struct jpeg_t {
+  img_reader_t* reader;
+  uint16_t quantization_tables[4][64];  // in natural order
+  huffman_t huffman_tables[2][4];       // DC and AC tables
+  bool has_quantization_table[4];
+  bool has_huffman_table[2][4];
+  uint32_t width, height;
+  uint32_t nb_components;
+  component_t components[MAX_COMPONENTS];
+  uint32_t h_max, v_max;
+  uint32_t restart_interval;
+  int32_t adobe_transform;  // -1 without an Adobe segment
+
+  // The entropy decoder state: the bits are read from the most significant one.
+  uint32_t bits;
+  int32_t nb_bits;
+  uint8_t marker;  // the marker found in the entropy coded data, no more bytes are read after it
+} jpeg_t;
+
+// ========================================================================
+// Markers
+
+static bool build_huffman(huffman_t* huffman, const uint8_t counts[16]) {
+  uint16_t codes[256];
+  uint32_t k = 0, code = 0;
+  for (uint32_t size = 1; size <= 16; ++size) {
+    huffman->delta[size] = (int32_t)k - (int32_t)code;
+    for (uint32_t i = 0; i < counts[size - 1]; ++i) {
+      huffman->sizes[k] = size;
+      codes[k++] = code++;
+    }
+
+    if (code > (1u << size))
+      return false;  // more codes than possible
+
+    huffman->maxcode[size] = code << (16 - size);
+    code <<= 1;
+  }
+
+  huffman->maxcode[17] = UINT32_MAX;
+
+  memset(huffman->fast, 0xff, sizeof(huffman->fast));
+  for (uint32_t i = 0; i < k; ++i) {
+    const uint32_t size = huffman->sizes[i];
+    if (size > FAST_BITS)
+      continue;
+
+    const uint32_t first = codes[i] << (FAST_BITS - size);
+    for (uint32_t j = 0; j < (1u << (FAST_BITS - size)); ++j)
+      huffman->fast[first + j] = i;
+  }
+
+  return true;
+}
+
+static bool read_huffman_tables(jpeg_t* jpeg, uint32_t length) {
+  while (length > 0) {
+    const uint32_t type = img_reader_byte(jpeg->reader);
+    const uint32_t table_class = type >> 4;
+    const uint32_t index = type & 0xf;
+    if (table_class > 1 || index > 3 || length < 17)
+      return false;
+
+    uint8_t counts[16];
+    uint32_t nb_values = 0;
+    for (uint32_t i = 0; i < 16; ++i) {
+      counts[i] = img_reader_byte(jpeg->reader);
+      nb_values += counts[i];
+    }
+
+    huffman_t* huffman = &jpeg->huffman_tables[table_class][index];
+    if (nb_values > 256 || 17 + nb_values > length ||
+        img_reader_read(jpeg->reader, huffman->values, nb_values) != nb_values || !build_huffman(huffman, counts))
+      return false;
+
+    jpeg->has_huffman_table[table_class][index] = true;
+    length -= 17 + nb_values;
+  }
+
+  return true;
+}
+
+static bool read_quantization_tables(jpeg_t* jpeg, uint32_t length) {
+  while (length > 0) {
+    const uint32_t type = img_reader_byte(jpeg->reader);
+    const uint32_t precision = type >> 4;  // 8 or 16 bits
+    const uint32_t index = type & 0xf;
+    const uint32_t size = 1 + 64 * (precision + 1);
+    if (precision > 1 || index > 3 || size > length)
+      return false;
+
+    for (uint32_t i = 0; i < 64; ++i) {
+      const uint32_t value = precision ? img_reader_u16be(jpeg->reader) : img_reader_byte(jpeg->reader);
+      jpeg->quantization_tables[index][ZIGZAG[i]] = value;
+    }
+
+    jpeg->has_quantization_table[index] = true;
+    length -= size;
+  }
+
+  return true;
+}
+
+static img_result_t read_frame(jpeg_t* jpeg, uint32_t length) {
+  img_reader_t* reader = jpeg->reader;
+  if (img_reader_byte(reader) != 8)
+    return IMG_UNSUPPORTED;  // 12-bit samples
+
+  jpeg->height = img_reader_u16be(reader);
+  jpeg->width = img_reader_u16be(reader);
+  jpeg->nb_components = img_reader_byte(reader);
+  if (jpeg->height == 0 || (jpeg->nb_components != 1 && jpeg->nb_components != 3))
+    return IMG_UNSUPPORTED;  // height defined later by a DNL marker, or CMYK image
+  if (jpeg->width == 0 || length != 6 + 3 * jpeg->nb_components)
+    return IMG_ERROR;
+
+  jpeg->h_max = 1;
+  jpeg->v_max = 1;
+  for (uint32_t i = 0; i < jpeg->nb_components; ++i) {
+    component_t* component = &jpeg->components[i];
+    component->id = img_reader_byte(reader);
+    const uint32_t sampling = img_reader_byte(reader);
+    component->h = sampling >> 4;
+    component->v = sampling & 0xf;
+    component->quantization_table = img_reader_byte(reader);
+    if (component->h == 0 || component->h > 4 || component->v == 0 || component->v > 4 ||
+        component->quantization_table > 3)
+      return IMG_ERROR;
+
+    // The MCU of a single component image is always a single block.
+    if (jpeg->nb_components == 1)
+      component->h = component->v = 1;
+
+    if (component->h > jpeg->h_max)
+      jpeg->h_max = component->h;
+    if (component->v > jpeg->v_max)
+      jpeg->v_max = component->v;
+  }
+
+  // Only integer upsampling factors are supported (as 4:2:0, 4:2:2 or 4:4:0).
+  for (uint32_t i = 0; i < jpeg->nb_components; ++i) {
+    if (jpeg->h_max % jpeg->components[i].h != 0 || jpeg->v_max % jpeg->components[i].v != 0)
+      return IMG_UNSUPPORTED;
+  }
+
+  return reader->eof ? IMG_ERROR : IMG_OK;
+}
+
+static img_result_t read_scan(jpeg_t* jpeg, uint32_t length) {
+  img_reader_t* reader = jpeg->reader;
+  const uint32_t nb_components = img_reader_byte(reader);
+  if (nb_components != jpeg->nb_components)
+    return IMG_UNSUPPORTED;  // each component in its own scan
+  if (length != 4 + 2 * nb_components)
+    return IMG_ERROR;
+
+  for (uint32_t i = 0; i < nb_components; ++i) {
+    const uint32_t id = img_reader_byte(reader);
+    const uint32_t tables = img_reader_byte(reader);
+    component_t* component = NULL;
+    for (uint32_t j = 0; j < jpeg->nb_components; ++j) {
+      if (jpeg->components[j].id == id)
+        component = &jpeg->components[j];
+    }
+
+    if (component == NULL)
+      return IMG_ERROR;
+
+    component->dc_table = tables >> 4;
+    component->ac_table = tables & 0xf;
+    if (component->dc_table > 3 || component->ac_table > 3 || !jpeg->has_huffman_table[0][component->dc_table] ||
+        !jpeg->has_huffman_table[1][component->ac_table] ||
+        !jpeg->has_quantization_table[component->quantization_table])
+      return IMG_ERROR;
+  }
+
+  // The spectral selection and successive approximation are fixed for baseline images.
+  img_reader_skip(reader, 3);
+  return reader->eof ? IMG_ERROR : IMG_OK;
+}
+
+// Reads the next marker, skipping the bytes before it. Returns 0 at the end of the file.
+static uint32_t read_marker(img_reader_t* reader) {
+  while (!reader->eof) {
+    if (img_reader_byte(reader) != 0xff)
+      continue;
+
+    uint32_t marker;
+    do {
+      marker = img_reader_byte(reader);
+    } while (marker == 0xff);
+
+    if (marker != 0)
+      return reader->eof ? 0 : marker;
+  }
+
+  return 0;
+}
+
+// Reads the segments until the start of the scan (or only until the frame header if until_scan is false).
+static img_result_t read_segments(jpeg_t* jpeg, bool until_scan) {
+  img_reader_t* reader = jpeg->reader;
+  if (img_reader_byte(reader) != 0xff || img_reader_byte(reader) != MARKER_SOI)
+    return IMG_ERROR;
+
+  jpeg->adobe_transform = -1;
+  bool has_frame = false;
+  for (;;) {
+    const uint32_t marker = read_marker(reader);
+    if (marker == 0 || marker == MARKER_EOI)
+      return IMG_ERROR;
+    if (marker >= MARKER_RST0 && marker <= MARKER_RST7)
+      continue;  // no segment
+
+    const uint32_t length = img_reader_u16be(reader);
+    if (length < 2)
+      return IMG_ERROR;
+
+    img_result_t result = IMG_OK;
+    switch (marker) {
+      case MARKER_SOF0:
+      case MARKER_SOF1:
+        if (has_frame)
+          return IMG_ERROR;
+
+        result = read_frame(jpeg, length - 2);
+        has_frame = true;
+        if (result == IMG_OK && !until_scan)
+          return IMG_OK;
+        break;
+      case MARKER_DHT:
+        result = read_huffman_tables(jpeg, length - 2) ? IMG_OK : IMG_ERROR;
+        break;
+      case MARKER_DQT:
+        result = read_quantization_tables(jpeg, length - 2) ? IMG_OK : IMG_ERROR;
+        break;
+      case MARKER_DRI:
+        if (length != 4)
+          return IMG_ERROR;
+
+        jpeg->restart_interval = img_reader_u16be(reader);
+        break;
+      case MARKER_SOS:
+        return has_frame ? read_scan(jpeg, length - 2) : IMG_ERROR;
+      case MARKER_APP14: {
+        // The Adobe segment tells if the 3 components are YCbCr (transform 1) or RGB (transform 0).
+        uint8_t adobe[12];
+        if (length - 2 >= sizeof(adobe)) {
+          img_reader_read(reader, adobe, sizeof(adobe));
+          if (memcmp(adobe, "Adobe", 5) == 0)
+            jpeg->adobe_transform = adobe[11];
+          img_reader_skip(reader, length - 2 - sizeof(adobe));
+        } else {
+          img_reader_skip(reader, length - 2);
+        }
+        break;
+      }
+      default:
+        // Progressive, lossless, hierarchical or arithmetic coded frames.
+        if (marker >= 0xc2 && marker <= 0xcf)
+          return IMG_UNSUPPORTED;
+
+        img_reader_skip(reader, length - 2);
+        break;
+    }
+
+    if (result != IMG_OK)
+      return result;
+  }
+}
+
+img_result_t img_jpeg_read_size(img_reader_t* reader, uint32_t* width, uint32_t* height) {
+  jpeg_t* jpeg = malloc(sizeof(jpeg_t));
+  if (jpeg == NULL)
+    return IMG_ERROR;
+
+  memset(jpeg, 0, sizeof(jpeg_t));
+  jpeg->reader = reader;
+  const img_result_t result = read_segments(jpeg, false);
+  *width = jpeg->width;
+  *height = jpeg->height;
+  free(jpeg);
+  return result;
+}
+
+// ========================================================================
+// Entropy decoding
+
+static void fill_bits(jpeg_t* jpeg) {
+  while (jpeg->nb_bits <= 24) {
+    uint32_t byte = 0;
+    if (jpeg->marker == 0) {
+      byte = img_reader_byte(jpeg->reader);
+      if (byte == 0xff) {
+        // A zero byte follows the 0xff data bytes, otherwise this is a marker (fill bytes are skipped).
+        uint32_t next;
+        do {
+          next = img_reader_byte(jpeg->reader);
+        } while (next == 0xff);
+
+        if (next != 0) {
+          jpeg->marker = next;
+          byte = 0;
+        }
+      }
+
+      // A truncated image ends as if it was filled with zeros.
+      if (jpeg->reader->eof)
+        jpeg->marker = MARKER_EOI;
+    }
+
+    jpeg->bits |= byte << (24 - jpeg->nb_bits);
+    jpeg->nb_bits += 8;
+  }
+}
+
+// Reads size bits (at most 16).
+static inline uint32_t get_bits(jpeg_t* jpeg, uint32_t size) {
+  if (jpeg->nb_bits < (int32_t)size)
+    fill_bits(jpeg);
+
+  const uint32_t value = jpeg->bits >> (32 - size);
+  jpeg->bits <<= size;
+  jpeg->nb_bits -= size;
+  return value;
+}
+
+// Converts the size bits value read for a coefficient to a signed value.
+static inline int32_t extend(uint32_t value, uint32_t size) {
+  return value < (1u << (size - 1)) ? (int32_t)value - (int32_t)(1u << size) + 1 : (int32_t)value;
+}
+
+// Decodes a symbol, returns -1 if the code is invalid.
+static inline int32_t decode_huffman(jpeg_t* jpeg, const huffman_t* huffman) {
+  if (jpeg->nb_bits < 16)
+    fill_bits(jpeg);
+
+  uint32_t index = huffman->fast[jpeg->bits >> (32 - FAST_BITS)];
+  uint32_t size;
+  if (index != NO_SYMBOL) {
+    size = huffman->sizes[index];
+  } else {
+    const uint32_t code = jpeg->bits >> 16;
+    for (size = FAST_BITS + 1; code >= huffman->maxcode[size]; ++size) {
+    }
+
+    if (size > 16)
+      return -1;
+
+    index = (code >> (16 - size)) + huffman->delta[size];
+  }
+
+  jpeg->bits <<= size;
+  jpeg->nb_bits -= size;
+  return huffman->values[index];
+}
+
+static inline int32_t dequantize(int32_t value, uint32_t quantization) {
+  value *= (int32_t)quantization;
+  return value < -32768 ? -32768 : (value > 32767 ? 32767 : value);
+}
+
+// Decodes the coefficients of a block. Only the n x n low frequencies used by the IDCT are stored (in
+// natural order, with rows of 8 coefficients), the other ones are skipped.
+static bool decode_block(jpeg_t* jpeg, component_t* component, int32_t coefficients[64], uint32_t n) {
+  const uint16_t* quantization = jpeg->quantization_tables[component->quantization_table];
+  for (uint32_t y = 0; y < n; ++y)
+    memset(coefficients + 8 * y, 0, sizeof(int32_t) * n);
+
+  const int32_t dc_size = decode_huffman(jpeg, &jpeg->huffman_tables[0][component->dc_table]);
+  if (dc_size < 0 || dc_size > 16)
+    return false;
+
+  if (dc_size > 0)
+    component->dc_prediction += extend(get_bits(jpeg, dc_size), dc_size);
+  coefficients[0] = dequantize(component->dc_prediction, quantization[0]);
+
+  const huffman_t* ac_table = &jpeg->huffman_tables[1][component->ac_table];
+  for (uint32_t k = 1; k < 64;) {
+    const int32_t symbol = decode_huffman(jpeg, ac_table);
+    if (symbol < 0)
+      return false;
+
+    const uint32_t run = symbol >> 4;
+    const uint32_t size = symbol & 0xf;
+    if (size == 0) {
+      if (run != 15)
+        break;  // end of block
+
+      k += 16;
+      continue;
+    }
+
+    k += run;
+    if (k > 63)
+      return false;
+
+    const int32_t value = extend(get_bits(jpeg, size), size);
+    const uint32_t index = ZIGZAG[k++];
+    if (index % 8 < n && index / 8 < n)
+      coefficients[index] = dequantize(value, quantization[index]);
+  }
+
+  return true;
+}
+
+// Skips the entropy coded data until the next restart marker, and resets the decoder.
+static void restart(jpeg_t* jpeg) {
+  jpeg->bits = 0;
+  jpeg->nb_bits = 0;
+  if (jpeg->marker == 0)
+    jpeg->marker = read_marker(jpeg->reader);
+
+  // Another marker (or the end of the file) ends the image: the remaining blocks are decoded from zeros.
+  if (jpeg->marker >= MARKER_RST0 && jpeg->marker <= MARKER_RST7)
+    jpeg->marker = 0;
+  else if (jpeg->marker == 0)
+    jpeg->marker = MARKER_EOI;
+
+  for (uint32_t i = 0; i < jpeg->nb_components; ++i)
+    jpeg->components[i].dc_prediction = 0;
+}
+
+// ========================================================================
+// IDCT
+
+static inline uint8_t clamp_u8(int32_t value) {
+  return value < 0 ? 0 : (value > 255 ? 255 : value);
+}
+
+// The constants have 12 fractional bits, and the first pass keeps 2 more bits of precision.
+#define CONST_BITS 12
+#define PASS1_BITS 2
+#define FIX(x) ((int32_t)((x) * (1 << CONST_BITS) + 0.5))
+
+// The 8-point IDCT (from Loeffler, Ligtenberg and Moschytz), of the values in[i * stride]. The outputs
+// are scaled by sqrt(8) << CONST_BITS.
+static inline void idct_1d(const int32_t* in, uint32_t stride, int32_t out[8]) {
+  // Even part.
+  int32_t p1 = (in[2 * stride] + in[6 * stride]) * FIX(0.541196100);
+  const int32_t t2 = p1 + in[6 * stride] * FIX(-1.847759065);
+  const int32_t t3 = p1 + in[2 * stride] * FIX(0.765366865);
+  const int32_t t0 = (in[0] + in[4 * stride]) * (1 << CONST_BITS);
+  const int32_t t1 = (in[0] - in[4 * stride]) * (1 << CONST_BITS);
+  const int32_t x0 = t0 + t3;
+  const int32_t x3 = t0 - t3;
+  const int32_t x1 = t1 + t2;
+  const int32_t x2 = t1 - t2;
+
+  // Odd part.
+  int32_t o0 = in[7 * stride];
+  int32_t o1 = in[5 * stride];
+  int32_t o2 = in[3 * stride];
+  int32_t o3 = in[1 * stride];
+  int32_t p3 = o0 + o2;
+  int32_t p4 = o1 + o3;
+  p1 = o0 + o3;
+  int32_t p2 = o1 + o2;
+  const int32_t p5 = (p3 + p4) * FIX(1.175875602);
+  o0 *= FIX(0.298631336);
+  o1 *= FIX(2.053119869);
+  o2 *= FIX(3.072711026);
+  o3 *= FIX(1.501321110);
+  p1 = p5 + p1 * FIX(-0.899976223);
+  p2 = p5 + p2 * FIX(-2.562915447);
+  p3 *= FIX(-1.961570560);
+  p4 *= FIX(-0.390180644);
+  o3 += p1 + p4;
+  o2 += p2 + p3;
+  o1 += p2 + p4;
+  o0 += p1 + p3;
+
+  out[0] = x0 + o3;
+  out[7] = x0 - o3;
+  out[1] = x1 + o2;
+  out[6] = x1 - o2;
+  out[2] = x2 + o1;
+  out[5] = x2 - o1;
+  out[3] = x3 + o0;
+  out[4] = x3 - o0;
+}
+
+static void idct_8x8(const int32_t* in, uint8_t* out, uint32_t stride) {
+  int32_t tmp[64];
+  int32_t values[8];
+
+  // Columns.
+  for (uint32_t x = 0; x < 8; ++x) {
+    const int32_t* column = in + x;
+    if (column[8] == 0 && column[16] == 0 && column[24] == 0 && column[32] == 0 && column[40] == 0 &&
+        column[48] == 0 && column[56] == 0) {
+      for (uint32_t y = 0; y < 8; ++y)
+        tmp[x + 8 * y] = column[0] * (1 << PASS1_BITS);
+      continue;
+    }
+
+    idct_1d(column, 8, values);
+    for (uint32_t y = 0; y < 8; ++y)
+      tmp[x + 8 * y] = (values[y] + (1 << (CONST_BITS - PASS1_BITS - 1))) >> (CONST_BITS - PASS1_BITS);
+  }
+
+  // Rows, with the level shift. The outputs are scaled by 8 << (CONST_BITS + PASS1_BITS).
+  const uint32_t shift = CONST_BITS + PASS1_BITS + 3;
+  const int32_t offset = (1 << (shift - 1)) + (128 << shift);
+  for (uint32_t y = 0; y < 8; ++y, out += stride) {
+    idct_1d(tmp + 8 * y, 1, values);
+    for (uint32_t x = 0; x < 8; ++x)
+      out[x] = clamp_u8((values[x] + offset) >> shift);
+  }
+}
+
+// The reduced IDCTs evaluate the 8x8 IDCT at the center of each 2x2 or 4x4 group of pixels, which is
+// an IDCT of the n x n low frequencies: MATRIX_N[x][u] = C(u) / 2 * cos((2x + 1) * u * pi / (2n)).
+static const int32_t MATRIX_4[4][4] = {
+    {1448, 1892, 1448, 784},
+    {1448, 784, -1448, -1892},
+    {1448, -784, -1448, 1892},
+    {1448, -1892, 1448, -784},
+};
+
+static const int32_t MATRIX_2[2][2] = {
+    {1448, 1448},
+    {1448, -1448},
+};
+
+static void idct_reduced(const int32_t* in, uint8_t* out, uint32_t stride, uint32_t n, const int32_t* matrix) {
+  int32_t tmp[16];
+
+  // Columns.
+  for (uint32_t x = 0; x < n; ++x) {
+    for (uint32_t y = 0; y < n; ++y) {
+      int32_t sum = 0;
+      for (uint32_t v = 0; v < n; ++v)
+        sum += matrix[y * n + v] * in[x + 8 * v];
+      tmp[x + 4 * y] = (sum + (1 << (CONST_BITS - PASS1_BITS - 1))) >> (CONST_BITS - PASS1_BITS);
+    }
+  }
+
+  // Rows, with the level shift.
+  const uint32_t shift = CONST_BITS + PASS1_BITS;
+  const int32_t offset = (1 << (shift - 1)) + (128 << shift);
+  for (uint32_t y = 0; y < n; ++y, out += stride) {
+    for (uint32_t x = 0; x < n; ++x) {
+      int32_t sum = 0;
+      for (uint32_t u = 0; u < n; ++u)
+        sum += matrix[x * n + u] * tmp[u + 4 * y];
+      out[x] = clamp_u8((sum + offset) >> shift);
+    }
+  }
+}
+
+// Transforms the block into n x n pixels.
+static void idct(const int32_t* coefficients, uint8_t* out, uint32_t stride, uint32_t n) {
+  switch (n) {
+    case 8:
+      idct_8x8(coefficients, out, stride);
+      break;
+    case 4:
+      idct_reduced(coefficients, out, stride, 4, &MATRIX_4[0][0]);
+      break;
+    case 2:
+      idct_reduced(coefficients, out, stride, 2, &MATRIX_2[0][0]);
+      break;
+    default:
+      // Only the average of the block (the DC coefficient is 8 times it).
+      out[0] = clamp_u8(((coefficients[0] + 4) >> 3) + 128);
+      break;
+  }
+}
+
+// ========================================================================
+// Decoding
+
+static void free_planes(jpeg_t* jpeg) {
+  for (uint32_t i = 0; i < jpeg->nb_components; ++i) {
+    free(jpeg->components[i].plane);
+    free(jpeg->components[i].row);
+  }
+}
+
+// Writes the rows of the MCU row mcu_y into the scaler.
+static void output_rows(jpeg_t* jpeg,
+                        img_scaler_t* scaler,
+                        uint32_t* argb,
+                        uint32_t mcu_y,
+                        uint32_t n,
+                        uint32_t width,
+                        uint32_t height) {
+  const uint32_t nb_rows = jpeg->v_max * n;
+  const uint8_t* rows[MAX_COMPONENTS];
+  for (uint32_t r = 0; r < nb_rows && mcu_y * nb_rows + r < height; ++r) {
+    for (uint32_t i = 0; i < jpeg->nb_components; ++i) {
+      component_t* component = &jpeg->components[i];
+      const uint8_t* src = component->plane + component->plane_width * (r * component->v / jpeg->v_max);
+      if (component->h == jpeg->h_max) {
+        rows[i] = src;
+        continue;
+      }
+
+      const uint32_t factor = jpeg->h_max / component->h;
+      uint8_t* dst = component->row;
+      for (uint32_t x = 0; x < width; ++src) {
+        for (uint32_t k = 0; k < factor && x < width; ++k)
+          dst[x++] = *src;
+      }
+
+      rows[i] = component->row;
+    }
+
+    if (jpeg->nb_components == 3)
+      img_ycbcr_to_argb(argb, rows[0], rows[1], rows[2], width);
+    else
+      img_gray_to_argb(argb, rows[0], width);
+    img_scaler_push_row(scaler, argb);
+  }
+}
+
+img_result_t img_jpeg_decode(img_reader_t* reader, uint32_t* dst, uint32_t pitch, uint32_t width, uint32_t height) {
+  jpeg_t* jpeg = malloc(sizeof(jpeg_t));
+  if (jpeg == NULL)
+    return IMG_ERROR;
+
+  memset(jpeg, 0, sizeof(jpeg_t));
+  jpeg->reader = reader;
+  img_result_t result = read_segments(jpeg, true);
+  if (result == IMG_OK && jpeg->nb_components == 3 && jpeg->adobe_transform == 0)
+    result = IMG_UNSUPPORTED;  // RGB components
+
+  if (result != IMG_OK) {
+    free(jpeg);
+    return result;
+  }
+
+  // The block size at the output scale: the smallest one giving an image at least as large as the destination.
+  uint32_t n = 8;
+  while (n > 1 && (jpeg->width * (n / 2) + 7) / 8 >= width && (jpeg->height * (n / 2) + 7) / 8 >= height)
+    n /= 2;
+
+  const uint32_t scaled_width = (jpeg->width * n + 7) / 8;
+  const uint32_t scaled_height = (jpeg->height * n + 7) / 8;
+  const uint32_t nb_mcus_x = (jpeg->width + 8 * jpeg->h_max - 1) / (8 * jpeg->h_max);
+  const uint32_t nb_mcus_y = (jpeg->height + 8 * jpeg->v_max - 1) / (8 * jpeg->v_max);
+
+  // Only an MCU row of each component and a row of pixels are allocated.
+  bool ok = true;
+  for (uint32_t i = 0; i < jpeg->nb_components; ++i) {
+    component_t* component = &jpeg->components[i];
+    component->plane_width = nb_mcus_x * component->h * n;
+    component->plane = malloc((size_t)component->plane_width * component->v * n);
+    if (component->h != jpeg->h_max)
+      component->row = malloc(nb_mcus_x * jpeg->h_max * n);
+    ok = ok && component->plane != NULL && (component->h == jpeg->h_max || component->row != NULL);
+  }
+
+  uint32_t* argb = malloc(sizeof(uint32_t) * scaled_width);
+  img_scaler_t scaler;
+  if (!ok || argb == NULL || !img_scaler_init(&scaler, scaled_width, scaled_height, dst, pitch, width, height)) {
+    free(argb);
+    free_planes(jpeg);
+    free(jpeg);
+    return IMG_ERROR;
+  }
+
+  int32_t coefficients[64];
+  uint32_t mcu_index = 0;
+  for (uint32_t mcu_y = 0; mcu_y < nb_mcus_y && ok; ++mcu_y) {
+    for (uint32_t mcu_x = 0; mcu_x < nb_mcus_x && ok; ++mcu_x, ++mcu_index) {
+      if (jpeg->restart_interval != 0 && mcu_index != 0 && mcu_index % jpeg->restart_interval == 0)
+        restart(jpeg);
+
+      for (uint32_t i = 0; i < jpeg->nb_components && ok; ++i) {
+        component_t* component = &jpeg->components[i];
+        for (uint32_t by = 0; by < component->v && ok; ++by) {
+          for (uint32_t bx = 0; bx < component->h && ok; ++bx) {
+            ok = decode_block(jpeg, component, coefficients, n);
+            uint8_t* out = component->plane + component->plane_width * by * n + (mcu_x * component->h + bx) * n;
+            idct(coefficients, out, component->plane_width, n);
+          }
+        }
+      }
+    }
+
+    if (ok)
+      output_rows(jpeg, &scaler, argb, mcu_y, n, scaled_width, scaled_height);
+  }
+
+  img_scaler_free(&scaler);
+  free(argb);
+  free_planes(jpeg);
+  free(jpeg);
+  return ok ? IMG_OK : IMG_ERROR;
+}
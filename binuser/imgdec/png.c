@@ -0,0 +1,638 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "internal.h"
+
+// PNG decoder (all color types and depths, without interlacing).
+//
+// The compressed data is inflated as the rows are needed, so only the inflate window (32 KiB)
+// and two rows of the image are kept in memory. Each row is unfiltered, converted to ARGB and
+// scaled into the destination right away.
+
+#define CHUNK_IHDR 0x49484452
+#define CHUNK_PLTE 0x504c5445
+#define CHUNK_TRNS 0x74524e53
+#define CHUNK_IDAT 0x49444154
+#define CHUNK_IEND 0x49454e44
+
+#define COLOR_GRAY 0
+#define COLOR_RGB 2
+#define COLOR_PALETTE 3
+#define COLOR_GRAY_ALPHA 4
+#define COLOR_RGB_ALPHA 6
+
+#define FAST_BITS 9
+#define WINDOW_SIZE 32768
+
+typedef enum block_type_t {
+  BLOCK_NONE,  // the next block header must be read
+  BLOCK_STORED,
+  BLOCK_HUFFMAN,
+} block_type_t;
+
+// A canonical Huffman code of the deflate format (whose codes are stored from their most significant bit).
+typedef struct huffman_t {
+  uint16_t fast[1 << FAST_BITS];  // (size << 9) | symbol for the codes of at most FAST_BITS bits, 0 otherwise
+  uint16_t first_code[17];
+  uint16_t first_symbol[17];
+  uint32_t maxcode[17];  // the codes of each length are below this bound (aligned on 16 bits)
+  uint16_t symbols[288];
+} huffman_t;
+
+typedef struct png_t {
+  img_reader_t* reader;
+  uint32_t chunk_left;  // the bytes left in the current IDAT chunk
+
+  // The inflate state: the bits are read from the least significant one.
+  uint32_t bits;
+  uint32_t nb_bits;
+  uint8_t window[WINDOW_SIZE];
+  uint32_t window_position;
+  uint32_t window_filled;
+  block_type_t block_type;
+  bool final_block;
+  uint32_t stored_left;
+  uint32_t match_left, match_distance;
+  huffman_t lengths, distances;
+
+  // The image.
+  uint32_t width, height;
+  uint32_t depth;
+  uint32_t color_type;
+  uint32_t palette[256];
+  bool has_key;
+  uint16_t key[3];  // the transparent color (tRNS chunk)
+} png_t;
+
+static const uint16_t LENGTH_BASES[29] = {3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+                                          31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const uint8_t LENGTH_EXTRA_BITS[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                              2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const uint16_t DISTANCE_BASES[30] = {1,    2,    3,    4,    5,    7,     9,     13,    17,  25,
+                                            33,   49,   65,   97,   129,  193,   257,   385,   513, 769,
+                                            1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const uint8_t DISTANCE_EXTRA_BITS[30] = {0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+                                                6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+static const uint8_t CODE_LENGTH_ORDER[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+// ========================================================================
+// Inflate
+
+// Reads a byte of the compressed data, crossing the IDAT chunks. Returns 0 after the last one.
+static uint32_t read_data_byte(png_t* png) {
+  img_reader_t* reader = png->reader;
+  while (png->chunk_left == 0) {
+    if (reader->eof)
+      return 0;
+
+    img_reader_skip(reader, 4);  // CRC
+    const uint32_t length = img_reader_u32be(reader);
+    if (img_reader_u32be(reader) != CHUNK_IDAT) {
+      reader->eof = true;  // no more data is read
+      return 0;
+    }
+
+    png->chunk_left = length;
+  }
+
+  --png->chunk_left;
+  return img_reader_byte(reader);
+}
+
+static inline void need_bits(png_t* png, uint32_t n) {
+  while (png->nb_bits < n) {
+    png->bits |= read_data_byte(png) << png->nb_bits;
+    png->nb_bits += 8;
+  }
+}
+
+// Reads n bits (at most 16).
+static inline uint32_t get_bits(png_t* png, uint32_t n) {
+  need_bits(png, n);
+  const uint32_t value = png->bits & ((1u << n) - 1);
+  png->bits >>= n;
+  png->nb_bits -= n;
+  return value;
+}
+
+static uint32_t reverse_bits(uint32_t value, uint32_t n) {
+  uint32_t result = 0;
+  for (uint32_t i = 0; i < n; ++i, value >>= 1)
+    result = (result << 1) | (value & 1);
+  return result;
+}
+
+static bool build_huffman(huffman_t* huffman, const uint8_t* sizes, uint32_t nb_symbols) {
+  uint32_t counts[17] = {0};
+  for (uint32_t i = 0; i < nb_symbols; ++i)
+    ++counts[sizes[i]];
+
+  uint16_t next_symbol[17];
+  uint32_t code = 0, k = 0;
+  for (uint32_t size = 1; size <= 16; ++size) {
+    huffman->first_code[size] = code;
+    huffman->first_symbol[size] = k;
+    next_symbol[size] = k;
+    code += counts[size];
+    k += counts[size];
+    if (code > (1u << size))
+      return false;  // more codes than possible (incomplete codes are allowed)
+
+    huffman->maxcode[size] = code << (16 - size);
+    code <<= 1;
+  }
+
+  memset(huffman->fast, 0, sizeof(huffman->fast));
+  for (uint32_t symbol = 0; symbol < nb_symbols; ++symbol) {
+    const uint32_t size = sizes[symbol];
+    if (size == 0)
+      continue;
+
+    const uint32_t index = next_symbol[size]++;
+    huffman->symbols[index] = symbol;
+    if (size > FAST_BITS)
+      continue;
+
+    // The bits are read from the least significant one, so the fast table is indexed by the reversed codes.
+    const uint32_t reversed = reverse_bits(huffman->first_code[size] + index - huffman->first_symbol[size], size);
+    for (uint32_t j = reversed; j < (1u << FAST_BITS); j += 1u << size)
+      huffman->fast[j] = (size << 9) | symbol;
+  }
+
+  return true;
+}
+
+// Decodes a symbol, returns -1 if the code is invalid.
+static inline int32_t decode_huffman(png_t* png, const huffman_t* huffman) {
+  need_bits(png, 16);
+  const uint32_t entry = huffman->fast[png->bits & ((1u << FAST_BITS) - 1)];
+  uint32_t size, symbol;
+  if (entry != 0) {
+    size = entry >> 9;
+    symbol = entry & 0x1ff;
+  } else {
+    const uint32_t code = reverse_bits(png->bits & 0xffff, 16);
+    for (size = FAST_BITS + 1; size <= 16 && code >= huffman->maxcode[size]; ++size) {
+    }
+
+    if (size > 16)
+      return -1;
+
+    symbol = huffman->symbols[(code >> (16 - size)) - huffman->first_code[size] + huffman->first_symbol[size]];
+  }
+
+  png->bits >>= size;
+  png->nb_bits -= size;
+  return symbol;
+}
+
+static bool read_fixed_tables(png_t* png) {
+  uint8_t sizes[288];
+  memset(sizes, 8, 144);
+  memset(sizes + 144, 9, 256 - 144);
+  memset(sizes + 256, 7, 280 - 256);
+  memset(sizes + 280, 8, 288 - 280);
+  if (!build_huffman(&png->lengths, sizes, 288))
+    return false;
+
+  memset(sizes, 5, 30);
+  return build_huffman(&png->distances, sizes, 30);
+}
+
+static bool read_dynamic_tables(png_t* png) {
+  const uint32_t nb_lengths = get_bits(png, 5) + 257;
+  const uint32_t nb_distances = get_bits(png, 5) + 1;
+  const uint32_t nb_code_lengths = get_bits(png, 4) + 4;
+
+  uint8_t sizes[288 + 32];
+  memset(sizes, 0, 19);
+  for (uint32_t i = 0; i < nb_code_lengths; ++i)
+    sizes[CODE_LENGTH_ORDER[i]] = get_bits(png, 3);
+
+  // The code lengths of both tables are themselves Huffman coded (the lengths table is used meanwhile).
+  if (!build_huffman(&png->lengths, sizes, 19))
+    return false;
+
+  const uint32_t total = nb_lengths + nb_distances;
+  for (uint32_t i = 0; i < total;) {
+    const int32_t symbol = decode_huffman(png, &png->lengths);
+    if (symbol < 0)
+      return false;
+
+    if (symbol < 16) {
+      sizes[i++] = symbol;
+      continue;
+    }
+
+    uint32_t repeat, value = 0;
+    if (symbol == 16) {
+      if (i == 0)
+        return false;
+
+      repeat = 3 + get_bits(png, 2);
+      value = sizes[i - 1];
+    } else if (symbol == 17) {
+      repeat = 3 + get_bits(png, 3);
+    } else {
+      repeat = 11 + get_bits(png, 7);
+    }
+
+    if (i + repeat > total)
+      return false;
+
+    memset(sizes + i, value, repeat);
+    i += repeat;
+  }
+
+  if (sizes[256] == 0)
+    return false;  // no end of block
+
+  return build_huffman(&png->lengths, sizes, nb_lengths) &&
+         build_huffman(&png->distances, sizes + nb_lengths, nb_distances);
+}
+
+static bool read_block_header(png_t* png) {
+  if (png->final_block)
+    return false;  // the data ended before the image
+
+  png->final_block = get_bits(png, 1);
+  switch (get_bits(png, 2)) {
+    case 0: {
+      // Stored block: its length follows at the next byte boundary.
+      const uint32_t skip = png->nb_bits % 8;
+      png->bits >>= skip;
+      png->nb_bits -= skip;
+      const uint32_t length = get_bits(png, 16);
+      if ((get_bits(png, 16) ^ 0xffff) != length)
+        return false;
+
+      png->stored_left = length;
+      png->block_type = BLOCK_STORED;
+      return true;
+    }
+    case 1:
+      png->block_type = BLOCK_HUFFMAN;
+      return read_fixed_tables(png);
+    case 2:
+      png->block_type = BLOCK_HUFFMAN;
+      return read_dynamic_tables(png);
+    default:
+      return false;
+  }
+}
+
+static inline void output_byte(png_t* png, uint8_t byte) {
+  png->window[png->window_position] = byte;
+  png->window_position = (png->window_position + 1) % WINDOW_SIZE;
+  if (png->window_filled < WINDOW_SIZE)
+    ++png->window_filled;
+}
+
+// Inflates the next n bytes into out.
+static bool inflate(png_t* png, uint8_t* out, size_t n) {
+  for (size_t i = 0; i < n;) {
+    if (png->match_left > 0) {
+      const uint8_t byte = png->window[(png->window_position + WINDOW_SIZE - png->match_distance) % WINDOW_SIZE];
+      output_byte(png, byte);
+      out[i++] = byte;
+      --png->match_left;
+      continue;
+    }
+
+    if (png->block_type == BLOCK_NONE) {
+      if (!read_block_header(png))
+        return false;
+    } else if (png->block_type == BLOCK_STORED) {
+      if (png->stored_left == 0) {
+        png->block_type = BLOCK_NONE;
+        continue;
+      }
+
+      const uint8_t byte = get_bits(png, 8);
+      output_byte(png, byte);
+      out[i++] = byte;
+      --png->stored_left;
+    } else {
+      int32_t symbol = decode_huffman(png, &png->lengths);
+      if (symbol < 0)
+        return false;
+
+      if (symbol < 256) {
+        output_byte(png, symbol);
+        out[i++] = symbol;
+        continue;
+      }
+
+      if (symbol == 256) {
+        png->block_type = BLOCK_NONE;
+        continue;
+      }
+
+      symbol -= 257;
+      if (symbol >= 29)
+        return false;
+
+      const uint32_t length = LENGTH_BASES[symbol] + get_bits(png, LENGTH_EXTRA_BITS[symbol]);
+      symbol = decode_huffman(png, &png->distances);
+      if (symbol < 0 || symbol >= 30)
+        return false;
+
+      const uint32_t distance = DISTANCE_BASES[symbol] + get_bits(png, DISTANCE_EXTRA_BITS[symbol]);
+      if (distance > png->window_filled)
+        return false;
+
+      png->match_left = length;
+      png->match_distance = distance;
+    }
+  }
+
+  return true;
+}
+
+// ========================================================================
+// Chunks
+
+static uint32_t get_channel_count(uint32_t color_type) {
+  switch (color_type) {
+    case COLOR_RGB:
+      return 3;
+    case COLOR_GRAY_ALPHA:
+      return 2;
+    case COLOR_RGB_ALPHA:
+      return 4;
+    default:
+      return 1;
+  }
+}
+
+static img_result_t read_header(png_t* png) {
+  static const uint8_t SIGNATURE[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+  img_reader_t* reader = png->reader;
+
+  uint8_t signature[8];
+  if (img_reader_read(reader, signature, 8) != 8 || memcmp(signature, SIGNATURE, 8) != 0)
+    return IMG_ERROR;
+
+  if (img_reader_u32be(reader) != 13 || img_reader_u32be(reader) != CHUNK_IHDR)
+    return IMG_ERROR;
+
+  png->width = img_reader_u32be(reader);
+  png->height = img_reader_u32be(reader);
+  png->depth = img_reader_byte(reader);
+  png->color_type = img_reader_byte(reader);
+  const uint32_t compression = img_reader_byte(reader);
+  const uint32_t filter = img_reader_byte(reader);
+  const uint32_t interlace = img_reader_byte(reader);
+  img_reader_skip(reader, 4);  // CRC
+  if (reader->eof || png->width == 0 || png->height == 0 || png->width > (1 << 24) || png->height > (1 << 24) ||
+      compression != 0 || filter != 0)
+    return IMG_ERROR;
+
+  // The allowed depths of each color type.
+  const uint32_t depth = png->depth;
+  bool valid;
+  switch (png->color_type) {
+    case COLOR_GRAY:
+      valid = depth == 1 || depth == 2 || depth == 4 || depth == 8 || depth == 16;
+      break;
+    case COLOR_PALETTE:
+      valid = depth == 1 || depth == 2 || depth == 4 || depth == 8;
+      break;
+    case COLOR_RGB:
+    case COLOR_GRAY_ALPHA:
+    case COLOR_RGB_ALPHA:
+      valid = depth == 8 || depth == 16;
+      break;
+    default:
+      valid = false;
+      break;
+  }
+
+  if (!valid)
+    return IMG_ERROR;
+
+  // The interlaced images need the whole image to be decoded.
+  return interlace == 0 ? IMG_OK : IMG_UNSUPPORTED;
+}
+
+// Reads the chunks until the first IDAT one.
+static bool read_chunks(png_t* png) {
+  img_reader_t* reader = png->reader;
+  for (uint32_t i = 0; i < 256; ++i)
+    png->palette[i] = 0xff000000;
+
+  while (!reader->eof) {
+    const uint32_t length = img_reader_u32be(reader);
+    const uint32_t type = img_reader_u32be(reader);
+    if (type == CHUNK_IDAT) {
+      png->chunk_left = length;
+      return !reader->eof;
+    }
+
+    if (type == CHUNK_IEND)
+      return false;
+
+    if (type == CHUNK_PLTE) {
+      if (length % 3 != 0 || length > 3 * 256)
+        return false;
+
+      for (uint32_t i = 0; i < length / 3; ++i) {
+        const uint32_t r = img_reader_byte(reader);
+        const uint32_t g = img_reader_byte(reader);
+        const uint32_t b = img_reader_byte(reader);
+        png->palette[i] = 0xff000000 | (r << 16) | (g << 8) | b;
+      }
+    } else if (type == CHUNK_TRNS && png->color_type == COLOR_PALETTE) {
+      if (length > 256)
+        return false;
+
+      for (uint32_t i = 0; i < length; ++i)
+        png->palette[i] = (png->palette[i] & 0x00ffffff) | ((uint32_t)img_reader_byte(reader) << 24);
+    } else if (type == CHUNK_TRNS && (png->color_type == COLOR_GRAY || png->color_type == COLOR_RGB)) {
+      const uint32_t nb_samples = png->color_type == COLOR_GRAY ? 1 : 3;
+      if (length != 2 * nb_samples)
+        return false;
+
+      for (uint32_t i = 0; i < nb_samples; ++i)
+        png->key[i] = img_reader_u16be(reader);
+      png->has_key = true;
+    } else {
+      img_reader_skip(reader, length);
+    }
+
+    img_reader_skip(reader, 4);  // CRC
+  }
+
+  return false;
+}
+
+img_result_t img_png_read_size(img_reader_t* reader, uint32_t* width, uint32_t* height) {
+  png_t* png = malloc(sizeof(png_t));
+  if (png == NULL)
+    return IMG_ERROR;
+
+  memset(png, 0, sizeof(png_t));
+  png->reader = reader;
+  const img_result_t result = read_header(png);
+  *width = png->width;
+  *height = png->height;
+  free(png);
+  return result;
+}
+
+// ========================================================================
+// Rows
+
+static inline uint8_t paeth(uint8_t a, uint8_t b, uint8_t c) {
+  const int32_t p = (int32_t)a + b - c;
+  const int32_t pa = p > a ? p - a : a - p;
+  const int32_t pb = p > b ? p - b : b - p;
+  const int32_t pc = p > c ? p - c : c - p;
+  if (pa <= pb && pa <= pc)
+    return a;
+  return pb <= pc ? b : c;
+}
+
+static bool unfilter(uint32_t filter, uint8_t* row, const uint8_t* prev, size_t size, uint32_t bpp) {
+  switch (filter) {
+    case 0:
+      break;
+    case 1:
+      for (size_t i = bpp; i < size; ++i)
+        row[i] += row[i - bpp];
+      break;
+    case 2:
+      for (size_t i = 0; i < size; ++i)
+        row[i] += prev[i];
+      break;
+    case 3:
+      for (size_t i = 0; i < size; ++i)
+        row[i] += ((i >= bpp ? row[i - bpp] : 0) + prev[i]) / 2;
+      break;
+    case 4:
+      for (size_t i = 0; i < size; ++i)
+        row[i] += i >= bpp ? paeth(row[i - bpp], prev[i], prev[i - bpp]) : prev[i];
+      break;
+    default:
+      return false;
+  }
+
+  return true;
+}
+
+// Gets the sample x of a row of samples of less than 8 bits.
+static inline uint32_t get_packed_sample(const uint8_t* row, uint32_t x, uint32_t depth) {
+  const uint32_t bit = x * depth;
+  return (row[bit / 8] >> (8 - depth - bit % 8)) & ((1u << depth) - 1);
+}
+
+// Gets the sample i of a row of 8 or 16-bit samples, on 16 bits.
+static inline uint32_t get_sample(const uint8_t* row, size_t i, uint32_t depth) {
+  return depth == 16 ? ((uint32_t)row[2 * i] << 8) | row[2 * i + 1] : row[i];
+}
+
+static void convert_row(const png_t* png, const uint8_t* row, uint32_t* argb) {
+  const uint32_t depth = png->depth;
+  const uint32_t shift = depth == 16 ? 8 : 0;  // 16-bit samples are reduced to their high byte
+  switch (png->color_type) {
+    case COLOR_GRAY:
+      for (uint32_t x = 0; x < png->width; ++x) {
+        const uint32_t sample = depth < 8 ? get_packed_sample(row, x, depth) : get_sample(row, x, depth);
+        const uint32_t gray = depth < 8 ? sample * 255 / ((1u << depth) - 1) : sample >> shift;
+        const uint32_t alpha = png->has_key && sample == png->key[0] ? 0 : 0xff;
+        argb[x] = (alpha << 24) | (gray * 0x010101);
+      }
+      break;
+    case COLOR_PALETTE:
+      for (uint32_t x = 0; x < png->width; ++x)
+        argb[x] = png->palette[depth < 8 ? get_packed_sample(row, x, depth) : row[x]];
+      break;
+    case COLOR_RGB:
+      for (uint32_t x = 0; x < png->width; ++x) {
+        const uint32_t r = get_sample(row, 3 * x, depth);
+        const uint32_t g = get_sample(row, 3 * x + 1, depth);
+        const uint32_t b = get_sample(row, 3 * x + 2, depth);
+        const bool transparent = png->has_key && r == png->key[0] && g == png->key[1] && b == png->key[2];
+        argb[x] = (transparent ? 0 : 0xff000000) | ((r >> shift) << 16) | ((g >> shift) << 8) | (b >> shift);
+      }
+      break;
+    case COLOR_GRAY_ALPHA:
+      for (uint32_t x = 0; x < png->width; ++x) {
+        const uint32_t gray = get_sample(row, 2 * x, depth) >> shift;
+        const uint32_t alpha = get_sample(row, 2 * x + 1, depth) >> shift;
+        argb[x] = (alpha << 24) | (gray * 0x010101);
+      }
+      break;
+    default:
+      for (uint32_t x = 0; x < png->width; ++x) {
+        const uint32_t r = get_sample(row, 4 * x, depth) >> shift;
+        const uint32_t g = get_sample(row, 4 * x + 1, depth) >> shift;
+        const uint32_t b = get_sample(row, 4 * x + 2, depth) >> shift;
+        const uint32_t alpha = get_sample(row, 4 * x + 3, depth) >> shift;
+        argb[x] = (alpha << 24) | (r << 16) | (g << 8) | b;
+      }
+      break;
+  }
+}
+
+img_result_t img_png_decode(img_reader_t* reader, uint32_t* dst, uint32_t pitch, uint32_t width, uint32_t height) {
+  png_t* png = malloc(sizeof(png_t));
+  if (png == NULL)
+    return IMG_ERROR;
+
+  memset(png, 0, sizeof(png_t));
+  png->reader = reader;
+  img_result_t result = read_header(png);
+  if (result != IMG_OK) {
+    free(png);
+    return result;
+  }
+
+  if (!read_chunks(png)) {
+    free(png);
+    return IMG_ERROR;
+  }
+
+  // The zlib header (deflate, without preset dictionary).
+  const uint32_t cmf = read_data_byte(png);
+  const uint32_t flags = read_data_byte(png);
+  if ((cmf & 0xf) != 8 || (cmf * 256 + flags) % 31 != 0 || (flags & 0x20) != 0) {
+    free(png);
+    return IMG_ERROR;
+  }
+
+  const uint32_t bits_per_pixel = get_channel_count(png->color_type) * png->depth;
+  const size_t row_size = ((size_t)png->width * bits_per_pixel + 7) / 8;
+  const uint32_t bpp = bits_per_pixel < 8 ? 1 : bits_per_pixel / 8;  // the distance of the filters, in bytes
+
+  uint8_t* row = malloc(row_size);
+  uint8_t* prev = malloc(row_size);
+  uint32_t* argb = malloc(sizeof(uint32_t) * png->width);
+  img_scaler_t scaler;
+  bool ok = row != NULL && prev != NULL && argb != NULL &&
+            img_scaler_init(&scaler, png->width, png->height, dst, pitch, width, height);
+  if (ok) {
+    memset(prev, 0, row_size);  // the first row is filtered with a row of zeros
+    for (uint32_t y = 0; y < png->height && ok; ++y) {
+      uint8_t filter;
+      ok = inflate(png, &filter, 1) && inflate(png, row, row_size) && unfilter(filter, row, prev, row_size, bpp);
+      if (!ok)
+        break;
+
+      convert_row(png, row, argb);
+      img_scaler_push_row(&scaler, argb);
+
+      uint8_t* tmp = prev;
+      prev = row;
+      row = tmp;
+    }
+
+    img_scaler_free(&scaler);
+  }
+
+  free(row);
+  free(prev);
+  free(argb);
+  free(png);
+  return ok ? IMG_OK : IMG_ERROR;
+}
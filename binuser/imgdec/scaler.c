@@ -0,0 +1,196 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "internal.h"
+
+// The interpolation weights have 8 bits of precision.
+#define WEIGHT_ONE 256
+
+// Gets the position (with 8 fractional bits) in the source of the center of the destination pixel i,
+// clamped to the source pixels, for the bilinear interpolation.
+static uint32_t get_source_position(uint32_t i, uint32_t src_size, uint32_t dst_size) {
+  const int64_t position = ((int64_t)(2 * i + 1) * src_size - dst_size) * WEIGHT_ONE / (2 * dst_size);
+  if (position < 0)
+    return 0;
+  if (position > (int64_t)(src_size - 1) * WEIGHT_ONE)
+    return (src_size - 1) * WEIGHT_ONE;
+  return position;
+}
+
+static uint32_t interpolate(uint32_t a, uint32_t b, uint32_t weight) {
+  uint32_t result = 0;
+  for (uint32_t shift = 0; shift < 32; shift += 8) {
+    const uint32_t ca = (a >> shift) & 0xff;
+    const uint32_t cb = (b >> shift) & 0xff;
+    result |= ((ca * (WEIGHT_ONE - weight) + cb * weight + WEIGHT_ONE / 2) / WEIGHT_ONE) << shift;
+  }
+
+  return result;
+}
+
+static inline void accumulate(uint32_t* sums, uint32_t argb, uint32_t weight) {
+  sums[0] += (argb & 0xff) * weight;
+  sums[1] += ((argb >> 8) & 0xff) * weight;
+  sums[2] += ((argb >> 16) & 0xff) * weight;
+  sums[3] += (argb >> 24) * weight;
+}
+
+static inline uint32_t average(const uint32_t* sums, uint32_t total_weight) {
+  uint32_t result = 0;
+  for (uint32_t i = 0; i < 4; ++i)
+    result |= ((sums[i] + total_weight / 2) / total_weight) << (8 * i);
+  return result;
+}
+
+// Scales the source row src into dst, horizontally.
+static void scale_row(const img_scaler_t* scaler, uint32_t* dst, const uint32_t* src) {
+  const uint32_t src_width = scaler->src_width;
+  const uint32_t dst_width = scaler->dst_width;
+  if (src_width == dst_width) {
+    memcpy(dst, src, sizeof(uint32_t) * dst_width);
+  } else if (src_width > dst_width) {
+    // Average of the source pixels covered by each destination pixel, weighted by their coverage. In
+    // units of 1 / (src_width * dst_width) pixels, the destination pixel x covers [x * src_width, (x + 1)
+    // * src_width[ and the source pixel i covers [i * dst_width, (i + 1) * dst_width[.
+    uint32_t i = 0;
+    for (uint32_t x = 0; x < dst_width; ++x) {
+      const uint64_t start = (uint64_t)x * src_width;
+      const uint64_t end = start + src_width;
+      uint32_t sums[4] = {0, 0, 0, 0};
+      for (; (uint64_t)i * dst_width < end; ++i) {
+        const uint64_t pixel_start = (uint64_t)i * dst_width;
+        const uint64_t pixel_end = pixel_start + dst_width;
+        const uint32_t weight = (pixel_end < end ? pixel_end : end) - (pixel_start > start ? pixel_start : start);
+        accumulate(sums, src[i], weight);
+        if (pixel_end > end)
+          break;  // the pixel is shared with the next destination pixel
+      }
+
+      dst[x] = average(sums, src_width);
+    }
+  } else {
+    for (uint32_t x = 0; x < dst_width; ++x) {
+      const uint32_t position = get_source_position(x, src_width, dst_width);
+      const uint32_t i = position / WEIGHT_ONE;
+      const uint32_t weight = position % WEIGHT_ONE;
+      dst[x] = weight == 0 ? src[i] : interpolate(src[i], src[i + 1], weight);
+    }
+  }
+}
+
+bool img_scaler_init(img_scaler_t* scaler,
+                     uint32_t src_width,
+                     uint32_t src_height,
+                     uint32_t* dst,
+                     uint32_t dst_pitch,
+                     uint32_t dst_width,
+                     uint32_t dst_height) {
+  memset(scaler, 0, sizeof(img_scaler_t));
+  scaler->src_width = src_width;
+  scaler->src_height = src_height;
+  scaler->dst = dst;
+  scaler->dst_pitch = dst_pitch;
+  scaler->dst_width = dst_width;
+  scaler->dst_height = dst_height;
+
+  // Without vertical scaling, the rows are scaled directly into the destination.
+  if (src_height == dst_height)
+    return true;
+
+  scaler->row = malloc(sizeof(uint32_t) * dst_width);
+  if (src_height > dst_height)
+    scaler->sums = malloc(sizeof(uint32_t) * 4 * dst_width);
+  else
+    scaler->prev_row = malloc(sizeof(uint32_t) * dst_width);
+
+  if (scaler->row == NULL || (scaler->sums == NULL && scaler->prev_row == NULL)) {
+    img_scaler_free(scaler);
+    return false;
+  }
+
+  if (scaler->sums != NULL)
+    memset(scaler->sums, 0, sizeof(uint32_t) * 4 * dst_width);
+  return true;
+}
+
+void img_scaler_free(img_scaler_t* scaler) {
+  free(scaler->row);
+  free(scaler->prev_row);
+  free(scaler->sums);
+  scaler->row = NULL;
+  scaler->prev_row = NULL;
+  scaler->sums = NULL;
+}
+
+// Shrinking: the destination row is the average of the source rows it covers, weighted by their coverage
+// (as for the columns, see scale_row()). A source row covers at most two destination rows.
+static void push_row_shrink(img_scaler_t* scaler) {
+  const uint64_t row_start = (uint64_t)scaler->src_y * scaler->dst_height;
+  const uint64_t row_end = row_start + scaler->dst_height;
+  const uint64_t dst_end = (uint64_t)(scaler->dst_y + 1) * scaler->src_height;
+
+  uint32_t weight = (row_end < dst_end ? row_end : dst_end) - row_start;
+  for (uint32_t x = 0; x < scaler->dst_width; ++x)
+    accumulate(scaler->sums + 4 * x, scaler->row[x], weight);
+
+  if (row_end < dst_end)
+    return;
+
+  uint32_t* dst = scaler->dst + (size_t)scaler->dst_pitch * scaler->dst_y;
+  for (uint32_t x = 0; x < scaler->dst_width; ++x)
+    dst[x] = average(scaler->sums + 4 * x, scaler->src_height);
+
+  memset(scaler->sums, 0, sizeof(uint32_t) * 4 * scaler->dst_width);
+  ++scaler->dst_y;
+
+  // The rest of the row belongs to the next destination row.
+  weight = row_end - dst_end;
+  if (weight > 0) {
+    for (uint32_t x = 0; x < scaler->dst_width; ++x)
+      accumulate(scaler->sums + 4 * x, scaler->row[x], weight);
+  }
+}
+
+// Enlarging: each destination row interpolates the two nearest source rows, so it is written once the
+// second one is known.
+static void push_row_enlarge(img_scaler_t* scaler) {
+  while (scaler->dst_y < scaler->dst_height) {
+    const uint32_t position = get_source_position(scaler->dst_y, scaler->src_height, scaler->dst_height);
+    const uint32_t i = position / WEIGHT_ONE;
+    const uint32_t weight = position % WEIGHT_ONE;
+    const uint32_t last_row = (weight == 0) ? i : i + 1;
+    if (last_row > scaler->src_y)
+      break;
+
+    uint32_t* dst = scaler->dst + (size_t)scaler->dst_pitch * scaler->dst_y;
+    if (weight == 0) {
+      memcpy(dst, i == scaler->src_y ? scaler->row : scaler->prev_row, sizeof(uint32_t) * scaler->dst_width);
+    } else {
+      for (uint32_t x = 0; x < scaler->dst_width; ++x)
+        dst[x] = interpolate(scaler->prev_row[x], scaler->row[x], weight);
+    }
+
+    ++scaler->dst_y;
+  }
+
+  uint32_t* tmp = scaler->prev_row;
+  scaler->prev_row = scaler->row;
+  scaler->row = tmp;
+}
+
+void img_scaler_push_row(img_scaler_t* scaler, const uint32_t* argb) {
+  if (scaler->src_y >= scaler->src_height)
+    return;
+
+  if (scaler->src_height == scaler->dst_height) {
+    scale_row(scaler, scaler->dst + (size_t)scaler->dst_pitch * scaler->src_y, argb);
+  } else {
+    scale_row(scaler, scaler->row, argb);
+    if (scaler->sums != NULL)
+      push_row_shrink(scaler);
+    else
+      push_row_enlarge(scaler);
+  }
+
+  ++scaler->src_y;
+}
@@ -131,6 +131,7 @@ RECENT REVISION HISTORY:
 // Custom configuration for the PikachULM Kernel.
 #define STBI_NO_SIMD
 #define STBI_ONLY_JPEG
+#define STBI_ONLY_PNG  // only for the interlaced images (see imgdec/png.c)
 #define STBI_MAX_DIMENSIONS 2000
 #define STBI_NO_STDIO
 #define STBI_NO_LINEAR
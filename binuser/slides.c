@@ -1,52 +1,161 @@
-#include <assert.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/file.h>
 #include <sys/keyboard.h>
 #include <sys/syscall.h>
 #include <sys/window.h>
 
-#include "stb_image.h"
+#include "imgdec.h"
 
 static sys_window_t* window = NULL;
-static int current_slide = 0;
+static int current_slide = -1;  // no slide is shown before the show begins
 
 static bool begin_show = false;
 
-static const uint32_t* slide_pixels = NULL;
-static int slide_width = 0, slide_height = 0;
+// A slide is decoded to fit the drawing area, so it can be drawn as is. It is decoded again when the
+// area changes size.
+typedef struct slide_t {
+  img_decoder_t* image;
+  uint32_t* pixels;
+  uint32_t width, height;
+} slide_t;
+
+static slide_t slide = {NULL, NULL, 0, 0};
+// The next slide is loaded and decoded ahead, so it can be shown immediately.
+static slide_t next_slide = {NULL, NULL, 0, 0};
+
+// When in fullscreen, the screen is owned by the slides and directly drawn into.
+static uint32_t* screen = NULL;
+static uint32_t screen_width = 0, screen_height = 0, screen_stride = 0;
+
+// Gets the size of the area where the slide is drawn, returns false if it is empty.
+static bool get_slide_area(uint32_t* width, uint32_t* height) {
+  if (screen != NULL) {
+    *width = screen_width;
+    *height = screen_height;
+    return true;
+  }
+
+  uint32_t win_width, win_height;
+  sys_window_get_geometry(window, NULL, NULL, &win_width, &win_height);
+  if (win_width == 0 || win_height <= SYS_WINDOW_TITLE_BAR_HEIGHT)
+    return false;
+
+  *width = win_width;
+  *height = win_height - SYS_WINDOW_TITLE_BAR_HEIGHT;
+  return true;
+}
+
+static void free_slide(slide_t* s) {
+  if (s->image != NULL)
+    img_close(s->image);
+  free(s->pixels);
+  s->image = NULL;
+  s->pixels = NULL;
+  s->width = 0;
+  s->height = 0;
+}
 
-static const uint32_t* next_slide_pixels = NULL;
-static int next_slide_width = 0, next_slide_height = 0;
+// Decodes the slide to fit the area, keeping its aspect ratio. In a window, it is enlarged to fill
+// the window, whereas in fullscreen it is drawn at most at its real size. Nothing is done if it is
+// already decoded at the right size.
+static bool decode_slide(slide_t* s, uint32_t area_width, uint32_t area_height) {
+  if (s->image == NULL)
+    return false;
+
+  uint32_t width, height;
+  img_fit_size(s->image, area_width, area_height, screen == NULL, &width, &height);
+  if (s->pixels != NULL && width == s->width && height == s->height)
+    return true;
+
+  free(s->pixels);
+  s->width = 0;
+  s->height = 0;
+  s->pixels = malloc(sizeof(uint32_t) * width * height);
+  if (s->pixels == NULL)
+    return false;
+
+  if (!img_decode(s->image, s->pixels, width, width, height)) {
+    free(s->pixels);
+    s->pixels = NULL;
+    return false;
+  }
+
+  s->width = width;
+  s->height = height;
+  return true;
+}
 
 static void draw_welcome_page() {
   sys_gfx_clear(window, 0x000000);
-  sys_gfx_draw_text(window, 50, 50, "Press 'B' to begin the show", 0xffffff);
+  sys_gfx_draw_text(window, 50, 50, "Press 'B' to begin the show ('F' for fullscreen)", 0xffffff);
   sys_window_present(window);
 }
 
+// Draws the slide centered in the area of size @a area_width x @a area_height starting at row
+// @a area_y of @a dst (the slide fits in the area).
+static void blit_slide(uint32_t* dst, uint32_t pitch, uint32_t area_y, uint32_t area_width, uint32_t area_height) {
+  const uint32_t x = (area_width - slide.width) / 2;
+  const uint32_t y = area_y + (area_height - slide.height) / 2;
+  for (uint32_t row = 0; row < slide.height; ++row)
+    memcpy(dst + pitch * (y + row) + x, slide.pixels + slide.width * row, sizeof(uint32_t) * slide.width);
+}
+
+static void draw_slide_fullscreen() {
+  for (uint32_t row = 0; row < screen_height; ++row)
+    memset(screen + screen_stride * row, 0, sizeof(uint32_t) * screen_width);
+
+  if (!decode_slide(&slide, screen_width, screen_height))
+    return;
+
+  blit_slide(screen, screen_stride, 0, screen_width, screen_height);
+}
+
 static void draw_slide() {
-  if (!begin_show || slide_pixels == NULL) {
+  if (screen != NULL) {
+    draw_slide_fullscreen();
+    return;
+  }
+
+  if (!begin_show || slide.image == NULL) {
     draw_welcome_page();
     return;
   }
 
-  uint32_t win_width, win_height;
-  sys_window_get_geometry(window, NULL, NULL, &win_width, &win_height);
+  uint32_t area_width, area_height;
+  if (!get_slide_area(&area_width, &area_height))
+    return;
 
-  // The title bar is 30 pixels large.
-#define TITLE_BAR_HEIGHT 30
+  sys_gfx_fill_rect(window, 0, SYS_WINDOW_TITLE_BAR_HEIGHT, area_width, area_height, 0xff000000);
+  if (!decode_slide(&slide, area_width, area_height)) {
+    sys_print("Failed to decode the slide");
+  } else {
+    // The slide is already decoded at the size it is drawn.
+    const uint32_t x = (area_width - slide.width) / 2;
+    const uint32_t y = SYS_WINDOW_TITLE_BAR_HEIGHT + (area_height - slide.height) / 2;
+    if (!SYS_IS_OK(sys_gfx_blit(window, x, y, slide.width, slide.height, slide.pixels)))
+      sys_print("Failed to draw the slide");
+  }
 
-  win_height -= TITLE_BAR_HEIGHT;
+  sys_window_present2(window, 0, SYS_WINDOW_TITLE_BAR_HEIGHT, area_width, area_height);
+}
 
-  uint32_t x = 0, y = TITLE_BAR_HEIGHT;
-  if ((uint32_t)slide_width < win_width)
-    x += win_width / 2 - slide_width / 2;
-  if ((uint32_t)slide_height < win_height)
-    y += win_height / 2 - slide_height / 2;
+static void toggle_fullscreen() {
+  if (screen != NULL) {
+    // Give the screen back to the window manager.
+    sys_release_framebuffer();
+    screen = NULL;
+    draw_slide();
+    return;
+  }
 
-  sys_gfx_blit(window, x, y, slide_width, slide_height, slide_pixels);
-  sys_window_present(window);
+  void* pixels;
+  if (!SYS_IS_OK(sys_get_framebuffer(&pixels, &screen_width, &screen_height, &screen_stride))) {
+    sys_print("Failed to acquire the screen");
+    return;
+  }
+
+  screen = pixels;
+  draw_slide();
 }
 
 #define SLIDE_PATH_PREFIX "/slides/"
@@ -84,95 +193,47 @@ static const char* get_slide_path(int idx) {
   return buffer;
 }
 
-static uint8_t* load_slide_image_data(int idx, int* buffer_length) {
+static bool open_slide(slide_t* s, int idx) {
   const char* path = get_slide_path(idx);
-  sys_print("Reading file...");
+  sys_print("Opening slide...");
   sys_print(path);
-  sys_file_t* file = sys_open_file(path, SYS_FM_READ);
-  if (file == NULL)
-    return NULL;
-
-  const size_t file_size = sys_get_file_size(file);
-  uint8_t* buffer = malloc(sizeof(uint8_t) * file_size);
-  assert(buffer != NULL);
-
-  size_t read_bytes;
-  sys_file_read(file, buffer, file_size, &read_bytes);
-  assert(read_bytes == file_size);
-
-  *buffer_length = file_size;
-
-  sys_close_file(file);
-  sys_print("Reading done.");
-
-  return buffer;
+  s->image = img_open(path);
+  return s->image != NULL;
 }
 
-static void convert_to_argb(uint32_t* pixels, int width, int height) {
-  for (int x = 0; x < width; ++x) {
-    for (int y = 0; y < height; ++y) {
-      // The image is in RGBA, we expect ABGR.
-      const uint32_t color = __builtin_bswap32(pixels[x + width * y]);
-      pixels[x + width * y] = color >> 8;
-    }
-  }
-}
-
-static int load_next_image_slide(int idx) {
-  int slide_buffer_len = 0;
-  uint8_t* slide_buffer = load_slide_image_data(current_slide, &slide_buffer_len);
-  if (slide_buffer == NULL) {
-    if (current_slide > 0)
-      current_slide--;
-
-    sys_print("Failed to open next slide (invalid file)");
-    goto error;
-  }
-
-  int width, height;
-  uint32_t* new_slide_pixels =
-      (uint32_t*)stbi_load_from_memory(slide_buffer, slide_buffer_len, &width, &height, NULL, 4);
-  free((void*)slide_buffer);
-
-  if (new_slide_pixels == NULL) {
-    if (current_slide > 0)
-      current_slide--;
-
-
-    sys_print("Failed to open next slide (invalid image)");
-    goto error;
-  }
-
-  free((void*)slide_pixels);
+// Loads the slide after the current one, and decodes it for the current area.
+static void load_next_slide() {
+  free_slide(&next_slide);
+  if (!open_slide(&next_slide, current_slide + 1))
+    return;
 
-  sys_print("Converting to ARGB");
-  convert_to_argb(new_slide_pixels, width, height);
+  uint32_t area_width, area_height;
+  if (get_slide_area(&area_width, &area_height))
+    decode_slide(&next_slide, area_width, area_height);
   sys_print("Done. Ready to draw slide.");
-
-  next_slide_pixels = new_slide_pixels;
-  next_slide_width = width;
-  next_slide_height = height;
-  return 1;
-
-error:
-  next_slide_pixels = NULL;
-  next_slide_width = 0;
-  next_slide_height = 0;
-  return 0;
 }
 
-static void update_current_slide() {
-  if (next_slide_pixels != NULL) {
-    free((void*)slide_pixels);
-    slide_pixels = next_slide_pixels;
-    slide_width = next_slide_width;
-    slide_height = next_slide_height;
-    draw_slide();
-  }
+// Shows the slide idx, immediately if it is the next slide (which is already decoded).
+static void show_slide(int idx) {
+  if (idx == current_slide + 1 && next_slide.image != NULL) {
+    free_slide(&slide);
+    slide = next_slide;
+    next_slide = (slide_t){NULL, NULL, 0, 0};
+  } else {
+    slide_t new_slide = {NULL, NULL, 0, 0};
+    if (!open_slide(&new_slide, idx)) {
+      sys_print("Failed to open the slide (invalid file)");
+      return;
+    }
 
-  if (!load_next_image_slide(current_slide)) {
-    current_slide--;
+    free_slide(&slide);
+    slide = new_slide;
+    free_slide(&next_slide);
   }
+
+  current_slide = idx;
+  draw_slide();
+  load_next_slide();
 }
 
 static void handle_key_event(sys_key_event_t event) {
@@ -183,21 +244,25 @@ static void handle_key_event(sys_key_event_t event) {
     case SYS_KEY_B: {
       if (!begin_show) {
         begin_show = true;
-        current_slide++;
-        update_current_slide();
+        show_slide(current_slide + 1);
       }
       break;
     }
     case SYS_KEY_LEFT_ARROW:
-      if (current_slide == 0)
+      if (current_slide <= 0)
         return;
-      current_slide--;
-      update_current_slide();
+      show_slide(current_slide - 1);
       break;
     case SYS_KEY_SPACE:
     case SYS_KEY_RIGHT_ARROW:
-      current_slide++;
-      update_current_slide();
+      show_slide(current_slide + 1);
+      break;
+    case SYS_KEY_F:
+      toggle_fullscreen();
+      break;
+    case SYS_KEY_ESCAPE:
+      if (screen != NULL)
+        toggle_fullscreen();
       break;
     case SYS_KEY_C: {
       if (!sys_is_alt_pressed(event))
@@ -224,11 +289,10 @@ int main() {
   }
 
   if (begin_show) {
-    load_next_image_slide(current_slide);
-    update_current_slide();
+    show_slide(current_slide + 1);
   } else {
     draw_welcome_page();
-    load_next_image_slide(current_slide);
+    load_next_slide();
   }
 
   bool should_close = false;
@@ -250,8 +314,11 @@ int main() {
     }
   }
 
-  if (slide_pixels != NULL)
-    free((void*)slide_pixels);
+  if (screen != NULL)
+    sys_release_framebuffer();
+
+  free_slide(&slide);
+  free_slide(&next_slide);
 
   sys_window_destroy(window);
   return 0;
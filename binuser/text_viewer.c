@@ -1,13 +1,30 @@
 #include <sys/file.h>
+#include <sys/keyboard.h>
 #include <sys/syscall.h>
 #include <sys/window.h>
 #include <assert.h>
+#include <stdlib.h>
 
-#include "stb_image.h"
+#define TEXT_X 10
+#define TEXT_Y (SYS_WINDOW_TITLE_BAR_HEIGHT + 10)
+#define MAX_LINE_LENGTH 255
+#define BACKGROUND_COLOR 0xff000000
+#define TEXT_COLOR 0xffffffff
 
 static const uint8_t* text_data = NULL;
 static int text_length = 0;
 
+// The offset in text_data of the start of each line, and the first line displayed.
+static int* line_offsets = NULL;
+static int line_count = 0;
+static int first_line = 0;
+
+static uint32_t window_width = 0;
+static uint32_t window_height = 0;
+
+// The line spacing of the system font.
+static int line_height = 0;
+
 static uint8_t* read_file(const char* path, int* buffer_length) {
   sys_print("Reading file...");
   sys_print(path);
@@ -32,11 +49,134 @@ static uint8_t* read_file(const char* path, int* buffer_length) {
   return buffer;
 }
 
+static void split_lines() {
+  line_count = 1;
+  for (int i = 0; i < text_length; ++i) {
+    if (text_data[i] == '\n')
+      ++line_count;
+  }
+
+  line_offsets = malloc(sizeof(int) * line_count);
+  assert(line_offsets != NULL);
+
+  int line = 0;
+  line_offsets[line++] = 0;
+  for (int i = 0; i < text_length; ++i) {
+    if (text_data[i] == '\n')
+      line_offsets[line++] = i + 1;
+  }
+}
+
+// Number of lines fully visible in the window.
+static int get_visible_line_count() {
+  if (window_height <= TEXT_Y + 1)
+    return 0;
+  return (window_height - TEXT_Y - 1) / line_height;
+}
+
+// Draws the line displayed at the given slot (0 being the top of the window) over its background.
+static void draw_line(sys_window_t* window, int slot) {
+  const int32_t y = TEXT_Y + slot * line_height;
+  sys_gfx_push_clip(window, 1, y, window_width - 2, line_height);
+  sys_gfx_fill_rect(window, 1, y, window_width - 2, line_height, BACKGROUND_COLOR);
+
+  const int line = first_line + slot;
+  if (line < line_count) {
+    char buffer[MAX_LINE_LENGTH + 1];
+    int length = 0;
+    for (int i = line_offsets[line]; i < text_length && length < MAX_LINE_LENGTH; ++i) {
+      if (text_data[i] == '\n' || text_data[i] == '\r')
+        break;
+      buffer[length++] = text_data[i];
+    }
+
+    buffer[length] = '\0';
+    sys_gfx_draw_text(window, TEXT_X, y, buffer, TEXT_COLOR);
+  }
+
+  sys_gfx_pop_clip(window);
+}
+
 static void draw(sys_window_t* window) {
-  sys_gfx_draw_text(window, 10, 40, text_data, 0xffffffff);
+  sys_window_get_geometry(window, NULL, NULL, &window_width, &window_height);
+
+  sys_gfx_clear(window, BACKGROUND_COLOR);
+  const int visible_lines = get_visible_line_count();
+  for (int slot = 0; slot < visible_lines; ++slot) {
+    draw_line(window, slot);
+  }
+
   sys_window_present(window);
 }
 
+// Scrolls the text by the given number of lines. The lines still visible are moved with
+// sys_gfx_copy_area(), so only the lines that appear are drawn.
+static void scroll(sys_window_t* window, int delta) {
+  const int visible_lines = get_visible_line_count();
+  const int max_first_line = line_count > visible_lines ? line_count - visible_lines : 0;
+  int new_first_line = first_line + delta;
+  if (new_first_line < 0)
+    new_first_line = 0;
+  if (new_first_line > max_first_line)
+    new_first_line = max_first_line;
+
+  delta = new_first_line - first_line;
+  if (delta == 0)
+    return;
+
+  first_line = new_first_line;
+  const int moved_lines = delta > 0 ? delta : -delta;
+  if (moved_lines >= visible_lines) {
+    draw(window);
+    return;
+  }
+
+  const uint32_t kept_height = (visible_lines - moved_lines) * line_height;
+  if (delta > 0) {
+    sys_gfx_copy_area(window, 1, TEXT_Y + moved_lines * line_height, window_width - 2, kept_height, 0,
+                      -moved_lines * line_height);
+    for (int slot = visible_lines - moved_lines; slot < visible_lines; ++slot) {
+      draw_line(window, slot);
+    }
+  } else {
+    sys_gfx_copy_area(window, 1, TEXT_Y, window_width - 2, kept_height, 0, moved_lines * line_height);
+    for (int slot = 0; slot < moved_lines; ++slot) {
+      draw_line(window, slot);
+    }
+  }
+
+  sys_window_present2(window, 0, TEXT_Y, window_width, visible_lines * line_height);
+}
+
+static void handle_key_event(sys_window_t* window, sys_key_event_t event) {
+  if (!sys_is_press_event(event))
+    return;
+
+  const int page = get_visible_line_count() > 1 ? get_visible_line_count() - 1 : 1;
+  switch (sys_get_key_code(event)) {
+    case SYS_KEY_UP_ARROW:
+      scroll(window, -1);
+      break;
+    case SYS_KEY_DOWN_ARROW:
+      scroll(window, 1);
+      break;
+    case SYS_KEY_PAGE_UP:
+      scroll(window, -page);
+      break;
+    case SYS_KEY_PAGE_DOWN:
+      scroll(window, page);
+      break;
+    case SYS_KEY_HOME:
+      scroll(window, -line_count);
+      break;
+    case SYS_KEY_END:
+      scroll(window, line_count);
+      break;
+    default:
+      break;
+  }
+}
+
 int main() {
   size_t argc = sys_get_argc();
   const char** argv = sys_get_argv();
@@ -53,9 +193,22 @@ int main() {
     return 1;
   }
 
+  split_lines();
+
+  sys_font_metrics_t font_metrics;
+  if (!SYS_IS_OK(sys_gfx_get_font_metrics(&font_metrics))) {
+    free(line_offsets);
+    free((void*)text_data);
+    sys_print("ERROR: failed to get the font metrics.");
+    return 1;
+  }
+
+  line_height = (int)font_metrics.line_height;
+
   sys_window_t* window =
       sys_window_create("Text viewer", SYS_POS_DEFAULT, SYS_POS_DEFAULT, 600, 400, SYS_WF_DEFAULT);
   if (window == NULL) {
+    free(line_offsets);
     free(text_data);
     sys_print("ERROR: failed to create window.");
     return 1;
@@ -74,11 +227,15 @@ int main() {
       case SYS_MSG_RESIZE:
         draw(window);
         break;
+      case SYS_MSG_KEYDOWN:
+        handle_key_event(window, message.param1);
+        break;
       default:
         break;
     }
   }
 
   sys_window_destroy(window);
+  free(line_offsets);
   return 0;
 }
@@ -0,0 +1,162 @@
+#include <string.h>
+#include <sys/syscall.h>
+#include <sys/window.h>
+
+#define LINE_HEIGHT 20
+#define COLUMN_WIDTH 90
+#define REFRESH_DELAY_US 1000000
+
+static char* append_str(char* it, const char* str) {
+  const size_t length = strlen(str);
+  memcpy(it, str, length);
+  return it + length;
+}
+
+static char* append_uint(char* it, uint64_t value) {
+  char digits[20];
+  int size = 0;
+  do {
+    digits[size++] = '0' + (value % 10);
+    value /= 10;
+  } while (value != 0);
+
+  while (size > 0)
+    *it++ = digits[--size];
+  return it;
+}
+
+/* Formats @a pages as a size in KiB. */
+static const char* format_pages(uint64_t pages, uint32_t page_size) {
+  static char buffer[32];
+  char* it = append_uint(buffer, pages * page_size / 1024);
+  it = append_str(it, " KiB");
+  *it = '\0';
+  return buffer;
+}
+
+static void draw_row(sys_window_t* window, uint32_t y, const char** cells, size_t nb_cells, uint32_t argb) {
+  for (size_t i = 0; i < nb_cells; ++i)
+    sys_gfx_draw_text(window, 10 + i * COLUMN_WIDTH, y, cells[i], argb);
+}
+
+static void draw_task_row(sys_window_t* window, uint32_t y, sys_pid_t pid, const sys_mem_stats_t* stats) {
+  char pid_buffer[16];
+  *append_uint(pid_buffer, pid) = '\0';
+  sys_gfx_draw_text(window, 10, y, pid_buffer, 0xffffffff);
+  sys_gfx_draw_text(window, 10 + COLUMN_WIDTH, y, stats->is_kernel ? "kernel" : "user", 0xffffffff);
+
+  const uint64_t columns[] = {stats->heap_pages,  stats->stack_pages,  stats->chunk_pages,
+                              stats->buffer_pages, stats->table_pages, stats->window_pages};
+  for (size_t i = 0; i < sizeof(columns) / sizeof(columns[0]); ++i) {
+    const char* text = format_pages(columns[i], stats->page_size);
+    sys_gfx_draw_text(window, 10 + (i + 2) * COLUMN_WIDTH, y, text, 0xffffffff);
+  }
+}
+
+static void draw_system_stats(sys_window_t* window, uint32_t y, const sys_mem_stats_t* stats) {
+  char buffer[128];
+  char* it;
+
+  it = append_str(buffer, "Pages: ");
+  it = append_uint(it, stats->used_pages);
+  it = append_str(it, " / ");
+  it = append_uint(it, stats->total_pages);
+  it = append_str(it, " used, ");
+  it = append_uint(it, stats->total_table_pages);
+  it = append_str(it, " for MMU tables");
+  *it = '\0';
+  sys_gfx_draw_text(window, 10, y, buffer, 0xffffffff);
+
+  it = append_str(buffer, "Contiguous pages: ");
+  it = append_uint(it, stats->used_contiguous_pages);
+  it = append_str(it, " / ");
+  it = append_uint(it, stats->total_contiguous_pages);
+  it = append_str(it, " used");
+  *it = '\0';
+  sys_gfx_draw_text(window, 10, y + LINE_HEIGHT, buffer, 0xffffffff);
+
+  it = append_str(buffer, "kmalloc: ");
+  it = append_uint(it, stats->kmalloc_allocations);
+  it = append_str(it, " allocations, ");
+  it = append_uint(it, stats->kmalloc_used_bytes / 1024);
+  it = append_str(it, " KiB used, ");
+  it = append_uint(it, stats->kmalloc_heap_bytes / 1024);
+  it = append_str(it, " KiB heap");
+  *it = '\0';
+  sys_gfx_draw_text(window, 10, y + 2 * LINE_HEIGHT, buffer, 0xffffffff);
+}
+
+static void draw_compositor_stats(sys_window_t* window, uint32_t y, const sys_compositor_stats_t* stats) {
+  char buffer[128];
+  char* it;
+
+  it = append_str(buffer, "Compositor: ");
+  it = append_uint(it, stats->frames_per_second);
+  it = append_str(it, " frames/s, ");
+  it = append_uint(it, stats->average_composite_us);
+  it = append_str(it, " us per frame (max ");
+  it = append_uint(it, stats->max_composite_us);
+  it = append_str(it, " us)");
+  *it = '\0';
+  sys_gfx_draw_text(window, 10, y, buffer, 0xffffffff);
+
+  it = append_str(buffer, "Window frames: ");
+  it = append_uint(it, stats->frame_redraws_per_second);
+  it = append_str(it, " redraws/s");
+  *it = '\0';
+  sys_gfx_draw_text(window, 10, y + LINE_HEIGHT, buffer, 0xffffffff);
+}
+
+static void draw(sys_window_t* window) {
+  static const char* header[] = {"PID", "Kind", "Heap", "Stack", "Chunks", "Buffers", "Tables", "Windows"};
+
+  sys_gfx_clear(window, 0xff1e1e1e);
+
+  uint32_t y = 40;
+  draw_row(window, y, header, sizeof(header) / sizeof(header[0]), 0xfff0c000);
+  y += LINE_HEIGHT;
+
+  // PIDs are allocated sequentially and never reused, so stop at the first invalid one.
+  // PID 0 can not be queried as it is an alias for the current task.
+  sys_mem_stats_t stats;
+  for (sys_pid_t pid = 1; SYS_IS_OK(sys_mem_stats(pid, &stats)); ++pid) {
+    if (stats.is_terminated)
+      continue;
+
+    draw_task_row(window, y, pid, &stats);
+    y += LINE_HEIGHT;
+  }
+
+  if (SYS_IS_OK(sys_mem_stats(SYS_PID_CURRENT, &stats)))
+    draw_system_stats(window, y + LINE_HEIGHT, &stats);
+
+  sys_compositor_stats_t compositor_stats;
+  if (SYS_IS_OK(sys_compositor_stats(&compositor_stats)))
+    draw_compositor_stats(window, y + 4 * LINE_HEIGHT, &compositor_stats);
+
+  sys_window_present(window);
+}
+
+int main() {
+  sys_window_t* window = sys_window_create("Top", SYS_POS_DEFAULT, SYS_POS_DEFAULT, 760, 400, SYS_WF_DEFAULT);
+  if (window == NULL) {
+    sys_print("ERROR: failed to create window.");
+    return 1;
+  }
+
+  bool should_close = false;
+  while (!should_close) {
+    draw(window);
+
+    sys_message_t message;
+    while (sys_poll_message(window, &message)) {
+      if (message.id == SYS_MSG_CLOSE)
+        should_close = true;
+    }
+
+    sys_usleep(REFRESH_DELAY_US);
+  }
+
+  sys_window_destroy(window);
+  return 0;
+}
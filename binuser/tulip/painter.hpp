@@ -3,11 +3,18 @@
 
 #include "utils.hpp"
 
+#include <sys/window.h>
+
 class TuWidget;
 
 class TuPainter {
 public:
+  /** The drawings are clipped to the target widget, and recorded into the display list of its window
+   * (see sys_gfx_submit()): they are submitted at once when the window is presented. */
   explicit TuPainter(TuWidget* target);
+  TuPainter(const TuPainter&) = delete;
+  TuPainter& operator=(const TuPainter&) = delete;
+  ~TuPainter();
 
   [[nodiscard]] TuColor get_pen() const { return m_pen_color; }
   void set_pen(TuColor color) { m_pen_color = color; }
@@ -26,7 +33,8 @@ public:
 
 private:
   TuWidget* m_target;
-  TuRect m_clip_rect;
+  sys_window_t* m_window_handle;
+  TuPoint m_origin;  // the target top-left corner, in window coordinates
   TuColor m_pen_color = {0, 0, 0, 255};
   TuColor m_brush_color = {255, 255, 255, 255};
 }; // class TuPainter
@@ -16,6 +16,7 @@
 #define CUSTOM_PAGES_MEMORY (KERNEL_BASE + 0x0000300000000000)
 #define BUFFER_MEMORY (KERNEL_BASE + 0x0000400000000000)
 #define HEAP_MEMORY (KERNEL_BASE + 0x0000500000000000)
+#define TASK_STACK_MEMORY (KERNEL_BASE + 0x0000600000000000)
 #define RAM_FS_MEMORY (KERNEL_BASE + 0x0000a00000000000)
 #define STACK_MEMORY (KERNEL_BASE + 0x0000f00000000000)
 
@@ -27,6 +28,11 @@
 #define PROCESS_HEAP_BASE (PROCESS_BASE + 0x0000800000000000)
 #define PROCESS_STACK_BASE (PROCESS_BASE + 0x0000f00000000000)
 
+// Window surfaces mapped in a process, each one in its own slot (larger than any window framebuffer).
+#define PROCESS_SURFACE_BASE (PROCESS_BASE + 0x0000e00000000000)
+#define PROCESS_SURFACE_SLOT_SIZE (0x0000001000000000)
+#define PROCESS_SURFACE_MAX_SLOTS (256)
+
 #ifndef __ASSEMBLER__
 #include <cstddef>
 #include <cstdint>
@@ -8,6 +8,13 @@
 
 static uint8_t* ramdisk_buffer = nullptr;
 
+const void* ramdisk_get_sector_address(uint64_t sector) {
+  if (ramdisk_buffer == nullptr || sector >= RAM_FS_SECTOR_COUNT)
+    return nullptr;
+
+  return &ramdisk_buffer[sector * FF_MIN_SS];
+}
+
 extern "C" {
 DSTATUS disk_status(BYTE drive) {
   switch (drive) {
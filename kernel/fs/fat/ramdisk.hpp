@@ -5,3 +5,6 @@
 inline static constexpr PhysicalPA RAM_FS_PHYSICAL_LOAD_ADDRESS = 0x18000000;
 inline static constexpr size_t RAM_FS_BYTE_SIZE = 0xa00000;  // 10 Mio (Must be a multiple of PAGE_SIZE)
 inline static constexpr size_t RAM_FS_SECTOR_COUNT = RAM_FS_BYTE_SIZE / FF_MIN_SS;
+
+/** Gets the address of @a sector in the ramdisk memory, or nullptr if it is out of the ramdisk (or not mounted). */
+const void* ramdisk_get_sector_address(uint64_t sector);
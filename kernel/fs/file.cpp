@@ -1,4 +1,6 @@
 #include "file.hpp"
+#include "memory/memory.hpp"
+#include "fat/ramdisk.hpp"
 
 bool File::read(void* buffer, size_t bytes_to_read, size_t* read_bytes) {
   UINT read_bytes_bis;
@@ -34,3 +36,25 @@ bool File::truncate() {
   return false;
 #endif
 }
+
+const void* File::map() {
+  const FATFS* fs = m_handle.obj.fs;
+  const DWORD first_cluster = m_handle.obj.sclust;
+  if (first_cluster == 0)
+    return nullptr;  // no cluster allocated, the file is empty
+
+  // Follow the cluster chain by seeking into each cluster (seeking to the exact start of a
+  // cluster does not enter it yet), and check that the clusters are consecutive.
+  const FSIZE_t cluster_size = (FSIZE_t)fs->csize * FF_MIN_SS;
+  const FSIZE_t position = f_tell(&m_handle);
+  bool is_contiguous = true;
+  for (FSIZE_t offset = cluster_size; is_contiguous && offset < f_size(&m_handle); offset += cluster_size) {
+    is_contiguous = f_lseek(&m_handle, offset + 1) == FR_OK && m_handle.clust == first_cluster + offset / cluster_size;
+  }
+
+  if (f_lseek(&m_handle, position) != FR_OK || !is_contiguous)
+    return nullptr;
+
+  // The data area starts with the cluster 2.
+  return ramdisk_get_sector_address(fs->database + (LBA_t)fs->csize * (first_cluster - 2));
+}
@@ -15,6 +15,10 @@ class File {
   bool truncate();
   bool eof() const { return f_eof(&m_handle); }
 
+  /** Gets the content of the file directly in the ramdisk memory, without copying it.
+   * Returns nullptr if the file is empty or fragmented (its content is then not contiguous in memory). */
+  [[nodiscard]] const void* map();
+
  private:
   friend class FileSystem;
   FIL m_handle;
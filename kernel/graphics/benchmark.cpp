@@ -0,0 +1,165 @@
+#include "graphics/benchmark.hpp"
+#include "graphics/graphics.hpp"
+#include "graphics/pixel_format.hpp"
+#include "hardware/timer.hpp"
+
+#include <libk/log.hpp>
+#include <libk/string.hpp>
+
+#ifdef CONFIG_USE_DMA
+#include "hardware/dma/channel.hpp"
+#include "memory/buffer.hpp"
+#endif  // CONFIG_USE_DMA
+
+namespace graphics {
+static constexpr uint32_t WIDTH = 1280;
+static constexpr uint32_t HEIGHT = 720;
+static constexpr uint32_t NB_ITERATIONS = 20;
+
+template <class Fn>
+static void benchmark(const char* name, uint64_t nb_pixels_per_iteration, Fn fn) {
+  const uint64_t start = GenericTimer::get_elapsed_time_in_micros();
+  for (uint32_t i = 0; i < NB_ITERATIONS; ++i) {
+    fn(i);
+  }
+  const uint64_t elapsed = libk::max<uint64_t>(1, GenericTimer::get_elapsed_time_in_micros() - start);
+
+  // Pixels per microsecond is Mpixels per second, keep one decimal.
+  const uint64_t tenth_mpixels_per_s = (nb_pixels_per_iteration * NB_ITERATIONS * 10) / elapsed;
+  LOG_INFO("[graphics] {}: {}.{} Mpixels/s ({} us for {} iterations)", name, tenth_mpixels_per_s / 10,
+           tenth_mpixels_per_s % 10, elapsed, NB_ITERATIONS);
+}
+
+/** Measures the composition of a full screen window into a screen of each pixel format, as done by
+ * the window manager: the window is copied (opaque window) or blended (translucent window). */
+static void benchmark_composite(const uint32_t* window) {
+  auto* screen = new uint32_t[WIDTH * HEIGHT];  // large enough for any format
+  if (screen == nullptr) {
+    LOG_ERROR("[graphics] Failed to allocate the composite benchmark buffer");
+    return;
+  }
+
+  struct ScreenMode {
+    PixelFormat format;
+    bool dither;
+    const char* copy_name;
+    const char* blend_name;
+  };  // struct ScreenMode
+
+  static constexpr ScreenMode MODES[] = {
+      {PixelFormat::ARGB8888, false, "composite copy (ARGB8888)", "composite blend (ARGB8888)"},
+      {PixelFormat::RGB565, false, "composite copy (RGB565)", "composite blend (RGB565)"},
+      {PixelFormat::RGB565, true, "composite copy (RGB565, dithered)", "composite blend (RGB565, dithered)"},
+  };
+
+  static constexpr BlendMode BLEND_MODES[] = {BlendMode::Copy, BlendMode::SourceOver};
+
+  const uint64_t screen_pixels = WIDTH * HEIGHT;
+  for (const auto& mode : MODES) {
+    const uint32_t pitch = WIDTH * get_bytes_per_pixel(mode.format);
+    for (const auto blend_mode : BLEND_MODES) {
+      const auto convert_span =
+          get_convert_span(mode.format, PixelFormat::ARGB8888, blend_mode, AlphaFormat::Premultiplied, mode.dither);
+      benchmark(blend_mode == BlendMode::Copy ? mode.copy_name : mode.blend_name, screen_pixels, [&](uint32_t) {
+        for (uint32_t y = 0; y < HEIGHT; ++y) {
+          convert_span((uint8_t*)screen + pitch * y, window + WIDTH * y, WIDTH, 0, y);
+        }
+      });
+    }
+  }
+
+  delete[] screen;
+}
+
+#ifdef CONFIG_USE_DMA
+/** Compares the copy of a whole buffer (as done by the compositor for a full screen frame)
+ * with the CPU and with one or two DMA channels. */
+static void benchmark_copy() {
+  Buffer src(sizeof(uint32_t) * WIDTH * HEIGHT);
+  Buffer dst(sizeof(uint32_t) * WIDTH * HEIGHT);
+  const uint64_t screen_pixels = WIDTH * HEIGHT;
+
+  benchmark("copy (CPU)", screen_pixels, [&](uint32_t) {
+    blend_span((uint32_t*)dst.get(), (const uint32_t*)src.get(), WIDTH * HEIGHT, BlendMode::Copy);
+  });
+
+  static constexpr size_t NB_CHANNELS = 2;
+  DMA::Channel channels[NB_CHANNELS];
+  DMA::ControlBlockRing ring(NB_CHANNELS);
+  const DMA::Address src_addr = src.get_dma_address();
+  const DMA::Address dst_addr = dst.get_dma_address();
+
+  for (size_t nb_channels = 1; nb_channels <= NB_CHANNELS; ++nb_channels) {
+    benchmark(nb_channels == 1 ? "copy (DMA, 1 channel)" : "copy (DMA, 2 channels)", screen_pixels, [&](uint32_t) {
+      // Each channel copies a band of rows.
+      DMA::ControlBlockChain chains[NB_CHANNELS];
+      uint32_t y = 0;
+      for (size_t i = 0; i < nb_channels; ++i) {
+        const uint32_t height = (HEIGHT - y) / (nb_channels - i);
+        const size_t offset = sizeof(uint32_t) * WIDTH * y;
+        (void)chains[i].add_memcpy_2d(ring, src_addr + offset, dst_addr + offset, sizeof(uint32_t) * WIDTH, height, 0,
+                                      0);
+        (void)channels[i].execute_chain(chains[i], ring);
+        y += height;
+      }
+
+      for (size_t i = 0; i < nb_channels; ++i) {
+        if (channels[i].wait())
+          LOG_ERROR("[graphics] DMA error during the copy benchmark");
+      }
+
+      ring.release_until(ring.get_mark());
+    });
+  }
+}
+#endif  // CONFIG_USE_DMA
+
+void run_benchmark() {
+  auto* buffer = new uint32_t[WIDTH * HEIGHT];
+  if (buffer == nullptr) {
+    LOG_ERROR("[graphics] Failed to allocate the benchmark buffer");
+    return;
+  }
+
+  Painter painter(buffer, WIDTH, HEIGHT, WIDTH);
+  const uint64_t screen_pixels = WIDTH * HEIGHT;
+
+  benchmark("clear", screen_pixels, [&](uint32_t i) { painter.clear(Color(0xff000000 | i)); });
+  benchmark("fill_rect (opaque)", screen_pixels,
+            [&](uint32_t i) { painter.fill_rect(0, 0, WIDTH, HEIGHT, Color(0xff102030 + i)); });
+  benchmark("fill_rect (translucent)", screen_pixels,
+            [&](uint32_t i) { painter.fill_rect(0, 0, WIDTH, HEIGHT, Color(0x80102030 + i)); });
+
+  // Concentric rectangles covering the whole buffer.
+  uint64_t rect_pixels = 0;
+  for (uint32_t k = 0; k < HEIGHT / 2; ++k) {
+    rect_pixels += 2 * (WIDTH - 2 * k) + 2 * (HEIGHT - 2 * k - 2);
+  }
+
+  benchmark("draw_rect (opaque)", rect_pixels, [&](uint32_t i) {
+    for (uint32_t k = 0; k < HEIGHT / 2; ++k) {
+      painter.draw_rect(k, k, WIDTH - 2 * k, HEIGHT - 2 * k, Color(0xff000000 | (i + k)));
+    }
+  });
+
+  // A screen full of text, drawn with the glyph cache.
+  static constexpr const char* TEXT =
+      "The quick brown fox jumps over the lazy dog. 0123456789 {}[]()<>+-*/=!?;:,.'\"~#$%&@^_`|\\ ";
+  const PKFont font = painter.get_font();
+  const uint32_t nb_lines = HEIGHT / font.get_line_height();
+  const uint64_t text_pixels = (uint64_t)font.get_char_width() * font.get_char_height() * libk::strlen(TEXT) * nb_lines;
+  const TextLayout layout(font, TEXT, WIDTH);
+  benchmark("draw_text", text_pixels, [&](uint32_t i) {
+    for (uint32_t k = 0; k < nb_lines; ++k) {
+      painter.draw_text(0, k * font.get_line_height(), layout, Color(0xff000000 | (i & 1) * 0xffffff));
+    }
+  });
+
+  benchmark_composite(buffer);
+  delete[] buffer;
+
+#ifdef CONFIG_USE_DMA
+  benchmark_copy();
+#endif  // CONFIG_USE_DMA
+}
+}  // namespace graphics
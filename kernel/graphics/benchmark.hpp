@@ -0,0 +1,9 @@
+#pragma once
+
+namespace graphics {
+/** @brief Measures the Painter drawing primitives throughput (in Mpixels/s) on an offscreen
+ * 1280x720 buffer and logs the results. The full screen composite time is measured for each
+ * screen pixel format. With CONFIG_USE_DMA, the CPU and DMA copies of such a buffer are
+ * compared too. Enabled with CONFIG_GRAPHICS_BENCHMARK. */
+void run_benchmark();
+}  // namespace graphics
@@ -0,0 +1,212 @@
+#include "graphics/glyph_cache.hpp"
+
+#include <libk/log.hpp>
+#include <libk/utils.hpp>
+
+namespace graphics {
+static GlyphCache* _caches = nullptr;  // linked list of the caches of all used fonts
+
+GlyphCache* GlyphCache::get(PKFont font) {
+  for (GlyphCache* cache = _caches; cache != nullptr; cache = cache->m_next) {
+    if (cache->m_font.get_data() == font.get_data())
+      return cache;
+  }
+
+  auto* cache = new GlyphCache(font);
+  if (cache == nullptr)
+    return nullptr;
+
+  // Only the table of the blocks is allocated now, the blocks are decoded when drawn.
+  const uint32_t block_count = (cache->m_glyph_count + BLOCK_SIZE - 1) / BLOCK_SIZE;
+  cache->m_blocks = new GlyphBlock*[block_count];
+  if (cache->m_blocks == nullptr) {
+    LOG_ERROR("[graphics] Failed to allocate the glyph cache.");
+    delete cache;
+    return nullptr;
+  }
+
+  for (uint32_t i = 0; i < block_count; ++i) {
+    cache->m_blocks[i] = nullptr;
+  }
+
+  cache->m_next = _caches;
+  _caches = cache;
+  return cache;
+}
+
+GlyphCache::~GlyphCache() {
+  if (m_blocks != nullptr) {
+    for (uint32_t i = 0; i < (m_glyph_count + BLOCK_SIZE - 1) / BLOCK_SIZE; ++i) {
+      if (m_blocks[i] == nullptr)
+        continue;
+
+      delete[] m_blocks[i]->decoded_alpha_maps;
+      delete[] m_blocks[i]->runs;
+      delete m_blocks[i];
+    }
+
+    delete[] m_blocks;
+  }
+
+  for (auto& tinted_block : m_tinted_blocks) {
+    delete[] tinted_block.pixels;
+  }
+}
+
+GlyphCache::GlyphBlock* GlyphCache::decode_block(uint32_t block_index) {
+  auto* block = new GlyphBlock;
+  if (block == nullptr)
+    return nullptr;
+
+  if (!decode_alpha_maps(block_index, *block)) {
+    LOG_ERROR("[graphics] Failed to allocate a block of the glyph cache.");
+    delete[] block->decoded_alpha_maps;
+    delete[] block->runs;
+    delete block;
+    return nullptr;
+  }
+
+  m_blocks[block_index] = block;
+  return block;
+}
+
+bool GlyphCache::decode_alpha_maps(uint32_t block_index, GlyphBlock& block) {
+  const uint32_t first_glyph = block_index * BLOCK_SIZE;
+  const uint32_t glyph_count = libk::min(BLOCK_SIZE, m_glyph_count - first_glyph);
+
+  // The alpha maps of uncompressed fonts are used in place.
+  if (!m_font.is_compressed()) {
+    block.alpha_maps = m_font.get_glyph(PKFont::FIRST_CHARACTER) + (size_t)m_glyph_size * first_glyph;
+    return compute_runs(glyph_count, block);
+  }
+
+  block.decoded_alpha_maps = new uint8_t[(size_t)m_glyph_size * glyph_count];
+  if (block.decoded_alpha_maps == nullptr)
+    return false;
+
+  for (uint32_t i = 0; i < glyph_count; ++i) {
+    if (!m_font.decode_glyph(first_glyph + i, block.decoded_alpha_maps + (size_t)m_glyph_size * i))
+      LOG_WARNING("[graphics] The glyph {} of the font is invalid, it is not drawn.", first_glyph + i);
+  }
+
+  block.alpha_maps = block.decoded_alpha_maps;
+  return compute_runs(glyph_count, block);
+}
+
+bool GlyphCache::compute_runs(uint32_t glyph_count, GlyphBlock& block) {
+  const uint32_t char_width = m_font.get_char_width();
+  const uint32_t char_height = m_font.get_char_height();
+
+  // Two passes: first count the runs to allocate them at once, then fill them.
+  for (int pass = 0; pass < 2; ++pass) {
+    uint32_t nb_runs = 0;
+    for (size_t i = 0; i < glyph_count; ++i) {
+      const uint8_t* alpha_map = block.alpha_maps + (size_t)m_glyph_size * i;
+      block.first_run[i] = nb_runs;
+
+      uint32_t x_min = char_width, y_min = char_height, x_max = 0, y_max = 0;
+      for (uint32_t y = 0; y < char_height; ++y) {
+        const uint8_t* row = alpha_map + char_width * y;
+        uint32_t x = 0;
+        while (x < char_width) {
+          if (row[x] == 0) {
+            ++x;
+            continue;
+          }
+
+          const uint32_t start = x;
+          while (x < char_width && row[x] != 0) {
+            ++x;
+          }
+
+          if (pass == 1)
+            block.runs[nb_runs] = {(uint16_t)start, (uint16_t)y, (uint16_t)(x - start)};
+          ++nb_runs;
+
+          x_min = libk::min(x_min, start);
+          x_max = libk::max(x_max, x);
+          y_min = libk::min(y_min, y);
+          y_max = y + 1;
+        }
+      }
+
+      if (x_min < x_max)
+        block.boxes[i] = {(uint16_t)x_min, (uint16_t)y_min, (uint16_t)(x_max - x_min), (uint16_t)(y_max - y_min)};
+      else
+        block.boxes[i] = {0, 0, 0, 0};
+    }
+
+    block.first_run[glyph_count] = nb_runs;
+    if (pass == 0) {
+      block.runs = new GlyphRun[nb_runs];
+      if (block.runs == nullptr)
+        return false;
+    }
+  }
+
+  return true;
+}
+
+const uint32_t* GlyphCache::get_tinted_glyph(uint32_t index, uint32_t color) {
+  GlyphBlock* block = get_block(index);
+  if (block == nullptr)
+    return nullptr;
+
+  color &= 0x00ffffff;
+  const uint32_t block_index = index / BLOCK_SIZE;
+
+  // The glyphs of a block are usually drawn with the same color as the last time. Otherwise, find
+  // the tinted block, or recycle the least recently used one.
+  TintedBlock* tinted_block = block->last_tinted_block;
+  if (tinted_block == nullptr || tinted_block->color != color || tinted_block->block != block_index) {
+    tinted_block = nullptr;
+    TintedBlock* lru_block = &m_tinted_blocks[0];
+    for (auto& it : m_tinted_blocks) {
+      if (it.pixels != nullptr && it.color == color && it.block == block_index) {
+        tinted_block = &it;
+        break;
+      }
+
+      if (it.last_use < lru_block->last_use)
+        lru_block = &it;
+    }
+
+    if (tinted_block == nullptr) {
+      tinted_block = lru_block;
+      if (tinted_block->pixels == nullptr) {
+        tinted_block->pixels = new uint32_t[(size_t)m_glyph_size * BLOCK_SIZE];
+        if (tinted_block->pixels == nullptr)
+          return nullptr;
+      }
+
+      tinted_block->color = color;
+      tinted_block->block = block_index;
+      tinted_block->tinted_glyphs = 0;
+    }
+
+    block->last_tinted_block = tinted_block;
+  }
+
+  tinted_block->last_use = ++m_use_counter;
+
+  const uint32_t i = index % BLOCK_SIZE;
+  uint32_t* pixels = tinted_block->pixels + (size_t)m_glyph_size * i;
+  const uint32_t tinted_mask = (uint32_t)1 << i;
+  if ((tinted_block->tinted_glyphs & tinted_mask) == 0) {
+    // Only the texels covered by the runs are ever read, so only them are tinted.
+    const uint8_t* alpha_map = block->alpha_maps + (size_t)m_glyph_size * i;
+    const uint32_t char_width = m_font.get_char_width();
+    for (uint32_t j = block->first_run[i]; j < block->first_run[i + 1]; ++j) {
+      const GlyphRun& run = block->runs[j];
+      const size_t offset = run.x + char_width * run.y;
+      for (size_t k = offset; k < offset + run.length; ++k) {
+        pixels[k] = color | ((uint32_t)alpha_map[k] << 24);
+      }
+    }
+
+    tinted_block->tinted_glyphs |= tinted_mask;
+  }
+
+  return pixels;
+}
+}  // namespace graphics
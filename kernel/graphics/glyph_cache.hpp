@@ -0,0 +1,141 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "graphics/pkfont.hpp"
+
+namespace graphics {
+/** @brief A horizontal run of non-transparent texels in a glyph alpha map. */
+struct GlyphRun {
+  uint16_t x;
+  uint16_t y;
+  uint16_t length;
+};  // struct GlyphRun
+
+/** @brief The bounding box of the non-transparent texels of a glyph, relative to the character cell. */
+struct GlyphBox {
+  uint16_t x;
+  uint16_t y;
+  uint16_t width;
+  uint16_t height;
+};  // struct GlyphBox
+
+/**
+ * @brief Precomputed data used to quickly draw the glyphs of a PKFont.
+ *
+ * For each glyph, the cache stores the runs of non-transparent texels row by row, so that
+ * fully transparent texels (the majority of them) are never visited when drawing text, and
+ * their bounding box, so that glyphs outside the clipping are rejected at once. Glyphs are
+ * handled by blocks of BLOCK_SIZE consecutive glyphs, decoded the first time one of them is
+ * drawn: the memory used only depends on the glyphs actually drawn, not on the font size.
+ * Compressed fonts (PKF v2) are decoded once per block, drawing their text then costs the
+ * same as for uncompressed fonts.
+ *
+ * It also keeps a few tinted blocks: the glyphs of a block already converted to ARGB pixels of a
+ * given color. The glyph runs can then be blended directly from them with blend_span(). Glyphs are
+ * tinted lazily, the first time they are drawn with a color, and the least recently used tinted
+ * block is recycled when another block or color is needed.
+ */
+class GlyphCache {
+ public:
+  /** @brief Number of consecutive glyphs decoded or tinted at once. */
+  static constexpr uint32_t BLOCK_SIZE = 32;
+  /** @brief Maximal number of tinted blocks kept (for any color). */
+  static constexpr size_t MAX_TINTED_BLOCKS = 16;
+
+  /** @brief Gets the glyph cache of @a font, creating it if needed.
+   *
+   * Returns nullptr if the memory for the cache can not be allocated. */
+  [[nodiscard]] static GlyphCache* get(PKFont font);
+
+  GlyphCache(const GlyphCache&) = delete;
+  GlyphCache& operator=(const GlyphCache&) = delete;
+
+  /** @brief Gets the runs of glyph @a index (see PKFont::get_glyph_index()). Returns the number of runs
+   * stored in @a runs.
+   *
+   * The runs are sorted by row. If the glyph does not exist or its block can not be decoded, no runs
+   * are returned. */
+  [[nodiscard]] size_t get_runs(uint32_t index, const GlyphRun*& runs) {
+    const GlyphBlock* block = get_block(index);
+    if (block == nullptr)
+      return 0;
+
+    const uint32_t i = index % BLOCK_SIZE;
+    runs = block->runs + block->first_run[i];
+    return block->first_run[i + 1] - block->first_run[i];
+  }
+
+  /** @brief Gets the bounding box of glyph @a index, or nullptr if the glyph does not exist or its block
+   * can not be decoded. */
+  [[nodiscard]] const GlyphBox* get_box(uint32_t index) {
+    const GlyphBlock* block = get_block(index);
+    return block != nullptr ? &block->boxes[index % BLOCK_SIZE] : nullptr;
+  }
+
+  /** @brief Gets the pixels of glyph @a index tinted with @a color (in 0xAARRGGBB format, straight alpha).
+   *
+   * The alpha of @a color is ignored and replaced by the glyph alpha. The returned pixels are stored in
+   * row-major order, with a pitch equal to the font character width. They stay valid until the next call.
+   * Returns nullptr if the glyph does not exist or if the memory for its block can not be allocated. */
+  [[nodiscard]] const uint32_t* get_tinted_glyph(uint32_t index, uint32_t color);
+
+ private:
+  explicit GlyphCache(PKFont font)
+      : m_font(font),
+        m_glyph_count(font.get_glyph_count()),
+        m_glyph_size(font.get_char_width() * font.get_char_height()) {}
+  ~GlyphCache();
+
+  struct TintedBlock;
+
+  /** The decoded data of the glyphs [BLOCK_SIZE * i, BLOCK_SIZE * (i + 1)) of the font. */
+  struct GlyphBlock {
+    // The alpha maps of the glyphs (char_width x char_height texels each), owned only if they were decoded.
+    const uint8_t* alpha_maps = nullptr;
+    uint8_t* decoded_alpha_maps = nullptr;
+
+    GlyphRun* runs = nullptr;
+    uint32_t first_run[BLOCK_SIZE + 1];  // runs of glyph i are runs[first_run[i]..first_run[i + 1]]
+    GlyphBox boxes[BLOCK_SIZE];
+
+    // The tinted block last used for these glyphs (it may have been recycled for another block since).
+    TintedBlock* last_tinted_block = nullptr;
+  };  // struct GlyphBlock
+
+  struct TintedBlock {
+    uint32_t color = 0;
+    uint32_t block = 0;
+    uint64_t last_use = 0;
+    uint32_t tinted_glyphs = 0;  // bitmap of the glyphs of the block already tinted
+    uint32_t* pixels = nullptr;
+  };  // struct TintedBlock
+
+  static_assert(BLOCK_SIZE <= 32, "the tinted glyphs of a block must fit in TintedBlock::tinted_glyphs");
+
+  /** Gets the block of glyph @a index, decoding it if needed. Returns nullptr if @a index does not exist
+   * or the memory for the block can not be allocated. */
+  [[nodiscard]] GlyphBlock* get_block(uint32_t index) {
+    if (index >= m_glyph_count)
+      return nullptr;
+
+    GlyphBlock* block = m_blocks[index / BLOCK_SIZE];
+    return block != nullptr ? block : decode_block(index / BLOCK_SIZE);
+  }
+  /** Decodes the block @a block_index and stores it in m_blocks. Returns nullptr if out of memory. */
+  GlyphBlock* decode_block(uint32_t block_index);
+  bool decode_alpha_maps(uint32_t block_index, GlyphBlock& block);
+  bool compute_runs(uint32_t glyph_count, GlyphBlock& block);
+
+  PKFont m_font;
+  GlyphCache* m_next = nullptr;  // next glyph cache (for another font)
+
+  uint32_t m_glyph_count;
+  uint32_t m_glyph_size;            // number of texels of a glyph
+  GlyphBlock** m_blocks = nullptr;  // one per BLOCK_SIZE glyphs, null until decoded
+
+  TintedBlock m_tinted_blocks[MAX_TINTED_BLOCKS];
+  uint64_t m_use_counter = 0;
+};  // class GlyphCache
+}  // namespace graphics
@@ -1,21 +1,35 @@
 #include "graphics/graphics.hpp"
+#include <libk/assert.hpp>
 #include <libk/utils.hpp>
-#include <utility>
+#include "graphics/glyph_cache.hpp"
+#include "graphics/span.hpp"
 #include "hardware/framebuffer.hpp"
 
 extern const uint8_t firacode_16_pkf[100];
 
 namespace graphics {
+// The font of the new painters, the builtin one until another one is loaded (see set_default_font()).
+static PKFont g_default_font = firacode_16_pkf;
+
+PKFont get_default_font() {
+  return g_default_font;
+}
+
+void set_default_font(PKFont font) {
+  g_default_font = font;
+}
+
 [[gnu::always_inline, nodiscard]] static inline int32_t abs(int32_t x) {
   return x < 0 ? -x : x;
 }
 
-Painter::Painter() : m_font(firacode_16_pkf) {
+Painter::Painter() : m_font(g_default_font) {
   auto& fb = FrameBuffer::get();
-  create(fb.get_buffer(), fb.get_width(), fb.get_height(), fb.get_pitch());
+  KASSERT(fb.get_pixel_format() == PixelFormat::ARGB8888);
+  create((uint32_t*)fb.get_buffer(), fb.get_width(), fb.get_height(), fb.get_pitch());
 }
 
-Painter::Painter(uint32_t* buffer, uint32_t width, uint32_t height, uint32_t pitch) : m_font(firacode_16_pkf) {
+Painter::Painter(uint32_t* buffer, uint32_t width, uint32_t height, uint32_t pitch) : m_font(g_default_font) {
   create(buffer, width, height, pitch);
 }
 
@@ -29,10 +43,8 @@ void Painter::create(uint32_t* buffer, uint32_t width, uint32_t height, uint32_t
 }
 
 [[gnu::hot]] void Painter::clear(graphics::Color clear_color) {
-  for (uint32_t x = 0; x < m_width; ++x) {
-    for (uint32_t y = 0; y < m_height; ++y) {
-      m_buffer[x + m_pitch * y] = clear_color.argb;
-    }
+  for (uint32_t y = 0; y < m_height; ++y) {
+    fill_span(m_buffer + m_pitch * y, m_width, to_buffer_color(clear_color));
   }
 }
 
@@ -47,60 +59,229 @@ void Painter::draw_pixel(int32_t x, int32_t y) {
   if (y < m_clipping.y_min || y > m_clipping.y_max)
     return;
 
-  // Alpha blending: dst = alpha * src + (1 - alpha) * dst
-  const uint32_t dst_color = m_buffer[x + m_pitch * y];
-  const uint32_t dst_red = (dst_color >> 16) & 0xff;
-  const uint32_t dst_green = (dst_color >> 8) & 0xff;
-  const uint32_t dst_blue = dst_color & 0xff;
-
-  const uint32_t src_alpha = (color.argb >> 24) & 0xff;
-  const uint32_t src_red = (color.argb >> 16) & 0xff;
-  const uint32_t src_green = (color.argb >> 8) & 0xff;
-  const uint32_t src_blue = color.argb & 0xff;
-
-  const uint32_t result_red = (src_alpha * src_red + (255 - src_alpha) * dst_red) / 255;
-  const uint32_t result_green = (src_alpha * src_green + (255 - src_alpha) * dst_green) / 255;
-  const uint32_t result_blue = (src_alpha * src_blue + (255 - src_alpha) * dst_blue) / 255;
-  m_buffer[x + m_pitch * y] = (0x00 << 24) | (result_red << 16) | (result_green << 8) | result_blue;
+  uint32_t& dst = m_buffer[x + m_pitch * y];
+  switch (color.get_alpha()) {
+    case 0x00:
+      return;
+    case 0xff:
+      dst = color.argb;
+      return;
+    default:
+      if (m_alpha_format == AlphaFormat::Straight)
+        dst = blend_pixel(dst, color.argb);
+      else
+        dst = blend_pixel_premultiplied(dst, premultiply(color.argb));
+      return;
+  }
 }
 
 void Painter::draw_line(int32_t x0, int32_t y0, int32_t x1, int32_t y1) {
   draw_line(x0, y0, x1, y1, m_pen);
 }
 
-[[gnu::hot]] void Painter::draw_line(int32_t x1, int32_t y1, int32_t x2, int32_t y2, Color color) {
-  // See https://en.wikipedia.org/wiki/Bresenham's_line_algorithm
+/** @brief Computes @a n / @a d rounded toward negative infinity (@a d must be positive). */
+[[nodiscard]] static int64_t divide_floor(int64_t n, int64_t d) {
+  return n >= 0 ? n / d : -((-n + d - 1) / d);
+}
 
-  const auto dx = x2 - x1;
-  const auto dy = y2 - y1;
+/** @brief Computes @a n / @a d rounded to the nearest integer. */
+[[nodiscard]] static int64_t divide_rounded(int64_t n, int64_t d) {
+  if (d < 0) {
+    n = -n;
+    d = -d;
+  }
 
-  // If both of the differences are 0 there will be a division by 0 below.
-  if (dx == 0 && dy == 0) {
-    draw_pixel(x1, y1, color);
+  return divide_floor(2 * n + d, 2 * d);
+}
+
+/**
+ * @brief Clips the steps of a Bresenham line.
+ *
+ * The line goes from (@a a0, @a b0) along the major axis A by @a da steps of direction @a sa, and along
+ * the minor axis B by @a db (0 < @a db <= @a da) in direction @a sb. At step i, the point is
+ * (a0 + sa * i, b0 + sb * q(i)) where q(i) = floor((2 * db * i + da) / (2 * da)).
+ *
+ * Computes the first and last steps inside [@a a_min, @a a_max] x [@a b_min, @a b_max]. As the clipping is
+ * done on the steps, the drawn pixels are exactly the ones of the unclipped line. Returns false if
+ * no step is inside.
+ */
+[[nodiscard]] static bool clip_line_steps(int64_t a0,
+                                          int64_t sa,
+                                          int64_t da,
+                                          int64_t b0,
+                                          int64_t sb,
+                                          int64_t db,
+                                          int64_t a_min,
+                                          int64_t a_max,
+                                          int64_t b_min,
+                                          int64_t b_max,
+                                          int64_t& first,
+                                          int64_t& last) {
+  // Major axis constraint, directly on the steps.
+  first = sa > 0 ? a_min - a0 : a0 - a_max;
+  last = sa > 0 ? a_max - a0 : a0 - a_min;
+
+  // Minor axis constraint on q(i), converted into steps (q is non-decreasing).
+  const int64_t q_min = sb > 0 ? b_min - b0 : b0 - b_max;
+  const int64_t q_max = sb > 0 ? b_max - b0 : b0 - b_min;
+  if (q_max < 0 || q_min > db)
+    return false;
+
+  // q(i) >= q_min <=> i >= ceil((2 * da * q_min - da) / (2 * db))
+  if (q_min > 0)
+    first = libk::max(first, -divide_floor(da - 2 * da * q_min, 2 * db));
+  // q(i) <= q_max <=> i <= floor((2 * da * (q_max + 1) - da - 1) / (2 * db))
+  if (q_max < db)
+    last = libk::min(last, divide_floor(2 * da * (q_max + 1) - da - 1, 2 * db));
+
+  first = libk::max<int64_t>(first, 0);
+  last = libk::min(last, da);
+  return first <= last;
+}
+
+[[gnu::hot]] void Painter::draw_line(int32_t x0, int32_t y0, int32_t x1, int32_t y1, Color color) {
+  if (color.get_alpha() == 0)
+    return;
+
+  // Axis-aligned lines are spans (clamped first, so their length does not overflow).
+  if (y0 == y1) {
+    const int32_t x_min = libk::max(libk::min(x0, x1), m_clipping.x_min);
+    const int32_t x_max = libk::min(libk::max(x0, x1), m_clipping.x_max);
+    if (x_min <= x_max)
+      fill_rect(x_min, y0, x_max - x_min + 1, 1, color);
+    return;
+  }
+
+  if (x0 == x1) {
+    const int32_t y_min = libk::max(libk::min(y0, y1), m_clipping.y_min);
+    const int32_t y_max = libk::min(libk::max(y0, y1), m_clipping.y_max);
+    if (y_min <= y_max)
+      fill_rect(x0, y_min, 1, y_max - y_min + 1, color);
     return;
   }
 
-  if (abs(dx) > abs(dy)) {
-    if (x1 > x2) {
-      std::swap(x1, x2);
-      std::swap(y1, y2);
+  // Cohen-Sutherland trivial rejection: both endpoints are on the same outer side.
+  if ((compute_out_code(x0, y0, m_clipping) & compute_out_code(x1, y1, m_clipping)) != OUT_CODE_INSIDE)
+    return;
+
+  // Endpoints far away from the clipping region are first moved closer (still outside of it), so
+  // the computations below do not overflow. This is the only case where the pixels may slightly
+  // differ from the unclipped line.
+  constexpr int32_t GUARD_BAND = 1 << 20;
+  constexpr BBox GUARD_BAND_BOX = {-GUARD_BAND, -GUARD_BAND, GUARD_BAND, GUARD_BAND};
+  if ((compute_out_code(x0, y0, GUARD_BAND_BOX) | compute_out_code(x1, y1, GUARD_BAND_BOX)) != OUT_CODE_INSIDE &&
+      !clip_line(x0, y0, x1, y1, GUARD_BAND_BOX))
+    return;
+
+  // See https://en.wikipedia.org/wiki/Bresenham's_line_algorithm
+  const int64_t dx = abs(x1 - x0);
+  const int64_t dy = abs(y1 - y0);
+  const int32_t step_x = x0 < x1 ? 1 : -1;
+  const int32_t step_y = y0 < y1 ? 1 : -1;
+  const bool is_x_major = dx >= dy;
+  const int64_t da = is_x_major ? dx : dy;
+  const int64_t db = is_x_major ? dy : dx;
+
+  // The clipping is done once, then all the steps are inside the clipping region.
+  int64_t first, last;
+  const bool is_visible =
+      is_x_major ? clip_line_steps(x0, step_x, dx, y0, step_y, dy, m_clipping.x_min, m_clipping.x_max,
+                                   m_clipping.y_min, m_clipping.y_max, first, last)
+                 : clip_line_steps(y0, step_y, dy, x0, step_x, dx, m_clipping.y_min, m_clipping.y_max,
+                                   m_clipping.x_min, m_clipping.x_max, first, last);
+  if (!is_visible)
+    return;
+
+  // Start at the first visible step, the error being the remainder of q(first).
+  const int64_t numerator = 2 * db * first + da;
+  const int64_t q = numerator / (2 * da);
+  int64_t error = numerator % (2 * da);
+  const int64_t x = x0 + step_x * (is_x_major ? first : q);
+  const int64_t y = y0 + step_y * (is_x_major ? q : first);
+
+  const ptrdiff_t major_step = is_x_major ? step_x : step_y * (ptrdiff_t)m_pitch;
+  const ptrdiff_t minor_step = is_x_major ? step_y * (ptrdiff_t)m_pitch : step_x;
+  const uint32_t buffer_color = to_buffer_color(color);
+  const bool is_opaque = color.get_alpha() == 0xff;
+  uint32_t* pixel = m_buffer + x + m_pitch * y;
+  for (int64_t i = first; i <= last; ++i) {
+    if (is_opaque)
+      *pixel = buffer_color;
+    else
+      blend_solid_span(pixel, 1, buffer_color, m_alpha_format);
+
+    pixel += major_step;
+    error += 2 * db;
+    if (error >= 2 * da) {
+      error -= 2 * da;
+      pixel += minor_step;
     }
+  }
+}
+
+uint32_t Painter::compute_out_code(int64_t x, int64_t y, const BBox& box) {
+  uint32_t code = OUT_CODE_INSIDE;
+  if (x < box.x_min)
+    code |= OUT_CODE_LEFT;
+  else if (x > box.x_max)
+    code |= OUT_CODE_RIGHT;
+  if (y < box.y_min)
+    code |= OUT_CODE_TOP;
+  else if (y > box.y_max)
+    code |= OUT_CODE_BOTTOM;
+  return code;
+}
 
-    for (auto x = x1; x <= x2; ++x) {
-      const auto y = dy * (x - x1) / dx + y1;
-      draw_pixel(x, y, color);
+bool Painter::clip_line(int32_t& x0, int32_t& y0, int32_t& x1, int32_t& y1, const BBox& box) {
+  // See https://en.wikipedia.org/wiki/Cohen%E2%80%93Sutherland_algorithm
+  // The products below fit in 64-bit as all the coordinates (and the box) are 32-bit.
+  int64_t ax = x0, ay = y0, bx = x1, by = y1;
+  uint32_t code_a = compute_out_code(ax, ay, box);
+  uint32_t code_b = compute_out_code(bx, by, box);
+
+  // Each iteration moves an endpoint on an edge of the box. Because of the rounding, an endpoint
+  // may need to be moved twice: lines still outside after a few iterations only graze a corner.
+  for (int iteration = 0; iteration < 8; ++iteration) {
+    if ((code_a | code_b) == OUT_CODE_INSIDE) {
+      x0 = ax;
+      y0 = ay;
+      x1 = bx;
+      y1 = by;
+      return true;
     }
-  } else {
-    if (y1 > y2) {
-      std::swap(x1, x2);
-      std::swap(y1, y2);
+
+    if ((code_a & code_b) != OUT_CODE_INSIDE)
+      return false;  // both endpoints on the same outer side
+
+    // Move an endpoint outside to the intersection with the edge it is beyond.
+    const uint32_t code = code_a != OUT_CODE_INSIDE ? code_a : code_b;
+    int64_t x, y;
+    if ((code & OUT_CODE_TOP) != 0) {
+      y = box.y_min;
+      x = ax + divide_rounded((bx - ax) * (y - ay), by - ay);
+    } else if ((code & OUT_CODE_BOTTOM) != 0) {
+      y = box.y_max;
+      x = ax + divide_rounded((bx - ax) * (y - ay), by - ay);
+    } else if ((code & OUT_CODE_LEFT) != 0) {
+      x = box.x_min;
+      y = ay + divide_rounded((by - ay) * (x - ax), bx - ax);
+    } else {
+      x = box.x_max;
+      y = ay + divide_rounded((by - ay) * (x - ax), bx - ax);
     }
 
-    for (auto y = y1; y <= y2; ++y) {
-      const auto x = dx * (y - y1) / dy + x1;
-      draw_pixel(x, y, color);
+    if (code == code_a) {
+      ax = x;
+      ay = y;
+      code_a = compute_out_code(ax, ay, box);
+    } else {
+      bx = x;
+      by = y;
+      code_b = compute_out_code(bx, by, box);
     }
   }
+
+  return false;
 }
 
 void Painter::draw_rect(int32_t x, int32_t y, int32_t w, int32_t h) {
@@ -108,21 +289,35 @@ void Painter::draw_rect(int32_t x, int32_t y, int32_t w, int32_t h) {
 }
 
 [[gnu::hot]] void Painter::draw_rect(int32_t x, int32_t y, int32_t w, int32_t h, Color color) {
-  draw_line(x, y, x + w - 1, y, color);                  // top edge
-  draw_line(x, y + h - 1, x + w - 1, y + h - 1, color);  // bottom edge
-  draw_line(x, y, x, y + h - 1, color);                  // left edge
-  draw_line(x + w - 1, y, x + w - 1, y + h - 1, color);  // right edge
+  if (w <= 0 || h <= 0)
+    return;
+
+  // Each edge is a span, corners are only drawn once (matters for translucent colors).
+  fill_rect(x, y, w, 1, color);  // top edge
+  if (h > 1)
+    fill_rect(x, y + h - 1, w, 1, color);  // bottom edge
+  if (h > 2) {
+    fill_rect(x, y + 1, 1, h - 2, color);  // left edge
+    if (w > 1)
+      fill_rect(x + w - 1, y + 1, 1, h - 2, color);  // right edge
+  }
 }
 
 [[gnu::hot]] void Painter::draw_rect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t line_width, Color color) {
-  while (line_width != 0) {
-    draw_rect(x, y, w, h, color);
-    x += 1;
-    y += 1;
-    w -= 2;
-    h -= 2;
-    line_width -= 1;
+  if (w <= 0 || h <= 0 || line_width == 0)
+    return;
+
+  // The border is inside the rectangle. If it covers the whole rectangle, fill it.
+  const int32_t width = libk::min<uint32_t>(line_width, INT32_MAX / 2);
+  if (2 * width >= w || 2 * width >= h) {
+    fill_rect(x, y, w, h, color);
+    return;
   }
+
+  fill_rect(x, y, w, width, color);                                  // top edge
+  fill_rect(x, y + h - width, w, width, color);                      // bottom edge
+  fill_rect(x, y + width, width, h - 2 * width, color);              // left edge
+  fill_rect(x + w - width, y + width, width, h - 2 * width, color);  // right edge
 }
 
 void Painter::fill_rect(int32_t x, int32_t y, int32_t w, int32_t h) {
@@ -130,16 +325,17 @@ void Painter::fill_rect(int32_t x, int32_t y, int32_t w, int32_t h) {
 }
 
 [[gnu::hot]] void Painter::fill_rect(int32_t x, int32_t y, int32_t w, int32_t h, Color color) {
-  // Early clipping
-  x = libk::max(m_clipping.x_min, x);
-  y = libk::max(m_clipping.y_min, y);
-  w = libk::min(m_clipping.x_max - m_clipping.x_min + 1, w);
-  h = libk::min(m_clipping.y_max - m_clipping.y_min + 1, h);
-
-  for (uint32_t i = x; i < (x + w); ++i) {
-    for (uint32_t j = y; j < (y + h); ++j) {
-      draw_pixel(i, j, color);
-    }
+  if (color.get_alpha() == 0)
+    return;
+
+  Span span;
+  if (!clip_rect(x, y, w, h, span))
+    return;
+
+  const uint32_t buffer_color = to_buffer_color(color);
+  uint32_t* row = m_buffer + span.x + m_pitch * span.y;
+  for (uint32_t j = 0; j < span.height; ++j, row += m_pitch) {
+    blend_solid_span(row, span.width, buffer_color, m_alpha_format);
   }
 }
 
@@ -156,83 +352,252 @@ uint32_t Painter::draw_text(int32_t x, int32_t y, int32_t w, const char* text) {
 }
 
 uint32_t Painter::draw_text(int32_t x, int32_t y, int32_t w, const char* text, Color color) {
-  auto current_x = x;
-  auto current_y = y;
-
-  const uint32_t char_width = m_font.get_char_width();
   const uint32_t char_height = m_font.get_char_height();
-  const uint32_t advance = m_font.get_horizontal_advance();
   const uint32_t line_height = m_font.get_line_height();
 
-  for (const char* it = text; *it != '\0'; ++it) {
-    const char ch = *it;
+  int32_t current_x = x;
+  int32_t current_y = y;
+  for (const char* it = text; it != nullptr; current_y += line_height) {
+    // Early clipping
+    if (current_y > m_clipping.y_max)
+      break;
+
+    const char* line = it;
+    const uint32_t length = TextLayout::break_line(m_font, line, w, it);
+    if (current_y + (int32_t)char_height > m_clipping.y_min)
+      current_x = draw_glyphs(x, current_y, line, length, color);
+    else
+      current_x = x + m_font.get_horizontal_advance(line, length);
+  }
 
-    if (ch >= PKFont::FIRST_CHARACTER && ch <= PKFont::LAST_CHARACTER) {
-      // Early clipping
-      if (current_x > m_clipping.x_max)
-        continue;
+  return current_x;
+}
 
-      // If the character does not fit in the line, then start a new line.
-      // We check (Y - x >= w) instead of (Y >= x + w) to avoid overflow, as w may be defined to UINT32_MAX.
-      if ((current_x + char_width) - x >= w) {
-        current_x = x;
-        current_y += line_height;
-      }
+uint32_t Painter::draw_text(int32_t x, int32_t y, const TextLayout& layout, Color color) {
+  KASSERT(layout.get_font().get_data() == m_font.get_data());
 
-      const uint8_t* glyph = m_font.get_glyph(ch);
-      draw_alpha_map(current_x, current_y, glyph, char_width, char_height, color);
-      current_x += advance;
-    } else {
-      switch (ch) {
-        case ' ':
-          current_x += advance;
-          break;
-        case '\n':
-          current_x = x;
-          current_y += line_height;
-          break;
-        default:
-          // Ignore the unknown character.
-          // We aim that this text rendered is straightforward.
-          // So, we don't handle tabulations, backspaces, or any advanced controls.
-          break;
-      }
-    }
+  const int32_t char_height = m_font.get_char_height();
+  const int32_t line_height = m_font.get_line_height();
+  const size_t line_count = layout.get_line_count();
+  if (line_count == 0)
+    return x;
+
+  // Skip directly the lines above the clipping region.
+  size_t first_line = 0;
+  if (y + char_height <= m_clipping.y_min)
+    first_line = libk::min<size_t>(line_count - 1, (m_clipping.y_min - y - char_height) / line_height + 1);
 
+  int32_t current_x = x;
+  int32_t current_y = y + first_line * line_height;
+  for (size_t i = first_line; i < line_count; ++i, current_y += line_height) {
     // Early clipping
     if (current_y > m_clipping.y_max)
-      return current_x;
+      break;
+
+    const auto& line = layout.get_line(i);
+    current_x = draw_glyphs(x, current_y, layout.get_text() + line.offset, line.length, color);
   }
 
   return current_x;
 }
 
-[[gnu::hot]] void Painter::draw_alpha_map(int32_t x,
-                                          int32_t y,
-                                          const uint8_t* alpha_map,
-                                          uint32_t w,
-                                          uint32_t h,
-                                          Color color) {
+int32_t Painter::draw_glyphs(int32_t x, int32_t y, const char* text, uint32_t length, Color color) {
+  const int32_t advance = m_font.get_horizontal_advance();
+
+  const char* end = text + length;
+  for (const char* it = text; it < end; x += advance) {
+    // Early clipping
+    if (x > m_clipping.x_max)
+      return x + m_font.get_horizontal_advance(it, end - it);
+
+    // Spaces and unknown characters (we don't handle tabulations, backspaces, or any
+    // advanced controls) have no glyph and are simply skipped.
+    const uint32_t index = m_font.get_glyph_index(PKFont::decode_utf8(it));
+    if (index != PKFont::NO_GLYPH)
+      draw_glyph(x, y, index, color);
+  }
+
+  return x;
+}
+
+[[gnu::hot]] void Painter::draw_glyph(int32_t x, int32_t y, uint32_t index, Color color) {
   // This function is a performance bottleneck.
   // It is called to draw each glyph.
   // Therefore, it must be heavily optimized if possible.
-  for (uint32_t i = 0; i < w; ++i) {
-    for (uint32_t j = 0; j < h; ++j) {
+  auto* cache = GlyphCache::get(m_font);
+  const uint32_t* pixels = cache != nullptr ? cache->get_tinted_glyph(index, color.argb) : nullptr;
+  if (pixels == nullptr) {
+    // Without cache, only the glyphs of uncompressed fonts can be drawn.
+    const uint8_t* glyph = m_font.get_glyph((char)(PKFont::FIRST_CHARACTER + index));
+    if (glyph != nullptr)
+      draw_alpha_map(x, y, glyph, m_font.get_char_width(), m_font.get_char_height(), color);
+    return;
+  }
+
+  // Only the bounding box of the glyph texels is checked against the clipping.
+  const uint32_t char_width = m_font.get_char_width();
+  const GlyphBox* box = cache->get_box(index);  // the glyph block is decoded, as it was tinted
+  if (x + box->x > m_clipping.x_max || y + box->y > m_clipping.y_max || x + box->x + box->width <= m_clipping.x_min ||
+      y + box->y + box->height <= m_clipping.y_min)
+    return;
+
+  // Blend the runs of non-transparent texels directly from the tinted glyph. Straight alpha
+  // source-over blending gives premultiplied results on premultiplied buffers too.
+  const GlyphRun* runs;
+  const size_t nb_runs = cache->get_runs(index, runs);
+  for (size_t i = 0; i < nb_runs; ++i) {
+    const GlyphRun& run = runs[i];
+    const int32_t py = y + run.y;
+    if (py < m_clipping.y_min || py > m_clipping.y_max)
+      continue;
+
+    const int32_t x1 = libk::max<int32_t>(x + run.x, m_clipping.x_min);
+    const int32_t x2 = libk::min<int32_t>(x + run.x + run.length, m_clipping.x_max + 1);
+    if (x1 >= x2)
+      continue;
+
+    blend_span(m_buffer + x1 + m_pitch * py, pixels + (x1 - x) + char_width * run.y, x2 - x1,
+               BlendMode::SourceOver);
+  }
+}
+
+void Painter::draw_alpha_map(int32_t x,
+                             int32_t y,
+                             const uint8_t* alpha_map,
+                             uint32_t w,
+                             uint32_t h,
+                             Color color) {
+  for (uint32_t j = 0; j < h; ++j) {
+    for (uint32_t i = 0; i < w; ++i) {
       const uint8_t alpha = alpha_map[i + j * w];
-      draw_pixel(x + i, y + j, color.with_alpha(alpha));
+      if (alpha != 0)
+        draw_pixel(x + i, y + j, color.with_alpha(alpha));
     }
   }
 }
 
-void Painter::blit(uint32_t x, uint32_t y, uint32_t width, uint32_t height, const uint32_t* pixels_buffer) {
-  // TODO: Clipping
-  for (uint32_t i = 0; i < width; ++i) {
-    for (uint32_t j = 0; j < height; ++j) {
-      m_buffer[(x + i) + m_pitch * (y + j)] = pixels_buffer[i + width * j];
+void Painter::blit(int32_t x,
+                   int32_t y,
+                   uint32_t width,
+                   uint32_t height,
+                   const uint32_t* pixels_buffer,
+                   BlendMode mode) {
+  Span span;
+  if (!clip_rect(x, y, width, height, span))
+    return;
+
+  const uint32_t* src_origin = pixels_buffer + (span.x - x) + (size_t)width * (span.y - y);
+  for (uint32_t j = 0; j < span.height; ++j) {
+    blit_span(m_buffer + span.x + m_pitch * (span.y + j), src_origin + (size_t)width * j, span.width, mode);
+  }
+}
+
+/** @brief Interpolates the four channels of @a a and @a b, @a weight being the weight of @a b (in [0, 256]). */
+[[gnu::always_inline]] static inline uint32_t lerp_pixel(uint32_t a, uint32_t b, uint32_t weight) {
+  // Two channels at once (SWAR), each product fits in its 16-bit lane.
+  const uint32_t rb = (((a & 0x00ff00ff) * (256 - weight) + (b & 0x00ff00ff) * weight) >> 8) & 0x00ff00ff;
+  const uint32_t ag = ((((a >> 8) & 0x00ff00ff) * (256 - weight) + ((b >> 8) & 0x00ff00ff) * weight)) & 0xff00ff00;
+  return ag | rb;
+}
+
+[[gnu::hot]] void Painter::blit_scaled(int32_t x,
+                                       int32_t y,
+                                       uint32_t width,
+                                       uint32_t height,
+                                       const uint32_t* pixels_buffer,
+                                       uint32_t src_width,
+                                       uint32_t src_height,
+                                       ScaleFilter filter,
+                                       BlendMode mode) {
+  if (src_width == 0 || src_height == 0)
+    return;
+
+  if (width == src_width && height == src_height) {
+    blit(x, y, width, height, pixels_buffer, mode);
+    return;
+  }
+
+  Span span;
+  if (!clip_rect(x, y, width, height, span))
+    return;
+
+  // Source coordinates are in 16.16 fixed point. Destination pixel i samples the source at
+  // (i + 0.5) * step (its center), minus 0.5 for the bilinear filter to get the top-left of the
+  // four interpolated pixels.
+  const int64_t step_x = ((int64_t)src_width << 16) / width;
+  const int64_t step_y = ((int64_t)src_height << 16) / height;
+  const int64_t offset = filter == ScaleFilter::Bilinear ? 0x8000 : 0;
+  const int64_t max_u = (int64_t)(src_width - 1) << 16;
+  const int64_t max_v = (int64_t)(src_height - 1) << 16;
+
+  // The rows are scaled into a small buffer, chunk by chunk, then blended like a blit.
+  constexpr size_t CHUNK_SIZE = 256;
+  uint32_t scaled[CHUNK_SIZE];
+
+  for (uint32_t j = 0; j < span.height; ++j) {
+    const int64_t row = (int64_t)span.y - y + j;  // in the unclipped destination
+    const int64_t v = libk::clamp<int64_t>(row * step_y + step_y / 2 - offset, 0, max_v);
+    const uint32_t* src_row0 = pixels_buffer + (size_t)src_width * (v >> 16);
+    const uint32_t* src_row1 = src_row0 + ((v >> 16) + 1 < src_height ? src_width : 0);
+    const uint32_t weight_y = (v >> 8) & 0xff;
+
+    uint32_t* dst = m_buffer + span.x + m_pitch * (span.y + j);
+    for (uint32_t chunk = 0; chunk < span.width; chunk += CHUNK_SIZE) {
+      const size_t n = libk::min<size_t>(CHUNK_SIZE, span.width - chunk);
+      const int64_t column = (int64_t)span.x - x + chunk;
+      int64_t u = column * step_x + step_x / 2 - offset;
+      if (filter == ScaleFilter::Nearest) {
+        for (size_t i = 0; i < n; ++i, u += step_x) {
+          scaled[i] = src_row0[libk::min(u, max_u) >> 16];
+        }
+      } else {
+        for (size_t i = 0; i < n; ++i, u += step_x) {
+          const int64_t clamped_u = libk::clamp<int64_t>(u, 0, max_u);
+          const size_t u0 = clamped_u >> 16;
+          const size_t u1 = u0 + 1 < src_width ? u0 + 1 : u0;
+          const uint32_t weight_x = (clamped_u >> 8) & 0xff;
+          const uint32_t top = lerp_pixel(src_row0[u0], src_row0[u1], weight_x);
+          const uint32_t bottom = lerp_pixel(src_row1[u0], src_row1[u1], weight_x);
+          scaled[i] = lerp_pixel(top, bottom, weight_y);
+        }
+      }
+
+      blit_span(dst + chunk, scaled, n, mode);
     }
   }
 }
 
+void Painter::blit_span(uint32_t* dst, const uint32_t* src, size_t n, BlendMode mode) const {
+  if (mode == BlendMode::Copy && m_alpha_format == AlphaFormat::Premultiplied) {
+    for (size_t i = 0; i < n; ++i)
+      dst[i] = premultiply(src[i]);
+    return;
+  }
+
+  // Source-over and additive blending of straight alpha pixels already give premultiplied
+  // results on premultiplied buffers.
+  blend_span(dst, src, n, mode, AlphaFormat::Straight);
+}
+
+bool Painter::clip_rect(int32_t x, int32_t y, int32_t w, int32_t h, Span& span) const {
+  if (w <= 0 || h <= 0)
+    return false;
+
+  // Computed in 64-bit to avoid overflows with huge rectangles.
+  const int64_t x1 = libk::max<int64_t>(x, m_clipping.x_min);
+  const int64_t y1 = libk::max<int64_t>(y, m_clipping.y_min);
+  const int64_t x2 = libk::min<int64_t>((int64_t)x + w, (int64_t)m_clipping.x_max + 1);
+  const int64_t y2 = libk::min<int64_t>((int64_t)y + h, (int64_t)m_clipping.y_max + 1);
+  if (x1 >= x2 || y1 >= y2)
+    return false;
+
+  span.x = x1;
+  span.y = y1;
+  span.width = x2 - x1;
+  span.height = y2 - y1;
+  return true;
+}
+
 void Painter::revert_clipping() {
   m_clipping.x_min = 0;
   m_clipping.y_min = 0;
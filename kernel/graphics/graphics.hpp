@@ -3,8 +3,18 @@
 #include <cstdint>
 
 #include "graphics/pkfont.hpp"
+#include "graphics/span.hpp"
+#include "graphics/text_layout.hpp"
 
 namespace graphics {
+/** @brief How images are sampled when scaled, see Painter::blit_scaled(). */
+enum class ScaleFilter : uint8_t {
+  /** The nearest source pixel (sharp, but blocky when upscaled and aliased when downscaled). */
+  Nearest,
+  /** Interpolation between the four nearest source pixels (smooth). */
+  Bilinear,
+};  // enum class ScaleFilter
+
 /** @brief Represents a ARGB color that can be used in the Kernel graphics API. */
 struct Color {
   uint32_t argb;
@@ -52,6 +62,11 @@ struct Color {
   return {((uint32_t)a << 24) | (r << 16) | (g << 8) | b};
 }
 
+/** @brief Gets the font used by the painters when created (the builtin Fira Code 16 by default). */
+[[nodiscard]] PKFont get_default_font();
+/** @brief Sets the font used by the painters created from now on (such as a PKF v2 font loaded from the ramdisk). */
+void set_default_font(PKFont font);
+
 /**
  * @brief Painter provides an interface for drawing in a framebuffer.
  *
@@ -72,11 +87,20 @@ struct Color {
  * - draw_pixel() supports alpha blending. In other words, if the color is not totally opaque, then it will be blended
  *   with the background color. Similarly, if a color is completely transparent, it will not be written.
  *
+ * ## Alpha format
+ *
+ * Colors given to the drawing functions always use straight alpha. However, the framebuffer may store premultiplied
+ * colors (see set_alpha_format()), in which case colors are premultiplied before being blended and written.
+ * All the blending is done by blend_span() and blend_solid_span().
+ *
+ * The painter only draws into ARGB8888 buffers (such as the windows surfaces). The screen may use
+ * another pixel format, the conversion is done when compositing (see get_convert_span()).
+ *
  * @see Color
  */
 class Painter {
  public:
-  /** @brief Creates a painter that draws into the global framebuffer. See FrameBuffer class. */
+  /** @brief Creates a painter that draws into the global framebuffer (that must use the ARGB8888 format). */
   Painter();
   /** @brief Creates a painter that draws into the provided framebuffer. */
   Painter(uint32_t* buffer, uint32_t width, uint32_t height, uint32_t pitch);
@@ -92,6 +116,11 @@ class Painter {
   /** @brief Sets the font to draw text to @a font. */
   void set_font(PKFont font) { m_font = font; }
 
+  /** @brief Gets the alpha format of the framebuffer pixels. */
+  [[nodiscard]] AlphaFormat get_alpha_format() const { return m_alpha_format; }
+  /** @brief Sets the alpha format of the framebuffer pixels (straight by default). */
+  void set_alpha_format(AlphaFormat format) { m_alpha_format = format; }
+
   /** @brief Clears the framebuffer with the given @a clear_color. */
   void clear(Color clear_color = make_color(0, 0, 0));
 
@@ -115,9 +144,29 @@ class Painter {
   uint32_t draw_text(int32_t x, int32_t y, const char* text, Color color);
   uint32_t draw_text(int32_t x, int32_t y, int32_t w, const char* text);
   uint32_t draw_text(int32_t x, int32_t y, int32_t w, const char* text, Color color);
-
-  // Image blit.
-  void blit(uint32_t x, uint32_t y, uint32_t width, uint32_t height, const uint32_t* pixels_buffer);
+  /** @brief Draws a text whose line breaks were already computed (the @a layout must use the painter font). */
+  uint32_t draw_text(int32_t x, int32_t y, const TextLayout& layout, Color color);
+
+  // Image blit (pixels are in 0xAARRGGBB format with straight alpha, with a pitch of @a width).
+  void blit(int32_t x,
+            int32_t y,
+            uint32_t width,
+            uint32_t height,
+            const uint32_t* pixels_buffer,
+            BlendMode mode = BlendMode::Copy);
+  /** @brief Blits the image @a pixels_buffer of size @a src_width x @a src_height scaled to @a width x @a height.
+   *
+   * The image is stored row by row (with a pitch of @a src_width pixels). The bilinear filter interpolates
+   * straight alpha colors, which is exact only for opaque images. */
+  void blit_scaled(int32_t x,
+                   int32_t y,
+                   uint32_t width,
+                   uint32_t height,
+                   const uint32_t* pixels_buffer,
+                   uint32_t src_width,
+                   uint32_t src_height,
+                   ScaleFilter filter,
+                   BlendMode mode = BlendMode::Copy);
 
   // Clipping functions:
   void revert_clipping();
@@ -126,9 +175,32 @@ class Painter {
  private:
   /** @brief Implements the Painter constructor. */
   void create(uint32_t* buffer, uint32_t width, uint32_t height, uint32_t pitch);
-  /** @brief Used internally by draw_text() to draw a glyph alpha map. */
+  /** @brief Used internally by draw_text() to draw the @a length characters of a line. Returns the end X. */
+  int32_t draw_glyphs(int32_t x, int32_t y, const char* text, uint32_t length, Color color);
+  /** @brief Used internally by draw_text() to draw the glyph @a index of the font, using the GlyphCache. */
+  void draw_glyph(int32_t x, int32_t y, uint32_t index, Color color);
+  /** @brief Used internally by draw_glyph() to draw a glyph alpha map if the glyph cache is not available. */
   void draw_alpha_map(int32_t x, int32_t y, const uint8_t* alpha_map, uint32_t w, uint32_t h, Color color);
 
+  /** @brief Used internally by blit() to draw @a n straight alpha pixels of @a src at @a dst. */
+  void blit_span(uint32_t* dst, const uint32_t* src, size_t n, BlendMode mode) const;
+
+  /** @brief Converts @a color to the alpha format of the framebuffer. */
+  [[nodiscard]] uint32_t to_buffer_color(Color color) const {
+    return m_alpha_format == AlphaFormat::Premultiplied ? premultiply(color.argb) : color.argb;
+  }
+
+  /** @brief A rectangle already clipped, ready to be drawn row by row. */
+  struct Span {
+    uint32_t x;
+    uint32_t y;
+    uint32_t width;
+    uint32_t height;
+  };  // struct Span
+
+  /** @brief Clips the given rectangle to the clipping region. Returns false if nothing is left to draw. */
+  [[nodiscard]] bool clip_rect(int32_t x, int32_t y, int32_t w, int32_t h, Span& span) const;
+
   struct BBox {
     int32_t x_min;
     int32_t y_min;
@@ -136,12 +208,25 @@ class Painter {
     int32_t y_max;
   };  // struct BBox
 
+  // Cohen-Sutherland out codes: where a point is relative to a box.
+  static constexpr uint32_t OUT_CODE_INSIDE = 0;
+  static constexpr uint32_t OUT_CODE_LEFT = 1 << 0;
+  static constexpr uint32_t OUT_CODE_RIGHT = 1 << 1;
+  static constexpr uint32_t OUT_CODE_TOP = 1 << 2;
+  static constexpr uint32_t OUT_CODE_BOTTOM = 1 << 3;
+
+  [[nodiscard]] static uint32_t compute_out_code(int64_t x, int64_t y, const BBox& box);
+  /** @brief Clips the line from (@a x0, @a y0) to (@a x1, @a y1) to @a box (Cohen-Sutherland), the new
+   * endpoints being rounded to the nearest pixel. Returns false if nothing is left to draw. */
+  [[nodiscard]] static bool clip_line(int32_t& x0, int32_t& y0, int32_t& x1, int32_t& y1, const BBox& box);
+
   PKFont m_font;
   uint32_t* m_buffer;  // framebuffer, in 0xAARRGGBB format
   uint32_t m_width;    // width of the framebuffer, in pixels
   uint32_t m_height;   // height of the framebuffer, in pixels
   uint32_t m_pitch;    // pitch of the framebuffer
   BBox m_clipping;
+  AlphaFormat m_alpha_format = AlphaFormat::Straight;
   Color m_pen = make_color(0xff, 0xff, 0xff);
 };  // class Painter
 }  // namespace graphics
@@ -0,0 +1,199 @@
+#include "graphics/pixel_format.hpp"
+
+#include <libk/utils.hpp>
+
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif  // __ARM_NEON
+
+namespace graphics {
+// Thresholds of the 4x4 ordered dithering, in sixteenths of the quantization step.
+static constexpr uint8_t BAYER_MATRIX[4][4] = {{0, 8, 2, 10}, {12, 4, 14, 6}, {3, 11, 1, 9}, {15, 7, 13, 5}};
+
+/** Converts @a argb to RGB565, adding @a threshold (in [0, 16[, see BAYER_MATRIX) before the truncation. */
+[[gnu::always_inline]] static inline uint16_t to_rgb565_dithered(uint32_t argb, uint32_t threshold) {
+  // Red and blue lose 3 bits (a step of 8), green loses 2 bits (a step of 4).
+  const uint32_t r = libk::min<uint32_t>(((argb >> 16) & 0xff) + (threshold >> 1), 0xff);
+  const uint32_t g = libk::min<uint32_t>(((argb >> 8) & 0xff) + (threshold >> 2), 0xff);
+  const uint32_t b = libk::min<uint32_t>((argb & 0xff) + (threshold >> 1), 0xff);
+  return ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3);
+}
+
+/** Combines @a argb with @a dst, see blend_span(). */
+template <BlendMode Mode, AlphaFormat Alpha>
+[[gnu::always_inline]] static inline uint32_t combine_pixel(uint32_t dst, uint32_t argb) {
+  if constexpr (Mode == BlendMode::Copy) {
+    (void)dst;
+    return argb;
+  } else if constexpr (Mode == BlendMode::SourceOver) {
+    return Alpha == AlphaFormat::Straight ? blend_pixel(dst, argb) : blend_pixel_premultiplied(dst, argb);
+  } else {
+    return saturated_add(dst, Alpha == AlphaFormat::Straight ? premultiply(argb) : argb);
+  }
+}
+
+[[gnu::hot]] static void copy_span_16(uint16_t* dst, const uint16_t* src, size_t n) {
+  if (dst == src)
+    return;
+
+#ifdef __ARM_NEON
+  // 64 bytes (32 pixels) per iteration.
+  for (; n >= 32; n -= 32, dst += 32, src += 32) {
+    vst1q_u16_x4(dst, vld1q_u16_x4(src));
+  }
+
+  for (; n >= 8; n -= 8, dst += 8, src += 8) {
+    vst1q_u16(dst, vld1q_u16(src));
+  }
+#endif  // __ARM_NEON
+
+  for (; n > 0; --n) {
+    *dst++ = *src++;
+  }
+}
+
+template <bool Dither>
+[[gnu::hot]] static void to_rgb565_span(uint16_t* dst, const uint32_t* src, size_t n, uint32_t x, uint32_t y) {
+  const uint8_t* thresholds = BAYER_MATRIX[y % 4];
+
+#ifdef __ARM_NEON
+  // 8 pixels per iteration: the channels are deinterleaved, then packed with shift right and
+  // insert instructions. As 8 is a multiple of 4, the dithering thresholds do not change.
+  uint8_t rb_thresholds[8], g_thresholds[8];
+  for (uint32_t i = 0; i < 8; ++i) {
+    rb_thresholds[i] = thresholds[(x + i) % 4] >> 1;
+    g_thresholds[i] = thresholds[(x + i) % 4] >> 2;
+  }
+
+  const uint8x8_t rb_threshold = vld1_u8(rb_thresholds);
+  const uint8x8_t g_threshold = vld1_u8(g_thresholds);
+  for (; n >= 8; n -= 8, dst += 8, src += 8, x += 8) {
+    uint8x8x4_t pixels = vld4_u8((const uint8_t*)src);  // blue, green, red and alpha channels
+    if constexpr (Dither) {
+      pixels.val[0] = vqadd_u8(pixels.val[0], rb_threshold);
+      pixels.val[1] = vqadd_u8(pixels.val[1], g_threshold);
+      pixels.val[2] = vqadd_u8(pixels.val[2], rb_threshold);
+    }
+
+    uint16x8_t result = vshll_n_u8(pixels.val[2], 8);
+    result = vsriq_n_u16(result, vshll_n_u8(pixels.val[1], 8), 5);
+    result = vsriq_n_u16(result, vshll_n_u8(pixels.val[0], 8), 11);
+    vst1q_u16(dst, result);
+  }
+#endif  // __ARM_NEON
+
+  for (size_t i = 0; i < n; ++i) {
+    if constexpr (Dither)
+      dst[i] = to_rgb565_dithered(src[i], thresholds[(x + i) % 4]);
+    else
+      dst[i] = PixelTraits<PixelFormat::RGB565>::from_argb(src[i]);
+  }
+}
+
+template <PixelFormat DstFormat, PixelFormat SrcFormat, BlendMode Mode, AlphaFormat Alpha, bool Dither>
+[[gnu::hot]] static void convert_span(void* dst_buffer, const void* src_buffer, size_t n, uint32_t x, uint32_t y) {
+  using DstTraits = PixelTraits<DstFormat>;
+  using SrcTraits = PixelTraits<SrcFormat>;
+  auto* dst = (typename DstTraits::Pixel*)dst_buffer;
+  const auto* src = (const typename SrcTraits::Pixel*)src_buffer;
+
+  // Sources without alpha are opaque, and only the conversions to RGB565 lose precision.
+  constexpr BlendMode mode = (Mode == BlendMode::SourceOver && !SrcTraits::HAS_ALPHA) ? BlendMode::Copy : Mode;
+  constexpr bool dither = Dither && DstFormat == PixelFormat::RGB565 && SrcFormat != PixelFormat::RGB565;
+
+  if constexpr (DstFormat == PixelFormat::ARGB8888 && SrcFormat == PixelFormat::ARGB8888) {
+    (void)x, (void)y;
+    blend_span(dst, src, n, mode, Alpha);
+  } else if constexpr (DstFormat == SrcFormat && mode == BlendMode::Copy) {
+    (void)x, (void)y;
+    copy_span_16(dst, src, n);
+  } else if constexpr (DstFormat == PixelFormat::RGB565 && mode == BlendMode::Copy) {
+    to_rgb565_span<dither>(dst, src, n, x, y);
+  } else {
+    const uint8_t* thresholds = BAYER_MATRIX[y % 4];
+    for (size_t i = 0; i < n; ++i) {
+      const uint32_t argb = combine_pixel<mode, Alpha>(DstTraits::to_argb(dst[i]), SrcTraits::to_argb(src[i]));
+      if constexpr (dither)
+        dst[i] = to_rgb565_dithered(argb, thresholds[(x + i) % 4]);
+      else
+        dst[i] = DstTraits::from_argb(argb);
+    }
+  }
+}
+
+template <PixelFormat DstFormat, bool Dither>
+[[gnu::hot]] static void blend_solid_span_to(void* dst_buffer, size_t n, uint32_t argb, uint32_t x, uint32_t y) {
+  using DstTraits = PixelTraits<DstFormat>;
+  auto* dst = (typename DstTraits::Pixel*)dst_buffer;
+
+  if constexpr (DstFormat == PixelFormat::ARGB8888) {
+    (void)x, (void)y;
+    blend_solid_span(dst, n, argb);
+  } else {
+    const uint32_t alpha = argb >> 24;
+    if (alpha == 0)
+      return;
+
+    const uint8_t* thresholds = BAYER_MATRIX[y % 4];
+    for (size_t i = 0; i < n; ++i) {
+      const uint32_t color = alpha == 0xff ? argb : blend_pixel(DstTraits::to_argb(dst[i]), argb);
+      if constexpr (Dither)
+        dst[i] = to_rgb565_dithered(color, thresholds[(x + i) % 4]);
+      else
+        dst[i] = DstTraits::from_argb(color);
+    }
+  }
+}
+
+// Selection of the converter instantiation, one template parameter at a time.
+template <PixelFormat DstFormat, PixelFormat SrcFormat, BlendMode Mode, AlphaFormat Alpha>
+static ConvertSpanFn select_dither(bool dither) {
+  if (dither)
+    return &convert_span<DstFormat, SrcFormat, Mode, Alpha, true>;
+  return &convert_span<DstFormat, SrcFormat, Mode, Alpha, false>;
+}
+
+template <PixelFormat DstFormat, PixelFormat SrcFormat, BlendMode Mode>
+static ConvertSpanFn select_alpha_format(AlphaFormat alpha_format, bool dither) {
+  if (alpha_format == AlphaFormat::Premultiplied)
+    return select_dither<DstFormat, SrcFormat, Mode, AlphaFormat::Premultiplied>(dither);
+  return select_dither<DstFormat, SrcFormat, Mode, AlphaFormat::Straight>(dither);
+}
+
+template <PixelFormat DstFormat, PixelFormat SrcFormat>
+static ConvertSpanFn select_blend_mode(BlendMode mode, AlphaFormat alpha_format, bool dither) {
+  switch (mode) {
+    case BlendMode::Copy:
+      return select_alpha_format<DstFormat, SrcFormat, BlendMode::Copy>(alpha_format, dither);
+    case BlendMode::SourceOver:
+      return select_alpha_format<DstFormat, SrcFormat, BlendMode::SourceOver>(alpha_format, dither);
+    case BlendMode::Add:
+      return select_alpha_format<DstFormat, SrcFormat, BlendMode::Add>(alpha_format, dither);
+  }
+
+  return nullptr;
+}
+
+template <PixelFormat DstFormat>
+static ConvertSpanFn select_src_format(PixelFormat src_format, BlendMode mode, AlphaFormat alpha_format, bool dither) {
+  if (src_format == PixelFormat::RGB565)
+    return select_blend_mode<DstFormat, PixelFormat::RGB565>(mode, alpha_format, dither);
+  return select_blend_mode<DstFormat, PixelFormat::ARGB8888>(mode, alpha_format, dither);
+}
+
+ConvertSpanFn get_convert_span(PixelFormat dst_format,
+                               PixelFormat src_format,
+                               BlendMode mode,
+                               AlphaFormat alpha_format,
+                               bool dither) {
+  if (dst_format == PixelFormat::RGB565)
+    return select_src_format<PixelFormat::RGB565>(src_format, mode, alpha_format, dither);
+  return select_src_format<PixelFormat::ARGB8888>(src_format, mode, alpha_format, dither);
+}
+
+BlendSolidSpanFn get_blend_solid_span(PixelFormat dst_format, bool dither) {
+  if (dst_format == PixelFormat::RGB565)
+    return dither ? &blend_solid_span_to<PixelFormat::RGB565, true> : &blend_solid_span_to<PixelFormat::RGB565, false>;
+  return &blend_solid_span_to<PixelFormat::ARGB8888, false>;
+}
+}  // namespace graphics
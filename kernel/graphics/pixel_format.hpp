@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "graphics/span.hpp"
+
+namespace graphics {
+/** @brief How the pixels of a buffer are stored in memory. */
+enum class PixelFormat : uint8_t {
+  /** 32 bits per pixel, 0xAARRGGBB. The format of the windows and of everything drawn by the Painter. */
+  ARGB8888,
+  /** 16 bits per pixel, 5 bits of red, 6 bits of green and 5 bits of blue (from the most significant bit), no alpha. */
+  RGB565,
+};  // enum class PixelFormat
+
+/** @brief Gets the size of a pixel of @a format, in bytes. */
+[[nodiscard]] constexpr uint32_t get_bytes_per_pixel(PixelFormat format) {
+  return format == PixelFormat::RGB565 ? 2 : 4;
+}
+
+/** @brief The type of the pixels of a format, and their conversion from and to 0xAARRGGBB colors. */
+template <PixelFormat Format>
+struct PixelTraits;
+
+template <>
+struct PixelTraits<PixelFormat::ARGB8888> {
+  using Pixel = uint32_t;
+  static constexpr bool HAS_ALPHA = true;
+
+  [[gnu::always_inline, nodiscard]] static constexpr Pixel from_argb(uint32_t argb) { return argb; }
+  [[gnu::always_inline, nodiscard]] static constexpr uint32_t to_argb(Pixel pixel) { return pixel; }
+};  // struct PixelTraits<PixelFormat::ARGB8888>
+
+template <>
+struct PixelTraits<PixelFormat::RGB565> {
+  using Pixel = uint16_t;
+  static constexpr bool HAS_ALPHA = false;
+
+  /** Truncates the channels and drops the alpha. */
+  [[gnu::always_inline, nodiscard]] static constexpr Pixel from_argb(uint32_t argb) {
+    return ((argb >> 8) & 0xf800) | ((argb >> 5) & 0x07e0) | ((argb >> 3) & 0x001f);
+  }
+
+  /** Expands the channels by replicating their high bits (so white stays white), the alpha is 255. */
+  [[gnu::always_inline, nodiscard]] static constexpr uint32_t to_argb(Pixel pixel) {
+    const uint32_t r = (pixel >> 11) & 0x1f;
+    const uint32_t g = (pixel >> 5) & 0x3f;
+    const uint32_t b = pixel & 0x1f;
+    return 0xff000000 | (((r << 3) | (r >> 2)) << 16) | (((g << 2) | (g >> 4)) << 8) | ((b << 3) | (b >> 2));
+  }
+};  // struct PixelTraits<PixelFormat::RGB565>
+
+/** @brief Combines the @a n pixels of @a src with the ones of @a dst, converting them to the
+ * format of @a dst. (@a x, @a y) is the position of the first pixel of @a dst on the screen,
+ * used to select the thresholds of the ordered dithering. See get_convert_span(). */
+using ConvertSpanFn = void (*)(void* dst, const void* src, size_t n, uint32_t x, uint32_t y);
+/** @brief Like ConvertSpanFn with @a n copies of the straight alpha color @a argb as source, using the SourceOver mode. */
+using BlendSolidSpanFn = void (*)(void* dst, size_t n, uint32_t argb, uint32_t x, uint32_t y);
+
+/** @brief Gets the span converter from @a src_format to @a dst_format with the given blend @a mode.
+ *
+ * The converters are instantiated at compile time for each combination of formats, blend mode,
+ * alpha format and dithering, so the conversion does not test the formats for each pixel.
+ * ARGB8888 to ARGB8888 conversions are blend_span(). @a alpha_format is ignored for sources
+ * without alpha (that are opaque). With @a dither, the colors converted to RGB565 are dithered
+ * with a 4x4 ordered (Bayer) matrix to hide the color banding. */
+[[nodiscard]] ConvertSpanFn get_convert_span(PixelFormat dst_format,
+                                             PixelFormat src_format,
+                                             BlendMode mode,
+                                             AlphaFormat alpha_format = AlphaFormat::Straight,
+                                             bool dither = false);
+/** @brief Gets the solid span blender for @a dst_format, see get_convert_span(). */
+[[nodiscard]] BlendSolidSpanFn get_blend_solid_span(PixelFormat dst_format, bool dither = false);
+}  // namespace graphics
@@ -2,23 +2,170 @@
 
 #include <libk/string.hpp>
 
-uint32_t PKFont::get_horizontal_advance(const char* text, uint32_t length) const {
+/** @brief Counts the UTF-8 characters of @a text (of @a length bytes, or NUL-terminated if UINT32_MAX). */
+static uint32_t count_characters(const char* text, uint32_t length) {
   if (length == UINT32_MAX) {
     length = libk::strlen(text);
   }
 
-  return get_horizontal_advance() * length;
+  uint32_t count = 0;
+  for (const char* it = text; it < text + length; ++count) {
+    (void)PKFont::decode_utf8(it);
+  }
+
+  return count;
+}
+
+uint32_t PKFont::get_horizontal_advance(const char* text, uint32_t length) const {
+  return get_horizontal_advance() * count_characters(text, length);
 }
 
 uint32_t PKFont::get_width(const char* text, uint32_t length) const {
-  if (length == UINT32_MAX) {
-    length = libk::strlen(text);
+  return get_char_width() * count_characters(text, length);
+}
+
+uint32_t PKFont::decode_utf8_sequence(const char*& it) {
+  const auto* bytes = (const uint8_t*)it;
+  const uint8_t lead = bytes[0];
+
+  // The number of continuation bytes, and the smallest code point allowed (longer sequences are invalid).
+  uint32_t length, min_code_point;
+  uint32_t code_point;
+  if (lead >= 0xc2 && lead <= 0xdf) {
+    length = 1;
+    min_code_point = 0x80;
+    code_point = lead & 0x1f;
+  } else if (lead >= 0xe0 && lead <= 0xef) {
+    length = 2;
+    min_code_point = 0x800;
+    code_point = lead & 0x0f;
+  } else if (lead >= 0xf0 && lead <= 0xf4) {
+    length = 3;
+    min_code_point = 0x10000;
+    code_point = lead & 0x07;
+  } else {
+    ++it;
+    return lead;
+  }
+
+  // A NUL terminator is not a continuation byte, so this never reads past the end of the text.
+  for (uint32_t i = 1; i <= length; ++i) {
+    if ((bytes[i] & 0xc0) != 0x80) {
+      ++it;
+      return lead;
+    }
+
+    code_point = (code_point << 6) | (bytes[i] & 0x3f);
   }
 
-  return get_char_width() * length;
+  if (code_point < min_code_point || code_point > 0x10ffff || (code_point >= 0xd800 && code_point <= 0xdfff)) {
+    ++it;
+    return lead;
+  }
+
+  it += length + 1;
+  return code_point;
+}
+
+/** @brief Checks that the @a count entries of @a entry_size bytes at @a offset are inside a file of @a size bytes. */
+static bool check_array(size_t size, uint32_t offset, uint32_t count, size_t entry_size) {
+  return offset <= size && (uint64_t)count * entry_size <= size - offset;
+}
+
+bool PKFont::load(const uint8_t* data, size_t size, uint32_t pixel_size, PKFont& font) {
+  // The structures are read in place.
+  if (data == nullptr || (uintptr_t)data % alignof(PKF2Face) != 0 || size < sizeof(PKF2Header))
+    return false;
+
+  const auto* header = reinterpret_cast<const PKF2Header*>(data);
+  if (header->magic != PKF2_MAGIC || header->face_count == 0 || header->range_count == 0 ||
+      header->glyph_count == 0)
+    return false;
+
+  if (header->ranges_offset % alignof(PKF2Range) != 0 ||
+      !check_array(size, header->ranges_offset, header->range_count, sizeof(PKF2Range)))
+    return false;
+  if (header->faces_offset % alignof(PKF2Face) != 0 ||
+      !check_array(size, header->faces_offset, header->face_count, sizeof(PKF2Face)))
+    return false;
+
+  // The ranges must be sorted (for the binary search) and only reference existing glyphs.
+  const auto* ranges = reinterpret_cast<const PKF2Range*>(data + header->ranges_offset);
+  for (uint32_t i = 0; i < header->range_count; ++i) {
+    const PKF2Range& range = ranges[i];
+    if (range.first_code_point > range.last_code_point ||
+        (i > 0 && range.first_code_point <= ranges[i - 1].last_code_point) ||
+        (uint64_t)range.first_glyph + (range.last_code_point - range.first_code_point) >= header->glyph_count)
+      return false;
+  }
+
+  // Select the face of the nearest size.
+  const auto* faces = reinterpret_cast<const PKF2Face*>(data + header->faces_offset);
+  const PKF2Face* face = &faces[0];
+  for (uint32_t i = 1; i < header->face_count; ++i) {
+    const auto distance = [pixel_size](const PKF2Face* it) {
+      return it->pixel_size > pixel_size ? it->pixel_size - pixel_size : pixel_size - it->pixel_size;
+    };
+
+    if (distance(&faces[i]) < distance(face))
+      face = &faces[i];
+  }
+
+  // The glyph bounding boxes are stored on 8 bits.
+  const PKFHeader& metrics = face->metrics;
+  if (metrics.char_width == 0 || metrics.char_width > UINT8_MAX || metrics.char_height == 0 ||
+      metrics.char_height > UINT8_MAX)
+    return false;
+
+  if (face->glyphs_offset % alignof(PKF2Glyph) != 0 ||
+      !check_array(size, face->glyphs_offset, header->glyph_count, sizeof(PKF2Glyph)) ||
+      !check_array(size, face->rows_offset, face->rows_size, 1))
+    return false;
+
+  // The rows themselves are checked when decoded.
+  const auto* glyphs = reinterpret_cast<const PKF2Glyph*>(data + face->glyphs_offset);
+  for (uint32_t i = 0; i < header->glyph_count; ++i) {
+    const PKF2Glyph& glyph = glyphs[i];
+    if (glyph.x + glyph.width > metrics.char_width || glyph.y + glyph.height > metrics.char_height ||
+        glyph.rows_offset > face->rows_size)
+      return false;
+  }
+
+  font = PKFont(data, face);
+  return true;
+}
+
+uint32_t PKFont::get_glyph_count() const {
+  if (m_file == nullptr)
+    return LAST_CHARACTER - FIRST_CHARACTER + 1;
+
+  return reinterpret_cast<const PKF2Header*>(m_file)->glyph_count;
+}
+
+uint32_t PKFont::find_glyph_index(uint32_t code_point) const {
+  const auto* header = reinterpret_cast<const PKF2Header*>(m_file);
+  const auto* ranges = reinterpret_cast<const PKF2Range*>(m_file + header->ranges_offset);
+
+  // Binary search of the range containing the character (the ranges are sorted).
+  uint32_t low = 0, high = header->range_count;
+  while (low < high) {
+    const uint32_t middle = low + (high - low) / 2;
+    const PKF2Range& range = ranges[middle];
+    if (code_point < range.first_code_point)
+      high = middle;
+    else if (code_point > range.last_code_point)
+      low = middle + 1;
+    else
+      return range.first_glyph + (code_point - range.first_code_point);
+  }
+
+  return NO_GLYPH;
 }
 
 const uint8_t* PKFont::get_glyph(char code) const {
+  if (m_file != nullptr)
+    return nullptr;  // the glyphs must be decoded
+
   if (code < FIRST_CHARACTER || code > LAST_CHARACTER)
     return nullptr;  // the font does not contain this glyph
 
@@ -29,3 +176,50 @@ const uint8_t* PKFont::get_glyph(char code) const {
   const uint8_t* offset = m_buffer + sizeof(PKFHeader) + (size_t)((char_width * char_height) * index);
   return offset;
 }
+
+bool PKFont::decode_glyph(uint32_t index, uint8_t* alpha_map) const {
+  const uint32_t char_width = get_char_width();
+  const size_t glyph_size = char_width * get_char_height();
+  if (m_file == nullptr) {
+    libk::memcpy(alpha_map, m_buffer + sizeof(PKFHeader) + glyph_size * index, glyph_size);
+    return true;
+  }
+
+  libk::bzero(alpha_map, glyph_size);
+
+  const auto* face = reinterpret_cast<const PKF2Face*>(m_buffer);
+  const PKF2Glyph& glyph = reinterpret_cast<const PKF2Glyph*>(m_file + face->glyphs_offset)[index];
+  const uint8_t* it = m_file + face->rows_offset + glyph.rows_offset;
+  const uint8_t* end = m_file + face->rows_offset + face->rows_size;
+
+  for (uint32_t y = 0; y < glyph.height; ++y) {
+    if (it == end)
+      return false;
+
+    uint8_t* row = alpha_map + glyph.x + char_width * (glyph.y + y);
+    uint32_t x = 0;
+    for (uint32_t nb_runs = *it++; nb_runs > 0; --nb_runs) {
+      if (end - it < 2)
+        return false;
+
+      x += it[0];
+      const uint32_t length = it[1];
+      it += 2;
+
+      const uint32_t packed_size = (length + 1) / 2;
+      if (x + length > glyph.width || (size_t)(end - it) < packed_size)
+        return false;
+
+      // The 4-bit alphas are expanded to 8 bits (0xf gives 0xff).
+      for (uint32_t i = 0; i < length; ++i) {
+        const uint8_t nibble = (i % 2 == 0) ? (it[i / 2] >> 4) : (it[i / 2] & 0xf);
+        row[x + i] = nibble * 0x11;
+      }
+
+      x += length;
+      it += packed_size;
+    }
+  }
+
+  return true;
+}
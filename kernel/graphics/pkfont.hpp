@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 
 struct alignas(16) PKFHeader {
@@ -13,19 +14,88 @@ struct alignas(16) PKFHeader {
   uint32_t line_height;
 };  // struct PKFHeader
 
+/*
+ * The PKF v2 format stores several faces (one per size) of a font, for any set of Unicode characters.
+ *
+ * A file starts with a PKF2Header, followed by the Unicode ranges (sorted), the faces and, for each face,
+ * its glyphs (the same characters for all faces) and their rows. All offsets are relative to the start of
+ * the file. Only the bounding box of the non-transparent texels of each glyph is stored: each of its rows is
+ * a byte giving the number of runs of non-transparent texels, followed by the runs. A run is a byte giving
+ * the number of transparent texels before it (since the previous run, or the left of the bounding box), a
+ * byte giving its length, and its alphas on 4 bits (two per byte, the first one in the high nibble).
+ */
+
+/** @brief The magic number of PKF v2 files ("PKF2"). The v1 files start with the character width instead. */
+static constexpr uint32_t PKF2_MAGIC = 0x32464b50;
+
+struct PKF2Header {
+  uint32_t magic;
+  /** @brief Number of faces (sizes) in the file. */
+  uint32_t face_count;
+  /** @brief Number of Unicode ranges. */
+  uint32_t range_count;
+  /** @brief Number of glyphs of each face. */
+  uint32_t glyph_count;
+  /** @brief Offset of the PKF2Range array. */
+  uint32_t ranges_offset;
+  /** @brief Offset of the PKF2Face array (aligned on 16 bytes). */
+  uint32_t faces_offset;
+  uint32_t reserved[2];
+};  // struct PKF2Header
+
+/** @brief Consecutive Unicode characters, whose glyphs are consecutive too. */
+struct PKF2Range {
+  uint32_t first_code_point;
+  uint32_t last_code_point;
+  uint32_t first_glyph;
+};  // struct PKF2Range
+
+struct PKF2Face {
+  /** @brief The metrics of the face, as in a v1 file. */
+  PKFHeader metrics;
+  /** @brief The size of the face, in pixels. */
+  uint32_t pixel_size;
+  /** @brief Offset of the PKF2Glyph array (of PKF2Header::glyph_count entries). */
+  uint32_t glyphs_offset;
+  /** @brief Offset and size of the rows of all the glyphs of the face. */
+  uint32_t rows_offset;
+  uint32_t rows_size;
+};  // struct PKF2Face
+
+struct PKF2Glyph {
+  /** @brief Bounding box of the non-transparent texels, relative to the top-left of the character cell. */
+  uint8_t x, y, width, height;
+  /** @brief Offset of the glyph rows, relative to PKF2Face::rows_offset. */
+  uint32_t rows_offset;
+};  // struct PKF2Glyph
+
 class PKFont {
  public:
-  /** @brief First ASCII character included in the font. */
+  /** @brief First ASCII character included in v1 fonts. */
   static constexpr uint8_t FIRST_CHARACTER = 0x21;
-  /** @brief Last ASCII character included in the font. */
+  /** @brief Last ASCII character included in v1 fonts. */
   static constexpr uint8_t LAST_CHARACTER = 0x7e;
+  /** @brief The glyph index of the characters not included in the font. */
+  static constexpr uint32_t NO_GLYPH = UINT32_MAX;
 
-  /** @brief Creates a PKFont from the given @a buffer.
+  /** @brief Creates a PKFont from the given v1 @a buffer.
    *
    * The length of the @a buffer is implicit. Moreover, this function expect
    * the @a buffer is well-defined (the function is not safe). */
   constexpr PKFont(const uint8_t* buffer) : m_buffer(buffer) {}
 
+  /** @brief Loads from the PKF v2 file @a data (of @a size bytes) the face whose size is the nearest to
+   * @a pixel_size pixels, into @a font.
+   *
+   * The file is checked, returns false if it is invalid. The @a data must stay alive as long as the font is used. */
+  [[nodiscard]] static bool load(const uint8_t* data, size_t size, uint32_t pixel_size, PKFont& font);
+
+  /** @brief Gets the buffer the font was created from (it also identifies the font and its size). */
+  [[nodiscard]] const uint8_t* get_data() const { return m_buffer; }
+
+  /** @brief Checks if the font is a face of a PKF v2 file (whose glyphs are compressed, see decode_glyph()). */
+  [[nodiscard]] bool is_compressed() const { return m_file != nullptr; }
+
   /** @brief Gets the width of a character in pixels.
    *
    * Access the @c char_width field of the header. */
@@ -52,27 +122,66 @@ class PKFont {
    *
    * For monospace fonts (like PKF by default), the advance is the same for all characters. */
   [[nodiscard]] uint32_t get_horizontal_advance(char ch [[maybe_unused]]) const { return get_horizontal_advance(); }
-  /** @brief Returns the horizontal advance of @a text in pixels.
+  /** @brief Returns the horizontal advance of the UTF-8 encoded @a text in pixels.
    *
    * This is a distance appropriate for drawing a subsequent character after @a text.
    *
-   * If @a length is UINT32_MAX, the @a text is assumed to be NUL-terminated. */
+   * If @a length (in bytes) is UINT32_MAX, the @a text is assumed to be NUL-terminated. */
   [[nodiscard]] uint32_t get_horizontal_advance(const char* text, uint32_t length = UINT32_MAX) const;
 
-  /** @brief Returns the width of @a text in pixels.
+  /** @brief Returns the width of the UTF-8 encoded @a text in pixels.
    *
-   * If @a length is UINT32_MAX, the @a text is assumed to be NUL-terminated. */
+   * If @a length (in bytes) is UINT32_MAX, the @a text is assumed to be NUL-terminated. */
   [[nodiscard]] uint32_t get_width(const char* text, uint32_t length = UINT32_MAX) const;
 
+  /** @brief Gets the number of glyphs of the font. */
+  [[nodiscard]] uint32_t get_glyph_count() const;
+  /** @brief Gets the index of the glyph of the Unicode character @a code_point, or NO_GLYPH if the font
+   * does not contain it. */
+  [[nodiscard]] uint32_t get_glyph_index(uint32_t code_point) const {
+    // Fast path for the ASCII characters of v1 fonts.
+    if (m_file == nullptr)
+      return code_point >= FIRST_CHARACTER && code_point <= LAST_CHARACTER ? code_point - FIRST_CHARACTER : NO_GLYPH;
+    return find_glyph_index(code_point);
+  }
+
   /** @brief Returns the glyph alpha map corresponding of ASCII character @a code.
    *
-   * A NULL pointer is returned if the glyph doesnt exist or is not supported by the font.
+   * A NULL pointer is returned if the glyph doesnt exist, is not supported by the font or is compressed
+   * (see decode_glyph()).
    *
    * The returned alpha map is a 2D matrix of uint8_t (alpha component, 0 = transparent, 255 = opaque),
    * in row-major format. To access the alpha at (x,y), you query it with `buffer[x + char_width * y]`.
    */
   [[nodiscard]] const uint8_t* get_glyph(char code) const;
 
+  /** @brief Writes the alpha map of glyph @a index (see get_glyph()) into @a alpha_map, of char_width x
+   * char_height texels, for both compressed and uncompressed fonts.
+   *
+   * Returns false if the glyph data is invalid (the alpha map is then fully transparent). */
+  bool decode_glyph(uint32_t index, uint8_t* alpha_map) const;
+
+  /** @brief Decodes the UTF-8 character at @a it and moves @a it after it.
+   *
+   * Invalid sequences are decoded byte by byte as Latin-1 characters, so Latin-1 texts are still drawn. */
+  [[nodiscard]] static uint32_t decode_utf8(const char*& it) {
+    const uint8_t byte = *it;
+    if (byte < 0x80) {
+      ++it;
+      return byte;
+    }
+
+    return decode_utf8_sequence(it);
+  }
+
  private:
+  PKFont(const uint8_t* file, const PKF2Face* face) : m_buffer((const uint8_t*)face), m_file(file) {}
+
+  [[nodiscard]] uint32_t find_glyph_index(uint32_t code_point) const;
+  [[nodiscard]] static uint32_t decode_utf8_sequence(const char*& it);
+
+  // The font metrics (a PKFHeader for v1 fonts, a PKF2Face for v2 ones).
   const uint8_t* m_buffer;
+  // The PKF v2 file of the face, nullptr for v1 fonts.
+  const uint8_t* m_file = nullptr;
 };  // class PKFont
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "graphics/pixel_format.hpp"
+
+namespace graphics {
+/**
+ * @brief The header of the raw images, as produced by the `img2raw` tool (see tools/img2raw).
+ *
+ * A raw image stores its pixels as they will be in the screen (already scaled and converted to
+ * the screen pixel format), so it can be blit row by row without decoding anything. The rows
+ * start at data_offset (in bytes from the start of the file) and are pitch bytes apart.
+ */
+struct RawImageHeader {
+  static constexpr uint32_t MAGIC = 0x57524b50;  // "PKRW"
+
+  uint32_t magic;
+  uint32_t width;   // in pixels
+  uint32_t height;  // in pixels
+  uint32_t pitch;   // in bytes
+  uint32_t format;  // a PixelFormat value
+  uint32_t data_offset;
+  uint32_t reserved[10];
+
+  [[nodiscard]] PixelFormat get_format() const { return (PixelFormat)format; }
+
+  /** @brief Checks if the header describes an image that fits in a file of @a file_size bytes. */
+  [[nodiscard]] bool is_valid(size_t file_size) const {
+    if (magic != MAGIC || width == 0 || height == 0)
+      return false;
+    if (format != (uint32_t)PixelFormat::ARGB8888 && format != (uint32_t)PixelFormat::RGB565)
+      return false;
+
+    const uint64_t bpp = get_bytes_per_pixel(get_format());
+    if (pitch % bpp != 0 || pitch < bpp * width || data_offset < sizeof(RawImageHeader) || data_offset % bpp != 0)
+      return false;
+    return data_offset + (uint64_t)pitch * height <= file_size;
+  }
+};  // struct RawImageHeader
+
+static_assert(sizeof(RawImageHeader) == 64);
+}  // namespace graphics
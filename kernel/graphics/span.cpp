@@ -0,0 +1,198 @@
+#include "graphics/span.hpp"
+
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif  // __ARM_NEON
+
+namespace graphics {
+#ifdef __ARM_NEON
+/** Exact division by 255 with rounding of the 8 lanes: (x + ((x + 128) >> 8) + 128) >> 8. */
+[[gnu::always_inline]] static inline uint8x8_t div255(uint16x8_t x) {
+  return vraddhn_u16(x, vrshrq_n_u16(x, 8));
+}
+
+/** Broadcasts the alpha channel of each of the 4 pixels of @a pixels to its 4 channels. */
+[[gnu::always_inline]] static inline uint8x16_t broadcast_alpha(uint8x16_t pixels) {
+  static constexpr uint8_t ALPHA_INDICES[16] = {3, 3, 3, 3, 7, 7, 7, 7, 11, 11, 11, 11, 15, 15, 15, 15};
+  return vqtbl1q_u8(pixels, vld1q_u8(ALPHA_INDICES));
+}
+#endif  // __ARM_NEON
+
+[[gnu::hot]] void fill_span(uint32_t* dst, size_t n, uint32_t argb) {
+#ifdef __ARM_NEON
+  // 64 bytes (16 pixels) per iteration, using 128-bit stores.
+  const uint32x4_t value = vdupq_n_u32(argb);
+  for (; n >= 16; n -= 16, dst += 16) {
+    vst1q_u32(dst, value);
+    vst1q_u32(dst + 4, value);
+    vst1q_u32(dst + 8, value);
+    vst1q_u32(dst + 12, value);
+  }
+
+  for (; n >= 4; n -= 4, dst += 4) {
+    vst1q_u32(dst, value);
+  }
+#endif  // __ARM_NEON
+
+  for (; n > 0; --n) {
+    *dst++ = argb;
+  }
+}
+
+[[gnu::hot]] static void copy_span(uint32_t* dst, const uint32_t* src, size_t n) {
+  if (dst == src)
+    return;
+
+#ifdef __ARM_NEON
+  // 64 bytes (16 pixels) per iteration.
+  for (; n >= 16; n -= 16, dst += 16, src += 16) {
+    const uint32x4x4_t pixels = vld1q_u32_x4(src);
+    vst1q_u32_x4(dst, pixels);
+  }
+
+  for (; n >= 4; n -= 4, dst += 4, src += 4) {
+    vst1q_u32(dst, vld1q_u32(src));
+  }
+#endif  // __ARM_NEON
+
+  for (; n > 0; --n) {
+    *dst++ = *src++;
+  }
+}
+
+[[gnu::hot]] static void over_straight_span(uint32_t* dst, const uint32_t* src, size_t n) {
+#ifdef __ARM_NEON
+  // 4 pixels (16 channels) per iteration: result = src * alpha + dst * (255 - alpha), divided by 255.
+  // The source alpha channel is replaced by 255 so that the result alpha is alpha + dst_alpha * (1 - alpha).
+  const uint8x16_t alpha_channel = vreinterpretq_u8_u32(vdupq_n_u32(0xff000000));
+  for (; n >= 4; n -= 4, dst += 4, src += 4) {
+    const uint8x16_t s = vreinterpretq_u8_u32(vld1q_u32(src));
+    const uint8x16_t alpha = broadcast_alpha(s);
+
+    // Fast paths, common for images.
+    if (vminvq_u8(alpha) == 0xff) {
+      vst1q_u32(dst, vreinterpretq_u32_u8(s));
+      continue;
+    }
+
+    if (vmaxvq_u8(alpha) == 0)
+      continue;
+
+    const uint8x16_t d = vreinterpretq_u8_u32(vld1q_u32(dst));
+    const uint8x16_t s1 = vorrq_u8(s, alpha_channel);
+    const uint8x16_t inv_alpha = vmvnq_u8(alpha);
+    uint16x8_t lo = vmull_u8(vget_low_u8(s1), vget_low_u8(alpha));
+    lo = vmlal_u8(lo, vget_low_u8(d), vget_low_u8(inv_alpha));
+    uint16x8_t hi = vmull_high_u8(s1, alpha);
+    hi = vmlal_high_u8(hi, d, inv_alpha);
+    vst1q_u32(dst, vreinterpretq_u32_u8(vcombine_u8(div255(lo), div255(hi))));
+  }
+#endif  // __ARM_NEON
+
+  for (; n > 0; --n, ++dst, ++src) {
+    const uint32_t alpha = *src >> 24;
+    if (alpha == 0xff)
+      *dst = *src;
+    else if (alpha != 0)
+      *dst = blend_pixel(*dst, *src);
+  }
+}
+
+[[gnu::hot]] static void over_premultiplied_span(uint32_t* dst, const uint32_t* src, size_t n) {
+#ifdef __ARM_NEON
+  // 4 pixels (16 channels) per iteration: result = src + dst * (255 - alpha) / 255.
+  for (; n >= 4; n -= 4, dst += 4, src += 4) {
+    const uint8x16_t s = vreinterpretq_u8_u32(vld1q_u32(src));
+    const uint8x16_t inv_alpha = vmvnq_u8(broadcast_alpha(s));
+    const uint8x16_t d = vreinterpretq_u8_u32(vld1q_u32(dst));
+    const uint8x8_t lo = div255(vmull_u8(vget_low_u8(d), vget_low_u8(inv_alpha)));
+    const uint8x8_t hi = div255(vmull_high_u8(d, inv_alpha));
+    vst1q_u32(dst, vreinterpretq_u32_u8(vqaddq_u8(s, vcombine_u8(lo, hi))));
+  }
+#endif  // __ARM_NEON
+
+  for (; n > 0; --n, ++dst, ++src) {
+    *dst = blend_pixel_premultiplied(*dst, *src);
+  }
+}
+
+[[gnu::hot]] static void add_span(uint32_t* dst, const uint32_t* src, size_t n, AlphaFormat format) {
+#ifdef __ARM_NEON
+  // 4 pixels (16 channels) per iteration: result = dst + src (premultiplied, saturated).
+  const uint8x16_t alpha_channel = vreinterpretq_u8_u32(vdupq_n_u32(0xff000000));
+  for (; n >= 4; n -= 4, dst += 4, src += 4) {
+    uint8x16_t s = vreinterpretq_u8_u32(vld1q_u32(src));
+    if (format == AlphaFormat::Straight) {
+      const uint8x16_t alpha = broadcast_alpha(s);
+      const uint8x16_t s1 = vorrq_u8(s, alpha_channel);
+      s = vcombine_u8(div255(vmull_u8(vget_low_u8(s1), vget_low_u8(alpha))), div255(vmull_high_u8(s1, alpha)));
+    }
+
+    const uint8x16_t d = vreinterpretq_u8_u32(vld1q_u32(dst));
+    vst1q_u32(dst, vreinterpretq_u32_u8(vqaddq_u8(d, s)));
+  }
+#endif  // __ARM_NEON
+
+  for (; n > 0; --n, ++dst, ++src) {
+    const uint32_t s = format == AlphaFormat::Straight ? premultiply(*src) : *src;
+    *dst = saturated_add(*dst, s);
+  }
+}
+
+[[gnu::hot]] void blend_span(uint32_t* dst, const uint32_t* src, size_t n, BlendMode mode, AlphaFormat format) {
+  switch (mode) {
+    case BlendMode::Copy:
+      copy_span(dst, src, n);
+      break;
+    case BlendMode::SourceOver:
+      if (format == AlphaFormat::Straight)
+        over_straight_span(dst, src, n);
+      else
+        over_premultiplied_span(dst, src, n);
+      break;
+    case BlendMode::Add:
+      add_span(dst, src, n, format);
+      break;
+  }
+}
+
+[[gnu::hot]] void blend_solid_span(uint32_t* dst, size_t n, uint32_t argb, AlphaFormat format) {
+  const uint32_t alpha = argb >> 24;
+  if (alpha == 0 && (format == AlphaFormat::Straight || argb == 0))
+    return;
+
+  if (alpha == 0xff) {
+    fill_span(dst, n, argb);
+    return;
+  }
+
+#ifdef __ARM_NEON
+  const uint8x8_t inv_alpha = vdup_n_u8(255 - alpha);
+  if (format == AlphaFormat::Straight) {
+    // 4 pixels (16 channels) per iteration: result = src * alpha + dst * (255 - alpha), divided by 255.
+    // The source term is the same for every pixel and is precomputed.
+    const uint8x16_t s = vreinterpretq_u8_u32(vdupq_n_u32(argb | 0xff000000));
+    const uint16x8_t src_term = vmull_u8(vget_low_u8(s), vdup_n_u8(alpha));
+    for (; n >= 4; n -= 4, dst += 4) {
+      const uint8x16_t d = vreinterpretq_u8_u32(vld1q_u32(dst));
+      const uint8x8_t lo = div255(vmlal_u8(src_term, vget_low_u8(d), inv_alpha));
+      const uint8x8_t hi = div255(vmlal_u8(src_term, vget_high_u8(d), inv_alpha));
+      vst1q_u32(dst, vreinterpretq_u32_u8(vcombine_u8(lo, hi)));
+    }
+  } else {
+    // 4 pixels (16 channels) per iteration: result = src + dst * (255 - alpha) / 255.
+    const uint8x16_t s = vreinterpretq_u8_u32(vdupq_n_u32(argb));
+    for (; n >= 4; n -= 4, dst += 4) {
+      const uint8x16_t d = vreinterpretq_u8_u32(vld1q_u32(dst));
+      const uint8x8_t lo = div255(vmull_u8(vget_low_u8(d), inv_alpha));
+      const uint8x8_t hi = div255(vmull_u8(vget_high_u8(d), inv_alpha));
+      vst1q_u32(dst, vreinterpretq_u32_u8(vqaddq_u8(s, vcombine_u8(lo, hi))));
+    }
+  }
+#endif  // __ARM_NEON
+
+  for (; n > 0; --n, ++dst) {
+    *dst = format == AlphaFormat::Straight ? blend_pixel(*dst, argb) : blend_pixel_premultiplied(*dst, argb);
+  }
+}
+}  // namespace graphics
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace graphics {
+/** @brief The operator used to combine source pixels with destination pixels. */
+enum class BlendMode : uint8_t {
+  /** dst = src */
+  Copy,
+  /** dst = src + dst * (1 - src_alpha) */
+  SourceOver,
+  /** dst = src + dst (saturated) */
+  Add,
+};  // enum class BlendMode
+
+/** @brief How the alpha is stored in source pixels. */
+enum class AlphaFormat : uint8_t {
+  /** Color channels are independent of the alpha channel (e.g. 0x80ffffff is a translucent white). */
+  Straight,
+  /** Color channels are already multiplied by the alpha channel (e.g. 0x80808080 is a translucent white). */
+  Premultiplied,
+};  // enum class AlphaFormat
+
+/** @brief Writes @a argb (in 0xAARRGGBB format) to the @a n pixels starting at @a dst, without blending. */
+void fill_span(uint32_t* dst, size_t n, uint32_t argb);
+
+/** @brief Combines the @a n pixels of @a src with the ones of @a dst using the given blend @a mode.
+ *
+ * All blending done by the kernel (the Painter and the compositor) goes through this function.
+ * Divisions by 255 are exact, rounded to the nearest: x / 255 is computed as ((x + 128) * 257) >> 16.
+ * With straight alpha, the result alpha is computed as if the source was premultiplied, so the
+ * destination alpha is preserved. @a dst and @a src must not overlap (unless they are equal). */
+void blend_span(uint32_t* dst, const uint32_t* src, size_t n, BlendMode mode, AlphaFormat format = AlphaFormat::Straight);
+
+/** @brief Like blend_span() with @a n copies of @a argb as source, using the SourceOver mode.
+ *
+ * Fully opaque colors are forwarded to fill_span() and fully transparent ones do nothing. */
+void blend_solid_span(uint32_t* dst, size_t n, uint32_t argb, AlphaFormat format = AlphaFormat::Straight);
+
+/** @brief Divides each of the two 16-bit lanes of @a x by 255 (rounded), see blend_span(). */
+[[gnu::always_inline]] inline uint32_t div255_lanes(uint32_t x) {
+  x += 0x00800080;
+  return ((x + ((x >> 8) & 0x00ff00ff)) >> 8) & 0x00ff00ff;
+}
+
+/** @brief Converts a straight alpha color to a premultiplied one. */
+[[gnu::always_inline]] inline uint32_t premultiply(uint32_t argb) {
+  const uint32_t alpha = argb >> 24;
+  const uint32_t rb = div255_lanes((argb & 0x00ff00ff) * alpha);
+  const uint32_t g = div255_lanes(((argb >> 8) & 0xff) * alpha);
+  return (alpha << 24) | (g << 8) | rb;
+}
+
+/** @brief Adds the 4 channels of @a a and @a b, saturating at 255. */
+[[gnu::always_inline]] inline uint32_t saturated_add(uint32_t a, uint32_t b) {
+  uint32_t rb = (a & 0x00ff00ff) + (b & 0x00ff00ff);
+  uint32_t ag = ((a >> 8) & 0x00ff00ff) + ((b >> 8) & 0x00ff00ff);
+  rb = (rb | (((rb >> 8) & 0x00010001) * 0xff)) & 0x00ff00ff;
+  ag = (ag | (((ag >> 8) & 0x00010001) * 0xff)) & 0x00ff00ff;
+  return (ag << 8) | rb;
+}
+
+/** @brief Blends a single straight alpha pixel @a argb over @a dst, see blend_span(). */
+[[gnu::always_inline]] inline uint32_t blend_pixel(uint32_t dst, uint32_t argb) {
+  // The four channels are blended at once, two by two (SWAR). The source alpha channel is
+  // replaced by 255 so that the result alpha is alpha + dst_alpha * (1 - alpha).
+  const uint32_t alpha = argb >> 24;
+  const uint32_t inv_alpha = 255 - alpha;
+  const uint32_t src = argb | 0xff000000;
+
+  const uint32_t rb = div255_lanes((src & 0x00ff00ff) * alpha + (dst & 0x00ff00ff) * inv_alpha);
+  const uint32_t ag = div255_lanes(((src >> 8) & 0x00ff00ff) * alpha + ((dst >> 8) & 0x00ff00ff) * inv_alpha);
+  return (ag << 8) | rb;
+}
+
+/** @brief Blends a single premultiplied pixel @a argb over @a dst, see blend_span(). */
+[[gnu::always_inline]] inline uint32_t blend_pixel_premultiplied(uint32_t dst, uint32_t argb) {
+  const uint32_t inv_alpha = 255 - (argb >> 24);
+  const uint32_t rb = div255_lanes((dst & 0x00ff00ff) * inv_alpha);
+  const uint32_t ag = div255_lanes(((dst >> 8) & 0x00ff00ff) * inv_alpha);
+  // No overflow is possible for valid premultiplied colors (channels <= alpha).
+  return argb + ((ag << 8) | rb);
+}
+}  // namespace graphics
@@ -1,2 +1,6 @@
+// The JPEG decoder is only needed by the window manager to decode the wallpaper at boot, when it
+// is not converted to a raw image at build time (see tools/img2raw).
+#ifdef CONFIG_WALLPAPER_JPEG
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
+#endif  // CONFIG_WALLPAPER_JPEG
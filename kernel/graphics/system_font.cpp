@@ -0,0 +1,51 @@
+#include "graphics/system_font.hpp"
+#include "graphics/graphics.hpp"
+
+#include <libk/log.hpp>
+#include <sys/file.h>
+#include "fs/filesystem.hpp"
+#include "memory/mem_alloc.hpp"
+
+namespace graphics {
+bool load_default_font(const char* path, uint32_t pixel_size) {
+  File* file = FileSystem::get().open(path, SYS_FM_READ);
+  if (file == nullptr) {
+    LOG_WARNING("Failed to open '{}', the builtin font is used", path);
+    return false;
+  }
+
+  // As for the wallpaper, the font is used in place from the ramdisk (which is never unmapped), unless
+  // it is fragmented or not aligned enough for the PKF v2 structures. Then it is copied.
+  const size_t file_size = file->get_size();
+  const uint8_t* content = (const uint8_t*)file->map();
+  uint8_t* buffer = nullptr;  // the copy of the file, if it can not be used in place
+  if (content == nullptr || (uintptr_t)content % alignof(PKF2Face) != 0) {
+    buffer = (uint8_t*)kmalloc(file_size, 64);
+    size_t read_bytes;
+    if (buffer == nullptr || !file->seek(0) || !file->read(buffer, file_size, &read_bytes) ||
+        read_bytes != file_size) {
+      LOG_WARNING("Failed to read '{}', the builtin font is used", path);
+      kfree(buffer);
+      FileSystem::get().close(file);
+      return false;
+    }
+
+    content = buffer;
+  }
+
+  FileSystem::get().close(file);
+
+  // The font data is never freed, as the painters may use it until shutdown.
+  PKFont font = get_default_font();
+  if (!PKFont::load(content, file_size, pixel_size, font)) {
+    LOG_WARNING("'{}' is not a valid PKF v2 font, the builtin font is used", path);
+    kfree(buffer);
+    return false;
+  }
+
+  set_default_font(font);
+  LOG_INFO("Font '{}' loaded ({} glyphs of {}x{} pixels)", path, font.get_glyph_count(), font.get_char_width(),
+           font.get_char_height());
+  return true;
+}
+}  // namespace graphics
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstdint>
+
+namespace graphics {
+/** @brief Loads the face of the nearest size to @a pixel_size pixels of the PKF v2 font @a path (from
+ * the filesystem) and makes it the default font of the painters (see set_default_font()).
+ *
+ * On failure, a warning is logged and the builtin font is kept. The filesystem must be initialized. */
+bool load_default_font(const char* path, uint32_t pixel_size);
+}  // namespace graphics
@@ -0,0 +1,76 @@
+#include "graphics/text_layout.hpp"
+
+#include <libk/utils.hpp>
+
+namespace graphics {
+uint32_t TextLayout::break_line(PKFont font, const char* text, int32_t width, const char*& next) {
+  const uint32_t char_width = font.get_char_width();
+  const uint32_t advance = font.get_horizontal_advance();
+
+  uint32_t x = 0;
+  for (const char* it = text;;) {
+    const char* ch_start = it;
+    const uint32_t ch = PKFont::decode_utf8(it);
+    switch (ch) {
+      case '\0':
+        next = nullptr;
+        return ch_start - text;
+      case '\n':
+        next = it;
+        return ch_start - text;
+      case ' ':
+        x += advance;
+        break;
+      default:
+        if (font.get_glyph_index(ch) == PKFont::NO_GLYPH)
+          break;  // ignored when drawn
+
+        // If the character does not fit in the line, then start a new line (but keep
+        // at least one character per line).
+        if (ch_start != text && (int64_t)x + char_width >= width) {
+          next = ch_start;
+          return ch_start - text;
+        }
+
+        x += advance;
+        break;
+    }
+  }
+}
+
+void TextLayout::layout(PKFont font, const char* text, int32_t width) {
+  delete[] m_lines;
+  m_lines = nullptr;
+  m_line_count = 0;
+  m_width = 0;
+  m_text = text;
+  m_font = font;
+
+  if (text == nullptr)
+    return;
+
+  // Two passes: first count the lines to allocate them at once, then fill them.
+  size_t nb_lines = 0;
+  for (const char* it = text; it != nullptr; ++nb_lines) {
+    (void)break_line(font, it, width, it);
+  }
+
+  m_lines = new Line[nb_lines];
+  if (m_lines == nullptr)
+    return;
+
+  for (const char* it = text; it != nullptr; ++m_line_count) {
+    const char* line = it;
+    const uint32_t length = break_line(font, line, width, it);
+    m_lines[m_line_count] = {(uint32_t)(line - text), length};
+    m_width = libk::max(m_width, font.get_width(line, length));
+  }
+}
+
+uint32_t TextLayout::get_height() const {
+  if (m_line_count == 0)
+    return 0;
+
+  return (m_line_count - 1) * m_font.get_line_height() + m_font.get_char_height();
+}
+}  // namespace graphics
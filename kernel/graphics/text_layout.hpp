@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "graphics/pkfont.hpp"
+
+namespace graphics {
+/**
+ * @brief The line breaks of a text, computed once and reused each time the text is drawn.
+ *
+ * A new line is started after each '\n' and before each character that does not fit in
+ * the layout width (spaces never start a new line). See Painter::draw_text().
+ *
+ * The layout does not copy the text: it must stay alive (and unmodified) as long as the layout is used.
+ */
+class TextLayout {
+ public:
+  struct Line {
+    uint32_t offset;  // offset of the first character of the line in the text, in bytes
+    uint32_t length;  // number of bytes of the line (excluding the '\n')
+  };  // struct Line
+
+  /** @brief Creates an empty layout. */
+  TextLayout() = default;
+  /** @brief Computes the layout of @a text drawn with @a font in at most @a width pixels per line. */
+  TextLayout(PKFont font, const char* text, int32_t width = INT32_MAX) { layout(font, text, width); }
+  TextLayout(const TextLayout&) = delete;
+  TextLayout& operator=(const TextLayout&) = delete;
+  ~TextLayout() { delete[] m_lines; }
+
+  /** @brief Computes again the layout for the given @a text, @a font and @a width. */
+  void layout(PKFont font, const char* text, int32_t width = INT32_MAX);
+
+  [[nodiscard]] const char* get_text() const { return m_text; }
+  [[nodiscard]] PKFont get_font() const { return m_font; }
+  [[nodiscard]] size_t get_line_count() const { return m_line_count; }
+  [[nodiscard]] const Line& get_line(size_t index) const { return m_lines[index]; }
+
+  /** @brief Gets the width of the widest line, in pixels. */
+  [[nodiscard]] uint32_t get_width() const { return m_width; }
+  /** @brief Gets the height of all the lines, in pixels. */
+  [[nodiscard]] uint32_t get_height() const;
+
+  /** @brief Finds the end of the line starting at @a text (UTF-8 encoded).
+   *
+   * Returns the number of bytes of the line, and stores in @a next the start of the
+   * following line (or nullptr if this is the last one). This implements the line breaking
+   * rules for both TextLayout and Painter::draw_text(). */
+  [[nodiscard]] static uint32_t break_line(PKFont font, const char* text, int32_t width, const char*& next);
+
+ private:
+  const char* m_text = nullptr;
+  PKFont m_font = nullptr;
+  Line* m_lines = nullptr;
+  size_t m_line_count = 0;
+  uint32_t m_width = 0;
+};  // class TextLayout
+}  // namespace graphics
@@ -2,6 +2,7 @@
 #include <libk/utils.hpp>
 
 #include "dma_impl.hpp"
+#include "hardware/irq/irq_lists.hpp"
 #include "libk/log.hpp"
 #include "memory/kernel_internal_memory.hpp"
 
@@ -68,6 +69,34 @@ bool Channel::execute_requests(const Request* req) const {
   return true;
 }
 
+bool Channel::execute_chain(const ControlBlockChain& chain, const ControlBlockRing& ring) const {
+  if (chain.is_empty() || !is_free()) {
+    return false;
+  }
+
+  libk::write32(base + CONBLK_AD, ring.get_address(chain.get_first()));
+  libk::write32(base + CS, CS_WAIT_FOR_WRITE | CS_DIS_DEBUG | CS_ACTIVE | 15 << 20 | 8 << 16);
+  return true;
+}
+
+IRQ Channel::get_irq() const {
+  // Only the channels 0 to 10 have their own interrupt, the others share a single one.
+  const size_t index = dma_impl::get_channel_index(base);
+  KASSERT(index <= 10);
+  return {.type = VC_DMA_BASE.type, .id = VC_DMA_BASE.id + index};
+}
+
+bool Channel::acknowledge_interrupt() const {
+  const auto cs = libk::read32(base + CS);
+  if ((cs & CS_INT) == 0) {
+    return false;
+  }
+
+  // Writing 1 clears the interrupt and end flags (without touching the other bits).
+  libk::write32(base + CS, (cs & CS_ACTIVE) | CS_INT | CS_END);
+  return true;
+}
+
 bool Channel::wait() const {
   while (!is_free()) {
     libk::yield();
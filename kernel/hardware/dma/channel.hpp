@@ -3,7 +3,9 @@
 #include <cstddef>
 #include <cstdint>
 
+#include "hardware/dma/control_block_ring.hpp"
 #include "hardware/dma/request.hpp"
+#include "hardware/irq/irq_manager.hpp"
 
 namespace DMA {
 class Channel {
@@ -15,6 +17,18 @@ class Channel {
    * @a Returns `true` is the request has been started. */
   bool execute_requests(const Request* req) const;
 
+  /** Try to start executing the chain @a chain, whose control blocks come from @a ring.
+   * The channel does not wait for the end of the chain, see wait() or get_irq().
+   * @a Returns `true` is the chain has been started. */
+  bool execute_chain(const ControlBlockChain& chain, const ControlBlockRing& ring) const;
+
+  /** Gets the interrupt raised by this channel at the end of the control blocks with
+   * interrupts enabled (see ControlBlockChain::enable_completion_interrupt()). */
+  [[nodiscard]] IRQ get_irq() const;
+
+  /** Clears the interrupt of this channel. Returns `true` if the channel had raised it. */
+  bool acknowledge_interrupt() const;
+
   /** Wait for requests to end. */
   bool wait() const;
 
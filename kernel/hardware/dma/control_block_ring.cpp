@@ -0,0 +1,74 @@
+#include "control_block_ring.hpp"
+#include "dma_impl.hpp"
+#include "libk/log.hpp"
+#include "memory/kernel_internal_memory.hpp"
+
+namespace DMA {
+ControlBlockRing::ControlBlockRing(size_t capacity)
+    : m_buffer(libk::make_scoped<Buffer>(sizeof(ControlBlock) * capacity)) {
+  // The buffer is page aligned, so are the control blocks (which must be 32-byte aligned).
+  m_blocks = (ControlBlock*)m_buffer->get();
+  m_blocks_address = memory_impl::resolve_kernel_va((uintptr_t)m_blocks, false);
+  m_capacity = m_buffer->get_byte_size() / sizeof(ControlBlock);
+}
+
+ControlBlock* ControlBlockRing::allocate() {
+  if (get_free_count() == 0)
+    return nullptr;
+
+  return &m_blocks[m_head++ % m_capacity];
+}
+
+uint32_t ControlBlockRing::get_address(const ControlBlock* block) const {
+  KASSERT(block >= m_blocks && block < m_blocks + m_capacity);
+  return m_blocks_address + sizeof(ControlBlock) * (block - m_blocks);
+}
+
+void ControlBlockRing::release_until(uint64_t mark) {
+  KASSERT(mark >= m_tail && mark <= m_head);
+  m_tail = mark;
+}
+
+bool ControlBlockChain::add_memcpy_2d(ControlBlockRing& ring,
+                                      Address src,
+                                      Address dst,
+                                      uint16_t line_byte_length,
+                                      uint16_t nb_lines,
+                                      uint16_t src_stride,
+                                      uint16_t dst_stride) {
+  ControlBlock* block = ring.allocate();
+  if (block == nullptr)
+    return false;
+
+  block->ti = dma_impl::TI_SRC_INC | dma_impl::TI_DEST_INC | dma_impl::TI_WAIT_RESP | dma_impl::TI_TD_MODE |
+              dma_impl::TI_NO_WIDE_BURSTS;
+  block->src = src;
+  block->dst = dst;
+  block->length = (nb_lines << 16) | line_byte_length;
+  block->stride = (dst_stride << 16) | src_stride;
+  block->next_block = 0;
+  block->reserved[0] = 0;
+  block->reserved[1] = 0;
+
+  if (m_first == nullptr) {
+    m_first = block;
+  } else {
+    m_last->next_block = ring.get_address(block);
+  }
+
+  m_last = block;
+  m_byte_count += (uint64_t)line_byte_length * nb_lines;
+  return true;
+}
+
+void ControlBlockChain::enable_completion_interrupt() {
+  if (m_last != nullptr)
+    m_last->ti |= dma_impl::TI_INT_EN;
+}
+
+void ControlBlockChain::clear() {
+  m_first = nullptr;
+  m_last = nullptr;
+  m_byte_count = 0;
+}
+}  // namespace DMA
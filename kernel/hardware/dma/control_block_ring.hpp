@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <libk/memory.hpp>
+#include "hardware/dma/dma_controller.hpp"
+#include "memory/buffer.hpp"
+
+namespace DMA {
+/** A DMA control block, as read by the DMA engine. */
+struct ControlBlock {
+  uint32_t ti;
+  uint32_t src;
+  uint32_t dst;
+  uint32_t length;
+  uint32_t stride;
+  uint32_t next_block;
+  uint32_t reserved[2];
+};  // struct ControlBlock
+
+static_assert(sizeof(ControlBlock) == 32, "DMA control blocks must be 32 bytes long (and aligned)");
+
+/**
+ * A preallocated ring of DMA control blocks.
+ *
+ * Unlike Request, building a chain of transfers from the ring does not allocate any memory:
+ * control blocks are taken at the head of the ring and given back (in the same order) once
+ * the DMA engine has executed them, see get_mark() and release_until().
+ */
+class ControlBlockRing {
+ public:
+  /** Creates a ring of @a capacity control blocks (rounded up to fill whole pages). */
+  explicit ControlBlockRing(size_t capacity);
+
+  [[nodiscard]] size_t get_capacity() const { return m_capacity; }
+  /** Gets the number of control blocks that can still be allocated. */
+  [[nodiscard]] size_t get_free_count() const { return m_capacity - (m_head - m_tail); }
+
+  /** Takes a control block at the head of the ring. Returns nullptr if the ring is full. */
+  [[nodiscard]] ControlBlock* allocate();
+  /** Gets the address of @a block, as expected by the DMA engine in the chaining fields. */
+  [[nodiscard]] uint32_t get_address(const ControlBlock* block) const;
+
+  /** Gets the current head of the ring: all the control blocks allocated before are before it. */
+  [[nodiscard]] uint64_t get_mark() const { return m_head; }
+  /** Gives back all the control blocks allocated before @a mark (see get_mark()). */
+  void release_until(uint64_t mark);
+
+ private:
+  libk::ScopedPointer<Buffer> m_buffer;
+  ControlBlock* m_blocks = nullptr;
+  uint32_t m_blocks_address = 0;
+  size_t m_capacity = 0;
+  // Number of control blocks allocated (resp. released) since the creation of the ring.
+  uint64_t m_head = 0;
+  uint64_t m_tail = 0;
+};  // class ControlBlockRing
+
+/** A chain of DMA transfers, executed one after the other by a Channel. */
+class ControlBlockChain {
+ public:
+  [[nodiscard]] bool is_empty() const { return m_first == nullptr; }
+  [[nodiscard]] const ControlBlock* get_first() const { return m_first; }
+  /** Gets the number of bytes copied by the whole chain. */
+  [[nodiscard]] uint64_t get_byte_count() const { return m_byte_count; }
+
+  /** Appends a 2D copy to the chain, with a control block allocated from @a ring.
+   *
+   * See Request::memcpy_2d() for the meaning of the parameters. Returns false if the
+   * ring is full (the copy is then not done). */
+  bool add_memcpy_2d(ControlBlockRing& ring,
+                     Address src,
+                     Address dst,
+                     uint16_t line_byte_length,
+                     uint16_t nb_lines,
+                     uint16_t src_stride,
+                     uint16_t dst_stride);
+
+  /** Requests an interrupt once the whole chain has been executed (see Channel::get_irq()). */
+  void enable_completion_interrupt();
+
+  /** Empties the chain. The control blocks must be released from their ring separately. */
+  void clear();
+
+ private:
+  ControlBlock* m_first = nullptr;
+  ControlBlock* m_last = nullptr;
+  uint64_t m_byte_count = 0;
+};  // class ControlBlockChain
+}  // namespace DMA
@@ -70,12 +70,16 @@ uintptr_t allocate_channel() {
 }
 
 void free_channel(uintptr_t chan_base) {
-  const size_t chan_id = (chan_base - _dma_base) / CHANNEL_REGS_SIZE;
+  const size_t chan_id = get_channel_index(chan_base);
   _dma_channels |= 1 << chan_id;
 }
 
+size_t get_channel_index(uintptr_t chan_base) {
+  return (chan_base - _dma_base) / CHANNEL_REGS_SIZE;
+}
+
 void set_channel_enable(uintptr_t chan_base, bool enable) {
-  const size_t chan_id = (chan_base - _dma_base) / CHANNEL_REGS_SIZE;
+  const size_t chan_id = get_channel_index(chan_base);
 
   const auto old_enable_value = libk::read32(_dma_base + ENABLE);
   const uint32_t mask = 1u << chan_id;
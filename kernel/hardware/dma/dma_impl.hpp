@@ -1,16 +1,40 @@
 #pragma once
+#include <cstddef>
 #include <cstdint>
 
 #include "memory/memory.hpp"
 
 namespace dma_impl {
 
+/** Don’t do wide writes as a 2 beat burst.
+ * This prevents the DMA from issuing wide writes as 2 beat AXI bursts.
+ * This is an inefficient access mode, so the default is to use the bursts. */
+inline static constexpr uint32_t TI_NO_WIDE_BURSTS = 1 << 26;
+
+/** Source address increments after each read. */
+inline static constexpr uint32_t TI_SRC_INC = 1 << 8;
+
+/** Destination address increments after each write. */
+inline static constexpr uint32_t TI_DEST_INC = 1 << 4;
+
+/** Wait for a Write Response. */
+inline static constexpr uint32_t TI_WAIT_RESP = 1 << 3;
+
+/** Enable 2D Mode. */
+inline static constexpr uint32_t TI_TD_MODE = 1 << 1;
+
+/** Interrupt Enable. */
+inline static constexpr uint32_t TI_INT_EN = 1 << 0;
+
 [[nodiscard]] bool init();
 
 [[nodiscard]] uintptr_t allocate_channel();
 
 void free_channel(uintptr_t chan_base);
 
+/** Gets the index (between 0 and 14) of the channel whose registers start at @a chan_base. */
+[[nodiscard]] size_t get_channel_index(uintptr_t chan_base);
+
 void set_channel_enable(uintptr_t chan_base, bool enable);
 
 [[nodiscard]] uintptr_t get_dma_bus_address(VirtualAddress va_addr, bool read_only_address);
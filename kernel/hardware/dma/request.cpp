@@ -1,29 +1,11 @@
 #include "request.hpp"
 #include <climits>
+#include "dma_impl.hpp"
 #include "libk/log.hpp"
 #include "memory/kernel_internal_memory.hpp"
 #include "memory/mem_alloc.hpp"
 
 namespace DMA {
-/** Don’t do wide writes as a 2 beat burst.
- * This prevents the DMA from issuing wide writes as 2 beat AXI bursts.
- * This is an inefficient access mode, so the default is to use the bursts. */
-inline static constexpr uint32_t TI_NO_WIDE_BURSTS = 1 << 26;
-
-/** Source address increments after each read. */
-inline static constexpr uint32_t TI_SRC_INC = 1 << 8;
-
-/** Destination address increments after each write. */
-inline static constexpr uint32_t TI_DEST_INC = 1 << 4;
-
-/** Wait for a Write Response. */
-inline static constexpr uint32_t TI_WAIT_RESP = 1 << 3;
-
-/** Enable 2D Mode. */
-inline static constexpr uint32_t TI_TD_MODE = 1 << 1;
-
-/** Interrupt Enable. */
-// inline static constexpr uint32_t TI_INT_EN = 1 << 0;
 
 struct Request::DMAStruct {
   uint32_t ti;
@@ -42,7 +24,7 @@ Request::~Request() {
 }
 
 Request::Request(Address src, Address dest, uint32_t length) : Request() {
-  dma_s->ti = TI_SRC_INC | TI_DEST_INC | TI_WAIT_RESP | TI_NO_WIDE_BURSTS;
+  dma_s->ti = dma_impl::TI_SRC_INC | dma_impl::TI_DEST_INC | dma_impl::TI_WAIT_RESP | dma_impl::TI_NO_WIDE_BURSTS;
   dma_s->src = src;
   dma_s->dst = dest;
   dma_s->length = length;
@@ -59,7 +41,8 @@ Request::Request(Address src,
                  uint16_t src_strid,
                  uint16_t dst_stride)
     : Request() {
-  dma_s->ti = TI_SRC_INC | TI_DEST_INC | TI_WAIT_RESP | TI_TD_MODE | TI_NO_WIDE_BURSTS;
+  dma_s->ti = dma_impl::TI_SRC_INC | dma_impl::TI_DEST_INC | dma_impl::TI_WAIT_RESP | dma_impl::TI_TD_MODE |
+              dma_impl::TI_NO_WIDE_BURSTS;
   dma_s->src = src;
   dma_s->dst = dest;
   dma_s->length = (y_length << 16) | x_length;
@@ -3,6 +3,7 @@
 #include <libk/assert.hpp>
 #include <libk/log.hpp>
 #include "hardware/mailbox.hpp"
+#include "hardware/timer.hpp"
 
 FrameBuffer& FrameBuffer::get() {
   static FrameBuffer framebuffer;
@@ -24,7 +25,7 @@ FrameBuffer& FrameBuffer::get() {
   return success && MailBox::check_tag_status(message.tag.status);
 }
 
-bool FrameBuffer::init(uint32_t width, uint32_t height) {
+bool FrameBuffer::init(uint32_t width, uint32_t height, graphics::PixelFormat format) {
   // Common to SetPhysicalSizeTag and SetVirtualSizeTag.
   struct SetFrameBufferSizeTagBuffer {
     uint32_t width;
@@ -65,9 +66,9 @@ bool FrameBuffer::init(uint32_t width, uint32_t height) {
     uint32_t end_tag = 0;
   };  // struct PropertyMessage
 
-  // Allocate a virtual buffer double the size in case of double buffering.
+  // Allocate a virtual buffer of several screens in case of double buffering.
 #ifdef CONFIG_USE_DOUBLE_BUFFERING
-  const uint32_t requested_virtual_height = height * 2;
+  const uint32_t requested_virtual_height = height * MAX_BUFFER_COUNT;
 #else
   const uint32_t requested_virtual_height = height;
 #endif  // CONFIG_USE_DOUBLE_BUFFERING
@@ -80,7 +81,7 @@ bool FrameBuffer::init(uint32_t width, uint32_t height) {
   message.set_virtual_size_tag.buffer.height = requested_virtual_height;
   message.set_virtual_offset_tag.buffer.x = 0;
   message.set_virtual_offset_tag.buffer.y = 0;
-  message.set_depth_tag.buffer = 32;             // 32-bits per pixel (8-bits per component)
+  message.set_depth_tag.buffer = 8 * graphics::get_bytes_per_pixel(format);  // 32 (ARGB8888) or 16 (RGB565) bits
   message.set_pixel_order_tag.buffer = 0;        // BGR (so we have 0xRRGGBB, yep, this seems inverted but is not)
   message.allocate_tag.buffer.alignment = 4096;  // Which value to choose?
   message.get_pitch_tag.buffer = 0;
@@ -89,21 +90,41 @@ bool FrameBuffer::init(uint32_t width, uint32_t height) {
     return false;
 
   // Read back the responses. The GPU may have changed some requested parameters.
+  switch (message.set_depth_tag.buffer) {
+    case 32:
+      m_format = graphics::PixelFormat::ARGB8888;
+      break;
+    case 16:
+      m_format = graphics::PixelFormat::RGB565;
+      break;
+    default:
+      LOG_ERROR("Unsupported framebuffer depth: {}", message.set_depth_tag.buffer);
+      return false;
+  }
+
+  if (m_format != format)
+    LOG_WARNING("Framebuffer pixel format not supported, falling back to {} bits per pixel",
+                message.set_depth_tag.buffer);
+
   m_width = message.set_virtual_size_tag.buffer.width;
+  m_height = message.set_physical_size_tag.buffer.height;
 #ifdef CONFIG_USE_DOUBLE_BUFFERING
-  m_height = message.set_virtual_size_tag.buffer.height / 2;
-#else
-  m_height = message.set_virtual_size_tag.buffer.height;
+  // The GPU may give less buffers than requested, fallback to double (or single) buffering.
+  m_buffer_count = libk::clamp<uint32_t>(message.set_virtual_size_tag.buffer.height / m_height, 1, MAX_BUFFER_COUNT);
+  if (m_buffer_count == 1)
+    LOG_WARNING("Double buffering not supported by the framebuffer");
 #endif  // CONFIG_USE_DOUBLE_BUFFERING
-  m_pitch = message.get_pitch_tag.buffer / sizeof(m_buffer[0]);
-  m_buffer_size = message.allocate_tag.buffer.response.size / sizeof(uint32_t);
+  m_pitch = message.get_pitch_tag.buffer / graphics::get_bytes_per_pixel(m_format);
+  m_buffer_size = message.allocate_tag.buffer.response.size;
 
   uint64_t buffer_address = message.allocate_tag.buffer.response.base_address;
   buffer_address &= 0x3FFFFFFF;  // convert GPU address to ARM address
   buffer_address = KernelMemory::get_virtual_vc_address(buffer_address);
-  m_buffer = (uint32_t*)buffer_address;
+  m_buffer = (uint8_t*)buffer_address;
+  m_buffers = m_buffer;
 
-  LOG_INFO("Framebuffer of size {}x{} allocated (requested {}x{})", m_width, m_height, width, height);
+  LOG_INFO("Framebuffer of size {}x{} allocated (requested {}x{}, {} buffers)", m_width, m_height, width, height,
+           m_buffer_count);
 
   // Dump some debugging information in case of something is not working as intended.
   LOG_DEBUG("Framebuffer at {:#x} of size {} bytes (pitch = {})", m_buffer, message.allocate_tag.buffer.response.size,
@@ -113,54 +134,141 @@ bool FrameBuffer::init(uint32_t width, uint32_t height) {
 
   // Initially clear the framebuffer with black color. In case the VideoCore gives us
   // an uninitialized framebuffer.
-  // This is called before double buffering initialization, so both the front and back
-  // buffers are cleared.
+  // This is called before double buffering initialization, so all the buffers are cleared.
   clear(0x00000000);
 
-#ifdef CONFIG_USE_DOUBLE_BUFFERING
-  // Display the screen 0.
-  m_is_screen0 = true;
-  set_virtual_offset(0, 0);
-  // Switch to screen 1 (the back buffer)
-  m_buffer_size = m_height * m_pitch;
-  m_buffer += m_buffer_size;
-#endif  // CONFIG_USE_DOUBLE_BUFFERING
+  // Display the buffer 0, and render into the buffer 1 (if any).
+  m_buffer_size = m_height * m_pitch * graphics::get_bytes_per_pixel(m_format);
+  m_front_index = 0;
+  m_previous_front_index = 0;
+  if (m_buffer_count > 1) {
+    set_virtual_offset(0, 0);
+    m_buffer = (uint8_t*)get_buffer(1);
+  }
 
   m_initialized = true;
   return true;
 }
 
+PhysicalAddress FrameBuffer::get_buffer_physical_address() const {
+  return KernelMemory::get_physical_vc_address((VirtualAddress)m_buffer);
+}
+
+PhysicalAddress FrameBuffer::get_front_buffer_physical_address() const {
+  return KernelMemory::get_physical_vc_address((VirtualAddress)(m_buffers + m_buffer_size * m_front_index));
+}
+
+int32_t FrameBuffer::get_back_buffer_index() const {
+  if (m_buffer_count == 1)
+    return 0;
+
+  const bool flip_pending = is_flip_pending();
+  for (uint32_t i = 0; i < m_buffer_count; ++i) {
+    if (i == m_front_index || (flip_pending && i == m_previous_front_index))
+      continue;
+
+    // Prefer the buffer displayed just before (the most up to date one), unless
+    // it may still be scanned out.
+    if (!flip_pending && m_previous_front_index != m_front_index)
+      return m_previous_front_index;
+
+    return i;
+  }
+
+  return -1;
+}
+
+bool FrameBuffer::flip(uint32_t index) {
+  KASSERT(index < m_buffer_count);
+
+  if (index == m_front_index)
+    return true;
+
+  if (!set_virtual_offset(0, m_height * index))
+    return false;
+
+  m_previous_front_index = m_front_index;
+  m_front_index = index;
+  m_flip_time = GenericTimer::get_elapsed_time_in_micros();
+  ++m_flip_count;
+  return true;
+}
+
+bool FrameBuffer::is_flip_pending() const {
+  if (m_front_index == m_previous_front_index || m_vsync_flip_count == m_flip_count)
+    return false;
+
+  return m_has_vsync || GenericTimer::get_elapsed_time_in_micros() < m_flip_time + FLIP_LATENCY_US;
+}
+
+bool FrameBuffer::wait_for_vsync() {
+  if (!m_has_vsync)
+    return false;
+
+  using SetVSyncTag = MailBox::PropertyTag<0x0004800e, uint32_t>;
+
+  // Only the flips done before the request are known to be effective once it returns (flip() may
+  // be called by an interrupt handler meanwhile).
+  const uint32_t flip_count = m_flip_count;
+
+  MailBox::PropertyMessage<SetVSyncTag> message = {};
+  message.tag.buffer = 0;
+  const bool success = MailBox::send_property(message);
+  if (!success || !MailBox::check_tag_status(message.tag.status)) {
+    LOG_WARNING("Vertical sync not supported by the framebuffer, flips may tear");
+    m_has_vsync = false;
+    return false;
+  }
+
+  m_vsync_flip_count = flip_count;
+  return true;
+}
+
 void FrameBuffer::clear(uint32_t color) {
+  using namespace graphics;
+
   // Clear the current framebuffer.
-  for (uint32_t i = 0; i < m_buffer_size; ++i) {
-    m_buffer[i] = color;
+  if (m_format == PixelFormat::RGB565) {
+    auto* pixels = (PixelTraits<PixelFormat::RGB565>::Pixel*)m_buffer;
+    for (uint32_t i = 0; i < m_buffer_size / sizeof(pixels[0]); ++i) {
+      pixels[i] = PixelTraits<PixelFormat::RGB565>::from_argb(color);
+    }
+  } else {
+    fill_span((uint32_t*)m_buffer, m_buffer_size / sizeof(uint32_t), color);
   }
 }
 
 uint32_t FrameBuffer::get_pixel(uint32_t x, uint32_t y) const {
+  using namespace graphics;
+
   KASSERT(x < m_width && y < m_height);
-  return m_buffer[x + m_pitch * y];
+  const size_t index = x + m_pitch * y;
+  if (m_format == PixelFormat::RGB565)
+    return PixelTraits<PixelFormat::RGB565>::to_argb(((const uint16_t*)m_buffer)[index]);
+  return ((const uint32_t*)m_buffer)[index];
 }
 
 void FrameBuffer::set_pixel(uint32_t x, uint32_t y, uint32_t color) {
+  using namespace graphics;
+
   KASSERT(x < m_width && y < m_height);
-  m_buffer[x + m_pitch * y] = color;
+  const size_t index = x + m_pitch * y;
+  if (m_format == PixelFormat::RGB565)
+    ((uint16_t*)m_buffer)[index] = PixelTraits<PixelFormat::RGB565>::from_argb(color);
+  else
+    ((uint32_t*)m_buffer)[index] = color;
 }
 
 void FrameBuffer::present() {
-#ifdef CONFIG_USE_DOUBLE_BUFFERING
-  if (m_is_screen0) {
-    // We are displaying screen0, switch to screen1.
-    set_virtual_offset(0, m_height);
-    // Swap back buffer <-> front buffer.
-    m_buffer -= m_buffer_size;
-  } else {
-    set_virtual_offset(0, 0);
-    m_buffer += m_buffer_size;
-  }
+  if (m_buffer_count == 1)
+    return;
 
-  m_is_screen0 = !m_is_screen0;
-#endif  // CONFIG_USE_DOUBLE_BUFFERING
+  // Swap back buffer <-> front buffer.
+  const uint32_t back_index = (m_buffer - m_buffers) / m_buffer_size;
+  if (!flip(back_index))
+    return;
+
+  m_buffer = (uint8_t*)get_buffer(m_previous_front_index);
 }
 
 bool FrameBuffer::set_virtual_offset(uint32_t x, uint32_t y) {
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <cstdint>
+#include "graphics/pixel_format.hpp"
+#include "memory/memory.hpp"
 
 /**
  * There can only be one framebuffer at any time that can be accessed using get().
@@ -15,6 +17,16 @@
  * Once you have rendered a full frame, you should call:
  * - present(): presents the current framebuffer to the screen
  *
+ * The colors given to these functions are in 0xAARRGGBB format, whatever the pixel format of the
+ * framebuffer (see get_pixel_format()). The pixels of get_buffer() are stored in that format:
+ * 32-bit ARGB8888 by default, or 16-bit RGB565 when requested to init() (halving the memory traffic
+ * of the compositor).
+ *
+ * With CONFIG_USE_DOUBLE_BUFFERING, the framebuffer is made of several buffers (up to
+ * MAX_BUFFER_COUNT, stacked vertically in the virtual framebuffer) and one of them is
+ * displayed at a time. Instead of present(), callers may pick the buffer to render into
+ * with get_back_buffer_index() and display it with flip().
+ *
  * Example:
  * ```c++
  * FrameBuffer& fb = FrameBuffer::get();
@@ -36,15 +48,24 @@
  */
 class FrameBuffer {
  public:
+  /** Maximal number of buffers (triple buffering). */
+  static constexpr uint32_t MAX_BUFFER_COUNT = 3;
+  /** Without the firmware vertical sync (see wait_for_vsync()), time after a flip during which the
+   * previously displayed buffer is assumed to be still scanned out. It is shorter than a 60 Hz frame
+   * so a 60 fps compositor is not throttled, so tearing is possible in that case. */
+  static constexpr uint64_t FLIP_LATENCY_US = 1000000 / 75;
+
   /** @brief Returns the framebuffer instance. It should be initialized first. */
   static FrameBuffer& get();
 
   /** Checks if the framebuffer is correctly initialized (init() called and returned true). */
   [[nodiscard]] bool is_initialized() const { return m_initialized; }
-  /** @brief Initializes a framebuffer of the given size. */
-  bool init(uint32_t width, uint32_t height);
+  /** @brief Initializes a framebuffer of the given size and pixel format.
+   *
+   * If the GPU does not support @a format, the framebuffer falls back to the format it gives. */
+  bool init(uint32_t width, uint32_t height, graphics::PixelFormat format = graphics::PixelFormat::ARGB8888);
 
-  /** @brief Converts a color to 0xAARRGGBB format suitable to be directly written to the buffer. */
+  /** @brief Converts a color to 0xAARRGGBB format (see get_pixel_format() to write it directly to the buffer). */
   [[gnu::always_inline, nodiscard]] constexpr static uint32_t from_rgb(uint8_t r,
                                                                        uint8_t g,
                                                                        uint8_t b,
@@ -73,8 +94,36 @@ class FrameBuffer {
   void present();
 
   /** @brief Gets the internal framebuffer buffer. */
-  [[nodiscard]] uint32_t* get_buffer() { return m_buffer; }
-  [[nodiscard]] const uint32_t* get_buffer() const { return m_buffer; }
+  [[nodiscard]] void* get_buffer() { return m_buffer; }
+  [[nodiscard]] const void* get_buffer() const { return m_buffer; }
+  /** @brief Gets the physical address of the internal framebuffer buffer (as returned by get_buffer()). */
+  [[nodiscard]] PhysicalAddress get_buffer_physical_address() const;
+
+  /** @brief Gets the number of buffers (1 without double buffering, 2 or 3 otherwise). */
+  [[nodiscard]] uint32_t get_buffer_count() const { return m_buffer_count; }
+  /** @brief Gets the buffer @a index (between 0 and get_buffer_count() - 1). */
+  [[nodiscard]] void* get_buffer(uint32_t index) { return m_buffers + m_buffer_size * index; }
+  /** @brief Gets the index of the buffer currently displayed. */
+  [[nodiscard]] uint32_t get_front_buffer_index() const { return m_front_index; }
+  /** @brief Gets the physical address of the buffer currently displayed. */
+  [[nodiscard]] PhysicalAddress get_front_buffer_physical_address() const;
+
+  /** @brief Gets a buffer that can be rendered into without tearing: it is neither displayed nor
+   * possibly still scanned out because of a pending flip (see is_flip_pending()).
+   *
+   * When a flip is pending, the third buffer (if any) is used. Returns -1 if there is no such buffer
+   * for now. Without double buffering, the only buffer (the displayed one) is returned. */
+  [[nodiscard]] int32_t get_back_buffer_index() const;
+  /** @brief Displays the buffer @a index (at the next vertical sync). */
+  bool flip(uint32_t index);
+  /** @brief Checks if the last flip may not be effective yet.
+   *
+   * A flip is effective at the next vertical sync, known by wait_for_vsync(). If the firmware does
+   * not support it, the flip is assumed effective after FLIP_LATENCY_US. */
+  [[nodiscard]] bool is_flip_pending() const;
+  /** @brief Waits (busy, in the firmware) for the next vertical sync, so the flips done until now are
+   * effective. Returns false if the firmware does not support it. */
+  bool wait_for_vsync();
 
   /** @brief Gets the framebuffer width, in pixels. */
   [[nodiscard]] uint32_t get_width() const { return m_width; }
@@ -83,7 +132,9 @@ class FrameBuffer {
   /** @brief Gets the framebuffer pitch, in pixels. */
   [[nodiscard]] uint32_t get_pitch() const { return m_pitch; }
   /** @brief Gets the framebuffer size, in bytes. */
-  [[nodiscard]] uint32_t get_byte_size() const { return m_buffer_size * sizeof(uint32_t); }
+  [[nodiscard]] uint32_t get_byte_size() const { return m_buffer_size; }
+  /** @brief Gets the format of the pixels of the buffers. */
+  [[nodiscard]] graphics::PixelFormat get_pixel_format() const { return m_format; }
 
  private:
   // Private constructor so there can be only once instance of Framebuffer
@@ -93,14 +144,19 @@ class FrameBuffer {
   /** @brief Sends a SET_VIRTUAL_OFFSET request to VideoCore. */
   bool set_virtual_offset(uint32_t x, uint32_t y);
 
-  uint32_t* m_buffer = nullptr;
-  uint32_t m_buffer_size = 0;  // in count of uint32_t, the size of either front or back buffer
+  uint8_t* m_buffer = nullptr;   // the back buffer used by present()
+  uint8_t* m_buffers = nullptr;  // the first buffer, the others follow it
+  uint32_t m_buffer_size = 0;  // in bytes, the size of either front or back buffer
   uint32_t m_width = 0;        // in pixels
   uint32_t m_height = 0;       // in pixels
   uint32_t m_pitch = 0;        // length of a row, in pixels (this may be greater than the frame width)
-#ifdef CONFIG_USE_DOUBLE_BUFFERING
-  // display screen when using double buffering
-  bool m_is_screen0 = true;
-#endif  // CONFIG_USE_DOUBLE_BUFFERING
+  graphics::PixelFormat m_format = graphics::PixelFormat::ARGB8888;
+  uint32_t m_buffer_count = 1;
+  uint32_t m_front_index = 0;           // the displayed buffer
+  uint32_t m_previous_front_index = 0;  // the buffer displayed before the last flip
+  uint64_t m_flip_time = 0;             // time of the last flip, in microseconds
+  uint32_t m_flip_count = 0;            // number of flips done
+  uint32_t m_vsync_flip_count = 0;      // number of flips known to be effective (see wait_for_vsync())
+  bool m_has_vsync = true;              // does the firmware support wait_for_vsync()?
   bool m_initialized = false;
 };  // class FrameBuffer
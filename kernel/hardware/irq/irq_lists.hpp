@@ -38,6 +38,12 @@ static inline constexpr IRQ VC_TIMER_BASE = {.type = IRQ::Type::VideoCore, .id =
 // Timer 2: 2
 // Timer 3: 3
 
+/** Base for DMA IRQ id. */
+static inline constexpr IRQ VC_DMA_BASE = {.type = IRQ::Type::VideoCore, .id = 16};
+// DMA channel 0: 16
+// ...
+// DMA channel 10: 26
+
 /** AUX IRQ id. */
 static inline constexpr IRQ VC_AUX = {.type = IRQ::Type::VideoCore, .id = 29};
 
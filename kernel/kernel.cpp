@@ -8,6 +8,8 @@
 #include "hardware/uart_keyboard.hpp"
 
 #include "fs/filesystem.hpp"
+#include "graphics/benchmark.hpp"
+#include "graphics/system_font.hpp"
 
 #include "sys/syscall.h"
 #include "task/task_manager.hpp"
@@ -54,11 +56,24 @@
 
   FileSystem::get().init();
 
+  // Before any painter is created (they use the default font).
+  graphics::load_default_font("/fonts/firacode.pkf", 16);
+
+#ifdef CONFIG_SCREEN_RGB565
+  constexpr auto screen_format = graphics::PixelFormat::RGB565;
+#else
+  constexpr auto screen_format = graphics::PixelFormat::ARGB8888;
+#endif  // CONFIG_SCREEN_RGB565
+
   FrameBuffer& framebuffer = FrameBuffer::get();
-  if (!framebuffer.init(1280, 720)) {
+  if (!framebuffer.init(1280, 720, screen_format)) {
     LOG_WARNING("failed to initialize framebuffer");
   }
 
+#ifdef CONFIG_GRAPHICS_BENCHMARK
+  graphics::run_benchmark();
+#endif  // CONFIG_GRAPHICS_BENCHMARK
+
   WindowManager* window_manager = new WindowManager;
   KASSERT(window_manager != nullptr);
 
@@ -71,6 +86,9 @@
   TaskManager* task_manager = new TaskManager;
   KASSERT(task_manager != nullptr);
 
+  // Redraw the screen from now on.
+  window_manager->start_compositor();
+
   // Run the init program.
   load_init();
 }
@@ -17,13 +17,7 @@ Buffer::Buffer(uint32_t byte_size) {
 }
 
 Buffer::~Buffer() {
-  // Free all mapping in processes
-  for (const auto proc : _proc) {
-    proc.proc->unmap_memory(proc.buffer_start);  // <- proc will be removed from the list by the unregister call
-  }
-
-  KASSERT(_proc.is_empty());
-
+  unmap_from_processes();
   memory_impl::unmap_buffer(kernel_va, kernel_va + buffer_pa_end - buffer_pa_start);
   memory_impl::free_buffer_pa(buffer_pa_start, buffer_pa_end);
 }
@@ -40,6 +34,14 @@ DMA::Address Buffer::get_dma_address() {
   return DMA::get_dma_bus_address(kernel_va, false);
 }
 
+void Buffer::unmap_from_processes() {
+  for (const auto proc : _proc) {
+    proc.proc->unmap_memory(proc.buffer_start);  // <- proc will be removed from the list by the unregister call
+  }
+
+  KASSERT(_proc.is_empty());
+}
+
 VirtualPA Buffer::end_address(VirtualPA start_address) {
   return start_address + get_byte_size() - PAGE_SIZE;
 }
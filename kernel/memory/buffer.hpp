@@ -26,6 +26,9 @@ class Buffer {
   /** Returns the DMA Address of this buffer. */
   [[nodiscard]] DMA::Address get_dma_address();
 
+  /** Removes this buffer from the memory of all the processes where it is mapped. */
+  void unmap_from_processes();
+
  private:
 //  const size_t nb_pages;
   PhysicalPA buffer_pa_start;
@@ -9,7 +9,7 @@ uint64_t ContiguousPageAllocator::memory_needed(size_t nb_pages) {
 }
 
 ContiguousPageAllocator::ContiguousPageAllocator(size_t nb_pages, uintptr_t array)
-    : _nb_pages(nb_pages), _free_page(array, memory_needed(nb_pages)), _page_cursor(0) {
+    : _nb_pages(nb_pages), _free_page(array, memory_needed(nb_pages)), _page_cursor(0), _nb_used_pages(0) {
   _free_page.fill_array(true);
 }
 
@@ -72,6 +72,8 @@ void ContiguousPageAllocator::mark_as_used(PhysicalPA start, PhysicalPA end) {
   //  LOG_DEBUG("Marking as Used {:#x} -> {:#x}", start, end);
 
   for (size_t page_i = page_index(start); page_i <= page_index(end); ++page_i) {
+    if (_free_page[page_i])
+      _nb_used_pages++;
     _free_page.set_bit(page_i, false);
   }
 }
@@ -93,6 +95,8 @@ void ContiguousPageAllocator::free_pages(PhysicalPA start, PhysicalPA end) {
   //  LOG_DEBUG("Marking as Free {:#x} -> {:#x}", start, end);
 
   for (size_t page_i = page_index(start); page_i <= page_index(end); ++page_i) {
+    if (!_free_page[page_i])
+      _nb_used_pages--;
     _free_page.set_bit(page_i, true);
   }
 }
@@ -25,6 +25,11 @@ class ContiguousPageAllocator {
    *            - `false` otherwise */
   bool page_status(PhysicalPA addr) const;
 
+  /** Returns the number of pages managed by this allocator. */
+  size_t get_nb_pages() const { return _nb_pages; }
+  /** Returns the number of pages currently allocated. */
+  size_t get_nb_used_pages() const { return _nb_used_pages; }
+
   /** @brief Returns the memory needed by this construction to manage
    * @a nb_pages pages in *bytes* */
   static uint64_t memory_needed(size_t nb_pages);
@@ -36,4 +41,5 @@ class ContiguousPageAllocator {
   uint64_t _nb_pages;
   libk::BitArray _free_page;
   PhysicalPA _page_cursor;
+  size_t _nb_used_pages;
 };
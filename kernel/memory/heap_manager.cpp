@@ -95,6 +95,10 @@ size_t HeapManager::get_heap_byte_size() const {
   return _heap_byte_size;
 }
 
+size_t HeapManager::get_nb_pages() const {
+  return (_heap_va_end - _heap_start) / PAGE_SIZE;
+}
+
 void HeapManager::free() {
   while (_heap_byte_size > 0) {
     const VirtualPA va_to_del = get_heap_end() - PAGE_SIZE;
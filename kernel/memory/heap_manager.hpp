@@ -21,6 +21,9 @@ class HeapManager {
 
   size_t get_heap_byte_size() const;
 
+  /** Returns the number of physical pages currently backing the heap. */
+  size_t get_nb_pages() const;
+
   void free();
 
  private:
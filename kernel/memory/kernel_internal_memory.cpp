@@ -32,6 +32,8 @@ static PhysicalPA _contiguous_stop = 0;
 
 static MMUTable _tbl;
 
+static size_t _nb_table_pages = 0;
+
 static VirtualPA _custom_pages = CUSTOM_PAGES_MEMORY;
 static VirtualPA _buffer_pages = BUFFER_MEMORY;
 
@@ -43,7 +45,8 @@ PhysicalPA mmu_resolve_va(void*, VirtualPA page_address) {
   return page_address - KERNEL_BASE;
 }
 
-VirtualPA mmu_alloc_page(void*) {
+// For process tables, the handle points to a counter of the pages used by the table.
+VirtualPA mmu_alloc_page(void* handle) {
   PhysicalPA addr = -1;
 
   if (!_page_alloc.fresh_page(&addr)) {
@@ -53,13 +56,21 @@ VirtualPA mmu_alloc_page(void*) {
   const VirtualPA va = mmu_resolve_pa(nullptr, addr);
   zero_pages(va, 1);
 
+  _nb_table_pages++;
+  if (handle != nullptr)
+    (*(size_t*)handle)++;
+
   return va;
 }
 
-void mmu_free_page(void*, VirtualPA page_address) {
+void mmu_free_page(void* handle, VirtualPA page_address) {
   const PhysicalPA addr = mmu_resolve_va(nullptr, page_address);
 
   _page_alloc.free_page(addr);
+
+  _nb_table_pages--;
+  if (handle != nullptr)
+    (*(size_t*)handle)--;
 }
 
 void mark_as_used_range(PhysicalPA start, PhysicalPA end) {
@@ -165,14 +176,22 @@ MMUTable* memory_impl::get_kernel_tbl() {
   return &_tbl;
 }
 
-MMUTable memory_impl::new_process_tbl(uint8_t asid) {
-  const VirtualPA process_pgd = mmu_alloc_page(nullptr);
+ContiguousPageAllocator* memory_impl::get_contiguous_alloc() {
+  return &_contiguous_alloc;
+}
+
+size_t memory_impl::get_nb_table_pages() {
+  return _nb_table_pages;
+}
+
+MMUTable memory_impl::new_process_tbl(uint8_t asid, size_t* nb_table_pages) {
+  const VirtualPA process_pgd = mmu_alloc_page(nb_table_pages);
 
   return {
       .kind = MMUTable::Kind::Process,
       .pgd = process_pgd,
       .asid = asid,
-      .handle = nullptr,
+      .handle = nb_table_pages,
       .alloc = &mmu_alloc_page,
       .free = &mmu_free_page,
       .resolve_pa = &mmu_resolve_pa,
@@ -186,28 +205,42 @@ PhysicalPA memory_impl::resolve_table_pgd(const MMUTable& tbl) {
 
 void memory_impl::delete_process_tbl(MMUTable& tbl) {
   clear_all(&tbl);
-  mmu_free_page(nullptr, tbl.pgd);
+  mmu_free_page(tbl.handle, tbl.pgd);
   tbl.pgd = 0;
 }
 
-VirtualPA memory_impl::allocate_pages_section(const size_t nb_pages, PhysicalPA* pages_ptr) {
-  const VirtualPA section_start = _custom_pages;
-
+bool memory_impl::allocate_pages_at(VirtualPA va, size_t nb_pages, PhysicalPA* pages_ptr) {
   for (size_t page_id = 0; page_id < nb_pages; ++page_id) {
+    const VirtualPA page_va = va + page_id * PAGE_SIZE;
+
     if (!_page_alloc.fresh_page(&(pages_ptr[page_id]))) {
-      return 0;
+      if (page_id > 0)
+        free_section(page_id, va, pages_ptr);
+      return false;
     }
 
-    if (!map_range(&_tbl, _custom_pages, _custom_pages, pages_ptr[page_id], custom_memory_rw)) {
-      return 0;
+    if (!map_range(&_tbl, page_va, page_va, pages_ptr[page_id], custom_memory_rw)) {
+      _page_alloc.free_page(pages_ptr[page_id]);
+      if (page_id > 0)
+        free_section(page_id, va, pages_ptr);
+      return false;
     }
 
-    zero_pages(_custom_pages, 1);
-    _custom_pages += PAGE_SIZE;
+    zero_pages(page_va, 1);
+  }
+
+  return true;
+}
+
+VirtualPA memory_impl::allocate_pages_section(const size_t nb_pages, PhysicalPA* pages_ptr) {
+  const VirtualPA section_start = _custom_pages;
+
+  if (!allocate_pages_at(section_start, nb_pages, pages_ptr)) {
+    return 0;
   }
 
   // Create a gap between each custom segment.
-  _custom_pages += PAGE_SIZE;
+  _custom_pages += (nb_pages + 1) * PAGE_SIZE;
 
   return section_start;
 }
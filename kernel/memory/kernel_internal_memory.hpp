@@ -1,5 +1,6 @@
 #pragma once
 
+#include "contiguous_page_alloc.hpp"
 #include "page_alloc_list.hpp"
 
 namespace memory_impl {
@@ -8,12 +9,19 @@ namespace memory_impl {
 
 PageAllocList* get_kernel_alloc();
 MMUTable* get_kernel_tbl();
+ContiguousPageAllocator* get_contiguous_alloc();
 
-MMUTable new_process_tbl(uint8_t asid);
+/** Returns the number of pages used by all MMU tables (kernel and processes). */
+size_t get_nb_table_pages();
+
+/** Creates a new process table, @a nb_table_pages (if not null) is kept up to date
+ * with the number of pages used by the table. */
+MMUTable new_process_tbl(uint8_t asid, size_t* nb_table_pages = nullptr);
 void delete_process_tbl(MMUTable& tbl);
 PhysicalPA resolve_table_pgd(const MMUTable& tbl);
 
 VirtualPA allocate_pages_section(size_t nb_pages, PhysicalPA* pages_ptr);
+bool allocate_pages_at(VirtualPA va, size_t nb_pages, PhysicalPA* pages_ptr);
 void free_section(size_t nb_pages, VirtualPA kernel_va, PhysicalPA* pages_ptr);
 
 bool allocate_buffer_pa(size_t nb_pages, PhysicalPA* buffer_start, PhysicalPA* buffer_end);
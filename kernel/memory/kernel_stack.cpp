@@ -0,0 +1,130 @@
+#include "kernel_stack.hpp"
+
+#include <algorithm>
+#include <libk/linked_list.hpp>
+#include <libk/log.hpp>
+#include <libk/utils.hpp>
+
+#include "boot/mmu_utils.hpp"
+#include "memory/kernel_internal_memory.hpp"
+
+/** Number of pages of virtual memory reserved for each stack (mapped pages and guard pages). */
+static constexpr size_t SLOT_NB_PAGES = KernelStack::MAX_NB_PAGES + 1;
+/** Pattern written on the whole stack when it is handed out, used to compute the high-water mark. */
+static constexpr uint64_t FILL_PATTERN = 0x4b53544b4b53544bull;
+
+struct KernelStack::Slot {
+  size_t index;
+  size_t nb_pages;
+  PhysicalPA pages[MAX_NB_PAGES];
+
+  [[nodiscard]] VirtualPA get_bottom() const {
+    return TASK_STACK_MEMORY + (index * SLOT_NB_PAGES + (SLOT_NB_PAGES - nb_pages)) * PAGE_SIZE;
+  }
+
+  [[nodiscard]] VirtualPA get_top() const { return TASK_STACK_MEMORY + (index + 1) * SLOT_NB_PAGES * PAGE_SIZE; }
+};
+
+static libk::LinkedList<KernelStack::Slot*> _cached_slots;  // released slots still mapped
+static libk::LinkedList<size_t> _free_indexes;              // slots indexes not mapped anymore
+static size_t _nb_cached = 0;
+static size_t _next_index = 0;
+static size_t _nb_used = 0;
+static size_t _max_high_water_mark = 0;
+
+static void fill_stack(VirtualPA bottom, VirtualPA top) {
+  for (auto* it = (uint64_t*)bottom; it != (uint64_t*)top; ++it) {
+    *it = FILL_PATTERN;
+  }
+}
+
+KernelStack::KernelStack(size_t nb_pages) {
+  KASSERT(nb_pages > 0 && nb_pages <= MAX_NB_PAGES);
+
+  // Reuse a cached stack of the same size if possible.
+  auto it = std::find_if(_cached_slots.begin(), _cached_slots.end(),
+                         [nb_pages](const Slot* slot) { return slot->nb_pages == nb_pages; });
+  if (it != _cached_slots.end()) {
+    _slot = *it;
+    _cached_slots.erase(it);
+    _nb_cached--;
+  } else {
+    auto* slot = new Slot;
+    if (slot == nullptr) {
+      LOG_ERROR("[KernelStack] Failed to allocate a stack slot.");
+      return;
+    }
+
+    slot->index = _free_indexes.is_empty() ? _next_index++ : _free_indexes.pop_front();
+    slot->nb_pages = nb_pages;
+
+    if (!memory_impl::allocate_pages_at(slot->get_bottom(), nb_pages, slot->pages)) {
+      LOG_ERROR("[KernelStack] Failed to allocate {} pages.", nb_pages);
+      _free_indexes.push_back(slot->index);
+      delete slot;
+      return;
+    }
+
+    _slot = slot;
+  }
+
+  fill_stack(_slot->get_bottom(), _slot->get_top());
+  _nb_used++;
+}
+
+KernelStack::~KernelStack() {
+  if (_slot == nullptr)
+    return;
+
+  _max_high_water_mark = libk::max(_max_high_water_mark, get_high_water_mark());
+  _nb_used--;
+
+  if (_nb_cached < MAX_CACHED_STACKS) {
+    _cached_slots.push_back(_slot);
+    _nb_cached++;
+  } else {
+    memory_impl::free_section(_slot->nb_pages, _slot->get_bottom(), _slot->pages);
+    _free_indexes.push_back(_slot->index);
+    delete _slot;
+  }
+
+  _slot = nullptr;
+}
+
+VirtualAddress KernelStack::get_bottom() const {
+  KASSERT(_slot != nullptr);
+  return _slot->get_bottom();
+}
+
+VirtualAddress KernelStack::get_top() const {
+  KASSERT(_slot != nullptr);
+  return _slot->get_top();
+}
+
+size_t KernelStack::get_byte_size() const {
+  KASSERT(_slot != nullptr);
+  return _slot->nb_pages * PAGE_SIZE;
+}
+
+size_t KernelStack::get_high_water_mark() const {
+  KASSERT(_slot != nullptr);
+
+  // The stack grows downward, so the deepest used word is the first one (starting from the bottom)
+  // that does not hold the fill pattern anymore.
+  const auto* bottom = (const uint64_t*)_slot->get_bottom();
+  const auto* top = (const uint64_t*)_slot->get_top();
+  const auto* it = bottom;
+  while (it != top && *it == FILL_PATTERN) {
+    ++it;
+  }
+
+  return (top - it) * sizeof(uint64_t);
+}
+
+KernelStack::Stats KernelStack::get_stats() {
+  return {
+      .nb_used = _nb_used,
+      .nb_cached = _nb_cached,
+      .max_high_water_mark = _max_high_water_mark,
+  };
+}
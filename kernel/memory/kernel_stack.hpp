@@ -0,0 +1,60 @@
+#pragma once
+
+#include "memory/memory.hpp"
+
+#include <cstddef>
+
+/** A stack for a kernel task.
+ *
+ * Each stack lives in its own fixed-size slot of the TASK_STACK_MEMORY region. The lowest pages
+ * of a slot are never mapped and act as a guard: overflowing the stack triggers a translation fault
+ * instead of silently corrupting the neighbour memory.
+ *
+ * Released stacks are kept mapped in a small cache so that creating a new kernel task does not
+ * need to go through the page allocator and the MMU again. */
+class KernelStack {
+ public:
+  /** Number of pages used by default by a kernel task stack. */
+  static constexpr size_t DEFAULT_NB_PAGES = 4;
+  /** Maximal number of pages of a kernel task stack (the slot also contains at least one guard page). */
+  static constexpr size_t MAX_NB_PAGES = 15;
+  /** Maximal number of released stacks kept mapped for reuse. */
+  static constexpr size_t MAX_CACHED_STACKS = 8;
+
+  /** Creates a kernel stack of @a nb_pages pages. */
+  explicit KernelStack(size_t nb_pages = DEFAULT_NB_PAGES);
+  KernelStack(const KernelStack&) = delete;
+  KernelStack& operator=(const KernelStack&) = delete;
+
+  /** Releases the stack (either in the cache or back to the page allocator). */
+  ~KernelStack();
+
+  /** Checks if the stack has been allocated. YOU MUST DO IT. */
+  [[nodiscard]] bool is_status_okay() const { return _slot != nullptr; }
+
+  /** Returns the lowest usable address of the stack. */
+  [[nodiscard]] VirtualAddress get_bottom() const;
+  /** Returns the initial stack pointer (the stack grows downward). */
+  [[nodiscard]] VirtualAddress get_top() const;
+  /** Returns the number of usable bytes of the stack. */
+  [[nodiscard]] size_t get_byte_size() const;
+
+  /** Returns the maximal number of bytes that were ever used by this stack.
+   * This is computed by looking for the deepest word that no longer holds the fill pattern. */
+  [[nodiscard]] size_t get_high_water_mark() const;
+
+  struct Stats {
+    size_t nb_used;    //<! Number of stacks currently owned by a task.
+    size_t nb_cached;  //<! Number of released stacks kept mapped for reuse.
+    size_t max_high_water_mark;  //<! Deepest usage (in bytes) observed on a released stack.
+  };
+
+  /** Returns global statistics on kernel stacks. */
+  [[nodiscard]] static Stats get_stats();
+
+  /** Bookkeeping of a stack slot, defined in kernel_stack.cpp. */
+  struct Slot;
+
+ private:
+  Slot* _slot = nullptr;
+};  // class KernelStack
@@ -3,21 +3,34 @@
 
 #include <libk/utils.hpp>
 
+static size_t g_malloc_nb_allocations = 0;
+static size_t g_malloc_used_bytes = 0;
+
 #ifdef CONFIG_USE_NAIVE_MALLOC
 void* kmalloc(size_t byte_count, size_t alignment) {
-  if (alignment == 0)
-    alignment++;
+  // The size of the allocation is stored just before it, for kfree().
+  alignment = libk::max(alignment, alignof(size_t));
 
   if (byte_count == 0)
     byte_count++;  // ensure that we have a unique pointer address even when allocating 0 bytes
 
   uintptr_t ptr = KernelMemory::get_heap_end();
-  KernelMemory::change_heap_end(byte_count + alignment);
-  return (void*)libk::align_to_next(ptr, alignment);
+  KernelMemory::change_heap_end(sizeof(size_t) + byte_count + alignment);
+  g_malloc_nb_allocations++;
+  g_malloc_used_bytes += byte_count;
+
+  auto* data = (size_t*)libk::align_to_next(ptr + sizeof(size_t), alignment);
+  data[-1] = byte_count;
+  return data;
 }
 
 void kfree(void* ptr) {
-  (void)ptr;
+  if (ptr == nullptr)
+    return;
+
+  // The memory is never reused, only the statistics are updated.
+  g_malloc_nb_allocations--;
+  g_malloc_used_bytes -= ((size_t*)ptr)[-1];
 }
 #else
 using MetaPtr = struct MetaBlock*;
@@ -149,6 +162,8 @@ void* kmalloc(size_t byte_count, size_t alignment) {
       return nullptr;
     }
     g_malloc_meta_head = block;
+    g_malloc_nb_allocations++;
+    g_malloc_used_bytes += block->size;
     return block->ptr;
   }
 
@@ -165,6 +180,8 @@ void* kmalloc(size_t byte_count, size_t alignment) {
   }
 #endif
 
+  g_malloc_nb_allocations++;
+  g_malloc_used_bytes += block->size;
   return block->ptr;
 }
 
@@ -175,6 +192,8 @@ void kfree(void* ptr) {
   KASSERT(is_addr_valid((VirtualAddress)ptr));
 
   MetaPtr block = get_block_addr((VirtualAddress)ptr);
+  g_malloc_nb_allocations--;
+  g_malloc_used_bytes -= block->size;
   block->is_free = true;
   block->ptr = block->data;
   block->size += (uintptr_t)ptr - (uintptr_t)block->ptr;
@@ -198,6 +217,14 @@ void kfree(void* ptr) {
 }
 #endif  // CONFIG_USE_NAIVE_MALLOC
 
+KMallocStats kmalloc_get_stats() {
+  return {
+      .nb_allocations = g_malloc_nb_allocations,
+      .used_bytes = g_malloc_used_bytes,
+      .heap_byte_size = KernelMemory::get_heap_end() - KernelMemory::get_heap_start(),
+  };
+}
+
 extern "C" void* krealloc(void* ptr, size_t new_size) {
   kfree(ptr);
   return kmalloc(new_size, alignof(max_align_t));
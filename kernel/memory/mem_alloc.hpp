@@ -5,3 +5,12 @@
 extern "C" __attribute__((malloc)) void* kmalloc(size_t byte_count, size_t alignment);
 extern "C" void kfree(void* ptr);
 extern "C" void* krealloc(void* ptr, size_t new_size);
+
+struct KMallocStats {
+  size_t nb_allocations;  //<! Number of live allocations.
+  size_t used_bytes;      //<! Number of bytes handed out by live allocations.
+  size_t heap_byte_size;  //<! Size of the kernel heap used by kmalloc (including metadata and free blocks).
+};
+
+/** @returns the current statistics of the kernel heap allocator. */
+[[nodiscard]] KMallocStats kmalloc_get_stats();
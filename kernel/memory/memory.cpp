@@ -55,3 +55,16 @@ VirtualAddress KernelMemory::get_virtual_vc_address(PhysicalAddress vc_addr) {
 VirtualAddress KernelMemory::get_fs_address() {
   return RAM_FS_MEMORY;
 }
+
+KernelMemory::Stats KernelMemory::get_stats() {
+  const auto* page_alloc = memory_impl::get_kernel_alloc();
+  const auto* contiguous_alloc = memory_impl::get_contiguous_alloc();
+
+  return {
+      .nb_pages = page_alloc->get_nb_pages(),
+      .nb_used_pages = page_alloc->get_nb_used_pages(),
+      .nb_contiguous_pages = contiguous_alloc->get_nb_pages(),
+      .nb_used_contiguous_pages = contiguous_alloc->get_nb_used_pages(),
+      .nb_table_pages = memory_impl::get_nb_table_pages(),
+  };
+}
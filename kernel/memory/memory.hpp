@@ -36,4 +36,16 @@ VirtualAddress get_virtual_vc_address(PhysicalAddress vc_addr);
 
 /** Returns the address of the Filesystem in memory. */
 VirtualAddress get_fs_address();
+
+/** Statistics about the physical page allocators, all values are in pages. */
+struct Stats {
+  size_t nb_pages;                  //<! Pages managed by the page allocator.
+  size_t nb_used_pages;             //<! Pages allocated (or reserved) in the page allocator.
+  size_t nb_contiguous_pages;       //<! Pages managed by the contiguous (buffers) allocator.
+  size_t nb_used_contiguous_pages;  //<! Pages allocated in the contiguous allocator.
+  size_t nb_table_pages;            //<! Pages used by MMU tables allocated at runtime.
+};
+
+/** @returns the current statistics of the physical page allocators. */
+[[nodiscard]] Stats get_stats();
 };  // namespace KernelMemory
@@ -30,6 +30,10 @@ class MemoryChunk {
   /** Returns the number of bytes of this chunk. */
   [[nodiscard]] size_t get_byte_size() const;
 
+  /** Returns the raw pointer (in kernel memory) of this chunk.
+   * Reading or Writing before or after the chunk's end is undefined. */
+  [[nodiscard]] void* get() const { return (void*)_kernel_va; }
+
   /** @returns the size of a page. */
   static size_t get_page_byte_size();
 
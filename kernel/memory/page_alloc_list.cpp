@@ -87,6 +87,7 @@ bool PageAllocList::fresh_page(PhysicalPA* addr) {
   while (cur != nullptr) {
     if (cur->alloc.fresh_page(addr)) {
       *addr += cur->section_start;
+      _nb_used_pages++;
       return true;
     }
 
@@ -101,6 +102,8 @@ void PageAllocList::free_page(PhysicalPA addr) {
 
   while (cur != nullptr) {
     if (cur->section_start <= addr && addr < cur->section_stop) {
+      if (!cur->alloc.page_status(addr - cur->section_start))
+        _nb_used_pages--;
       cur->alloc.free_page(addr - cur->section_start);
     }
 
@@ -122,6 +125,8 @@ void PageAllocList::mark_as_used_range(PhysicalPA start, PhysicalPA end) {
       const auto page_stop = libk::min(end, cur->section_stop);
 
       for (size_t page = page_start; page < page_stop; page += PAGE_SIZE) {
+        if (cur->alloc.page_status(page - cur->section_start))
+          _nb_used_pages++;
         cur->alloc.mark_as_used(page - cur->section_start);
       }
     }
@@ -141,6 +146,7 @@ void PageAllocList::add_allocator(libk::LinearAllocator& mem_alloc,
   new_elm->section_stop = page_end;
   new_elm->alloc = PageAlloc(nb_pages, array);
   new_elm->next = nullptr;
+  _nb_pages += nb_pages;
 
   if (_list_end != nullptr){
     _list_end->next = new_elm;
@@ -18,6 +18,11 @@ class PageAllocList {
   PhysicalPA get_reserved_start() const { return contiguous_res_start; }
   PhysicalPA get_reserved_stop() const { return contiguous_res_stop; }
 
+  /** Returns the number of pages managed by this allocator. */
+  size_t get_nb_pages() const { return _nb_pages; }
+  /** Returns the number of pages currently allocated or reserved. */
+  size_t get_nb_used_pages() const { return _nb_used_pages; }
+
  private:
   struct AllocList {
     PhysicalPA section_start;
@@ -32,6 +37,9 @@ class PageAllocList {
   AllocList* _list_beg = nullptr;
   AllocList* _list_end = nullptr;
 
+  size_t _nb_pages = 0;
+  size_t _nb_used_pages = 0;
+
   void add_allocator(libk::LinearAllocator& mem_alloc,
                      PhysicalPA page_start,
                      PhysicalPA page_end,
@@ -7,16 +7,18 @@
 
 uint8_t ProcessMemory::_new_asid = 1;
 
-static inline PagesAttributes get_properties(bool read_only, bool executable) {
+static inline PagesAttributes get_properties(bool read_only,
+                                             bool executable,
+                                             MemoryType type = MemoryType::Normal) {
   return {.sh = Shareability::InnerShareable,
           .exec = executable ? ExecutionPermission::ProcessExecute : ExecutionPermission::NeverExecute,
           .rw = read_only ? ReadWritePermission::ReadOnly : ReadWritePermission::ReadWrite,
           .access = Accessibility::AllProcess,
-          .type = MemoryType::Normal};
+          .type = type};
 }
 
 ProcessMemory::ProcessMemory(size_t minimum_stack_byte_size)
-    : _tbl(memory_impl::new_process_tbl(_new_asid++)),
+    : _tbl(memory_impl::new_process_tbl(_new_asid++, &_nb_table_pages)),
       _heap(HeapManager::Kind::Process, &_tbl),
       _stack(libk::div_round_up(minimum_stack_byte_size, PAGE_SIZE)) {
   if (!_stack.is_status_okay()) {
@@ -102,7 +104,7 @@ bool ProcessMemory::map_chunk(MemoryChunk& chunk, const VirtualPA page_va, bool
     }
   }
 
-  _sec.emplace_back(page_va, false, &chunk);
+  _sec.emplace_back(page_va, MappedSections::Kind::Chunk, &chunk);
   chunk.register_mapping(this, page_va);
 
   return true;
@@ -122,12 +124,40 @@ bool ProcessMemory::map_buffer(Buffer& chunk, VirtualPA page_va, bool read_only,
     return false;
   }
 
-  _sec.emplace_back(buffer_va_start, true, &chunk);
+  _sec.emplace_back(buffer_va_start, MappedSections::Kind::Buffer, &chunk);
   chunk.register_mapping(this, page_va);
 
   return true;
 }
 
+bool ProcessMemory::map_physical(PhysicalPA pa_start, PhysicalPA pa_end, VirtualPA address, bool read_only) {
+  KASSERT(pa_start <= pa_end);
+
+  // Non-cacheable normal memory (and not device memory) so that the CPU can gather the writes.
+  const PagesAttributes attr = get_properties(read_only, false, MemoryType::Normal_NoCache);
+
+  const VirtualPA va_end = address + pa_end - pa_start;
+  if (!map_range(&_tbl, address, va_end, pa_start, attr)) {
+    return false;
+  }
+
+  _sec.emplace_back(address, MappedSections::Kind::Physical, nullptr, va_end);
+  return true;
+}
+
+VirtualPA ProcessMemory::end_address(const MappedSections& section) {
+  switch (section.kind) {
+    case MappedSections::Kind::Chunk:
+      return ((MemoryChunk*)section.mem)->end_address(section.start);
+    case MappedSections::Kind::Buffer:
+      return ((Buffer*)section.mem)->end_address(section.start);
+    case MappedSections::Kind::Physical:
+      return section.end;
+  }
+
+  return section.start;
+}
+
 void ProcessMemory::unmap_memory(VirtualPA start_address) {
   auto it = _sec.begin();
   for (; it != std::end(_sec); ++it) {
@@ -141,21 +171,16 @@ void ProcessMemory::unmap_memory(VirtualPA start_address) {
     return;
   }
 
-  VirtualAddress end_address;
-  if (it->is_buffer) {
-    end_address = ((Buffer*)it->mem)->end_address(it->start);
-  } else {
-    end_address = ((MemoryChunk*)it->mem)->end_address(it->start);
-  }
+  const VirtualAddress end_address = ProcessMemory::end_address(*it);
 
   if (!unmap_range(&_tbl, it->start, end_address)) {
     LOG_ERROR("Failed to unmap from {:#x} tp {:#x} in process memory with asid: {}.", it->start, end_address,
               get_asid());
   }
 
-  if (it->is_buffer) {
+  if (it->kind == MappedSections::Kind::Buffer) {
     ((Buffer*)it->mem)->unregister_mapping(this);
-  } else {
+  } else if (it->kind == MappedSections::Kind::Chunk) {
     ((MemoryChunk*)it->mem)->unregister_mapping(this);
   }
 
@@ -175,14 +200,29 @@ bool ProcessMemory::change_memory_attr(VirtualPA start_address, bool read_only,
     return false;
   }
 
-  VirtualAddress end_address;
-  if (it->is_buffer) {
-    end_address = ((Buffer*)it->mem)->end_address(it->start);
-  } else {
-    end_address = ((MemoryChunk*)it->mem)->end_address(it->start);
+  const MemoryType type =
+      it->kind == MappedSections::Kind::Physical ? MemoryType::Normal_NoCache : MemoryType::Normal;
+  return change_attr_range(&_tbl, it->start, end_address(*it), get_properties(read_only, executable, type));
+}
+
+ProcessMemory::Stats ProcessMemory::get_stats() const {
+  Stats stats = {
+      .heap_pages = _heap.get_nb_pages(),
+      .stack_pages = _stack.get_byte_size() / PAGE_SIZE,
+      .chunk_pages = 0,
+      .buffer_pages = 0,
+      .table_pages = _nb_table_pages,
+  };
+
+  for (const auto& sec : _sec) {
+    if (sec.kind == MappedSections::Kind::Buffer) {
+      stats.buffer_pages += ((const Buffer*)sec.mem)->get_byte_size() / PAGE_SIZE;
+    } else if (sec.kind == MappedSections::Kind::Chunk && sec.mem != &_stack) {
+      stats.chunk_pages += ((const MemoryChunk*)sec.mem)->get_byte_size() / PAGE_SIZE;
+    }
   }
 
-  return change_attr_range(&_tbl, it->start, end_address, get_properties(read_only, executable));
+  return stats;
 }
 
 bool ProcessMemory::is_read_only(VirtualPA va) const {
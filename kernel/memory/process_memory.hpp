@@ -37,6 +37,9 @@ class ProcessMemory {
   /* Memory chunk management */
   bool map_chunk(MemoryChunk& chunk, VirtualPA address, bool read_only, bool executable);
   bool map_buffer(Buffer& chunk, VirtualPA address, bool read_only, bool executable);
+  /** Maps the physical pages from @a pa_start to @a pa_end (both included) at @a address as non-cacheable
+   * normal memory, so that writes can be gathered by the CPU (used for the screen framebuffer). */
+  bool map_physical(PhysicalPA pa_start, PhysicalPA pa_end, VirtualPA address, bool read_only);
 
   void unmap_memory(VirtualPA start_address);
   bool change_memory_attr(VirtualPA start_address, bool read_only, bool executable);
@@ -46,19 +49,38 @@ class ProcessMemory {
   bool is_read_only(VirtualPA va) const;
   bool is_executable(VirtualPA va) const;
 
+  /** Physical memory used by a process, all values are in pages. */
+  struct Stats {
+    size_t heap_pages;    //<! Pages backing the heap.
+    size_t stack_pages;   //<! Pages of the stack.
+    size_t chunk_pages;   //<! Pages of the mapped memory chunks (stack excluded).
+    size_t buffer_pages;  //<! Pages of the mapped buffers.
+    size_t table_pages;   //<! Pages used by the MMU table.
+  };
+
+  /** @returns the physical memory currently used by this process. */
+  [[nodiscard]] Stats get_stats() const;
+
  private:
   static uint8_t _new_asid;
+  size_t _nb_table_pages = 0;  // must be declared before _tbl, updated by the MMU table allocator
   MMUTable _tbl;
 
   HeapManager _heap;
   MemoryChunk _stack;
 
   struct MappedSections {
-    MappedSections(VirtualPA start, bool is_buffer, void* mem) : start(start), is_buffer(is_buffer), mem(mem) {}
+    enum class Kind : uint8_t { Chunk, Buffer, Physical };
+
+    MappedSections(VirtualPA start, Kind kind, void* mem, VirtualPA end = 0)
+        : start(start), kind(kind), mem(mem), end(end) {}
     VirtualPA start;
-    bool is_buffer;
-    void* mem;
+    Kind kind;
+    void* mem;      // the MemoryChunk or Buffer, null for physical mappings
+    VirtualPA end;  // only for physical mappings
   };
 
   libk::LinkedList<MappedSections> _sec;
+
+  static VirtualPA end_address(const MappedSections& section);
 };
@@ -10,10 +10,14 @@
 #include "fs/filesystem.hpp"
 #include "task/task.hpp"
 #include "task/task_manager.hpp"
+#include "wm/surface.hpp"
 #include "wm/window.hpp"
 #include "wm/window_manager.hpp"
 #include "hardware/framebuffer.hpp"
+#include "memory/mem_alloc.hpp"
 #include "task/pipe.hpp"
+#include "task/shared_memory.hpp"
+#include "hardware/timer.hpp"
 
 static void set_error(Registers& regs, sys_error_t error) {
   regs.gp_regs.x0 = error;
@@ -90,6 +94,54 @@ static void pika_sys_sbrk(Registers& regs) {
   regs.gp_regs.x0 = previous_brk;
 }
 
+// Signature: sys_error_t sys_mem_stats(sys_pid_t pid, sys_mem_stats_t* stats);
+static void pika_sys_mem_stats(Registers& regs) {
+  const sys_pid_t pid = regs.gp_regs.x0;
+  auto* stats = (sys_mem_stats_t*)regs.gp_regs.x1;
+  if (!check_ptr(regs, stats, true))
+    return;
+
+  TaskPtr task = TaskManager::get().find_by_id(pid);
+  if (task == nullptr) {
+    set_error(regs, SYS_ERR_INVALID_PID);
+    return;
+  }
+
+  libk::bzero(stats, sizeof(sys_mem_stats_t));
+  stats->page_size = MemoryChunk::get_page_byte_size();
+  stats->is_kernel = task->get_saved_state().is_kernel;
+  stats->is_terminated = task->is_terminated();
+
+  // Task memory.
+  if (auto memory = task->get_memory()) {
+    const auto process_stats = memory->get_stats();
+    stats->heap_pages = process_stats.heap_pages;
+    stats->stack_pages = process_stats.stack_pages;
+    stats->chunk_pages = process_stats.chunk_pages;
+    stats->buffer_pages = process_stats.buffer_pages;
+    stats->table_pages = process_stats.table_pages;
+  } else if (const auto* kernel_stack = task->get_kernel_stack()) {
+    stats->stack_pages = kernel_stack->get_byte_size() / stats->page_size;
+  }
+
+  stats->window_pages = libk::div_round_up(task->get_windows_byte_size(), stats->page_size);
+
+  // System memory.
+  const auto memory_stats = KernelMemory::get_stats();
+  stats->total_pages = memory_stats.nb_pages;
+  stats->used_pages = memory_stats.nb_used_pages;
+  stats->total_contiguous_pages = memory_stats.nb_contiguous_pages;
+  stats->used_contiguous_pages = memory_stats.nb_used_contiguous_pages;
+  stats->total_table_pages = memory_stats.nb_table_pages;
+
+  const auto kmalloc_stats = kmalloc_get_stats();
+  stats->kmalloc_allocations = kmalloc_stats.nb_allocations;
+  stats->kmalloc_used_bytes = kmalloc_stats.used_bytes;
+  stats->kmalloc_heap_bytes = kmalloc_stats.heap_byte_size;
+
+  set_error(regs, SYS_ERR_OK);
+}
+
 static void pika_sys_spawn(Registers& regs) {
   const auto* path = (const char*)regs.gp_regs.x0;
   const size_t argc = (size_t)regs.gp_regs.x1;
@@ -351,7 +403,7 @@ static void pika_sys_window_set_title(Registers& regs) {
   if (!check_ptr(regs, (void*)title))
     return;
 
-  window->set_title(title);
+  WindowManager::get().set_window_title(window, title);
   set_error(regs, SYS_ERR_OK);
 }
 
@@ -438,6 +490,22 @@ static void pika_sys_window_set_geometry(Registers& regs) {
   set_error(regs, SYS_ERR_OK);
 }
 
+// Signature: sys_error_t sys_window_set_opaque_rect(sys_window_t* window, uint32_t x, uint32_t y,
+//                                                  uint32_t width, uint32_t height);
+static void pika_sys_window_set_opaque_rect(Registers& regs) {
+  auto* window = (Window*)regs.gp_regs.x0;
+  if (!check_window(regs, window))
+    return;
+
+  const uint32_t x = (uint32_t)regs.gp_regs.x1;
+  const uint32_t y = (uint32_t)regs.gp_regs.x2;
+  const uint32_t width = (uint32_t)regs.gp_regs.x3;
+  const uint32_t height = (uint32_t)regs.gp_regs.x4;
+
+  WindowManager::get().set_window_opaque_rect(window, Rect::from_pos_and_size(x, y, width, height));
+  set_error(regs, SYS_ERR_OK);
+}
+
 static void pika_sys_window_present(Registers& regs) {
   auto* window = (Window*)regs.gp_regs.x0;
   if (!check_window(regs, window))
@@ -452,6 +520,99 @@ static void pika_sys_window_present(Registers& regs) {
   set_error(regs, SYS_ERR_OK);
 }
 
+// Signature: sys_error_t sys_window_wait_present(sys_window_t* window);
+static void pika_sys_window_wait_present(Registers& regs) {
+  auto* window = (Window*)regs.gp_regs.x0;
+  if (!check_window(regs, window))
+    return;
+
+  if (WindowManager::get().block_task_until_presented(window, Task::current())) {
+    // Task was blocked until the next frame. Step back at the SVC instruction,
+    // so the system call is resubmitted once awakened.
+    step_back_one_inst(regs);
+    return;
+  }
+
+  set_error(regs, SYS_ERR_OK);
+}
+
+// Signature: sys_error_t sys_compositor_stats(sys_compositor_stats_t* stats);
+static void pika_sys_compositor_stats(Registers& regs) {
+  auto* stats = (sys_compositor_stats_t*)regs.gp_regs.x0;
+  if (!check_ptr(regs, stats, true))
+    return;
+
+  *stats = WindowManager::get().get_stats();
+  set_error(regs, SYS_ERR_OK);
+}
+
+// Signature: sys_error_t sys_gfx_get_font_metrics(sys_font_metrics_t* metrics);
+static void pika_sys_gfx_get_font_metrics(Registers& regs) {
+  auto* metrics = (sys_font_metrics_t*)regs.gp_regs.x0;
+  if (!check_ptr(regs, metrics, true))
+    return;
+
+  const PKFont font = graphics::get_default_font();
+  metrics->char_width = font.get_char_width();
+  metrics->char_height = font.get_char_height();
+  metrics->line_height = font.get_line_height();
+  set_error(regs, SYS_ERR_OK);
+}
+
+// Signature: sys_error_t sys_window_map_surface2(sys_window_t* window, uint32_t** pixels, uint32_t* pitch,
+//                                                uint32_t* generation);
+static void pika_sys_window_map_surface(Registers& regs) {
+  auto* window = (Window*)regs.gp_regs.x0;
+  if (!check_window(regs, window))
+    return;
+
+  auto** pixels = (uint32_t**)regs.gp_regs.x1;
+  auto* pitch = (uint32_t*)regs.gp_regs.x2;
+  auto* generation = (uint32_t*)regs.gp_regs.x3;
+  if (!check_ptr(regs, pixels, true))
+    return;
+  if (pitch != nullptr && !check_ptr(regs, pitch, true))
+    return;
+  if (generation != nullptr && !check_ptr(regs, generation, true))
+    return;
+
+  const VirtualAddress surface = window->map_surface();
+  if (surface == 0) {
+    set_error(regs, SYS_ERR_OUT_OF_MEM);
+    return;
+  }
+
+  *pixels = (uint32_t*)surface;
+  if (pitch != nullptr)
+    *pitch = window->get_framebuffer_pitch();
+  if (generation != nullptr)
+    *generation = window->get_surface_generation();
+  set_error(regs, SYS_ERR_OK);
+}
+
+// Signature: sys_error_t sys_window_map_tiles(sys_window_t* window, sys_window_tiles_t* tiles);
+static void pika_sys_window_map_tiles(Registers& regs) {
+  auto* window = (Window*)regs.gp_regs.x0;
+  if (!check_window(regs, window))
+    return;
+
+  auto* tiles = (sys_window_tiles_t*)regs.gp_regs.x1;
+  if (!check_ptr(regs, tiles, true))
+    return;
+
+  const VirtualAddress bits = window->map_tiles();
+  if (bits == 0) {
+    set_error(regs, SYS_ERR_OUT_OF_MEM);
+    return;
+  }
+
+  tiles->bits = (uint64_t*)bits;
+  tiles->stride = window->get_tiles_stride();
+  tiles->columns = window->get_tile_columns();
+  tiles->rows = window->get_tile_rows();
+  set_error(regs, SYS_ERR_OK);
+}
+
 static void pika_sys_gfx_clear(Registers& regs) {
   auto* window = (Window*)regs.gp_regs.x0;
   if (!check_window(regs, window))
@@ -530,6 +691,133 @@ static void pika_sys_gfx_draw_text(Registers& regs) {
   set_error(regs, SYS_ERR_OK);
 }
 
+/** Checks that the rectangle of @a width x @a height pixels at (@a x, @a y) can be represented by a Rect,
+ * that is all its edges fit in an int32_t. */
+static bool check_gfx_rect(int64_t x, int64_t y, uint32_t width, uint32_t height) {
+  return width <= INT32_MAX && height <= INT32_MAX && x >= INT32_MIN && y >= INT32_MIN && x + width <= INT32_MAX &&
+         y + height <= INT32_MAX;
+}
+
+static bool check_gfx_commands(Registers& regs, const sys_gfx_cmd_t* commands, size_t count) {
+  auto current_task = Task::current();
+  const Surface* target = nullptr;  // nullptr for the window
+  size_t clip_depth = 0;
+  for (size_t i = 0; i < count; ++i) {
+    const sys_gfx_cmd_t& command = commands[i];
+    switch (command.type) {
+      case SYS_GFX_CMD_CLEAR:
+      case SYS_GFX_CMD_LINE:
+        break;
+      case SYS_GFX_CMD_RECT:
+      case SYS_GFX_CMD_FILL:
+        if (!check_gfx_rect(command.rect.x, command.rect.y, command.rect.width, command.rect.height))
+          return false;
+        break;
+      case SYS_GFX_CMD_COPY_AREA: {
+        // The moved rectangle must be valid too.
+        const sys_gfx_copy_area_t& copy = command.copy_area;
+        if (!check_gfx_rect(copy.x, copy.y, copy.width, copy.height) ||
+            !check_gfx_rect((int64_t)copy.x + copy.dx, (int64_t)copy.y + copy.dy, copy.width, copy.height))
+          return false;
+        break;
+      }
+      case SYS_GFX_CMD_TEXT:
+        if (!check_ptr(regs, (void*)command.text.text))
+          return false;
+        break;
+      case SYS_GFX_CMD_BLIT:
+        if (!check_ptr(regs, (void*)command.blit.pixels) ||
+            !check_gfx_rect(command.blit.x, command.blit.y, command.blit.width, command.blit.height))
+          return false;
+        break;
+      case SYS_GFX_CMD_BLIT_SCALED:
+        if (!check_ptr(regs, (void*)command.blit_scaled.pixels))
+          return false;
+        if (!check_gfx_rect(command.blit_scaled.x, command.blit_scaled.y, command.blit_scaled.width,
+                            command.blit_scaled.height))
+          return false;
+        if (command.blit_scaled.filter != SYS_GFX_FILTER_NEAREST &&
+            command.blit_scaled.filter != SYS_GFX_FILTER_BILINEAR)
+          return false;
+        break;
+      case SYS_GFX_CMD_SET_TARGET: {
+        const auto* surface = (const Surface*)command.surface.surface;
+        if (clip_depth != 0 || (surface != nullptr && !current_task->own_surface(surface)))
+          return false;
+        target = surface;
+        break;
+      }
+      case SYS_GFX_CMD_BLIT_SURFACE: {
+        // A surface can not be blit into itself (the source and destination would overlap).
+        const auto* surface = (const Surface*)command.surface.surface;
+        if (!current_task->own_surface(surface) || surface == target)
+          return false;
+        break;
+      }
+      case SYS_GFX_CMD_PUSH_CLIP:
+        if (clip_depth == SYS_GFX_MAX_CLIP_DEPTH ||
+            !check_gfx_rect(command.rect.x, command.rect.y, command.rect.width, command.rect.height))
+          return false;
+        ++clip_depth;
+        break;
+      case SYS_GFX_CMD_POP_CLIP:
+        if (clip_depth == 0)
+          return false;
+        --clip_depth;
+        break;
+      default:
+        return false;
+    }
+  }
+
+  return true;
+}
+
+// Signature: sys_error_t sys_gfx_submit(sys_window_t* window, const sys_gfx_cmd_t* cmds, size_t n);
+static void pika_sys_gfx_submit(Registers& regs) {
+  auto* window = (Window*)regs.gp_regs.x0;
+  if (!check_window(regs, window))
+    return;
+
+  const auto* commands = (const sys_gfx_cmd_t*)regs.gp_regs.x1;
+  const size_t count = regs.gp_regs.x2;
+  if (count > 0 && !check_ptr(regs, (void*)commands))
+    return;
+
+  // Everything is checked before drawing anything, then the commands are executed at once.
+  if (!check_gfx_commands(regs, commands, count)) {
+    set_error(regs, SYS_ERR_INVALID_GFX_COMMAND);
+    return;
+  }
+
+  window->execute_commands(commands, count);
+  set_error(regs, SYS_ERR_OK);
+}
+
+// Signature: sys_surface_t* sys_surface_create(uint32_t width, uint32_t height, uint32_t flags);
+static void pika_sys_surface_create(Registers& regs) {
+  const uint32_t width = regs.gp_regs.x0;
+  const uint32_t height = regs.gp_regs.x1;
+  const uint32_t flags = regs.gp_regs.x2;
+  if (width == 0 || width > Surface::MAX_WIDTH || height == 0 || height > Surface::MAX_HEIGHT) {
+    regs.gp_regs.x0 = 0;  // NULL pointer as return value
+    return;
+  }
+
+  auto* surface = Task::current()->create_surface(width, height, flags);
+  regs.gp_regs.x0 = (sys_word_t)surface;
+}
+
+// Signature: void sys_surface_destroy(sys_surface_t* surface);
+static void pika_sys_surface_destroy(Registers& regs) {
+  auto current_task = Task::current();
+  auto* surface = (Surface*)regs.gp_regs.x0;
+  if (!current_task->own_surface(surface))
+    return;
+
+  current_task->destroy_surface(surface);
+}
+
 static void pika_sys_get_framebuffer(Registers& reg) {
   void** pixels = (void**)reg.gp_regs.x0;
   uint32_t* width = (uint32_t*)reg.gp_regs.x1;
@@ -546,29 +834,43 @@ static void pika_sys_get_framebuffer(Registers& reg) {
     return;
 
   auto& fb = FrameBuffer::get();
+  if (!fb.is_initialized()) {
+    set_error(reg, SYS_ERR_GENERIC);
+    return;
+  }
+
+  // If the user wants the pixels buffer, then it asks for the exclusive ownership of the screen.
+  // The framebuffer physical memory is then directly mapped into its memory space. Processes
+  // only know how to draw 0xAARRGGBB pixels.
+  if (pixels != nullptr) {
+    if (fb.get_pixel_format() != graphics::PixelFormat::ARGB8888) {
+      set_error(reg, SYS_ERR_GENERIC);
+      return;
+    }
+
+    const VirtualAddress address = Task::current()->acquire_screen();
+    if (address == 0) {
+      set_error(reg, WindowManager::get().is_screen_acquired() ? SYS_ERR_BUSY : SYS_ERR_OUT_OF_MEM);
+      return;
+    }
+
+    *pixels = (void*)address;
+  }
 
   // Trivial properties to get from the framebuffer.
   if (width != nullptr)
     *width = fb.get_width();
   if (height != nullptr)
-    *height = fb.get_width();
+    *height = fb.get_height();
   if (stride != nullptr)
     *stride = fb.get_pitch();
 
-  // If the user wan the pixels buffer, then we need to map it in its memory space.
-  if (pixels != nullptr) {
-    // FIXME: Map the framebuffer physical address to an address in userspace
-    auto* pixels_chunk = Task::current()->map_chunk(1, 0, false, true);
-    if (pixels_chunk == nullptr) {
-      set_error(reg, SYS_ERR_OUT_OF_MEM);
-      return;
-    }
-
-    // Write the framebuffer buffer in the user memory.
-    (void)pixels_chunk->write(0, fb.get_buffer(), fb.get_width() * fb.get_height() * sizeof(uint32_t));
-    *pixels = (void*)0;
-  }
+  set_error(reg, SYS_ERR_OK);
+}
 
+// Signature: sys_error_t sys_release_framebuffer()
+static void pika_sys_release_framebuffer(Registers& reg) {
+  Task::current()->release_screen();
   set_error(reg, SYS_ERR_OK);
 }
 
@@ -713,6 +1015,109 @@ static void pika_sys_pipe_write(Registers& regs) {
   set_error(regs, SYS_ERR_OK);
 }
 
+// Checks that @a name is a valid shared memory name (not too long).
+static bool check_shm_name(Registers& regs, const char* name) {
+  if (!check_ptr(regs, (void*)name))
+    return false;
+
+  if (libk::strlen(name) >= SYS_SHM_NAME_MAX) {
+    regs.gp_regs.x0 = 0;  // NULL pointer as return value
+    return false;
+  }
+
+  return true;
+}
+
+// Signature: sys_shm_t* sys_shm_create(const char* name, size_t size);
+static void pika_sys_shm_create(Registers& regs) {
+  const char* name = (const char*)regs.gp_regs.x0;
+  if (!check_shm_name(regs, name))
+    return;
+
+  const size_t size = regs.gp_regs.x1;
+  if (size == 0) {
+    regs.gp_regs.x0 = 0;  // NULL pointer as return value
+    return;
+  }
+
+  auto current_task = Task::current();
+  KASSERT(current_task != nullptr);
+  auto* shm = current_task->create_shared_memory(name, size);
+  regs.gp_regs.x0 = (sys_word_t)shm;
+}
+
+// Signature: sys_shm_t* sys_shm_get(sys_pid_t pid, const char* name);
+static void pika_sys_shm_get(Registers& regs) {
+  const sys_pid_t pid = regs.gp_regs.x0;
+  const char* name = (const char*)regs.gp_regs.x1;
+  if (!check_shm_name(regs, name))
+    return;
+
+  TaskPtr task = TaskManager::get().find_by_id(pid);
+  if (task == nullptr) {
+    // Task not found, PID invalid.
+    regs.gp_regs.x0 = 0;  // NULL pointer as return value
+    return;
+  }
+
+  auto* shm = task->get_shared_memory(name);
+  if (shm != nullptr)
+    Task::current()->register_shared_memory(shm);
+
+  regs.gp_regs.x0 = (sys_word_t)shm;
+}
+
+// Signature: sys_error_t sys_shm_map(sys_shm_t* shm, void** address, size_t* size);
+static void pika_sys_shm_map(Registers& regs) {
+  auto current_task = Task::current();
+  KASSERT(current_task != nullptr);
+
+  auto* shm = (SharedMemoryResource*)regs.gp_regs.x0;
+  if (!current_task->own_shared_memory(shm)) {
+    set_error(regs, SYS_ERR_INVALID_SHM);
+    return;
+  }
+
+  void** address = (void**)regs.gp_regs.x1;
+  if (!check_ptr(regs, address, true))
+    return;
+
+  size_t* size = (size_t*)regs.gp_regs.x2;
+  if (size != nullptr && !check_ptr(regs, size, true))
+    return;
+
+  const VirtualAddress mapped_address = current_task->map_shared_memory(shm);
+  if (mapped_address == 0) {
+    set_error(regs, SYS_ERR_OUT_OF_MEM);
+    return;
+  }
+
+  *address = (void*)mapped_address;
+  if (size != nullptr)
+    *size = shm->get_byte_size();
+  set_error(regs, SYS_ERR_OK);
+}
+
+// Signature: sys_error_t sys_shm_unmap(sys_shm_t* shm);
+static void pika_sys_shm_unmap(Registers& regs) {
+  auto current_task = Task::current();
+  KASSERT(current_task != nullptr);
+
+  auto* shm = (SharedMemoryResource*)regs.gp_regs.x0;
+  if (!current_task->own_shared_memory(shm)) {
+    set_error(regs, SYS_ERR_INVALID_SHM);
+    return;
+  }
+
+  current_task->unregister_shared_memory(shm);
+  set_error(regs, SYS_ERR_OK);
+}
+
+// Signature: uint64_t sys_get_time_us();
+static void pika_sys_get_time(Registers& regs) {
+  regs.gp_regs.x0 = GenericTimer::get_elapsed_time_in_micros();
+}
+
 SyscallTable* create_pika_syscalls() {
   SyscallTable* table = new SyscallTable;
   KASSERT(table != nullptr);
@@ -729,13 +1134,16 @@ SyscallTable* create_pika_syscalls() {
 
   // Memory system calls.
   table->register_syscall(SYS_SBRK, pika_sys_sbrk);
+  table->register_syscall(SYS_MEM_STATS, pika_sys_mem_stats);
 
   // Framebuffer system calls.
   table->register_syscall(SYS_GET_FRAMEBUFFER, pika_sys_get_framebuffer);
+  table->register_syscall(SYS_RELEASE_FRAMEBUFFER, pika_sys_release_framebuffer);
 
   // Scheduler system calls.
   table->register_syscall(SYS_SLEEP, pika_sys_sleep);
   table->register_syscall(SYS_YIELD, pika_sys_yield);
+  table->register_syscall(SYS_GET_TIME, pika_sys_get_time);
   table->register_syscall(SYS_SCHED_SET_PRIORITY, pika_sys_sched_set_priority);
   table->register_syscall(SYS_SCHED_GET_PRIORITY, pika_sys_sched_get_priority);
 
@@ -746,6 +1154,12 @@ SyscallTable* create_pika_syscalls() {
   table->register_syscall(SYS_PIPE_READ, pika_sys_pipe_read);
   table->register_syscall(SYS_PIPE_WRITE, pika_sys_pipe_write);
 
+  // Shared memory system calls.
+  table->register_syscall(SYS_SHM_CREATE, pika_sys_shm_create);
+  table->register_syscall(SYS_SHM_GET, pika_sys_shm_get);
+  table->register_syscall(SYS_SHM_MAP, pika_sys_shm_map);
+  table->register_syscall(SYS_SHM_UNMAP, pika_sys_shm_unmap);
+
   // File system calls.
   table->register_syscall(SYS_OPEN_FILE, pika_sys_open_file);
   table->register_syscall(SYS_CLOSE_FILE, pika_sys_close_file);
@@ -765,15 +1179,26 @@ SyscallTable* create_pika_syscalls() {
   table->register_syscall(SYS_WINDOW_SET_VISIBILITY, pika_sys_window_set_visibility);
   table->register_syscall(SYS_WINDOW_GET_GEOMETRY, pika_sys_window_get_geometry);
   table->register_syscall(SYS_WINDOW_SET_GEOMETRY, pika_sys_window_set_geometry);
+  table->register_syscall(SYS_WINDOW_SET_OPAQUE_RECT, pika_sys_window_set_opaque_rect);
+  table->register_syscall(SYS_WINDOW_MAP_SURFACE, pika_sys_window_map_surface);
+  table->register_syscall(SYS_WINDOW_MAP_TILES, pika_sys_window_map_tiles);
 
   // Window graphics calls.
   table->register_syscall(SYS_WINDOW_PRESENT, pika_sys_window_present);
+  table->register_syscall(SYS_WINDOW_WAIT_PRESENT, pika_sys_window_wait_present);
+  table->register_syscall(SYS_COMPOSITOR_STATS, pika_sys_compositor_stats);
   table->register_syscall(SYS_GFX_CLEAR, pika_sys_gfx_clear);
   table->register_syscall(SYS_GFX_DRAW_LINE, pika_sys_gfx_draw_line);
   table->register_syscall(SYS_GFX_DRAW_RECT, pika_sys_gfx_draw_rect);
   table->register_syscall(SYS_GFX_FILL_RECT, pika_sys_gfx_fill_rect);
   table->register_syscall(SYS_GFX_DRAW_TEXT, pika_sys_gfx_draw_text);
   table->register_syscall(SYS_GFX_BLIT, pika_sys_gfx_blit);
+  table->register_syscall(SYS_GFX_SUBMIT, pika_sys_gfx_submit);
+  table->register_syscall(SYS_GFX_GET_FONT_METRICS, pika_sys_gfx_get_font_metrics);
+
+  // Offscreen surfaces system calls.
+  table->register_syscall(SYS_SURFACE_CREATE, pika_sys_surface_create);
+  table->register_syscall(SYS_SURFACE_DESTROY, pika_sys_surface_destroy);
 
   return table;
 }
@@ -0,0 +1,14 @@
+#include "shared_memory.hpp"
+
+#include <libk/string.hpp>
+#include <libk/utils.hpp>
+
+SharedMemoryResource::SharedMemoryResource(Task* parent, const char* name, size_t byte_size)
+    : m_parent(parent), m_chunk(libk::div_round_up(byte_size, MemoryChunk::get_page_byte_size())) {
+  KASSERT(name != nullptr && libk::strlen(name) < SYS_SHM_NAME_MAX);
+  libk::strcpy(m_name, name);
+
+  // Do not leak the previous content of the pages to userspace.
+  if (m_chunk.is_status_okay())
+    libk::bzero(m_chunk.get(), m_chunk.get_byte_size());
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "resource.hpp"
+#include "memory/memory_chunk.hpp"
+
+#include <sys/syscall.h>
+#include <cstddef>
+
+/**
+ * @brief Represents a shared memory object that can be mapped by multiple tasks.
+ *
+ * A shared memory object is created by a task (its parent) and identified by
+ * a name unique inside this task. Other tasks can then look it up by the parent
+ * PID and the name, and map it in their own address space. Unlike pipes, no
+ * data is copied: all the tasks see the same physical pages.
+ *
+ * Each task referencing the object holds a reference to it. The pages are
+ * freed once the last task released its reference (the parent may die before
+ * the other tasks, the object simply can not be looked up anymore).
+ */
+class SharedMemoryResource : public Resource {
+ public:
+  /** Creates a shared memory object of at least @a byte_size bytes (zero initialized). */
+  SharedMemoryResource(Task* parent, const char* name, size_t byte_size);
+
+  /** Checks if the memory has been allocated. YOU MUST DO IT. */
+  [[nodiscard]] bool is_status_okay() const { return m_chunk.is_status_okay(); }
+
+  /** Gets the task that created this object, nullptr once it is dead. */
+  [[nodiscard]] Task* get_parent() const { return m_parent; }
+  /** Gets the name of this object. */
+  [[nodiscard]] const char* get_name() const { return m_name; }
+
+  /** Returns the number of bytes of this object (rounded up to a page boundary). */
+  [[nodiscard]] size_t get_byte_size() const { return m_chunk.get_byte_size(); }
+  /** Gets the backing memory chunk. */
+  [[nodiscard]] MemoryChunk& get_chunk() { return m_chunk; }
+
+ private:
+  friend class Task;
+  Task* m_parent = nullptr;
+  char m_name[SYS_SHM_NAME_MAX] = {};
+  MemoryChunk m_chunk;
+};  // class SharedMemoryResource
@@ -2,12 +2,18 @@
 #include <algorithm>
 #include "task_manager.hpp"
 #include "pipe.hpp"
+#include "shared_memory.hpp"
 #include <sys/syscall.h>
 
+#include "boot/mmu_utils.hpp"
 #include "fs/filesystem.hpp"
+#include "hardware/framebuffer.hpp"
+#include "wm/surface.hpp"
 #include "wm/window.hpp"
 #include "wm/window_manager.hpp"
 
+#include <libk/log.hpp>
+
 void TaskSavedState::save(const Registers& current_regs) {
   gp_regs = current_regs.gp_regs;
   fpu_regs.save();
@@ -52,6 +58,79 @@ MemoryChunk* Task::map_chunk(size_t nb_pages, VirtualAddress addr, bool executab
   return &chunk;
 }
 
+VirtualAddress Task::reserve_surface_address() {
+  for (size_t word = 0; word < PROCESS_SURFACE_MAX_SLOTS / 64; ++word) {
+    if (m_used_surface_slots[word] == UINT64_MAX)
+      continue;
+
+    const size_t bit = __builtin_ctzll(~m_used_surface_slots[word]);
+    m_used_surface_slots[word] |= 1ull << bit;
+    return PROCESS_SURFACE_BASE + PROCESS_SURFACE_SLOT_SIZE * (64 * word + bit);
+  }
+
+  return 0;
+}
+
+void Task::release_surface_address(VirtualAddress address) {
+  if (address == 0)
+    return;
+
+  KASSERT(address >= PROCESS_SURFACE_BASE && (address - PROCESS_SURFACE_BASE) % PROCESS_SURFACE_SLOT_SIZE == 0);
+  const size_t slot = (address - PROCESS_SURFACE_BASE) / PROCESS_SURFACE_SLOT_SIZE;
+  KASSERT(slot < PROCESS_SURFACE_MAX_SLOTS);
+  m_used_surface_slots[slot / 64] &= ~(1ull << (slot % 64));
+}
+
+VirtualAddress Task::acquire_screen() {
+  if (m_screen_address != 0)
+    return m_screen_address;
+
+  auto memory = get_memory();
+  if (memory == nullptr || !WindowManager::get().acquire_screen(this))
+    return 0;
+
+  const auto& fb = FrameBuffer::get();
+  // With double buffering, the compositor stops flipping while the screen is acquired.
+  const PhysicalAddress pa_start = fb.get_front_buffer_physical_address();
+  const PhysicalAddress pa_end = pa_start + libk::align_to_next(fb.get_byte_size(), PAGE_SIZE) - PAGE_SIZE;
+
+  const VirtualAddress address = reserve_surface_address();
+  if (address == 0 || !memory->map_physical(pa_start, pa_end, address, /* read_only= */ false)) {
+    release_surface_address(address);
+    WindowManager::get().release_screen(this);
+    return 0;
+  }
+
+  m_screen_address = address;
+  return m_screen_address;
+}
+
+void Task::release_screen() {
+  if (m_screen_address == 0)
+    return;
+
+  auto memory = get_memory();
+  if (memory != nullptr)
+    memory->unmap_memory(m_screen_address);
+
+  release_surface_address(m_screen_address);
+  m_screen_address = 0;
+  WindowManager::get().release_screen(this);
+}
+
+size_t Task::get_windows_byte_size() const {
+  size_t byte_size = 0;
+  for (const auto* window : m_windows) {
+    byte_size += window->get_framebuffer_byte_size();
+  }
+
+  for (const auto* surface : m_surfaces) {
+    byte_size += surface->get_byte_size();
+  }
+
+  return byte_size;
+}
+
 bool Task::own_window(Window* window) const {
   if (window == nullptr)
     return false;
@@ -73,6 +152,47 @@ void Task::unregister_window(Window* window) {
   m_windows.erase(it);
 }
 
+bool Task::own_surface(const Surface* surface) const {
+  if (surface == nullptr)
+    return false;
+
+  auto it = std::find(m_surfaces.begin(), m_surfaces.end(), surface);
+  return it != m_surfaces.end();
+}
+
+Surface* Task::create_surface(uint32_t width, uint32_t height, uint32_t flags) {
+  size_t surface_count = 0;
+  size_t byte_size = (size_t)width * height * sizeof(uint32_t);
+  for (const auto* surface : m_surfaces) {
+    ++surface_count;
+    byte_size += surface->get_byte_size();
+  }
+
+  if (surface_count >= Surface::MAX_SURFACES_PER_TASK || byte_size > Surface::MAX_BYTES_PER_TASK)
+    return nullptr;
+
+  auto* surface = new Surface(this, width, height, flags);
+  if (surface == nullptr)
+    return nullptr;
+
+  if (!surface->is_status_okay()) {
+    delete surface;
+    return nullptr;
+  }
+
+  m_surfaces.push_back(surface);
+  return surface;
+}
+
+void Task::destroy_surface(Surface* surface) {
+  KASSERT(surface != nullptr && surface->get_task() == this);
+
+  auto it = std::find(m_surfaces.begin(), m_surfaces.end(), surface);
+  KASSERT(it != m_surfaces.end());
+  m_surfaces.erase(it);
+  delete surface;
+}
+
 bool Task::own_file(File* file) const {
   if (file == nullptr)
     return false;
@@ -179,6 +299,107 @@ void Task::unregister_pipe(PipeResource* pipe) {
   pipe->unref();
 }
 
+/*
+ * Shared memory resources
+ */
+
+bool Task::own_shared_memory(const SharedMemoryResource* shm) const {
+  if (shm == nullptr)
+    return false;
+
+  auto it = std::find_if(m_shared_memories.begin(), m_shared_memories.end(),
+                         [shm](const SharedMemoryMapping& mapping) { return mapping.shm == shm; });
+  return it != m_shared_memories.end();
+}
+
+SharedMemoryResource* Task::get_shared_memory(const char* name) const {
+  for (const auto& mapping : m_shared_memories) {
+    if (mapping.shm->m_parent != this)
+      continue;
+
+    if (libk::strcmp(mapping.shm->m_name, name) == 0)
+      return mapping.shm;
+  }
+
+  return nullptr;
+}
+
+SharedMemoryResource* Task::create_shared_memory(const char* name, size_t byte_size) {
+  KASSERT(name != nullptr && libk::strlen(name) < SYS_SHM_NAME_MAX);
+  KASSERT(byte_size > 0);
+
+  // Check if the shared memory object already exists.
+  if (get_shared_memory(name) != nullptr)
+    return nullptr;
+
+  auto* shm = new SharedMemoryResource(this, name, byte_size);
+  if (shm == nullptr)
+    return nullptr;
+
+  if (!shm->is_status_okay()) {
+    delete shm;
+    return nullptr;
+  }
+
+  register_shared_memory(shm);
+  return shm;
+}
+
+void Task::register_shared_memory(SharedMemoryResource* shm) {
+  KASSERT(shm != nullptr);
+
+  if (own_shared_memory(shm))
+    return;  // each task holds at most one reference
+
+  shm->ref();
+  m_shared_memories.push_back({shm, 0});
+}
+
+void Task::unregister_shared_memory(SharedMemoryResource* shm) {
+  KASSERT(shm != nullptr);
+
+  auto it = std::find_if(m_shared_memories.begin(), m_shared_memories.end(),
+                         [shm](const SharedMemoryMapping& mapping) { return mapping.shm == shm; });
+  KASSERT(it != m_shared_memories.end());
+
+  auto memory = get_memory();
+  if (it->address != 0 && memory != nullptr)
+    memory->unmap_memory(it->address);
+  release_surface_address(it->address);
+
+  if (shm->m_parent == this) {
+    // The object can not be looked up anymore, but stays alive for the other tasks.
+    shm->m_parent = nullptr;
+  }
+
+  m_shared_memories.erase(it);
+  shm->unref();
+}
+
+VirtualAddress Task::map_shared_memory(SharedMemoryResource* shm) {
+  KASSERT(shm != nullptr);
+
+  auto it = std::find_if(m_shared_memories.begin(), m_shared_memories.end(),
+                         [shm](const SharedMemoryMapping& mapping) { return mapping.shm == shm; });
+  KASSERT(it != m_shared_memories.end());
+
+  if (it->address != 0)
+    return it->address;
+
+  auto memory = get_memory();
+  if (memory == nullptr)
+    return 0;
+
+  const VirtualAddress address = reserve_surface_address();
+  if (address == 0 || !memory->map_chunk(shm->get_chunk(), address, /* read_only= */ false, /* executable= */ false)) {
+    release_surface_address(address);
+    return 0;
+  }
+
+  it->address = address;
+  return address;
+}
+
 void Task::free_resources() {
   // Destroy the windows.
   auto& window_manager = WindowManager::get();
@@ -188,6 +409,16 @@ void Task::free_resources() {
 
   m_windows.clear();
 
+  // Free the offscreen surfaces.
+  for (auto* surface : m_surfaces) {
+    delete surface;
+  }
+
+  m_surfaces.clear();
+
+  // Give the screen back to the window manager (after the windows are destroyed to only redraw once).
+  release_screen();
+
   // Free all open files.
   auto& fs = FileSystem::get();
   for (auto* file : m_open_files) {
@@ -208,4 +439,17 @@ void Task::free_resources() {
     unregister_pipe(pipe);
   }
   m_open_pipes.clear();
+
+  // Release all shared memory objects.
+  while (!m_shared_memories.is_empty()) {
+    unregister_shared_memory(m_shared_memories.front().shm);
+  }
+
+  // Release the kernel stack. This is safe even for the current task as the kernel is
+  // running on the exception stack (SP_EL1) when a task is killed, not on SP_EL0.
+  if (m_kernel_stack) {
+    LOG_DEBUG("Kernel task pid={} used {} bytes of its {} bytes stack", m_id, m_kernel_stack->get_high_water_mark(),
+              m_kernel_stack->get_byte_size());
+    m_kernel_stack.reset();
+  }
 }
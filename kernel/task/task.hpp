@@ -2,7 +2,9 @@
 
 #include <cstdint>
 #include <libk/memory.hpp>
+#include "boot/mmu_utils.hpp"
 #include "hardware/regs.hpp"
+#include "memory/kernel_stack.hpp"
 #include "memory/process_memory.hpp"
 #include "task/syscall_table.hpp"
 #include "task/resource.hpp"
@@ -23,9 +25,11 @@ struct TaskSavedState {
 
 class TaskManager;
 class Window;
+class Surface;
 class File;
 class Dir;
 class PipeResource;
+class SharedMemoryResource;
 
 /**
  * Represents a runnable task in the system. This can be a user process, a thread, etc.
@@ -93,10 +97,26 @@ class Task {
   [[nodiscard]] TaskSavedState& get_saved_state() { return m_saved_state; }
   [[nodiscard]] const TaskSavedState& get_saved_state() const { return m_saved_state; }
 
+  /** Gets the stack of a kernel task (null for userspace tasks or once the task is killed). */
+  [[nodiscard]] const KernelStack* get_kernel_stack() const { return m_kernel_stack.get(); }
+
   /** Gets the task virtual memory. */
   [[nodiscard]] libk::SharedPointer<ProcessMemory> get_memory() const { return m_saved_state.memory; }
   [[nodiscard]] MemoryChunk& alloc_chunk(size_t nb_pages) { return m_mapped_chunks.emplace_back(nb_pages); }
   [[nodiscard]] MemoryChunk* map_chunk(size_t nb_pages, VirtualAddress addr, bool executable = false, bool read_only = false);
+  /** Reserves a range of the task address space where a window surface (or the screen, or a
+   * shared memory object) can be mapped.
+   * @returns the start of the range, or 0 if all the ranges are in use. */
+  [[nodiscard]] VirtualAddress reserve_surface_address();
+  /** Gives back a range reserved by reserve_surface_address(), once nothing is mapped there anymore.
+   * Does nothing if @a address is 0. */
+  void release_surface_address(VirtualAddress address);
+
+  /** Acquires the exclusive ownership of the screen and maps the framebuffer in the task memory.
+   * @returns the address of the framebuffer in the task memory, or 0 on failure. */
+  [[nodiscard]] VirtualAddress acquire_screen();
+  /** Unmaps the framebuffer and gives the screen back to the window manager. */
+  void release_screen();
 
   /** Forward to `get_syscall_table()->call_syscall(id, registers)`. */
   void call_syscall(uint32_t id, Registers& registers) { m_syscall_table->call_syscall(id, registers); }
@@ -111,10 +131,19 @@ class Task {
   [[nodiscard]] bool is_marked_to_be_killed() const { return m_marked_kill; }
   void mark_to_be_killed() { m_marked_kill = true; }
 
+  /** Gets the number of bytes used by the framebuffers of the task windows and offscreen surfaces. */
+  [[nodiscard]] size_t get_windows_byte_size() const;
+
   [[nodiscard]] bool own_window(Window* window) const;
   void register_window(Window* window);
   void unregister_window(Window* window);
 
+  [[nodiscard]] bool own_surface(const Surface* surface) const;
+  /** Creates an offscreen surface owned by this task, or returns nullptr if out of memory or if the
+   * task already reached the limits of Surface::MAX_SURFACES_PER_TASK and Surface::MAX_BYTES_PER_TASK. */
+  Surface* create_surface(uint32_t width, uint32_t height, uint32_t flags);
+  void destroy_surface(Surface* surface);
+
   [[nodiscard]] bool own_file(File* file) const;
   void register_file(File* file);
   void unregister_file(File* file);
@@ -136,6 +165,20 @@ class Task {
   void register_pipe(PipeResource* pipe);
   void unregister_pipe(PipeResource* pipe);
 
+  /*
+   * Shared memory resources
+   */
+
+  [[nodiscard]] bool own_shared_memory(const SharedMemoryResource* shm) const;
+  /** Finds the shared memory object named @a name created by this task. */
+  [[nodiscard]] SharedMemoryResource* get_shared_memory(const char* name) const;
+  SharedMemoryResource* create_shared_memory(const char* name, size_t byte_size);
+  void register_shared_memory(SharedMemoryResource* shm);
+  /** Unmaps (if needed) @a shm from the task memory and releases the task reference. */
+  void unregister_shared_memory(SharedMemoryResource* shm);
+  /** Maps @a shm in the task memory (once) and returns its address, or 0 on failure. */
+  [[nodiscard]] VirtualAddress map_shared_memory(SharedMemoryResource* shm);
+
   /*
    * Preempt control
    */
@@ -163,6 +206,9 @@ class Task {
   TaskManager* m_manager = nullptr;
   uint64_t m_elapsed_ticks = 0;
   bool m_is_kernel = false;    // it is a kernel stack (in EL1)?
+  libk::ScopedPointer<KernelStack> m_kernel_stack;  // only for kernel tasks
+  uint64_t m_used_surface_slots[PROCESS_SURFACE_MAX_SLOTS / 64] = {};  // see reserve_surface_address()
+  VirtualAddress m_screen_address = 0;  // where the framebuffer is mapped, if the task owns the screen
   bool m_marked_kill = false;  // is the task marked to be called at the next context switch?
   int m_preempt_count = 0;
 
@@ -172,9 +218,17 @@ class Task {
 
   // Task resources
   libk::LinkedList<Window*> m_windows;
+  libk::LinkedList<Surface*> m_surfaces;
   libk::LinkedList<File*> m_open_files;
   libk::LinkedList<Dir*> m_open_dirs;
   libk::LinkedList<PipeResource*> m_open_pipes;
+
+  struct SharedMemoryMapping {
+    SharedMemoryResource* shm;
+    VirtualAddress address;  // 0 if not mapped yet
+  };
+
+  libk::LinkedList<SharedMemoryMapping> m_shared_memories;
   libk::LinkedList<MemoryChunk> m_mapped_chunks;
 
   libk::LinkedList<libk::SharedPointer<Resource>> m_resources;
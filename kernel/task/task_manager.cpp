@@ -58,20 +58,16 @@ TaskPtr TaskManager::create_task_common(bool is_kernel, Task* parent) {
 
   task->m_manager = this;
 
-  // Set parent-child relationship.
-  if (parent != nullptr) {
-    task->m_parent = parent;
-    parent->m_children.push_back(task);
-  }
-
   libk::bzero(&task->m_saved_state, sizeof(task->m_saved_state));
   task->m_saved_state.is_kernel = is_kernel;
 
   if (is_kernel) {
-    const auto stack_size = MemoryChunk::get_page_byte_size();
-    const void* stack = kmalloc(stack_size, alignof(std::max_align_t));
-    task->m_saved_state.sp = (uint64_t)stack + stack_size;
-    // FIXME: free the kernel stack once the task is killed
+    // The stack is released in Task::free_resources().
+    task->m_kernel_stack = libk::make_scoped<KernelStack>();
+    if (!task->m_kernel_stack || !task->m_kernel_stack->is_status_okay())
+      return nullptr;
+
+    task->m_saved_state.sp = task->m_kernel_stack->get_top();
   } else {
     // Create a process virtual memory view and allocate its stack.
     const auto stack_size = MemoryChunk::get_page_byte_size() * 2;
@@ -88,6 +84,13 @@ TaskPtr TaskManager::create_task_common(bool is_kernel, Task* parent) {
 
   task->m_syscall_table = m_default_syscall_table;
 
+  // Set parent-child relationship (once nothing can fail anymore, so the parent never keeps a
+  // child that was not created).
+  if (parent != nullptr) {
+    task->m_parent = parent;
+    parent->m_children.push_back(task);
+  }
+
   m_tasks.push_back(task);
 
 #if LOG_MIN_LEVEL <= LOG_TRACE_LEVEL
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstdint>
+#include <utility>
 #include <libk/utils.hpp>
 
 struct Rect {
@@ -91,6 +92,8 @@ struct Rect {
     return true;
   }
 
+  bool operator==(const Rect&) const = default;
+
   bool contains(int32_t x, int32_t y) const { return x >= x1 && x < x2 && y >= y1 && y < y2; }
 
   Rect union_with(const Rect& r) const {
@@ -117,6 +120,9 @@ struct Rect {
              libk::min(self.x2, other.x2), libk::min(self.y2, other.y2) };
   }
 
+  /** Gets this rectangle moved by (@a dx, @a dy). */
+  [[nodiscard]] Rect translated(int32_t dx, int32_t dy) const { return {x1 + dx, y1 + dy, x2 + dx, y2 + dy}; }
+
   static Rect from_edges(int32_t left, int32_t top, int32_t right, int32_t bottom) {
     return {left, top, right, bottom};
   }
@@ -0,0 +1,188 @@
+#include "wm/region.hpp"
+
+[[nodiscard]] static uint64_t area_of(const Rect& rect) {
+  return rect.has_surface() ? (uint64_t)rect.width() * rect.height() : 0;
+}
+
+/** Checks if @a a contains the whole @a b. */
+[[nodiscard]] static bool contains(const Rect& a, const Rect& b) {
+  return b.x1 >= a.x1 && b.x2 <= a.x2 && b.y1 >= a.y1 && b.y2 <= a.y2;
+}
+
+/** Checks if @a a and @a b share at least one pixel. */
+[[nodiscard]] static bool overlaps(const Rect& a, const Rect& b) {
+  return a.x1 < b.x2 && b.x1 < a.x2 && a.y1 < b.y2 && b.y1 < a.y2;
+}
+
+/** Checks if @a a and @a b share at least one pixel or one edge. */
+[[nodiscard]] static bool overlaps_or_touches(const Rect& a, const Rect& b) {
+  return a.x1 <= b.x2 && b.x1 <= a.x2 && a.y1 <= b.y2 && b.y1 <= a.y2;
+}
+
+/**
+ * Stores in @a parts the parts of @a rect outside of @a hole (which must overlap it).
+ * Returns the number of parts (at most 4):
+ * -------------------
+ * |       top       |
+ * -------------------
+ * | left | H | right|
+ * -------------------
+ * |     bottom      |
+ * -------------------
+ */
+static size_t split(const Rect& rect, const Rect& hole, Rect parts[4]) {
+  const int32_t middle_top = libk::max(rect.y1, hole.y1);
+  const int32_t middle_bottom = libk::min(rect.y2, hole.y2);
+  const Rect candidates[] = {
+      {rect.x1, rect.y1, rect.x2, middle_top},
+      {rect.x1, middle_bottom, rect.x2, rect.y2},
+      {rect.x1, middle_top, libk::max(rect.x1, hole.x1), middle_bottom},
+      {libk::min(rect.x2, hole.x2), middle_top, rect.x2, middle_bottom},
+  };
+
+  size_t nb_parts = 0;
+  for (const auto& candidate : candidates) {
+    if (candidate.has_surface())
+      parts[nb_parts++] = candidate;
+  }
+
+  return nb_parts;
+}
+
+uint64_t Region::get_area() const {
+  uint64_t area = 0;
+  for (const auto& rect : *this) {
+    area += area_of(rect);
+  }
+
+  return area;
+}
+
+Rect Region::get_bounds() const {
+  Rect bounds = {};
+  for (const auto& rect : *this) {
+    bounds = bounds.union_with(rect);
+  }
+
+  return bounds;
+}
+
+bool Region::intersects(const Rect& rect) const {
+  for (const auto& it : *this) {
+    if (overlaps(it, rect))
+      return true;
+  }
+
+  return false;
+}
+
+void Region::add(const Rect& rect) {
+  if (!rect.has_surface())
+    return;
+
+  // First, merge the new rectangle with the rectangles it overlaps or touches if their bounding
+  // box does not add more than 25% of undamaged pixels. The bounding box may overlap or contain
+  // other rectangles, so check again from the beginning each time it grows.
+  Rect new_rect = rect;
+  for (size_t i = 0; i < m_count;) {
+    const Rect existing = m_rects[i];
+    if (contains(existing, new_rect))
+      return;  // already damaged
+
+    if (contains(new_rect, existing)) {
+      remove(i);
+      continue;
+    }
+
+    if (overlaps_or_touches(existing, new_rect)) {
+      const Rect bounds = existing.union_with(new_rect);
+      const uint64_t covered_area =
+          area_of(existing) + area_of(new_rect) - area_of(existing.intersection_with(new_rect));
+      if ((area_of(bounds) - covered_area) * 4 <= area_of(bounds)) {
+        remove(i);
+        new_rect = bounds;
+        i = 0;
+        continue;
+      }
+    }
+
+    ++i;
+  }
+
+  // Then, only keep the parts of the new rectangle that are not already in the region.
+  // Each overlapped rectangle splits a piece in (at most) 4 parts, see split().
+  constexpr size_t MAX_PIECES = MAX_RECTS;
+  Rect pieces[MAX_PIECES];
+  size_t nb_pieces = 0;
+  pieces[nb_pieces++] = new_rect;
+  for (size_t i = 0; i < m_count; ++i) {
+    const Rect existing = m_rects[i];
+    for (size_t j = 0; j < nb_pieces;) {
+      const Rect piece = pieces[j];
+      if (!overlaps(existing, piece)) {
+        ++j;
+        continue;
+      }
+
+      pieces[j] = pieces[--nb_pieces];
+
+      Rect parts[4];
+      const size_t nb_parts = split(piece, existing, parts);
+      for (size_t k = 0; k < nb_parts; ++k) {
+        const Rect& part = parts[k];
+        if (nb_pieces == MAX_PIECES) {
+          // Too fragmented, degrade to the bounding box.
+          m_rects[0] = get_bounds().union_with(new_rect);
+          m_count = 1;
+          return;
+        }
+
+        // The parts do not overlap the current rectangle, no need to check them again.
+        pieces[nb_pieces++] = part;
+      }
+    }
+  }
+
+  if (m_count + nb_pieces > MAX_RECTS) {
+    // Too many rectangles, degrade to the bounding box.
+    m_rects[0] = get_bounds().union_with(new_rect);
+    m_count = 1;
+    return;
+  }
+
+  for (size_t i = 0; i < nb_pieces; ++i) {
+    m_rects[m_count++] = pieces[i];
+  }
+}
+
+bool Region::subtract(const Rect& rect) {
+  if (!rect.has_surface())
+    return true;
+
+  bool exact = true;
+  for (size_t i = 0; i < m_count;) {
+    const Rect existing = m_rects[i];
+    if (!overlaps(existing, rect)) {
+      ++i;
+      continue;
+    }
+
+    Rect parts[4];
+    const size_t nb_parts = split(existing, rect, parts);
+    if (m_count - 1 + nb_parts > MAX_RECTS) {
+      // Too fragmented, keep the whole rectangle.
+      exact = false;
+      ++i;
+      continue;
+    }
+
+    // The parts do not overlap the subtracted rectangle, so checking them
+    // again (after being moved to index i) is harmless.
+    remove(i);
+    for (size_t j = 0; j < nb_parts; ++j) {
+      m_rects[m_count++] = parts[j];
+    }
+  }
+
+  return exact;
+}
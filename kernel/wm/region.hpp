@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+
+#include "wm/geometry.hpp"
+
+/**
+ * A set of pixels of the screen, such as the damaged (to be redrawn) part of the screen
+ * accumulated between two frames, or the part of it not yet covered by opaque windows.
+ *
+ * The region is stored as a small list of non-overlapping rectangles, so no pixel is
+ * composited twice. When a rectangle is added, it is merged with the rectangles it overlaps
+ * or touches if their bounding box does not waste too much area. Otherwise, only the parts
+ * not already in the region are added. If there are too many rectangles, the region degrades
+ * to its bounding box.
+ */
+class Region {
+ public:
+  static constexpr size_t MAX_RECTS = 64;
+
+  [[nodiscard]] bool is_empty() const { return m_count == 0; }
+  [[nodiscard]] size_t get_rect_count() const { return m_count; }
+  [[nodiscard]] const Rect& get_rect(size_t index) const { return m_rects[index]; }
+  [[nodiscard]] const Rect* begin() const { return m_rects; }
+  [[nodiscard]] const Rect* end() const { return m_rects + m_count; }
+
+  /** Gets the number of pixels in the region. */
+  [[nodiscard]] uint64_t get_area() const;
+  /** Gets the bounding box of the whole region. */
+  [[nodiscard]] Rect get_bounds() const;
+  /** Checks if @a rect intersects (with a non-empty intersection) the region. */
+  [[nodiscard]] bool intersects(const Rect& rect) const;
+
+  /** Adds @a rect to the region. */
+  void add(const Rect& rect);
+  /** Removes @a rect from the region.
+   *
+   * If the region would need too many rectangles, some pixels of @a rect may be kept in
+   * the region (so the region is never smaller than expected, only larger). In that case,
+   * false is returned. */
+  bool subtract(const Rect& rect);
+  /** Empties the region. */
+  void clear() { m_count = 0; }
+
+ private:
+  void remove(size_t index) { m_rects[index] = m_rects[--m_count]; }
+
+  Rect m_rects[MAX_RECTS];
+  size_t m_count = 0;
+};  // class Region
@@ -0,0 +1,22 @@
+#include "surface.hpp"
+
+#include <libk/log.hpp>
+
+Surface::Surface(Task* task, uint32_t width, uint32_t height, uint32_t flags)
+    : m_task(task), m_width(width), m_height(height), m_translucent((flags & SYS_SF_TRANSLUCENT) != 0) {
+  KASSERT(task != nullptr);
+  KASSERT(width > 0 && width <= MAX_WIDTH && height > 0 && height <= MAX_HEIGHT);
+
+  const size_t byte_size = sizeof(uint32_t) * width * height;
+  m_pixels = libk::make_scoped<MemoryChunk>(libk::div_round_up(byte_size, MemoryChunk::get_page_byte_size()));
+  if (!m_pixels->is_status_okay()) {
+    LOG_ERROR("Failed to allocate the surface pixels.");
+    m_pixels.reset();
+    m_painter = {nullptr, 0, 0, 0};
+    return;
+  }
+
+  // The surface pixels are straight alpha colors, like the ones given to the gfx commands.
+  m_painter = graphics::Painter(get_pixels(), width, height, width);
+  m_painter.clear(0x00000000);
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <sys/window.h>
+#include <libk/memory.hpp>
+#include "graphics/graphics.hpp"
+#include "memory/memory_chunk.hpp"
+#include "wm/geometry.hpp"
+
+class Task;
+
+/**
+ * An offscreen surface: ARGB pixels allocated on the kernel side and owned by a task (see Task::create_surface()).
+ *
+ * Surfaces are drawn into with the window display lists (see SYS_GFX_CMD_SET_TARGET) and blit into windows or
+ * other surfaces by the kernel (see SYS_GFX_CMD_BLIT_SURFACE), so their pixels never cross into userspace.
+ */
+class Surface {
+ public:
+  static constexpr int32_t MAX_WIDTH = 4096;
+  static constexpr int32_t MAX_HEIGHT = 4096;
+  // The pixels are allocated on the kernel side, so the surfaces of a task are limited in number and size.
+  static constexpr size_t MAX_SURFACES_PER_TASK = 64;
+  static constexpr size_t MAX_BYTES_PER_TASK = 128 * 1024 * 1024;
+
+  /** Allocates a surface of @a width x @a height transparent pixels, @a flags being a combination of SYS_SF_XXX.
+   * Check is_status_okay() before using it. */
+  Surface(Task* task, uint32_t width, uint32_t height, uint32_t flags);
+
+  /** Checks if the pixels have been allocated. */
+  [[nodiscard]] bool is_status_okay() const { return m_pixels != nullptr; }
+
+  /** Gets the owner task of this surface. */
+  [[nodiscard]] Task* get_task() const { return m_task; }
+
+  [[nodiscard]] uint32_t get_width() const { return m_width; }
+  [[nodiscard]] uint32_t get_height() const { return m_height; }
+  /** Gets the whole surface, relative to itself. */
+  [[nodiscard]] Rect get_rect() const { return Rect::from_pos_and_size(0, 0, m_width, m_height); }
+  /** Gets the number of bytes allocated for the surface pixels. */
+  [[nodiscard]] size_t get_byte_size() const { return m_pixels ? m_pixels->get_byte_size() : 0; }
+
+  /** Gets the surface pixels, stored row by row without padding (the pitch is the width). */
+  [[nodiscard]] uint32_t* get_pixels() { return m_pixels ? (uint32_t*)m_pixels->get() : nullptr; }
+  [[nodiscard]] const uint32_t* get_pixels() const { return m_pixels ? (const uint32_t*)m_pixels->get() : nullptr; }
+  [[nodiscard]] graphics::Painter& get_painter() { return m_painter; }
+
+  /** Gets how the surface is drawn when blit: blended over the destination if it is translucent, copied otherwise. */
+  [[nodiscard]] graphics::BlendMode get_blend_mode() const {
+    return m_translucent ? graphics::BlendMode::SourceOver : graphics::BlendMode::Copy;
+  }
+
+ private:
+  // Not a SharedPointer: surfaces are destroyed with their owner task (see Task::free_resources()).
+  Task* m_task;
+  uint32_t m_width, m_height;
+  libk::ScopedPointer<MemoryChunk> m_pixels;
+  graphics::Painter m_painter;
+  bool m_translucent;
+};  // class Surface
@@ -1,11 +1,16 @@
 #include "window.hpp"
 #include "data/pika_icon.hpp"
+#include "surface.hpp"
+#include "window_manager.hpp"
 #include "memory/mem_alloc.hpp"
 
+#include <libk/log.hpp>
+
 Window::Window(const libk::SharedPointer<Task>& task) : m_task(task) {
   KASSERT(task != nullptr);
 
   m_painter = {nullptr, 0, 0, 0};
+  m_title_bar_painter = {nullptr, 0, 0, 0};
 
 #ifdef CONFIG_USE_DMA
 #ifdef CONFIG_WINDOW_LARGE_FRAMEBUFFER
@@ -16,6 +21,15 @@ Window::Window(const libk::SharedPointer<Task>& task) : m_task(task) {
 #endif  // CONFIG_USE_DMA
 }
 
+Window::~Window() {
+  // Destroying the framebuffer and the tiles bitmap removes them from the task memory, so their address
+  // ranges can be reused.
+  release_framebuffer();
+  m_tiles.reset();
+  m_task->release_surface_address(m_surface_address);
+  m_task->release_surface_address(m_tiles_address);
+}
+
 void Window::set_title(libk::StringView title) {
   delete[] m_title.get_data();
 
@@ -26,6 +40,14 @@ void Window::set_title(libk::StringView title) {
   libk::memcpy(buffer, title.get_data(), length);
   buffer[length] = '\0';
   m_title = {buffer, length};
+  m_title_layout.layout(m_painter.get_font(), buffer);
+  m_frame_dirty = true;
+}
+
+void Window::set_focus(bool focus) {
+  if (m_focus != focus)
+    m_frame_dirty = true;
+  m_focus = focus;
 }
 
 void Window::set_geometry(const Rect& rect) {
@@ -38,77 +60,460 @@ void Window::set_geometry(const Rect& rect) {
     reallocate_framebuffer();
 }
 
+Rect Window::get_opaque_rect() const {
+  if (!m_premultiplied)
+    return m_geometry;
+
+  const Rect rect = Rect::from_pos_and_size(m_geometry.x() + m_opaque_rect.x(), m_geometry.y() + m_opaque_rect.y(),
+                                            m_opaque_rect.width(), m_opaque_rect.height());
+  return rect.intersection_with(m_geometry);
+}
+
+size_t Window::get_framebuffer_byte_size() const {
+  return m_framebuffer ? m_framebuffer->get_byte_size() : 0;
+}
+
+/** Gets the rectangle covered by @a text drawn at (@a x, @a y), see Painter::draw_text(). */
+static Rect get_text_rect(PKFont font, int32_t x, int32_t y, const char* text) {
+  uint32_t width = 0, nb_lines = 0;
+  for (const char* it = text; it != nullptr; ++nb_lines) {
+    const char* line = it;
+    const uint32_t length = graphics::TextLayout::break_line(font, line, INT32_MAX, it);
+    width = libk::max(width, font.get_width(line, length));
+  }
+
+  const uint32_t height = (nb_lines - 1) * font.get_line_height() + font.get_char_height();
+  return Rect::from_pos_and_size(x, y, width, height);
+}
+
+/** Gets the rectangle covered by the line from (@a x1, @a y1) to (@a x2, @a y2). */
+static Rect get_line_rect(int32_t x1, int32_t y1, int32_t x2, int32_t y2) {
+  return Rect::from_edges(libk::min(x1, x2), libk::min(y1, y2), libk::max(x1, x2) + 1, libk::max(y1, y2) + 1);
+}
+
 void Window::clear(uint32_t argb) {
   m_painter.clear(argb);
+  mark_dirty(get_local_rect());
 }
 
 void Window::draw_line(uint32_t x1, uint32_t y1, uint32_t x2, uint32_t y2, uint32_t argb) {
   m_painter.draw_line(x1, y1, x2, y2, argb);
+  mark_dirty(get_line_rect(x1, y1, x2, y2));
 }
 
 void Window::draw_rect(uint32_t x, uint32_t y, uint32_t width, uint32_t height, uint32_t argb) {
   m_painter.draw_rect(x, y, width, height, argb);
+  mark_dirty(Rect::from_pos_and_size(x, y, width, height));
 }
 
 void Window::fill_rect(uint32_t x, uint32_t y, uint32_t width, uint32_t height, uint32_t argb) {
   m_painter.fill_rect(x, y, width, height, argb);
+  mark_dirty(Rect::from_pos_and_size(x, y, width, height));
 }
 
 void Window::draw_text(uint32_t x, uint32_t y, const char* text, uint32_t argb) {
   m_painter.draw_text(x, y, text, argb);
+  mark_dirty(get_text_rect(m_painter.get_font(), x, y, text));
 }
 
 void Window::blit(uint32_t x, uint32_t y, uint32_t width, uint32_t height, const uint32_t* argb_buffer) {
   m_painter.blit(x, y, width, height, argb_buffer);
+  mark_dirty(Rect::from_pos_and_size(x, y, width, height));
 }
 
-void Window::draw_frame() {
-  if (!m_has_frame)
+/** Moves the pixels of @a rect by (@a dx, @a dy) inside the buffer @a pixels covering @a bounds (see
+ * Window::copy_area()). Returns the destination rectangle, clipped to @a clip. */
+static Rect move_pixels(uint32_t* pixels, uint32_t pitch, const Rect& bounds, const Rect& rect, int32_t dx, int32_t dy,
+                        const Rect& clip) {
+  // Only the pixels whose source and destination are both inside the buffer (and the destination
+  // inside the clipping) are moved.
+  const Rect src = rect.intersection_with(bounds);
+  const Rect dst = src.translated(dx, dy).intersection_with(clip).intersection_with(bounds);
+  if (!dst.has_surface() || (dx == 0 && dy == 0))
+    return {0, 0, 0, 0};
+
+  // When moving down, the rows are copied from the bottom so the source rows are read before being
+  // overwritten. Within a row, memmove() handles the overlap.
+  const size_t row_size = sizeof(uint32_t) * dst.width();
+  for (int32_t i = 0; i < dst.height(); ++i) {
+    const int32_t y = dy > 0 ? dst.bottom() - 1 - i : dst.top() + i;
+    uint32_t* dst_row = pixels + (size_t)pitch * y + dst.left();
+    const uint32_t* src_row = pixels + (size_t)pitch * (y - dy) + (dst.left() - dx);
+    libk::memmove(dst_row, src_row, row_size);
+  }
+
+  return dst;
+}
+
+void Window::copy_area(const Rect& rect, int32_t dx, int32_t dy, const Rect& clip) {
+  uint32_t* framebuffer = get_framebuffer();
+  if (framebuffer == nullptr)
     return;
 
-  constexpr const uint32_t TITLE_BAR_HEIGHT = 30;
-  constexpr const graphics::Color BACKGROUND_COLOR = 0xff282828;
-  constexpr const graphics::Color BORDER_COLOR = 0xff121212;
+  mark_dirty(move_pixels(framebuffer, m_framebuffer_pitch, get_local_rect(), rect, dx, dy, clip));
+}
+
+void Window::execute_commands(const sys_gfx_cmd_t* commands, size_t count) {
+  // The commands draw into the window, or into the surface set by the last SYS_GFX_CMD_SET_TARGET.
+  // Only the drawings into the window mark tiles dirty.
+  graphics::Painter* painter = &m_painter;
+  Surface* target = nullptr;
+
+  // The clipping rectangles pushed, each one intersected with the previous ones.
+  Rect clip_stack[SYS_GFX_MAX_CLIP_DEPTH + 1];
+  size_t clip_depth = 0;
+  clip_stack[0] = get_local_rect();
+
+  for (size_t i = 0; i < count; ++i) {
+    const sys_gfx_cmd_t& command = commands[i];
+    Rect drawn = {0, 0, 0, 0};  // the area drawn by the command (before clipping)
+    switch (command.type) {
+      case SYS_GFX_CMD_CLEAR:
+        painter->clear(command.argb);
+        drawn = clip_stack[0];  // not clipped
+        break;
+      case SYS_GFX_CMD_LINE:
+        painter->draw_line(command.line.x0, command.line.y0, command.line.x1, command.line.y1, command.argb);
+        drawn = get_line_rect(command.line.x0, command.line.y0, command.line.x1, command.line.y1);
+        break;
+      case SYS_GFX_CMD_RECT:
+        painter->draw_rect(command.rect.x, command.rect.y, command.rect.width, command.rect.height, command.argb);
+        drawn = Rect::from_pos_and_size(command.rect.x, command.rect.y, command.rect.width, command.rect.height);
+        break;
+      case SYS_GFX_CMD_FILL:
+        painter->fill_rect(command.rect.x, command.rect.y, command.rect.width, command.rect.height, command.argb);
+        drawn = Rect::from_pos_and_size(command.rect.x, command.rect.y, command.rect.width, command.rect.height);
+        break;
+      case SYS_GFX_CMD_TEXT:
+        painter->draw_text(command.text.x, command.text.y, command.text.text, command.argb);
+        drawn = get_text_rect(painter->get_font(), command.text.x, command.text.y, command.text.text);
+        break;
+      case SYS_GFX_CMD_BLIT:
+        painter->blit(command.blit.x, command.blit.y, command.blit.width, command.blit.height, command.blit.pixels);
+        drawn = Rect::from_pos_and_size(command.blit.x, command.blit.y, command.blit.width, command.blit.height);
+        break;
+      case SYS_GFX_CMD_BLIT_SCALED: {
+        const sys_gfx_blit_scaled_t& blit = command.blit_scaled;
+        const auto filter = blit.filter == SYS_GFX_FILTER_BILINEAR ? graphics::ScaleFilter::Bilinear
+                                                                    : graphics::ScaleFilter::Nearest;
+        painter->blit_scaled(blit.x, blit.y, blit.width, blit.height, blit.pixels, blit.src_width, blit.src_height,
+                             filter);
+        drawn = Rect::from_pos_and_size(blit.x, blit.y, blit.width, blit.height);
+        break;
+      }
+      case SYS_GFX_CMD_BLIT_SURFACE: {
+        // The surface pixels are read directly from the kernel memory.
+        const auto* surface = (const Surface*)command.surface.surface;
+        painter->blit(command.surface.x, command.surface.y, surface->get_width(), surface->get_height(),
+                      surface->get_pixels(), surface->get_blend_mode());
+        drawn = surface->get_rect().translated(command.surface.x, command.surface.y);
+        break;
+      }
+      case SYS_GFX_CMD_COPY_AREA: {
+        const sys_gfx_copy_area_t& copy = command.copy_area;
+        const Rect rect = Rect::from_pos_and_size(copy.x, copy.y, copy.width, copy.height);
+        if (target == nullptr)
+          copy_area(rect, copy.dx, copy.dy, clip_stack[clip_depth]);  // marks the destination dirty
+        else
+          move_pixels(target->get_pixels(), target->get_width(), clip_stack[0], rect, copy.dx, copy.dy,
+                      clip_stack[clip_depth]);
+        break;
+      }
+      case SYS_GFX_CMD_SET_TARGET:
+        // Only allowed without clipping, the new target starts without clipping too.
+        painter->revert_clipping();
+        target = (Surface*)command.surface.surface;
+        painter = target != nullptr ? &target->get_painter() : &m_painter;
+        clip_stack[0] = target != nullptr ? target->get_rect() : get_local_rect();
+        break;
+      case SYS_GFX_CMD_PUSH_CLIP:
+      case SYS_GFX_CMD_POP_CLIP: {
+        if (command.type == SYS_GFX_CMD_PUSH_CLIP) {
+          const Rect rect =
+              Rect::from_pos_and_size(command.rect.x, command.rect.y, command.rect.width, command.rect.height);
+          clip_stack[clip_depth + 1] = rect.intersection_with(clip_stack[clip_depth]);
+          ++clip_depth;
+        } else {
+          --clip_depth;
+        }
+
+        // The painter clipping bounds are inclusive.
+        const Rect& clip = clip_stack[clip_depth];
+        painter->set_clipping(clip.x1, clip.y1, clip.x2 - 1, clip.y2 - 1);
+        break;
+      }
+      default:
+        KASSERT(false && "unknown gfx command");
+        break;
+    }
+
+    if (target == nullptr && drawn.has_surface())
+      mark_dirty(command.type == SYS_GFX_CMD_CLEAR ? drawn : drawn.intersection_with(clip_stack[clip_depth]));
+  }
+
+  // The painter is also used to draw the window frame, and the surfaces painters by the next lists.
+  painter->revert_clipping();
+}
+
+Rect Window::get_client_rect() const {
+  if (!m_has_frame)
+    return m_geometry;
+
+  // Inside the borders, below the title bar (it may be empty for small windows).
+  const int32_t top = libk::min(m_geometry.top() + (int32_t)TITLE_BAR_HEIGHT + 1, m_geometry.bottom());
+  return Rect::from_edges(m_geometry.left() + 1, top, m_geometry.right() - 1, libk::max(m_geometry.bottom() - 1, top));
+}
+
+bool Window::draw_frame() {
+  if (!m_has_frame || !m_frame_dirty || !m_title_bar)
+    return false;
 
-  m_painter.fill_rect(0, 0, m_geometry.width(), TITLE_BAR_HEIGHT, BACKGROUND_COLOR);
-  m_painter.draw_rect(0, 0, m_geometry.width(), m_geometry.height(), BORDER_COLOR);
-  m_painter.draw_line(0, TITLE_BAR_HEIGHT, m_geometry.width(), TITLE_BAR_HEIGHT, BORDER_COLOR);
+  // The title is dimmed when the window does not have the focus.
+  const graphics::Color title_color = m_focus ? 0xffffff : 0x8c8c8c;
+
+  auto& painter = m_title_bar_painter;
+  painter.fill_rect(0, 0, m_geometry.width(), TITLE_BAR_HEIGHT, FRAME_BACKGROUND_COLOR);
+  painter.draw_rect(0, 0, m_geometry.width(), TITLE_BAR_HEIGHT + 1, FRAME_BORDER_COLOR);
 
   // Draw the pikachu icon.
   constexpr uint32_t pika_color = 0xffffff;
   for (uint32_t i = 0; i < pika_icon_width; ++i) {
     for (uint32_t j = 0; j < pika_icon_height; ++j) {
       const uint32_t color = pika_color | (pika_icon[i + pika_icon_height * j] << 24);
-      m_painter.draw_pixel(5 + i, 2 + j, color);
+      painter.draw_pixel(5 + i, 2 + j, color);
     }
   }
 
-  const auto text_width = m_painter.get_font().get_width(m_title.get_data(), m_title.get_length());
-  const auto text_x = (m_geometry.width() - text_width) / 2;
-  const auto text_y = (TITLE_BAR_HEIGHT - m_painter.get_font().get_char_height()) / 2;
-  m_painter.draw_text(text_x, text_y, m_title.get_data(), 0xffffff);
+  const auto text_x = (m_geometry.width() - m_title_layout.get_width()) / 2;
+  const auto text_y = (TITLE_BAR_HEIGHT - painter.get_font().get_char_height()) / 2;
+  painter.draw_text(text_x, text_y, m_title_layout, title_color);
+  m_frame_dirty = false;
+  return true;
 }
 
 void Window::reallocate_framebuffer() {
+  const auto buffer_size = sizeof(uint32_t) * m_geometry.width() * m_geometry.height();
+
+#if defined(CONFIG_USE_DMA) && defined(CONFIG_WINDOW_LARGE_FRAMEBUFFER)
+  // The framebuffer is allocated once for all (and stays mapped in the task), only its layout changes.
+  (void)buffer_size;
+#else
+  // Destroying the old framebuffer also removes it from the task memory.
+  release_framebuffer();
 #ifdef CONFIG_USE_DMA
-#ifdef CONFIG_WINDOW_LARGE_FRAMEBUFFER
+  m_framebuffer = libk::make_scoped<Buffer>(buffer_size);
+#else
+  m_framebuffer = libk::make_scoped<MemoryChunk>(libk::div_round_up(buffer_size, MemoryChunk::get_page_byte_size()));
+  if (!m_framebuffer->is_status_okay()) {
+    LOG_ERROR("Failed to allocate the window framebuffer.");
+    m_framebuffer.reset();
+    m_painter = {nullptr, 0, 0, 0};
+    m_task->release_surface_address(m_surface_address);
+    m_surface_address = 0;
+    return;
+  }
+#endif  // CONFIG_USE_DMA
+
+  if (m_surface_address != 0 && !map_framebuffer_in_task(m_surface_address)) {
+    LOG_ERROR("Failed to remap the window surface in the task memory.");
+    m_task->release_surface_address(m_surface_address);
+    m_surface_address = 0;
+  }
+#endif  // CONFIG_USE_DMA && CONFIG_WINDOW_LARGE_FRAMEBUFFER
+
   // Update the painter.
-  uint32_t* framebuffer = (uint32_t*)m_framebuffer->get();
   m_framebuffer_pitch = m_geometry.width();
-  m_painter = graphics::Painter(framebuffer, m_geometry.width(), m_geometry.height(), m_framebuffer_pitch);
+  m_painter = graphics::Painter(get_framebuffer(), m_geometry.width(), m_geometry.height(), m_framebuffer_pitch);
+  m_painter.set_alpha_format(m_premultiplied ? graphics::AlphaFormat::Premultiplied : graphics::AlphaFormat::Straight);
+  reallocate_tiles();
+  reallocate_title_bar();
+  m_surface_generation++;
+  m_frame_dirty = true;
+}
+
+void Window::release_framebuffer() {
+#ifdef CONFIG_USE_DMA
+  // The DMA may still be copying it into the screen.
+  WindowManager::get().retire_framebuffer(m_framebuffer.release());
 #else
   m_framebuffer.reset();
-  const auto buffer_size = sizeof(uint32_t) * m_geometry.width() * m_geometry.height();
-  m_framebuffer = libk::make_scoped<Buffer>(buffer_size);
-  m_task->get_memory()->map_buffer(*m_framebuffer.get(), 0x0000ff0000000000, false, false);
-  m_painter =
-      graphics::Painter((uint32_t*)m_framebuffer->get(), m_geometry.width(), m_geometry.height(), m_framebuffer_pitch);
-#endif
+#endif  // CONFIG_USE_DMA
+}
+
+void Window::reallocate_tiles() {
+  m_tile_columns = libk::div_round_up(m_geometry.width(), TILE_SIZE);
+  m_tile_rows = libk::div_round_up(m_geometry.height(), TILE_SIZE);
+  m_tiles_stride = libk::div_round_up(m_tile_columns, 64u);
+  const size_t byte_size = sizeof(uint64_t) * m_tiles_stride * m_tile_rows;
+
+  if (!m_tiles || m_tiles->get_byte_size() < byte_size) {
+    // Destroying the old bitmap also removes it from the task memory.
+    m_tiles.reset();
+    const size_t nb_pages = libk::div_round_up(byte_size, MemoryChunk::get_page_byte_size());
+    m_tiles = libk::make_scoped<MemoryChunk>(libk::max<size_t>(1, nb_pages));
+    if (!m_tiles->is_status_okay()) {
+      LOG_ERROR("Failed to allocate the window tiles bitmap.");
+      m_tiles.reset();
+      m_tile_columns = m_tile_rows = m_tiles_stride = 0;
+      m_task->release_surface_address(m_tiles_address);
+      m_tiles_address = 0;
+      return;
+    }
+
+    auto memory = m_task->get_memory();
+    if (m_tiles_address != 0 &&
+        (memory == nullptr || !memory->map_chunk(*m_tiles, m_tiles_address, /* read_only= */ false,
+                                                 /* executable= */ false))) {
+      LOG_ERROR("Failed to remap the window tiles bitmap in the task memory.");
+      m_task->release_surface_address(m_tiles_address);
+      m_tiles_address = 0;
+    }
+  }
+
+  // Nothing is known to be drawn in the new framebuffer.
+  libk::bzero(m_tiles->get(), m_tiles->get_byte_size());
+}
+
+void Window::reallocate_title_bar() {
+  if (!m_has_frame)
+    return;
+
+  const size_t byte_size = sizeof(uint32_t) * m_geometry.width() * (TITLE_BAR_HEIGHT + 1);
+  if (!m_title_bar || m_title_bar->get_byte_size() < byte_size) {
+    m_title_bar.reset();
+    m_title_bar = libk::make_scoped<MemoryChunk>(libk::div_round_up(byte_size, MemoryChunk::get_page_byte_size()));
+    if (!m_title_bar->is_status_okay()) {
+      LOG_ERROR("Failed to allocate the window title bar.");
+      m_title_bar.reset();
+      m_title_bar_painter = {nullptr, 0, 0, 0};
+      return;
+    }
+  }
+
+  m_title_bar_painter = graphics::Painter((uint32_t*)m_title_bar->get(), m_geometry.width(), TITLE_BAR_HEIGHT + 1,
+                                          m_geometry.width());
+}
+
+/** Sets (if @a value) or clears the bits @a first to @a last (included) of the bitmap @a words. */
+static void set_bits(uint64_t* words, uint32_t first, uint32_t last, bool value) {
+  for (uint32_t word = first / 64; word <= last / 64; ++word) {
+    const uint32_t low = word == first / 64 ? first % 64 : 0;
+    const uint32_t high = word == last / 64 ? last % 64 : 63;
+    const uint64_t mask = (UINT64_MAX >> (63 - high)) & (UINT64_MAX << low);
+    if (value)
+      words[word] |= mask;
+    else
+      words[word] &= ~mask;
+  }
+}
+
+void Window::mark_dirty(const Rect& rect) {
+  const Rect bounds = rect.intersection_with(get_local_rect());
+  if (!bounds.has_surface())
+    return;
+
+  if (!m_tiles)
+    return;
+
+  auto* tiles = (uint64_t*)m_tiles->get();
+  const uint32_t first_column = bounds.left() / TILE_SIZE;
+  const uint32_t last_column = (bounds.right() - 1) / TILE_SIZE;
+  for (int32_t row = bounds.top() / TILE_SIZE; row <= (bounds.bottom() - 1) / TILE_SIZE; ++row) {
+    set_bits(tiles + m_tiles_stride * row, first_column, last_column, true);
+  }
+}
+
+bool Window::take_dirty_tiles(const Rect& rect, Region& region) {
+  const Rect window_rect = get_local_rect();
+  const Rect bounds = rect.intersection_with(window_rect);
+  if (!m_tiles || !bounds.has_surface())
+    return false;
+
+  auto* tiles = (uint64_t*)m_tiles->get();
+  const int32_t first_column = bounds.left() / TILE_SIZE;
+  const int32_t last_column = (bounds.right() - 1) / TILE_SIZE;
+  const auto is_dirty = [&](const uint64_t* words, int32_t column) {
+    return (words[column / 64] & (1ull << (column % 64))) != 0;
+  };
+
+  bool has_dirty_tiles = false;
+  for (int32_t row = bounds.top() / TILE_SIZE; row <= (bounds.bottom() - 1) / TILE_SIZE; ++row) {
+    uint64_t* words = tiles + m_tiles_stride * row;
+    for (int32_t column = first_column; column <= last_column; ++column) {
+      if (!is_dirty(words, column))
+        continue;
+
+      // Each run of consecutive dirty tiles of the row is added at once.
+      int32_t end = column + 1;
+      while (end <= last_column && is_dirty(words, end)) {
+        ++end;
+      }
+
+      const Rect run = Rect::from_edges(column * TILE_SIZE, row * TILE_SIZE, end * TILE_SIZE, (row + 1) * TILE_SIZE);
+      region.add(run.intersection_with(bounds));
+      has_dirty_tiles = true;
+
+      // The tiles only partially in @a rect are not entirely presented, they stay dirty.
+      for (int32_t i = column; i < end; ++i) {
+        const Rect tile = Rect::from_pos_and_size(i * TILE_SIZE, row * TILE_SIZE, TILE_SIZE, TILE_SIZE)
+                              .intersection_with(window_rect);
+        if (tile.intersection_with(bounds) == tile)
+          set_bits(words, i, i, false);
+      }
+
+      column = end;
+    }
+  }
+
+  return has_dirty_tiles;
+}
+
+bool Window::map_framebuffer_in_task(VirtualAddress address) {
+  auto memory = m_task->get_memory();
+  if (memory == nullptr)
+    return false;
+
+#ifdef CONFIG_USE_DMA
+  return memory->map_buffer(*m_framebuffer, address, /* read_only= */ false, /* executable= */ false);
 #else
-  delete[] m_framebuffer;
-  m_framebuffer = new uint32_t[m_geometry.width() * m_geometry.height()];
-  m_framebuffer_pitch = m_geometry.width();
-  libk::bzero(m_framebuffer, sizeof(uint32_t) * m_geometry.width() * m_geometry.height());
-  m_painter = graphics::Painter(m_framebuffer, m_geometry.width(), m_geometry.height(), m_framebuffer_pitch);
-#endif
+  return memory->map_chunk(*m_framebuffer, address, /* read_only= */ false, /* executable= */ false);
+#endif  // CONFIG_USE_DMA
+}
+
+VirtualAddress Window::map_tiles() {
+  if (m_tiles_address != 0)
+    return m_tiles_address;
+
+  auto memory = m_task->get_memory();
+  if (!m_tiles || memory == nullptr)
+    return 0;
+
+  const VirtualAddress address = m_task->reserve_surface_address();
+  if (address == 0 || !memory->map_chunk(*m_tiles, address, /* read_only= */ false, /* executable= */ false)) {
+    m_task->release_surface_address(address);
+    return 0;
+  }
+
+  m_tiles_address = address;
+  return m_tiles_address;
+}
+
+VirtualAddress Window::map_surface() {
+  if (m_surface_address != 0)
+    return m_surface_address;
+
+  if (!m_framebuffer || m_task->get_memory() == nullptr)
+    return 0;
+
+  const VirtualAddress address = m_task->reserve_surface_address();
+  if (address == 0)
+    return 0;
+
+  if (!map_framebuffer_in_task(address)) {
+    m_task->release_surface_address(address);
+    return 0;
+  }
+
+  m_surface_address = address;
+  return m_surface_address;
 }
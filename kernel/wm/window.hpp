@@ -1,12 +1,16 @@
 #pragma once
 
+#include <sys/window.h>
 #include <libk/memory.hpp>
 #include <libk/string_view.hpp>
 #include "graphics/graphics.hpp"
 #include "memory/buffer.hpp"
+#include "memory/memory_chunk.hpp"
 #include "task/task.hpp"
 #include "wm/geometry.hpp"
 #include "wm/message_queue.hpp"
+#include "wm/region.hpp"
+#include "wm/window_stack.hpp"
 
 class Window {
  public:
@@ -21,8 +25,11 @@ class Window {
   static constexpr int32_t MAX_HEIGHT = UINT16_MAX;
 #endif  // CONFIG_WINDOW_LARGE_FRAMEBUFFER
   static constexpr size_t MAX_TITLE_LENGTH = 255;
+  /** The framebuffer damage is tracked by square tiles of TILE_SIZE pixels (see mark_dirty()). */
+  static constexpr int32_t TILE_SIZE = SYS_WINDOW_TILE_SIZE;
 
   Window(const libk::SharedPointer<Task>& task);
+  ~Window();
 
   /** Gets the owner task of this window. All windows have an owner. */
   [[nodiscard]] libk::SharedPointer<Task> get_task() const { return m_task; }
@@ -38,37 +45,111 @@ class Window {
   void set_visibility(bool visible) { m_visible = visible; }
 
   [[nodiscard]] bool has_focus() const { return m_focus; }
+  /** The frame decoration depends on the focus, it is redrawn when the focus changes. */
+  void set_focus(bool focus);
+
+  /** Checks if the window framebuffer stores premultiplied colors. Such windows may be translucent
+   * and are blended over what is below them, other windows are opaque. */
+  [[nodiscard]] bool is_premultiplied() const { return m_premultiplied; }
 
   [[nodiscard]] Rect get_geometry() const { return m_geometry; }
   void set_geometry(const Rect& rect);
 
+  /** Gets the part of the window (in screen coordinates) that is fully opaque, and so hides
+   * everything below it. This is the whole window, except for premultiplied windows where it
+   * is the rectangle given to set_opaque_rect() (empty by default). */
+  [[nodiscard]] Rect get_opaque_rect() const;
+  /** Sets the fully opaque part of a premultiplied window, relative to the window top-left corner. */
+  void set_opaque_rect(const Rect& rect) { m_opaque_rect = rect; }
+
   [[nodiscard]] MessageQueue& get_message_queue() { return m_message_queue; }
   [[nodiscard]] const MessageQueue& get_message_queue() const { return m_message_queue; }
 
   // Graphics functions:
+  [[nodiscard]] uint32_t* get_framebuffer() { return m_framebuffer ? (uint32_t*)m_framebuffer->get() : nullptr; }
+  [[nodiscard]] const uint32_t* get_framebuffer() const {
+    return m_framebuffer ? (const uint32_t*)m_framebuffer->get() : nullptr;
+  }
 #ifdef CONFIG_USE_DMA
-  [[nodiscard]] uint32_t* get_framebuffer() { return (uint32_t*)m_framebuffer->get(); }
-  [[nodiscard]] const uint32_t* get_framebuffer() const { return (const uint32_t*)m_framebuffer->get(); }
   [[nodiscard]] DMA::Address get_framebuffer_dma_addr() const { return m_framebuffer->get_dma_address(); }
-#else
-  [[nodiscard]] uint32_t* get_framebuffer() { return m_framebuffer; }
-  [[nodiscard]] const uint32_t* get_framebuffer() const { return m_framebuffer; }
 #endif  // CONFIG_USE_DMA
   [[nodiscard]] uint32_t get_framebuffer_pitch() const { return m_framebuffer_pitch; }
+  /** Gets the number of bytes allocated for the window framebuffer. */
+  [[nodiscard]] size_t get_framebuffer_byte_size() const;
   void clear(uint32_t argb = 0x000000);
   void draw_line(uint32_t x1, uint32_t y1, uint32_t x2, uint32_t y2, uint32_t argb);
   void draw_rect(uint32_t x, uint32_t y, uint32_t width, uint32_t height, uint32_t argb);
   void fill_rect(uint32_t x, uint32_t y, uint32_t width, uint32_t height, uint32_t argb);
   void draw_text(uint32_t x, uint32_t y, const char* text, uint32_t argb);
   void blit(uint32_t x, uint32_t y, uint32_t width, uint32_t height, const uint32_t* argb_buffer);
-  // Draw the window frame decoration (title bar + borders).
-  void draw_frame();
+  /** Moves the pixels of @a rect by (@a dx, @a dy), the source and destination may overlap (see
+   * sys_gfx_copy_area()). Only the destination is marked dirty. */
+  void copy_area(const Rect& rect, int32_t dx, int32_t dy) { copy_area(rect, dx, dy, get_local_rect()); }
+  /** Executes the display list @a commands in order (see sys_gfx_submit()). The commands must have been
+   * validated: the types are known, the pointers valid, the surfaces owned by the window task and the
+   * clipping pushes and pops balanced. */
+  void execute_commands(const sys_gfx_cmd_t* commands, size_t count);
+  /** Draws the title bar into its own buffer (see get_title_bar()), if it was invalidated since it was
+   * last drawn. Returns true if it was redrawn. The client never draws over it, as the compositor takes
+   * the frame decoration (title bar + borders) from there and not from the framebuffer. */
+  bool draw_frame();
+  /** Marks the frame decoration to be redrawn at the next composite. */
+  void invalidate_frame() { m_frame_dirty = true; }
+  /** Gets the part of the window (in screen coordinates) composited from the framebuffer: the whole
+   * window, or what is inside the frame decoration if it has one. */
+  [[nodiscard]] Rect get_client_rect() const;
+  /** Gets the pixels of the title bar, with the top border and the line below it (TITLE_BAR_HEIGHT + 1
+   * rows of the window width), or nullptr if the window has no frame or it could not be allocated. */
+  [[nodiscard]] const uint32_t* get_title_bar() const {
+    return m_title_bar ? (const uint32_t*)m_title_bar->get() : nullptr;
+  }
+
+  /** Maps (if not already done) the window framebuffer read/write into the owner task memory.
+   * The surface stays at the same address across resizes, only its pitch may change.
+   * @returns the address of the surface in the task memory, or 0 in case of failure. */
+  [[nodiscard]] VirtualAddress map_surface();
+  /** Gets the surface generation, incremented each time the framebuffer is reallocated or its
+   * layout changes (so clients that render directly know they must query the pitch again). */
+  [[nodiscard]] uint32_t get_surface_generation() const { return m_surface_generation; }
+
+  /** Marks the tiles of the framebuffer covering @a rect (relative to the window) as dirty.
+   * The drawing functions mark the tiles they draw into, direct rendering clients mark them
+   * through the tiles bitmap shared with them (see map_tiles()). */
+  void mark_dirty(const Rect& rect);
+  /** Adds the dirty tiles of @a rect (relative to the window, clipped to it) to @a region, and marks
+   * the ones fully inside @a rect as clean. Returns false if there is no dirty tile in @a rect. */
+  bool take_dirty_tiles(const Rect& rect, Region& region);
+  /** Maps (if not already done) the dirty tiles bitmap read/write into the owner task memory.
+   * Like the surface, it stays at the same address across resizes but its layout may change.
+   * @returns the address of the bitmap in the task memory, or 0 in case of failure. */
+  [[nodiscard]] VirtualAddress map_tiles();
+  [[nodiscard]] uint32_t get_tile_columns() const { return m_tile_columns; }
+  [[nodiscard]] uint32_t get_tile_rows() const { return m_tile_rows; }
+  /** Gets the number of 64-bit words per row of tiles in the bitmap. */
+  [[nodiscard]] uint32_t get_tiles_stride() const { return m_tiles_stride; }
 
  private:
+  static constexpr uint32_t TITLE_BAR_HEIGHT = SYS_WINDOW_TITLE_BAR_HEIGHT;
+  static constexpr uint32_t FRAME_BACKGROUND_COLOR = 0xff282828;
+  static constexpr uint32_t FRAME_BORDER_COLOR = 0xff121212;
+
+  /** Gets the whole window, relative to itself. */
+  [[nodiscard]] Rect get_local_rect() const {
+    return Rect::from_pos_and_size(0, 0, m_geometry.width(), m_geometry.height());
+  }
+  /** Implements copy_area(), the destination being clipped to @a clip. */
+  void copy_area(const Rect& rect, int32_t dx, int32_t dy, const Rect& clip);
+
   void reallocate_framebuffer();
+  /** Frees the framebuffer, see WindowManager::retire_framebuffer(). */
+  void release_framebuffer();
+  bool map_framebuffer_in_task(VirtualAddress address);
+  void reallocate_tiles();
+  void reallocate_title_bar();
 
  private:
   friend class WindowManager;
+  friend class WindowStack;
 
   // The task that owns this window. A window is always owned by a unique task.
   // When the task is killed, all child windows are destroyed.
@@ -81,24 +162,58 @@ class Window {
   // The window allocates the title pointer on the kernel side.
   // It is free when the window is destroyed or when the title is modified.
   libk::StringView m_title;
+  // The line breaks of the title, computed once each time the title is modified.
+  graphics::TextLayout m_title_layout;
 
   // The window size and position (relative to the screen).
   Rect m_geometry;
+  // The fully opaque part of a premultiplied window (relative to the window).
+  Rect m_opaque_rect = {0, 0, 0, 0};
+
+  // The links of the window in the window manager stack (see WindowStack).
+  WindowStack* m_stack = nullptr;
+  Window* m_above = nullptr;
+  Window* m_below = nullptr;
 
   // The framebuffer is allocated on the kernel side. It is updated each time
   // the window geometry changes. The size of the framebuffer is the same
-  // as the window size (see m_geometry variable).
+  // as the window size (see m_geometry variable). It is page backed, so it
+  // can be mapped in the owner task memory (see map_surface()).
 #ifdef CONFIG_USE_DMA
   libk::ScopedPointer<Buffer> m_framebuffer;
 #else
-  uint32_t* m_framebuffer;
+  libk::ScopedPointer<MemoryChunk> m_framebuffer;
 #endif
   uint32_t m_framebuffer_pitch = 0;
 
+  // Address of the framebuffer in the owner task memory (0 if not mapped).
+  VirtualAddress m_surface_address = 0;
+  uint32_t m_surface_generation = 0;
+
+  // The dirty tiles bitmap: the bit (x % 64) of the word (y * m_tiles_stride + x / 64) is set if the
+  // tile (x, y) was drawn since it was last presented. It is page backed, so it can be shared with
+  // the owner task (see map_tiles()), and reallocated only when the window grows.
+  libk::ScopedPointer<MemoryChunk> m_tiles;
+  uint32_t m_tile_columns = 0, m_tile_rows = 0;
+  uint32_t m_tiles_stride = 0;
+  // Address of the tiles bitmap in the owner task memory (0 if not mapped).
+  VirtualAddress m_tiles_address = 0;
+
   graphics::Painter m_painter;
 
+  // The title bar pixels, drawn by draw_frame() (only for windows with a frame). It is kept apart
+  // from the framebuffer, so what the client draws never requires to draw it again.
+  libk::ScopedPointer<MemoryChunk> m_title_bar;
+  graphics::Painter m_title_bar_painter;
+
+  // Sequence number of the compositor frame that will display the last present (see
+  // WindowManager::block_task_until_presented()).
+  uint64_t m_present_frame = 0;
+
   // Some flags about the window:
   bool m_has_frame : 1 = true;  // should we draw the window frame (title bar + borders)?
   bool m_visible : 1 = false;   // the window is currently visible?
   bool m_focus : 1 = false;     // the window currently has the focus (receives keyboard inputs)?
+  bool m_premultiplied : 1 = false;  // the framebuffer stores premultiplied alpha colors?
+  bool m_frame_dirty : 1 = true;     // the frame decoration must be redrawn (see draw_frame())?
 };  // class Window
@@ -1,19 +1,23 @@
 #include "wm/window_manager.hpp"
 #include "graphics/graphics.hpp"
 #include "hardware/framebuffer.hpp"
+#include "hardware/irq/irq_manager.hpp"
 #include "hardware/timer.hpp"
 #include "input/mouse_input.hpp"
+#include "memory/mem_alloc.hpp"
 #include "libk/log.hpp"
 #include "task/task_manager.hpp"
 #include "wm/window.hpp"
 
-#include <algorithm>
+#include <sys/file.h>
+#include <sys/syscall.h>
 
-#ifdef CONFIG_USE_DMA
-#include "hardware/dma/request.hpp"
-#endif  // CONFIG_USE_DMA
+#include "fs/filesystem.hpp"
+#include "graphics/raw_image.hpp"
 
+#ifdef CONFIG_WALLPAPER_JPEG
 #include "graphics/stb_image.h"
+#endif  // CONFIG_WALLPAPER_JPEG
 
 #ifdef CONFIG_HAS_CURSOR
 static constexpr uint32_t CURSOR_DATA[] = {
@@ -33,9 +37,6 @@ static constexpr uint32_t CURSOR_DATA[] = {
     0x00000000, 0x00000100, 0x00000000, 0x00000000, 0x00000000, 0xff000000, 0xffffffff, 0xfffffeff, 0xff010000,
     0x00000001, 0x00000000, 0x00000000, 0x00000001, 0x00000000, 0xff000000, 0xfffffffe, 0xffffffff, 0xff010000,
     0x00000001, 0x00000100, 0x00000000, 0x00000000, 0x00000000, 0x00010000, 0xff000000, 0xff000100, 0x00000000};
-
-static constexpr uint32_t CURSOR_HEIGHT = 16;
-static constexpr uint32_t CURSOR_WIDTH = 9;
 #endif // CONFIG_HAS_CURSOR
 
 WindowManager* WindowManager::g_instance = nullptr;
@@ -47,14 +48,21 @@ WindowManager::WindowManager() {
   auto& fb = FrameBuffer::get();
   m_is_supported = fb.is_initialized();
   if (m_is_supported) {
-    m_screen_buffer = fb.get_buffer();
     m_screen_width = fb.get_width();
     m_screen_height = fb.get_height();
     m_screen_pitch = fb.get_pitch();
-    m_screen_buffer = fb.get_buffer();
+    m_screen_format = fb.get_pixel_format();
+    m_screen_buffer = (uint8_t*)fb.get_buffer(fb.get_front_buffer_index());
 
 #ifdef CONFIG_USE_DMA
-    m_screen_buffer_dma_addr = DMA::get_dma_bus_address((VirtualAddress)m_screen_buffer, false);
+    // The buffers of the framebuffer are contiguous, also for the DMA.
+    m_screen_buffers_dma_addr = DMA::get_dma_bus_address((VirtualAddress)fb.get_buffer(0), false);
+    m_screen_buffer_dma_addr = m_screen_buffers_dma_addr;
+
+    // Each channel raises an interrupt at the end of its chain, see end_frame().
+    for (const auto& channel : m_dma_channels) {
+      IRQManager::register_irq_handler(channel.get_irq(), &dma_interrupt_handler, this);
+    }
 #endif  // CONFIG_USE_DMA
   }
 
@@ -63,11 +71,7 @@ WindowManager::WindowManager() {
 }
 
 [[nodiscard]] bool WindowManager::is_valid(Window* window) const {
-  if (window == nullptr)
-    return false;
-
-  const auto it = std::find(m_windows.begin(), m_windows.end(), window);
-  return it != m_windows.end();
+  return window != nullptr && m_windows.contains(window);
 }
 
 Window* WindowManager::create_window(const libk::SharedPointer<Task>& task, uint32_t flags) {
@@ -80,10 +84,11 @@ Window* WindowManager::create_window(const libk::SharedPointer<Task>& task, uint
 
   if ((flags & SYS_WF_NO_FRAME) != 0)
     window->m_has_frame = false;
+  if ((flags & SYS_WF_PREMULTIPLIED) != 0)
+    window->m_premultiplied = true;
 
   task->register_window(window);
-  ++m_window_count;
-  m_windows.push_back(window);
+  m_windows.push_bottom(window);
 
   // Focus the window.
   focus_window(window);
@@ -101,17 +106,18 @@ void WindowManager::destroy_window(Window* window) {
     unfocus_window(window);
   }
 
-  const auto it = std::find(m_windows.begin(), m_windows.end(), window);
-  m_windows.erase(it);
+  if (m_pending_move.window == window)
+    cancel_pending_move();
+
+  m_windows.remove(window);
 
-  --m_window_count;
   if (window->is_visible())
     update(window->get_geometry());
   delete window;
 
   // Focus another window if needed.
   if (!m_windows.is_empty())
-    focus_window(m_windows.back());
+    focus_window(m_windows.get_bottom());
 }
 
 void WindowManager::set_window_visibility(Window* window, bool visible) {
@@ -187,8 +193,105 @@ void WindowManager::set_window_geometry(Window* window, Rect rect) {
     post_message(window, message);
   }
 
-  if (moved || resized)
-    update(old_rect.union_with(rect));
+  if (!moved && !resized)
+    return;
+
+  // A window only moved is copied on the screen by the compositor (see take_pending_move()). If it
+  // moves again before the next frame, the pixels are still where it was first displayed.
+  if (m_pending_move.window == window && !resized)
+    return;
+
+  cancel_pending_move();
+  if (!resized && window->is_visible()) {
+    m_pending_move = {window, old_rect};
+    return;
+  }
+
+  update(old_rect.union_with(rect));
+}
+
+void WindowManager::cancel_pending_move() {
+  if (m_pending_move.window == nullptr)
+    return;
+
+  update(m_pending_move.from);
+  update(m_pending_move.window->get_geometry());
+  m_pending_move.window = nullptr;
+}
+
+bool WindowManager::can_copy_pending_move() const {
+  Window* window = m_pending_move.window;
+  const Rect& from = m_pending_move.from;
+  const Rect to = window->get_geometry();
+
+  // The pixels on the screen must be exactly the window ones: opaque, with an up to date frame
+  // decoration and not damaged since they were composited.
+  if (!window->is_visible() || window->is_premultiplied() || window->m_frame_dirty || m_damage.intersects(from))
+    return false;
+
+  // And nothing must be above the window, at the old or the new position.
+  const Rect bounds = from.union_with(to);
+  for (auto* above = WindowStack::get_above(window); above != nullptr; above = WindowStack::get_above(above)) {
+    if (above->is_visible() && above->get_geometry().intersection_with(bounds).has_surface())
+      return false;
+  }
+
+  return true;
+}
+
+void WindowManager::take_pending_move() {
+  const Rect& from = m_pending_move.from;
+  const Rect to = m_pending_move.window->get_geometry();
+  m_frame.move_from = from;
+  m_frame.move_to = to;
+  m_frame.changes.add(to);
+
+  // Only the parts of the old position not covered by the new one are composited.
+  Region exposed;
+  exposed.add(from);
+  exposed.subtract(to);
+  for (const auto& rect : exposed) {
+    m_damage.add(rect);
+    m_frame.changes.add(rect);
+  }
+
+  m_frame.damaged_pixels += exposed.get_area();
+  m_pending_move.window = nullptr;
+}
+
+void WindowManager::copy_moved_pixels() {
+  const Rect& from = m_frame.move_from;
+  const Rect& to = m_frame.move_to;
+  const int32_t dx = to.x() - from.x();
+  const int32_t dy = to.y() - from.y();
+
+  // The rows are copied in the order that reads each source row before it is overwritten.
+  const uint32_t bytes_per_pixel = graphics::get_bytes_per_pixel(m_screen_format);
+  const size_t row_size = (size_t)from.width() * bytes_per_pixel;
+  for (int32_t i = 0; i < to.height(); ++i) {
+    const int32_t y = dy > 0 ? to.bottom() - 1 - i : to.top() + i;
+    libk::memmove(get_screen_pixel(to.left(), y), get_screen_pixel(to.left() - dx, y - dy), row_size);
+  }
+}
+
+void WindowManager::set_window_opaque_rect(Window* window, const Rect& rect) {
+  KASSERT(is_valid(window));
+
+  window->set_opaque_rect(rect);
+
+  // What is below the window may have to be drawn again.
+  if (window->is_visible())
+    update(window->get_geometry());
+}
+
+void WindowManager::set_window_title(Window* window, libk::StringView title) {
+  KASSERT(is_valid(window));
+
+  window->set_title(title);
+
+  // The title bar is redrawn with the new title.
+  if (window->is_visible())
+    update(window->get_geometry());
 }
 
 void WindowManager::set_window_geometry(Window* window, int32_t x, int32_t y, int32_t w, int32_t h) {
@@ -230,12 +333,9 @@ void WindowManager::focus_window(Window* window) {
   post_message(window, message);
 
   m_focus_window = window;
-  m_focus_window->m_focus = true;
+  m_focus_window->set_focus(true);
 
-  auto it = std::find(m_windows.begin(), m_windows.end(), window);
-  KASSERT(it != m_windows.end());
-  m_windows.erase(it);
-  m_windows.push_front(window);
+  m_windows.raise(window);
   update(m_focus_window->get_geometry());
 }
 
@@ -246,7 +346,9 @@ void WindowManager::unfocus_window(Window* window) {
     return;
 
   if (m_focus_window != nullptr) {
-    m_focus_window->m_focus = false;
+    m_focus_window->set_focus(false);
+    // Redraw the window without the focus border and with its unfocused title bar.
+    update(m_focus_window->get_geometry());
 
     // Send focus out messsage.
     sys_message_t message;
@@ -255,11 +357,10 @@ void WindowManager::unfocus_window(Window* window) {
     post_message(m_focus_window, message);
   }
 
-  Window* new_focus_window = nullptr;
-  for (auto* w : m_windows) {
-    // TODO: give focus to the nearest window (according to depth).
-    if (w != window && w->is_visible())
-      new_focus_window = w;
+  // Give the focus to the nearest visible window (according to depth).
+  Window* new_focus_window = m_windows.get_top();
+  while (new_focus_window != nullptr && (new_focus_window == window || !new_focus_window->is_visible())) {
+    new_focus_window = WindowStack::get_below(new_focus_window);
   }
 
   m_focus_window = nullptr;
@@ -274,7 +375,26 @@ void WindowManager::post_message(sys_message_t message) {
   if (!m_is_supported)
     return;
 
-  // Handle window manager specific shortcuts.
+  // The compositor is rendering a frame with interrupts enabled, see compositor_main().
+  if (m_rendering) {
+    sys_message_t* last = m_deferred_message_count > 0 ? &m_deferred_messages[m_deferred_message_count - 1] : nullptr;
+    if (message.id == SYS_MSG_MOUSEMOVE && last != nullptr && last->id == SYS_MSG_MOUSEMOVE) {
+      last->param1 += message.param1;
+      last->param2 += message.param2;
+    } else if (m_deferred_message_count < MAX_DEFERRED_MESSAGES) {
+      m_deferred_messages[m_deferred_message_count++] = message;
+    }
+    return;
+  }
+
+  // Handle window manager specific shortcuts (disabled while a task owns the screen,
+  // moving or resizing windows makes no sense as they are not drawn).
+  if (m_screen_owner != nullptr) {
+    if (m_focus_window != nullptr)
+      post_message(m_focus_window, message);
+    return;
+  }
+
   if (message.id == SYS_MSG_KEYDOWN) {
     if (handle_key_event(message.param1))
       return;  // the key event was handled by the window manager, do not propagate it.
@@ -306,8 +426,8 @@ bool WindowManager::post_message(Window* window, sys_message_t message) {
 void WindowManager::present_window(Window* window) {
   KASSERT(is_valid(window));
 
-  // Redraw the window.
-  update(window->get_geometry());
+  const auto window_rect = window->get_geometry();
+  present_window(window, 0, 0, window_rect.width(), window_rect.height());
 }
 
 void WindowManager::present_window(Window* window, uint32_t x, uint32_t y, uint32_t width, uint32_t height) {
@@ -320,33 +440,54 @@ void WindowManager::present_window(Window* window, uint32_t x, uint32_t y, uint3
   width = libk::min<uint32_t>(width, window_rect.width() - x);
   height = libk::min<uint32_t>(height, window_rect.height() - y);
 
-  // Redraw the window.
-  update(Rect::from_pos_and_size(window_rect.x() + x, window_rect.y() + y, width, height));
+  // Only the dirty tiles of the presented area are composited. If there is none, the client rendered
+  // directly into its surface without marking the tiles, so the whole area is redrawn.
+  const Rect rect = Rect::from_pos_and_size(x, y, width, height);
+  Region dirty_region;
+  if (!window->take_dirty_tiles(rect, dirty_region))
+    dirty_region.add(rect);
+
+  window->m_present_frame = m_frame_sequence + 1;
+  for (const Rect& dirty_rect : dirty_region) {
+    update(Rect::from_pos_and_size(window_rect.x() + dirty_rect.x(), window_rect.y() + dirty_rect.y(),
+                                   dirty_rect.width(), dirty_rect.height()));
+  }
+}
+
+bool WindowManager::block_task_until_presented(Window* window, const libk::SharedPointer<Task>& task) {
+  KASSERT(is_valid(window));
+
+  if (!m_is_supported || window->m_present_frame <= m_frame_sequence)
+    return false;
+
+  m_present_wait_list.add(task);
+  return true;
 }
 
 void WindowManager::mosaic_layout() {
-  if (m_window_count == 0)
+  const size_t window_count = m_windows.get_size();
+  if (window_count == 0)
     return;
 
-  // Let nb_columns be ceil(sqrt(m_window_count)).
-  int nb_columns = libk::isqrt(m_window_count);  // isqrt returns the floor value
-  if ((size_t)(nb_columns) * (size_t)(nb_columns) != m_window_count)
+  // Let nb_columns be ceil(sqrt(window_count)).
+  int nb_columns = libk::isqrt(window_count);  // isqrt returns the floor value
+  if ((size_t)(nb_columns) * (size_t)(nb_columns) != window_count)
     nb_columns += 1;  // convert it into ceil(sqrt(...))
 
-  const int nb_rows = (int)libk::div_round_up(m_window_count, nb_columns);
+  const int nb_rows = (int)libk::div_round_up(window_count, nb_columns);
 
   const int window_width = m_screen_width / nb_columns;
   const int window_height = m_screen_height / nb_rows;
 
   int current_idx = 0;
   int i = 0, j = 0;
-  for (auto* window : m_windows) {
+  for (auto* window = m_windows.get_top(); window != nullptr; window = WindowStack::get_below(window)) {
     const auto x = i * window_width;
     const auto y = j * window_height;
 
     int32_t width = window_width;
     // If we are the last window, take all the remaining place in the last row.
-    const bool is_last = (size_t)(current_idx + 1) == m_window_count;
+    const bool is_last = (size_t)(current_idx + 1) == window_count;
     if (is_last) {
       width = (nb_columns - i) * window_width;
     }
@@ -363,6 +504,31 @@ void WindowManager::mosaic_layout() {
   }
 }
 
+bool WindowManager::acquire_screen(Task* task) {
+  KASSERT(task != nullptr);
+
+  if (!m_is_supported)
+    return false;
+
+  if (m_screen_owner != nullptr)
+    return m_screen_owner == task;
+
+  LOG_INFO("Task {} acquired the screen", task->get_id());
+  m_screen_owner = task;
+  return true;
+}
+
+void WindowManager::release_screen(Task* task) {
+  if (m_screen_owner == nullptr || m_screen_owner != task)
+    return;
+
+  LOG_INFO("Task {} released the screen", task->get_id());
+  m_screen_owner = nullptr;
+
+  // The task may have drawn anywhere, redraw everything.
+  update();
+}
+
 void WindowManager::update() {
   update({0, 0, m_screen_width, m_screen_height});
 }
@@ -371,23 +537,395 @@ void WindowManager::update(const Rect& rect) {
   if (!m_is_supported)
     return;
 
-  DMARequestQueue request_queue{};
+  Rect clipped_rect = rect;
+  clip_rect_to_screen(clipped_rect);
+  m_damage.add(clipped_rect);
+}
+
+void WindowManager::start_compositor() {
+  if (!m_is_supported)
+    return;
+
+  auto& task_manager = TaskManager::get();
+  auto task = task_manager.create_kernel_task(&WindowManager::compositor_main);
+  if (task == nullptr) {
+    LOG_CRITICAL("Failed to create the compositor task");
+    return;
+  }
 
-  // Draw the windows and the background.
-  draw_windows(rect, request_queue);
+  // Above the applications, so a frame is not delayed by a busy task.
+  task_manager.set_task_priority(task, Scheduler::DEFAULT_PRIORITY + 1);
+  task_manager.wake_task(task);
+}
+
+void WindowManager::compositor_main() {
+  auto& window_manager = get();
+
+  uint64_t next_frame = GenericTimer::get_elapsed_time_in_micros();
+  while (true) {
+    window_manager.wait_for_flip();
+
+    // Windows are only modified by system calls and interrupt handlers (which both run with
+    // interrupts disabled), so the frame is prepared with interrupts disabled. The pixels are
+    // then rendered with interrupts enabled: the task is not preempted (so no system call runs)
+    // and the input events are deferred until the frame is rendered (see post_message()).
+    IRQManager::disable_irq_interrupts();
+    if (window_manager.prepare_frame()) {
+      auto task = Task::current();
+      task->disable_preempt();
+      window_manager.m_rendering = true;
+      IRQManager::enable_irq_interrupts();
+
+      window_manager.render_frame();
+
+      IRQManager::disable_irq_interrupts();
+      window_manager.m_rendering = false;
+      task->enable_preempt();
+      window_manager.end_frame();
+      window_manager.post_deferred_messages();
+    }
+    IRQManager::enable_irq_interrupts();
+
+    // Sleep until the next frame. If late, do not try to catch up.
+    next_frame += FRAME_INTERVAL_US;
+    const uint64_t now = GenericTimer::get_elapsed_time_in_micros();
+    if (now >= next_frame) {
+      next_frame = now;
+      sys_yield();
+    } else {
+      sys_usleep(next_frame - now);
+    }
+  }
+}
 
+bool WindowManager::prepare_frame() {
 #ifdef CONFIG_USE_DMA
-  request_queue.execute_and_wait(m_dma_channel);
+  // The copies of the previous frame are still running. The damage accumulated
+  // since then will be composited at the next frame.
+  if (m_dma_running_chains > 0)
+    return false;
 #endif  // CONFIG_USE_DMA
 
+  // The task owning the screen draws directly into it. The whole screen is
+  // damaged when the screen is released.
+  if (m_screen_owner != nullptr) {
+    m_damage.clear();
+    m_pending_move.window = nullptr;
 #ifdef CONFIG_HAS_CURSOR
-  // Draw the cursor.
-  auto cursor_rect = Rect::from_pos_and_size(m_cursor_x, m_cursor_y, CURSOR_WIDTH, CURSOR_HEIGHT);
-  clip_rect_to_screen(cursor_rect);
+    m_cursor_drawn_rect = {0, 0, 0, 0};  // overwritten by the task
+#endif  // CONFIG_HAS_CURSOR
+  }
 
-  if (cursor_rect.intersects(rect))
-    draw_cursor();
-#endif // CONFIG_HAS_CURSOR
+  m_frame.start = GenericTimer::get_elapsed_time_in_micros();
+  m_frame.damaged_pixels = m_damage.get_area();
+  m_frame.focus_window = m_focus_window;
+  m_frame.focus_rect = m_focus_window != nullptr ? m_focus_window->get_geometry() : Rect(0, 0, 0, 0);
+
+  // The pixels of a moved window are reused if possible, otherwise it is composited again.
+  const bool copy_move = m_pending_move.window != nullptr && can_copy_pending_move();
+  if (!copy_move)
+    cancel_pending_move();
+
+#ifdef CONFIG_HAS_CURSOR
+  // The cursor is only redrawn if it has moved since the last frame (all the mouse moves
+  // in between are coalesced) or if the damage overwrites it. Otherwise, the pixels saved
+  // below it are still valid and nothing is done.
+  m_frame.redraw_cursor = m_screen_owner == nullptr && (get_cursor_rect() != m_cursor_drawn_rect ||
+                                                        m_damage.intersects(m_cursor_drawn_rect));
+  // The cursor must not be copied with the moved window.
+  if (copy_move && (m_cursor_drawn_rect.intersection_with(m_pending_move.from).has_surface() ||
+                    m_cursor_drawn_rect.intersection_with(m_pending_move.window->get_geometry()).has_surface()))
+    m_frame.redraw_cursor = true;
+#endif  // CONFIG_HAS_CURSOR
+
+  // Nothing is flipped if nothing changes. Otherwise, if no buffer can be rendered into
+  // without tearing (a flip is still pending), the damage is kept for the next frame.
+  m_frame.flip = !m_damage.is_empty() || m_frame.redraw_cursor || copy_move;
+  if (m_frame.flip && !select_back_buffer())
+    return false;
+
+  m_frame.changes = m_damage;
+
+#ifdef CONFIG_HAS_CURSOR
+  if (m_frame.redraw_cursor) {
+    m_frame.damaged_pixels += (uint64_t)m_cursor_drawn_rect.width() * m_cursor_drawn_rect.height();
+    m_frame.changes.add(m_cursor_drawn_rect);
+  }
+#endif  // CONFIG_HAS_CURSOR
+
+  m_frame.copy_move = copy_move;
+  if (copy_move)
+    take_pending_move();
+
+  // The visible rectangles and the frame decorations may allocate memory, which can not be done
+  // with interrupts enabled. They are ready before the frame is rendered.
+  m_visible_rect_count = 0;
+  if (!m_damage.is_empty()) {
+    compute_visible_rects();
+    Window* previous_window = nullptr;
+    for (size_t i = 0; i < m_visible_rect_count; ++i) {
+      Window* window = m_visible_rects[i].window;
+      if (window == nullptr || window == previous_window)
+        continue;
+
+      // The frame decoration is only redrawn when it was invalidated (see Window::draw_frame()).
+      if (window->draw_frame())
+        m_stats_period_frame_redraws++;
+      previous_window = window;
+    }
+
+    m_damage.clear();
+  }
+
+  return true;
+}
+
+void WindowManager::render_frame() {
+  if (m_frame.flip)
+    copy_stale_region();
+
+#ifdef CONFIG_HAS_CURSOR
+  // Before compositing the damage, the cursor is erased so the screen only contains the
+  // windows, and the pixels saved again after it.
+  if (m_frame.redraw_cursor)
+    erase_cursor();
+#endif  // CONFIG_HAS_CURSOR
+
+  if (m_frame.copy_move)
+    copy_moved_pixels();
+
+  // Draw the visible parts of the windows and the background from the bottom to the top,
+  // so translucent windows are blended over what is below them.
+  for (size_t i = m_visible_rect_count; i-- > 0;) {
+    const VisibleRect& visible = m_visible_rects[i];
+    if (visible.window == nullptr)
+      draw_background(visible.rect);
+    else
+      draw_window(visible.window, visible.rect);
+  }
+}
+
+void WindowManager::end_frame() {
+#ifdef CONFIG_USE_DMA
+  // The frame is finished by the DMA interrupt handler, once all the copies are done.
+  if (start_dma_chains())
+    return;
+#endif  // CONFIG_USE_DMA
+
+  finish_frame();
+}
+
+void WindowManager::post_deferred_messages() {
+  for (size_t i = 0; i < m_deferred_message_count; ++i) {
+    post_message(m_deferred_messages[i]);
+  }
+
+  m_deferred_message_count = 0;
+}
+
+void WindowManager::finish_frame() {
+  // Draw the focus border to inform the user what window has the focus.
+  if (m_frame.focus_window != nullptr) {
+    for (size_t i = 0; i < m_visible_rect_count; ++i) {
+      const VisibleRect& visible = m_visible_rects[i];
+      if (visible.window == m_frame.focus_window)
+        draw_focus_border(m_frame.focus_rect, visible.rect);
+    }
+  }
+
+#ifdef CONFIG_HAS_CURSOR
+  if (m_frame.redraw_cursor) {
+    const Rect cursor_rect = get_cursor_rect();
+    m_frame.damaged_pixels += (uint64_t)cursor_rect.width() * cursor_rect.height();
+    m_frame.changes.add(cursor_rect);
+    draw_cursor(cursor_rect);
+  }
+#endif  // CONFIG_HAS_CURSOR
+
+  if (m_frame.flip)
+    present_back_buffer();
+
+  if (m_frame.damaged_pixels > 0) {
+    const uint64_t now = GenericTimer::get_elapsed_time_in_micros();
+    update_stats(now, now - m_frame.start, m_frame.damaged_pixels);
+  } else {
+    update_stats(m_frame.start, 0, 0);
+  }
+
+  // All presents done until now are visible.
+  ++m_frame_sequence;
+  m_present_wait_list.wake_all();
+}
+
+bool WindowManager::select_back_buffer() {
+  auto& fb = FrameBuffer::get();
+  const int32_t index = fb.get_back_buffer_index();
+  if (index < 0)
+    return false;
+
+  m_back_buffer_index = index;
+  m_screen_buffer = (uint8_t*)fb.get_buffer(index);
+#ifdef CONFIG_USE_DMA
+  m_screen_buffer_dma_addr = m_screen_buffers_dma_addr + (VirtualAddress)fb.get_byte_size() * index;
+#endif  // CONFIG_USE_DMA
+
+  if (fb.get_buffer_count() == 1)
+    return true;  // the displayed buffer, always up to date
+
+  // The damage is composited anyway, it is not copied forward (see copy_stale_region()).
+  Region& stale = m_stale_regions[index];
+  for (const auto& rect : m_damage) {
+    stale.subtract(rect);
+  }
+
+  return true;
+}
+
+void WindowManager::wait_for_flip() {
+  auto& fb = FrameBuffer::get();
+  if (fb.get_back_buffer_index() >= 0)
+    return;
+
+  // The mailbox is also used by system calls, so no other task must run during the request.
+  auto task = Task::current();
+  task->disable_preempt();
+  fb.wait_for_vsync();
+  task->enable_preempt();
+}
+
+void WindowManager::copy_stale_region() {
+  // Copy forward the parts of the screen the buffer misses. Then the buffer is the same as the
+  // displayed one, except the damage that is being composited.
+  auto& fb = FrameBuffer::get();
+  Region& stale = m_stale_regions[m_back_buffer_index];
+  const auto copy_span = graphics::get_convert_span(m_screen_format, m_screen_format, graphics::BlendMode::Copy);
+  const auto* front_buffer = (const uint8_t*)fb.get_buffer(fb.get_front_buffer_index());
+  const uint32_t bytes_per_pixel = graphics::get_bytes_per_pixel(m_screen_format);
+  for (const auto& rect : stale) {
+    for (int32_t y = rect.y1; y < rect.y2; ++y) {
+      const size_t offset = (rect.x1 + m_screen_pitch * y) * bytes_per_pixel;
+      copy_span(m_screen_buffer + offset, front_buffer + offset, rect.width(), rect.x1, y);
+    }
+  }
+
+  stale.clear();
+}
+
+void WindowManager::present_back_buffer() {
+  auto& fb = FrameBuffer::get();
+  // The task that acquired the screen (while the DMA was running) draws into the displayed
+  // buffer, it must stay displayed. The whole screen is damaged when the screen is released.
+  if (fb.get_buffer_count() == 1 || m_screen_owner != nullptr)
+    return;
+
+  if (!fb.flip(m_back_buffer_index)) {
+    LOG_ERROR("[wm] Failed to flip the framebuffer.");
+    // The changes are not visible, composite them again at the next frame.
+    for (const auto& rect : m_frame.changes) {
+      m_damage.add(rect);
+    }
+    return;
+  }
+
+  // All the other buffers miss the changes of the frame.
+  for (uint32_t i = 0; i < fb.get_buffer_count(); ++i) {
+    if (i == m_back_buffer_index)
+      continue;
+
+    for (const auto& rect : m_frame.changes) {
+      m_stale_regions[i].add(rect);
+    }
+  }
+}
+
+void WindowManager::compute_visible_rects() {
+  m_visible_rect_count = 0;
+#ifdef CONFIG_USE_DMA
+  m_frame.use_dma = true;
+#endif  // CONFIG_USE_DMA
+
+  // Walk the windows from the top to the bottom. Each one is visible in the part of the
+  // damage not yet covered by the opaque windows above it. As the damage rectangles do
+  // not overlap, each pixel of a window is drawn at most once.
+  m_uncovered = m_damage;
+  for (auto* window = m_windows.get_top(); window != nullptr && !m_uncovered.is_empty();
+       window = WindowStack::get_below(window)) {
+    if (!window->is_visible())
+      continue;
+
+    const Rect geometry = window->get_geometry();
+    for (const auto& rect : m_uncovered) {
+      const Rect intersection = rect.intersection_with(geometry);
+      if (intersection.has_surface())
+        add_visible_rect(window, intersection);
+    }
+
+#ifdef CONFIG_USE_DMA
+    // Windows are copied by the DMA, even translucent ones (see draw_window()). The copies run
+    // concurrently on several channels and with the CPU drawing, so they must not overlap. If the
+    // region is too fragmented to remove the whole window, the windows below may overlap it and
+    // the frame is drawn by the CPU, from the bottom to the top.
+    if (!m_uncovered.subtract(geometry))
+      m_frame.use_dma = false;
+#else
+    m_uncovered.subtract(window->get_opaque_rect());
+#endif  // CONFIG_USE_DMA
+  }
+
+  // What is not covered by any opaque window shows the background.
+  for (const auto& rect : m_uncovered) {
+    add_visible_rect(nullptr, rect);
+  }
+}
+
+void WindowManager::add_visible_rect(Window* window, const Rect& rect) {
+  if (m_visible_rect_count == m_visible_rect_capacity) {
+    const size_t new_capacity = libk::max<size_t>(2 * m_visible_rect_capacity, Region::MAX_RECTS);
+    auto* new_rects = new VisibleRect[new_capacity];
+    if (new_rects == nullptr) {
+      LOG_ERROR("[wm] Failed to allocate the visible rectangles.");
+      return;
+    }
+
+    for (size_t i = 0; i < m_visible_rect_count; ++i) {
+      new_rects[i] = m_visible_rects[i];
+    }
+
+    delete[] m_visible_rects;
+    m_visible_rects = new_rects;
+    m_visible_rect_capacity = new_capacity;
+  }
+
+  m_visible_rects[m_visible_rect_count++] = {window, rect};
+}
+
+void WindowManager::update_stats(uint64_t now, uint64_t composite_time, uint64_t damaged_pixels) {
+  if (damaged_pixels > 0) {
+    m_stats.frame_count++;
+    m_stats.damaged_pixels = damaged_pixels;
+    m_stats.last_composite_us = composite_time;
+
+    m_stats_period_frames++;
+    m_stats_period_composite_time += composite_time;
+    m_stats_period_max_composite_time = libk::max<uint32_t>(m_stats_period_max_composite_time, composite_time);
+  }
+
+  // Statistics over a period are published once the period (one second) has elapsed.
+  const uint64_t period = now - m_stats_period_start;
+  if (period < 1000000)
+    return;
+
+  m_stats.frames_per_second = (m_stats_period_frames * 1000000 + period / 2) / period;
+  m_stats.average_composite_us =
+      m_stats_period_frames > 0 ? m_stats_period_composite_time / m_stats_period_frames : 0;
+  m_stats.max_composite_us = m_stats_period_max_composite_time;
+  m_stats.frame_redraws_per_second = (m_stats_period_frame_redraws * 1000000 + period / 2) / period;
+
+  m_stats_period_start = now;
+  m_stats_period_frames = 0;
+  m_stats_period_composite_time = 0;
+  m_stats_period_max_composite_time = 0;
+  m_stats_period_frame_redraws = 0;
 }
 
 void WindowManager::clip_rect_to_screen(Rect& rect) {
@@ -397,49 +935,96 @@ void WindowManager::clip_rect_to_screen(Rect& rect) {
   rect.y2 = libk::min(m_screen_height, rect.y2);
 }
 
-void WindowManager::draw_background(const Rect& rect, DMARequestQueue& request_queue) {
+void WindowManager::draw_background(const Rect& rect) {
   if (rect.is_null())
     return;
 
-  if (m_wallpaper == nullptr) {
-    // No wallpaper found. Fill the background.
-    // TODO
-    return;
-  }
-
+  // The wallpaper covers the top left of the screen (all of it if it has the screen size).
+  const int32_t wallpaper_right = libk::min(rect.right(), (int32_t)m_wallpaper_width);
+  const int32_t wallpaper_bottom = libk::min(rect.bottom(), (int32_t)m_wallpaper_height);
+  if (rect.left() < wallpaper_right && rect.top() < wallpaper_bottom) {
+    const Rect wallpaper_rect = Rect::from_edges(rect.left(), rect.top(), wallpaper_right, wallpaper_bottom);
 #if defined(CONFIG_USE_DMA) && defined(CONFIG_USE_DMA_FOR_WALLPAPER)
-  const auto framebuffer_dma_addr = m_wallpaper->get_dma_address();
-  const auto src_stride = 0;
-  const auto dst_stride = sizeof(uint32_t) * (m_screen_pitch - m_screen_width);
-  auto* request =
-      DMA::Request::memcpy_2d(framebuffer_dma_addr, m_screen_buffer_dma_addr, sizeof(uint32_t) * (m_wallpaper_width),
-                              m_wallpaper_height, src_stride, dst_stride);
-  request_queue.add(request);
+    const uint32_t pitch = m_wallpaper_pitch / sizeof(uint32_t);
+    const size_t offset = wallpaper_rect.left() + pitch * wallpaper_rect.top();
+    copy_with_dma(wallpaper_rect, (const uint32_t*)m_wallpaper_dma_buffer->get() + offset,
+                  m_wallpaper_dma_buffer->get_dma_address() + sizeof(uint32_t) * offset, pitch);
 #else
-  (void)request_queue;
-
-  for (int32_t x = rect.left(); x < rect.right(); ++x) {
-    for (int32_t y = rect.top(); y < rect.bottom(); ++y) {
-      m_screen_buffer[x + m_screen_pitch * y] = m_wallpaper[x + m_wallpaper_width * y];
+    // A plain copy of each row when the wallpaper is in the screen format.
+    const auto copy_span = graphics::get_convert_span(m_screen_format, m_wallpaper_format, graphics::BlendMode::Copy,
+                                                      graphics::AlphaFormat::Straight, SCREEN_DITHERING);
+    const uint32_t bpp = graphics::get_bytes_per_pixel(m_wallpaper_format);
+    const uint8_t* row = m_wallpaper + wallpaper_rect.left() * bpp + (size_t)m_wallpaper_pitch * wallpaper_rect.top();
+    for (int32_t y = wallpaper_rect.top(); y < wallpaper_rect.bottom(); ++y, row += m_wallpaper_pitch) {
+      copy_span(get_screen_pixel(wallpaper_rect.left(), y), row, wallpaper_rect.width(), wallpaper_rect.left(), y);
     }
-  }
 #endif  // CONFIG_USE_DMA && CONFIG_USE_DMA_FOR_WALLPAPER
+  }
+
+  // Fill the background outside the wallpaper: at its right, then below it.
+  const auto fill_span = graphics::get_blend_solid_span(m_screen_format, SCREEN_DITHERING);
+  const int32_t fill_left = libk::max(rect.left(), (int32_t)m_wallpaper_width);
+  for (int32_t y = rect.top(); y < wallpaper_bottom && fill_left < rect.right(); ++y) {
+    fill_span(get_screen_pixel(fill_left, y), rect.right() - fill_left, BACKGROUND_COLOR, fill_left, y);
+  }
+
+  for (int32_t y = libk::max(rect.top(), wallpaper_bottom); y < rect.bottom(); ++y) {
+    fill_span(get_screen_pixel(rect.left(), y), rect.width(), BACKGROUND_COLOR, rect.left(), y);
+  }
 }
 
-void WindowManager::draw_window(Window* window, const Rect& dst_rect, DMARequestQueue& request_queue) {
-#ifndef CONFIG_USE_DMA
-  (void)request_queue;
-#endif  // !CONFIG_USE_DMA
+void WindowManager::draw_window(Window* window, const Rect& dst_rect) {
+  // The frame decoration is not taken from the framebuffer (see Window::draw_frame()).
+  const Rect client_rect = dst_rect.intersection_with(window->get_client_rect());
+  if (client_rect.has_surface())
+    draw_window_client(window, client_rect);
+  if (window->m_has_frame)
+    draw_window_frame(window, dst_rect);
+}
 
-  if (!window->is_visible())
-    return;
+void WindowManager::draw_window_frame(Window* window, const Rect& clip) {
+  const Rect& geometry = window->m_geometry;
+  const int32_t title_bar_bottom = libk::min(geometry.top() + (int32_t)Window::TITLE_BAR_HEIGHT + 1, geometry.bottom());
+  const auto fill_span = graphics::get_blend_solid_span(m_screen_format, SCREEN_DITHERING);
+
+  // The title bar, with the top border and the line below it.
+  const Rect title_bar =
+      Rect::from_edges(geometry.left(), geometry.top(), geometry.right(), title_bar_bottom).intersection_with(clip);
+  const uint32_t* title_bar_pixels = window->get_title_bar();
+  const auto copy_span = graphics::get_convert_span(m_screen_format, graphics::PixelFormat::ARGB8888,
+                                                    graphics::BlendMode::Copy, graphics::AlphaFormat::Straight,
+                                                    SCREEN_DITHERING);
+  for (int32_t y = title_bar.top(); y < title_bar.bottom() && title_bar.has_surface(); ++y) {
+    void* dst = get_screen_pixel(title_bar.left(), y);
+    if (title_bar_pixels == nullptr) {
+      fill_span(dst, title_bar.width(), Window::FRAME_BACKGROUND_COLOR, title_bar.left(), y);
+      continue;
+    }
 
+    const size_t offset = (title_bar.left() - geometry.left()) + (size_t)geometry.width() * (y - geometry.top());
+    copy_span(dst, title_bar_pixels + offset, title_bar.width(), title_bar.left(), y);
+  }
+
+  // The other borders are solid lines.
+  const Rect borders[3] = {
+      Rect::from_edges(geometry.left(), title_bar_bottom, geometry.left() + 1, geometry.bottom()),
+      Rect::from_edges(geometry.right() - 1, title_bar_bottom, geometry.right(), geometry.bottom()),
+      Rect::from_edges(geometry.left() + 1, libk::max(geometry.bottom() - 1, title_bar_bottom), geometry.right() - 1,
+                       geometry.bottom()),
+  };
+  for (const auto& border : borders) {
+    const Rect rect = border.intersection_with(clip);
+    for (int32_t y = rect.top(); y < rect.bottom() && rect.has_surface(); ++y) {
+      fill_span(get_screen_pixel(rect.left(), y), rect.width(), Window::FRAME_BORDER_COLOR, rect.left(), y);
+    }
+  }
+}
+
+void WindowManager::draw_window_client(Window* window, const Rect& dst_rect) {
   const Rect& src_rect = window->m_geometry;
   if (!src_rect.intersects(dst_rect))
     return;
 
-  window->draw_frame();
-
   uint32_t x1 = 0, x2 = src_rect.width();
   uint32_t y1 = 0, y2 = src_rect.height();
 
@@ -462,125 +1047,213 @@ void WindowManager::draw_window(Window* window, const Rect& dst_rect, DMARequest
 
   // Blit the framebuffer into the screen.
 #ifdef CONFIG_USE_DMA
-  const auto framebuffer_dma_addr =
-      window->get_framebuffer_dma_addr() + sizeof(uint32_t) * (x1 + framebuffer_pitch * y1);
-  const auto screen_dma_addr =
-      m_screen_buffer_dma_addr + sizeof(uint32_t) * (src_rect.x() + x1 + m_screen_pitch * (src_rect.y() + y1));
-  const auto src_stride = sizeof(uint32_t) * (framebuffer_pitch - (x2 - x1));
-  const auto dst_stride = sizeof(uint32_t) * (m_screen_pitch - (x2 - x1));
-  auto* request = DMA::Request::memcpy_2d(framebuffer_dma_addr, screen_dma_addr, sizeof(uint32_t) * (x2 - x1), y2 - y1,
-                                          src_stride, dst_stride);
-  request_queue.add(request);
+  // Premultiplied windows are copied too (the DMA can not blend), so all windows are opaque.
+  const size_t offset = x1 + framebuffer_pitch * y1;
+  copy_with_dma(Rect::from_pos_and_size(src_rect.x() + x1, src_rect.y() + y1, x2 - x1, y2 - y1),
+                framebuffer + offset, window->get_framebuffer_dma_addr() + sizeof(uint32_t) * offset,
+                framebuffer_pitch);
 #else
-  for (uint32_t src_x = x1, dst_x = src_rect.x() + x1; src_x < x2; ++src_x, dst_x++) {
-    for (uint32_t src_y = y1, dst_y = src_rect.y() + y1; src_y < y2; ++src_y, dst_y++) {
-      const auto color = framebuffer[src_x + framebuffer_pitch * src_y];
-      m_screen_buffer[dst_x + m_screen_pitch * dst_y] = color;
-    }
+  // Premultiplied windows may be translucent, what is below them has already been drawn
+  // (see render_frame()). Other windows are opaque.
+  const auto mode = window->is_premultiplied() ? graphics::BlendMode::SourceOver : graphics::BlendMode::Copy;
+  const auto blend_span = graphics::get_convert_span(m_screen_format, graphics::PixelFormat::ARGB8888, mode,
+                                                     graphics::AlphaFormat::Premultiplied, SCREEN_DITHERING);
+  const int32_t dst_x = src_rect.x() + x1;
+  for (uint32_t src_y = y1, dst_y = src_rect.y() + y1; src_y < y2; ++src_y, dst_y++) {
+    blend_span(get_screen_pixel(dst_x, dst_y), framebuffer + x1 + framebuffer_pitch * src_y, x2 - x1, dst_x, dst_y);
   }
 #endif  // CONFIG_USE_DMA
+}
 
-  // Draw the focus border to inform the user what window has the focus.
-  if (window->has_focus()) {
-    graphics::Painter painter(m_screen_buffer, m_screen_width, m_screen_height, m_screen_pitch);
-    painter.set_clipping(dst_rect.x1, dst_rect.y1, dst_rect.x2, dst_rect.y2);
-    const auto window_rect = window->get_geometry();
-    painter.draw_rect(window_rect.x(), window_rect.y(), window_rect.width(), window_rect.height(), 3,
-                      0xAA6BA4B8);
+void WindowManager::draw_focus_border(const Rect& rect, const Rect& clip) {
+  static constexpr int32_t THICKNESS = 3;
+  static constexpr uint32_t COLOR = 0xAA6BA4B8;
+
+  // Four bands inside the rectangle, or the whole rectangle if they would overlap.
+  Rect bands[4] = {
+      Rect::from_pos_and_size(rect.x(), rect.y(), rect.width(), THICKNESS),
+      Rect::from_pos_and_size(rect.x(), rect.bottom() - THICKNESS, rect.width(), THICKNESS),
+      Rect::from_pos_and_size(rect.x(), rect.y() + THICKNESS, THICKNESS, rect.height() - 2 * THICKNESS),
+      Rect::from_pos_and_size(rect.right() - THICKNESS, rect.y() + THICKNESS, THICKNESS, rect.height() - 2 * THICKNESS),
+  };
+  size_t nb_bands = 4;
+  if (rect.width() <= 2 * THICKNESS || rect.height() <= 2 * THICKNESS) {
+    bands[0] = rect;
+    nb_bands = 1;
   }
-}
 
-void WindowManager::draw_windows_helper(libk::LinkedList<Window*>::Iterator it,
-                                        const Rect& rect,
-                                        DMARequestQueue& request_queue) {
-  if (rect.is_null())
-    return;
+  const auto blend_solid_span = graphics::get_blend_solid_span(m_screen_format, SCREEN_DITHERING);
+  for (size_t i = 0; i < nb_bands; ++i) {
+    const Rect band = bands[i].intersection_with(clip);
+    if (!band.has_surface())
+      continue;
 
-  auto* window = *it;
-  const auto window_rect = window->get_geometry();
-  const auto intersection = rect.intersection_with(window_rect);
-  if (!window->is_visible() || intersection.is_null()) {
-    if (it.has_next())
-      return draw_windows_helper(++it, rect, request_queue);
+    for (int32_t y = band.top(); y < band.bottom(); ++y) {
+      blend_solid_span(get_screen_pixel(band.left(), y), band.width(), COLOR, band.left(), y);
+    }
+  }
+}
 
-    // No more windows. Draw the background.
-    draw_background(rect, request_queue);
+#ifdef CONFIG_USE_DMA
+void WindowManager::copy_with_dma(const Rect& dst_rect,
+                                  const uint32_t* src,
+                                  DMA::Address src_dma_addr,
+                                  uint32_t src_pitch) {
+  // The DMA only copies bytes, the pixels are converted to another screen format by the CPU. The
+  // CPU also copies all the frame if the visible rectangles overlap (see compute_visible_rects()).
+  if (m_screen_format != graphics::PixelFormat::ARGB8888 || !m_frame.use_dma) {
+    const auto copy_span = graphics::get_convert_span(m_screen_format, graphics::PixelFormat::ARGB8888,
+                                                      graphics::BlendMode::Copy, graphics::AlphaFormat::Premultiplied,
+                                                      SCREEN_DITHERING);
+    for (int32_t y = dst_rect.top(); y < dst_rect.bottom(); ++y) {
+      copy_span(get_screen_pixel(dst_rect.left(), y), src, dst_rect.width(), dst_rect.left(), y);
+      src += src_pitch;
+    }
     return;
   }
 
-  // We decompose the update rectangle into 5 rectangles:
-  // A, B, C, D, and E with E the part of the update rectangle that
-  // intersects with the current window (e.g. E = intersection).
-  // --------------------
-  // |     |  C   |     |
-  // |     --------     |
-  // |  A  |  E   |  B  |
-  // |     --------     |
-  // |     |  D   |     |
-  // --------------------
-  // We then draw the current window with the rect E, and recursively
-  // update A, B, C and D with the next window.
+  // Large copies are split in two halves (by rows), one for each channel. Otherwise,
+  // the copy is added to the chain with the fewer bytes to copy.
+  const uint64_t byte_count = sizeof(uint32_t) * (uint64_t)dst_rect.width() * dst_rect.height();
+  const int32_t nb_parts = (byte_count >= DMA_SPLIT_THRESHOLD && dst_rect.height() >= 2) ? NB_DMA_CHANNELS : 1;
+
+  const uint32_t width = dst_rect.width();
+  int32_t y = 0;
+  for (int32_t part = 0; part < nb_parts; ++part) {
+    const int32_t height = (dst_rect.height() - y) / (nb_parts - part);
+    const size_t src_offset = src_pitch * y;
+    const size_t dst_offset = dst_rect.x() + m_screen_pitch * (dst_rect.y() + y);
+
+    auto* chain = &m_dma_chains[0];
+    for (auto& it : m_dma_chains) {
+      if (it.get_byte_count() < chain->get_byte_count())
+        chain = &it;
+    }
 
-  const Rect A = {rect.x(), rect.y(), intersection.left(), rect.bottom()};
-  const Rect B = {intersection.right(), rect.y(), rect.right(), rect.bottom()};
-  const Rect C = {intersection.left(), rect.y(), intersection.right(), intersection.top()};
-  const Rect D = {intersection.left(), intersection.bottom(), intersection.right(), rect.bottom()};
+    const bool added = chain->add_memcpy_2d(
+        m_dma_ring, src_dma_addr + sizeof(uint32_t) * src_offset, m_screen_buffer_dma_addr + sizeof(uint32_t) * dst_offset,
+        sizeof(uint32_t) * width, height, sizeof(uint32_t) * (src_pitch - width),
+        sizeof(uint32_t) * (m_screen_pitch - width));
+    if (!added) {
+      // No more control blocks, copy with the CPU (the visible rectangles do not overlap
+      // when the DMA is used, so the order with the DMA copies does not matter).
+      for (int32_t j = 0; j < height; ++j) {
+        graphics::blend_span((uint32_t*)m_screen_buffer + dst_offset + m_screen_pitch * j,
+                             src + src_offset + src_pitch * j, width, graphics::BlendMode::Copy);
+      }
+    }
 
-  // Draw the window.
-  draw_window(window, intersection, request_queue);
+    y += height;
+  }
+}
 
-  if (!it.has_next()) {
-    // No more windows. Draw the background.
-    draw_background(A, request_queue);
-    draw_background(B, request_queue);
-    draw_background(C, request_queue);
-    draw_background(D, request_queue);
-    return;
+bool WindowManager::start_dma_chains() {
+  m_dma_running_chains = 0;
+  for (size_t i = 0; i < NB_DMA_CHANNELS; ++i) {
+    auto& chain = m_dma_chains[i];
+    if (chain.is_empty())
+      continue;
+
+    chain.enable_completion_interrupt();
+    if (m_dma_channels[i].execute_chain(chain, m_dma_ring)) {
+      ++m_dma_running_chains;
+    } else {
+      // Should never happen, the channels are only used by the compositor.
+      LOG_ERROR("[wm] Failed to start a DMA channel.");
+      chain.clear();
+      update();
+    }
   }
 
-  ++it;
+  if (m_dma_running_chains > 0)
+    return true;
 
-  // Update the other parts.
-  draw_windows_helper(it, A, request_queue);
-  draw_windows_helper(it, B, request_queue);
-  draw_windows_helper(it, C, request_queue);
-  draw_windows_helper(it, D, request_queue);
+  m_dma_ring.release_until(m_dma_ring.get_mark());
+  return false;
 }
 
-void WindowManager::draw_windows(const Rect& rect, DMARequestQueue& request_queue) {
-  if (m_windows.is_empty()) {
-    draw_background(rect, request_queue);
+void WindowManager::retire_framebuffer(Buffer* buffer) {
+  if (buffer == nullptr)
+    return;
+
+  if (m_dma_running_chains == 0) {
+    delete buffer;
     return;
   }
 
-  // Draw the windows from the top to the bottom.
-  draw_windows_helper(m_windows.begin(), rect, request_queue);
+  // The task must not see it anymore, its address may be reused right away.
+  buffer->unmap_from_processes();
+  m_retired_framebuffers.push_back(buffer);
 }
 
-#ifdef CONFIG_HAS_CURSOR
-void WindowManager::draw_cursor() {
-  const uint32_t x = m_cursor_x;
-  const uint32_t y = m_cursor_y;
+void WindowManager::dma_interrupt_handler(void* handle) {
+  auto* window_manager = (WindowManager*)handle;
+  for (auto& channel : window_manager->m_dma_channels) {
+    if (!channel.acknowledge_interrupt())
+      continue;
 
-  // Clip the cursor to the screen (to avoid drawing outside the framebuffer...).
-  const uint32_t cursor_width = libk::min(CURSOR_WIDTH, m_screen_width - x);
-  const uint32_t cursor_height = libk::min(CURSOR_HEIGHT, m_screen_height - y);
-
-  // Draw the cursor.
-  for (uint32_t i = 0; i < cursor_width; ++i) {
-    for (uint32_t j = 0; j < cursor_height; ++j) {
-      const uint32_t color = CURSOR_DATA[i + j * CURSOR_WIDTH];
-      if ((color & 0xff000000) == 0)
-        continue;
-      m_screen_buffer[x + i + (y + j) * m_screen_pitch] = color;
+    if (channel.has_error())
+      LOG_ERROR("[wm] DMA error while compositing.");
+
+    KASSERT(window_manager->m_dma_running_chains > 0);
+    if (--window_manager->m_dma_running_chains > 0)
+      continue;
+
+    // All the copies of the frame are done.
+    for (auto& chain : window_manager->m_dma_chains) {
+      chain.clear();
     }
+
+    window_manager->m_dma_ring.release_until(window_manager->m_dma_ring.get_mark());
+    while (!window_manager->m_retired_framebuffers.is_empty()) {
+      delete window_manager->m_retired_framebuffers.pop_front();
+    }
+
+    window_manager->finish_frame();
+  }
+}
+#endif  // CONFIG_USE_DMA
+
+#ifdef CONFIG_HAS_CURSOR
+Rect WindowManager::get_cursor_rect() {
+  // Clip the cursor to the screen (to avoid drawing outside the framebuffer...).
+  auto rect = Rect::from_pos_and_size(m_cursor_x, m_cursor_y, CURSOR_WIDTH, CURSOR_HEIGHT);
+  clip_rect_to_screen(rect);
+  return rect;
+}
+
+void WindowManager::draw_cursor(const Rect& rect) {
+  KASSERT(rect.width() <= (int32_t)CURSOR_WIDTH && rect.height() <= (int32_t)CURSOR_HEIGHT);
+
+  const auto save_span = graphics::get_convert_span(m_screen_format, m_screen_format, graphics::BlendMode::Copy);
+  const auto draw_span = graphics::get_convert_span(m_screen_format, graphics::PixelFormat::ARGB8888,
+                                                    graphics::BlendMode::SourceOver, graphics::AlphaFormat::Straight,
+                                                    SCREEN_DITHERING);
+  const size_t save_under_pitch = CURSOR_WIDTH * graphics::get_bytes_per_pixel(m_screen_format);
+  for (int32_t j = 0; j < rect.height(); ++j) {
+    void* screen_row = get_screen_pixel(rect.x(), rect.y() + j);
+
+    // Save the pixels below the cursor, then draw it.
+    save_span((uint8_t*)m_cursor_save_under + j * save_under_pitch, screen_row, rect.width(), 0, 0);
+    draw_span(screen_row, CURSOR_DATA + j * CURSOR_WIDTH, rect.width(), rect.x(), rect.y() + j);
   }
+
+  m_cursor_drawn_rect = rect;
 }
 
-bool WindowManager::handle_mouse_move_event(int32_t dx, int32_t dy) {
-  const int32_t previous_x = m_cursor_x;
-  const int32_t previous_y = m_cursor_y;
+void WindowManager::erase_cursor() {
+  const Rect& rect = m_cursor_drawn_rect;
+  const auto restore_span = graphics::get_convert_span(m_screen_format, m_screen_format, graphics::BlendMode::Copy);
+  const size_t save_under_pitch = CURSOR_WIDTH * graphics::get_bytes_per_pixel(m_screen_format);
+  for (int32_t j = 0; j < rect.height(); ++j) {
+    restore_span(get_screen_pixel(rect.x(), rect.y() + j), (uint8_t*)m_cursor_save_under + j * save_under_pitch,
+                 rect.width(), rect.x(), rect.y() + j);
+  }
 
+  m_cursor_drawn_rect = {0, 0, 0, 0};
+}
+
+bool WindowManager::handle_mouse_move_event(int32_t dx, int32_t dy) {
   // Update cursor position.
   m_cursor_x += dx;
   m_cursor_y += dy;
@@ -589,24 +1262,14 @@ bool WindowManager::handle_mouse_move_event(int32_t dx, int32_t dy) {
   m_cursor_x = libk::clamp(m_cursor_x, 0, m_screen_width);
   m_cursor_y = libk::clamp(m_cursor_y, 0, m_screen_height);
 
-  // Check if the cursor has moved.
-  if (m_cursor_x == previous_x && m_cursor_y == previous_y)
-    return false;
-
-  // Update the previous cursor position.
-  auto previous_rect = Rect::from_pos_and_size(previous_x, previous_y, CURSOR_WIDTH, CURSOR_HEIGHT);
-  clip_rect_to_screen(previous_rect);
-
-  // Redraw the windows and background at the previous cursor position.
-  // The update function will also draw the cursor at the new position.
-  update(previous_rect);
+  // Nothing is damaged: the compositor moves the cursor at the next frame (see prepare_frame()).
   return false;
 }
 
 bool WindowManager::handle_mouse_click_event(int button_type, bool is_pressed) {
   if (button_type == SYS_MOUSE_BUTTON_LEFT && is_pressed) {
     // Check if the cursor is on a window.
-    for (auto* window : m_windows) {
+    for (auto* window = m_windows.get_top(); window != nullptr; window = WindowStack::get_below(window)) {
       if (window->get_geometry().contains(m_cursor_x, m_cursor_y)) {
         focus_window(window);
         return true;
@@ -698,48 +1361,43 @@ void WindowManager::switch_focus() {
     return;
 
   if (m_focus_window == nullptr) {
-    focus_window(*m_windows.begin());
+    focus_window(m_windows.get_top());
     return;
   } else {
-    auto old_window_it = std::find(m_windows.begin(), m_windows.end(), m_focus_window);
-    auto new_window_it = old_window_it;
-
-    new_window_it++;
+    auto* old_window = m_focus_window;
+    auto* new_window = WindowStack::get_below(old_window);
 
-    if (new_window_it == m_windows.end())
-      new_window_it = m_windows.begin();
+    if (new_window == nullptr)
+      new_window = m_windows.get_top();
 
-    if (*old_window_it == *new_window_it)
+    if (old_window == new_window)
       return;
 
     sys_message_t message;
 
-    (*old_window_it)->m_focus = false;
+    old_window->set_focus(false);
 
     // Send focus out messsage.
     libk::bzero(&message, sizeof(sys_message_t));
     message.id = SYS_MSG_FOCUS_OUT;
-    post_message(*old_window_it, message);
+    post_message(old_window, message);
 
     // Send focus in message.
     libk::bzero(&message, sizeof(sys_message_t));
     message.id = SYS_MSG_FOCUS_IN;
-    post_message(*new_window_it, message);
+    post_message(new_window, message);
 
-    m_focus_window = *new_window_it;
-    m_focus_window->m_focus = true;
+    m_focus_window = new_window;
+    m_focus_window->set_focus(true);
 
     // Move new window to front
-    auto new_window = *new_window_it;
-    m_windows.erase(new_window_it);
-    m_windows.push_front(new_window);
+    m_windows.raise(new_window);
 
     // Move old window to back
-    auto old_window = *old_window_it;
-    m_windows.erase(old_window_it);
-    m_windows.push_back(old_window);
+    m_windows.lower(old_window);
 
     update(new_window->get_geometry());
+    update(old_window->get_geometry());
   }
 }
 
@@ -772,27 +1430,103 @@ void WindowManager::resize_focus_window(int32_t dx, int32_t dy) {
   set_window_geometry(m_focus_window, rect);
 }
 
-#include "fs/fat/ff.h"
-#include "window_manager.hpp"
-
 void WindowManager::read_wallpaper() {
+  if (!read_raw_wallpaper()) {
+#ifdef CONFIG_WALLPAPER_JPEG
+    read_jpeg_wallpaper();
+#endif  // CONFIG_WALLPAPER_JPEG
+  }
+
+  if (m_wallpaper == nullptr) {
+    LOG_WARNING("No wallpaper, the background is filled with a solid color");
+    return;
+  }
+
+#if defined(CONFIG_USE_DMA) && defined(CONFIG_USE_DMA_FOR_WALLPAPER)
+  // The DMA only copies the pixels, so it needs them in ARGB8888 (see copy_with_dma()).
+  m_wallpaper_dma_buffer = libk::make_scoped<Buffer>(sizeof(uint32_t) * m_wallpaper_width * m_wallpaper_height);
+  const auto convert_span = graphics::get_convert_span(graphics::PixelFormat::ARGB8888, m_wallpaper_format,
+                                                       graphics::BlendMode::Copy);
+  uint32_t* dst = (uint32_t*)m_wallpaper_dma_buffer->get();
+  for (uint32_t y = 0; y < m_wallpaper_height; ++y) {
+    convert_span(dst + m_wallpaper_width * y, m_wallpaper + (size_t)m_wallpaper_pitch * y, m_wallpaper_width, 0, y);
+  }
+
+  m_wallpaper_pitch = sizeof(uint32_t) * m_wallpaper_width;
+  m_wallpaper_format = graphics::PixelFormat::ARGB8888;
+#endif  // CONFIG_USE_DMA && CONFIG_USE_DMA_FOR_WALLPAPER
+
+  LOG_INFO("Wallpaper loaded (size {}x{})", m_wallpaper_width, m_wallpaper_height);
+}
+
+bool WindowManager::read_raw_wallpaper() {
+  constexpr const char* WALLPAPER_PATH = "/wallpaper.raw";
+
+  File* file = FileSystem::get().open(WALLPAPER_PATH, SYS_FM_READ);
+  if (file == nullptr) {
+    LOG_WARNING("Failed to open '{}'", WALLPAPER_PATH);
+    return false;
+  }
+
+  const size_t file_size = file->get_size();
+  graphics::RawImageHeader header;
+  size_t read_bytes;
+  if (!file->read(&header, sizeof(header), &read_bytes) || read_bytes != sizeof(header) ||
+      !header.is_valid(file_size)) {
+    LOG_WARNING("Failed to load the wallpaper, '{}' is not a valid raw image", WALLPAPER_PATH);
+    FileSystem::get().close(file);
+    return false;
+  }
+
+  // The ramdisk is never unmapped, so the pixels can be used in place. This is the usual case,
+  // as the file is written at once when the ramdisk is created. Otherwise, they are copied.
+  const uint8_t* content = (const uint8_t*)file->map();
+  if (content == nullptr) {
+    LOG_WARNING("'{}' is fragmented in the ramdisk, it is copied to memory", WALLPAPER_PATH);
+    uint8_t* buffer = (uint8_t*)kmalloc(file_size, 64);
+    if (buffer == nullptr || !file->seek(0) || !file->read(buffer, file_size, &read_bytes) ||
+        read_bytes != file_size) {
+      LOG_WARNING("Failed to read '{}'", WALLPAPER_PATH);
+      kfree(buffer);
+      FileSystem::get().close(file);
+      return false;
+    }
+
+    content = buffer;
+  }
+
+  FileSystem::get().close(file);
+
+  m_wallpaper = content + header.data_offset;
+  m_wallpaper_width = header.width;
+  m_wallpaper_height = header.height;
+  m_wallpaper_pitch = header.pitch;
+  m_wallpaper_format = header.get_format();
+
+  if (m_wallpaper_format != m_screen_format)
+    LOG_WARNING("The wallpaper is not in the screen pixel format, it will be converted at each redraw");
+  return true;
+}
+
+#ifdef CONFIG_WALLPAPER_JPEG
+void WindowManager::read_jpeg_wallpaper() {
   constexpr const char* WALLPAPER_PATH = "/wallpaper.jpg";
 
-  FIL file = {};
-  if (f_open(&file, WALLPAPER_PATH, FA_READ) != FR_OK) {
+  File* file = FileSystem::get().open(WALLPAPER_PATH, SYS_FM_READ);
+  if (file == nullptr) {
     LOG_WARNING("Failed to open '{}'", WALLPAPER_PATH);
     return;
   }
 
-  const UINT file_size = f_size(&file);
+  const size_t file_size = file->get_size();
   uint8_t* buffer = (uint8_t*)kmalloc(file_size, alignof(max_align_t));
   KASSERT(buffer != nullptr);
 
-  UINT read_bytes;
-  const auto result = f_read(&file, buffer, file_size, &read_bytes);
-  KASSERT(result == FR_OK);
+  size_t read_bytes;
+  const bool result = file->read(buffer, file_size, &read_bytes);
+  KASSERT(result);
   KASSERT(read_bytes == file_size);
-  f_close(&file);
+  FileSystem::get().close(file);
 
   int wallpaper_width, wallpaper_height;
   uint32_t* wallpaper =
@@ -804,23 +1538,16 @@ void WindowManager::read_wallpaper() {
     return;
   }
 
-  // The wallpaper is in RGBA, we expect ABGR. Do the conversion once.
-  for (int32_t x = 0; x < wallpaper_width; ++x) {
-    for (int32_t y = 0; y < wallpaper_height; ++y) {
-      // The wallpaper is in RGBA, we expect ABGR.
-      const auto color = libk::bswap(wallpaper[x + wallpaper_width * y]);
-      wallpaper[x + wallpaper_width * y] = color >> 8;
-    }
+  // The wallpaper is in RGBA, we expect ARGB. Do the conversion once.
+  const size_t nb_pixels = (size_t)wallpaper_width * wallpaper_height;
+  for (size_t i = 0; i < nb_pixels; ++i) {
+    wallpaper[i] = 0xff000000 | (libk::bswap(wallpaper[i]) >> 8);
   }
 
-#if defined(CONFIG_USE_DMA) && defined(CONFIG_USE_DMA_FOR_WALLPAPER)
-  m_wallpaper = libk::make_scoped<Buffer>(sizeof(uint32_t) * wallpaper_width * wallpaper_height);
-  libk::memcpy(m_wallpaper->get(), wallpaper, m_wallpaper->get_byte_size());
-#else
-  m_wallpaper = wallpaper;
-#endif  // CONFIG_USE_DMA && CONFIG_USE_DMA_FOR_WALLPAPER
+  m_wallpaper = (const uint8_t*)wallpaper;
   m_wallpaper_width = wallpaper_width;
   m_wallpaper_height = wallpaper_height;
-
-  LOG_INFO("Wallpaper loaded (size {}x{})", m_wallpaper_width, m_wallpaper_height);
+  m_wallpaper_pitch = sizeof(uint32_t) * wallpaper_width;
+  m_wallpaper_format = graphics::PixelFormat::ARGB8888;
 }
+#endif  // CONFIG_WALLPAPER_JPEG
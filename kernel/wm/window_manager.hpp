@@ -1,11 +1,15 @@
 #pragma once
 
 #include <sys/window.h>
-#include <libk/linked_list.hpp>
 #include <libk/memory.hpp>
+#include <libk/string_view.hpp>
 #include "geometry.hpp"
+#include "hardware/framebuffer.hpp"
 #include "sys/keyboard.h"
 #include "task/task.hpp"
+#include "task/wait_list.hpp"
+#include "wm/region.hpp"
+#include "wm/window_stack.hpp"
 
 #ifdef CONFIG_USE_DMA
 #include "hardware/dma/channel.hpp"
@@ -29,13 +33,30 @@ class WindowManager {
   Window* create_window(const libk::SharedPointer<Task>& task, uint32_t flags);
   void destroy_window(Window* window);
 
+  /** Sets the title of @a window (see Window::set_title()). */
+  void set_window_title(Window* window, libk::StringView title);
   void set_window_visibility(Window* window, bool visible);
   void set_window_geometry(Window* window, Rect rect);
   void set_window_geometry(Window* window, int32_t x, int32_t y, int32_t w, int32_t h);
+  /** Sets the fully opaque part of @a window (see Window::get_opaque_rect()). */
+  void set_window_opaque_rect(Window* window, const Rect& rect);
 
+  /** Marks the whole screen as damaged, see update(const Rect&). */
   void update();
+  /** Marks @a rect as damaged. It will be redrawn by the compositor at the next frame. */
   void update(const Rect& rect);
 
+  /** Starts the compositor kernel task. It redraws the damaged parts of the screen at most
+   * once per frame interval (see FRAME_INTERVAL_US). */
+  void start_compositor();
+
+  /** Blocks @a task until all the presents of @a window done so far are visible on the screen.
+   * Returns true if the task was blocked, false if there is nothing to wait for. */
+  bool block_task_until_presented(Window* window, const libk::SharedPointer<Task>& task);
+
+  /** Gets the statistics of the compositor. */
+  [[nodiscard]] const sys_compositor_stats_t& get_stats() const { return m_stats; }
+
   void clip_rect_to_screen(Rect& rect);
 
   void focus_window(Window* window);
@@ -49,6 +70,22 @@ class WindowManager {
 
   void mosaic_layout();
 
+  /** Gives the exclusive ownership of the screen to @a task. While a task owns the screen,
+   * the window manager does not draw anything so the task can directly render into the
+   * framebuffer. Returns false if another task already owns the screen. */
+  bool acquire_screen(Task* task);
+  /** Gives back the screen ownership of @a task (if it owns it) and redraws the whole screen. */
+  void release_screen(Task* task);
+  /** Checks if some task currently has the exclusive ownership of the screen. */
+  [[nodiscard]] bool is_screen_acquired() const { return m_screen_owner != nullptr; }
+
+#ifdef CONFIG_USE_DMA
+  /** Frees the window framebuffer @a buffer (owned by the window manager from now), once the DMA
+   * copies of the current frame, that may still read it, are done. It is unmapped from the tasks
+   * immediately. */
+  void retire_framebuffer(Buffer* buffer);
+#endif  // CONFIG_USE_DMA
+
  private:
   // Input events handler.
 #ifdef CONFIG_HAS_CURSOR
@@ -61,88 +98,221 @@ class WindowManager {
   void move_focus_window(int32_t dx, int32_t dy);
   void resize_focus_window(int32_t dx, int32_t dy);
 
+  /** Loads the wallpaper, a raw image (see graphics::RawImageHeader) mapped from the ramdisk
+   * when possible. Otherwise, the background is filled with BACKGROUND_COLOR. */
   void read_wallpaper();
+  bool read_raw_wallpaper();
+#ifdef CONFIG_WALLPAPER_JPEG
+  /** Decodes the JPEG wallpaper, the fallback if there is no raw one (slow, and needs the decoder in the kernel). */
+  void read_jpeg_wallpaper();
+#endif  // CONFIG_WALLPAPER_JPEG
+
+  [[noreturn]] static void compositor_main();
+  /** Prepares the frame, with interrupts disabled: takes the damage, selects the back buffer and
+   * computes the visible parts of the windows. Returns false if there is nothing to render. */
+  bool prepare_frame();
+  /** Renders the prepared frame into the back buffer. It runs with interrupts enabled, but nothing
+   * else may modify the windows meanwhile (see compositor_main()). */
+  void render_frame();
+  /** Starts the DMA copies of the frame, or finishes it right away (interrupts disabled). */
+  void end_frame();
+  /** Handles the input events received while the frame was rendered (see post_message()). */
+  void post_deferred_messages();
+  /** Draws what must be drawn over the windows (focus border and cursor), once all the windows
+   * are copied into the screen, and wakes up the tasks waiting for the frame. */
+  void finish_frame();
+  /** Selects the buffer of the framebuffer to render the frame into. Returns false if no buffer is
+   * available for now. */
+  bool select_back_buffer();
+  /** Waits for the vertical sync if no buffer is available because of a pending flip (interrupts
+   * enabled, the task is not preempted meanwhile). */
+  void wait_for_flip();
+  /** Copies forward into the back buffer what it misses from the displayed buffer. */
+  void copy_stale_region();
+  /** Displays the buffer the frame was rendered into. */
+  void present_back_buffer();
+  void update_stats(uint64_t now, uint64_t composite_time, uint64_t damaged_pixels);
+
+  /** Marks the old and new positions of the moved window as damaged, when its pixels can not be reused. */
+  void cancel_pending_move();
+  /** Checks if the pixels of the moved window can be copied on the screen to its new position. */
+  [[nodiscard]] bool can_copy_pending_move() const;
+  /** Takes the pending move for the frame, and damages the exposed parts of the old window position. */
+  void take_pending_move();
+  /** Copies the pixels of the window moved by the frame on the screen, to its new position. */
+  void copy_moved_pixels();
+
+  // Drawing functions.
+  void draw_background(const Rect& rect);
+  void draw_window(Window* window, const Rect& rect);
+  /** Draws the frame decoration of @a window, clipped to @a clip. */
+  void draw_window_frame(Window* window, const Rect& clip);
+  /** Draws the framebuffer of @a window into @a rect, that must be inside the client rect of the window. */
+  void draw_window_client(Window* window, const Rect& rect);
+  /** Draws the focus border inside @a rect, clipped to @a clip. */
+  void draw_focus_border(const Rect& rect, const Rect& clip);
+
+  /** Gets the address of the pixel (x, y) of the buffer the frame is rendered into. */
+  [[nodiscard]] void* get_screen_pixel(int32_t x, int32_t y) const {
+    return m_screen_buffer + (x + m_screen_pitch * y) * graphics::get_bytes_per_pixel(m_screen_format);
+  }
 
 #ifdef CONFIG_USE_DMA
-  struct DMARequestQueue {
-    DMA::Request* first_request = nullptr;
-    DMA::Request* last_request = nullptr;
-
-    ~DMARequestQueue() {
-      // Free the DMA request queue.
-      auto* request = first_request;
-      while (request != nullptr) {
-        auto* next = request->next();
-        delete request;
-        request = next;
-      }
-    }
-
-    void add(DMA::Request* request) {
-      KASSERT(request != nullptr);
-
-      if (first_request == nullptr) {
-        first_request = request;
-        last_request = request;
-      } else {
-        last_request->link_to(request);
-        last_request = request;
-      }
-    }
-
-    void execute_and_wait(DMA::Channel& channel) {
-      if (first_request == nullptr)
-        return;
-
-      channel.execute_requests(first_request);
-      channel.wait();
-    }
-  };
-#else
-  // Stub class when DMA usage is disabled.
-  struct DMARequestQueue {};  // struct DMARequestQueue
+  /** Adds to the DMA chains of the frame a copy of @a src (with a pitch of @a src_pitch pixels)
+   * into @a dst_rect of the screen. */
+  void copy_with_dma(const Rect& dst_rect, const uint32_t* src, DMA::Address src_dma_addr, uint32_t src_pitch);
+  /** Starts the DMA chains of the frame. Returns false if there is nothing to copy. */
+  bool start_dma_chains();
+  static void dma_interrupt_handler(void* handle);
 #endif  // CONFIG_USE_DMA
 
-  // Drawing functions.
-  void draw_background(const Rect& rect, DMARequestQueue& request_queue);
-  void draw_window(Window* window, const Rect& rect, DMARequestQueue& request_queue);
-  void draw_windows_helper(libk::LinkedList<Window*>::Iterator it, const Rect& rect, DMARequestQueue& request_queue);
-  void draw_windows(const Rect& rect, DMARequestQueue& request_queue);
+  /** Computes the parts of the damage where each window (or the background) is visible,
+   * see m_visible_rects. */
+  void compute_visible_rects();
+  void add_visible_rect(Window* window, const Rect& rect);
 
 #ifdef CONFIG_HAS_CURSOR
-  void draw_cursor();
+  /** Gets the part of the screen covered by the cursor at its current position. */
+  [[nodiscard]] Rect get_cursor_rect();
+  /** Saves the pixels of the screen in @a rect, then draws the cursor there. */
+  void draw_cursor(const Rect& rect);
+  /** Restores the pixels saved below the cursor, if it is drawn. */
+  void erase_cursor();
 #endif // CONFIG_HAS_CURSOR
 
+ public:
+  /** Interval between two frames of the compositor (60 Hz). The effective rate is limited by
+   * the scheduler tick, as the compositor task sleeps between two frames. */
+  static constexpr uint64_t FRAME_INTERVAL_US = 1000000 / 60;
+
  private:
   static WindowManager* g_instance;
 
   Window* m_focus_window = nullptr;  // the window that actually has focus
-  libk::LinkedList<Window*> m_windows;
-  size_t m_window_count = 0;
+  WindowStack m_windows;  // all the windows, sorted by depth
 
   uint32_t m_last_window_x = 50, m_last_window_y = 50;
 
+  // The color of the background where there is no wallpaper.
+  static constexpr uint32_t BACKGROUND_COLOR = 0xff1d2b3a;
+
+  // The wallpaper pixels, already in their final size and (usually) in the screen format.
+  const uint8_t* m_wallpaper = nullptr;
+  uint32_t m_wallpaper_width = 0, m_wallpaper_height = 0;
+  uint32_t m_wallpaper_pitch = 0;  // in bytes
+  graphics::PixelFormat m_wallpaper_format = graphics::PixelFormat::ARGB8888;
 #if defined(CONFIG_USE_DMA) && defined(CONFIG_USE_DMA_FOR_WALLPAPER)
-  libk::ScopedPointer<Buffer> m_wallpaper;
-#else
-  const uint32_t* m_wallpaper = nullptr;
+  // A copy of the wallpaper in ARGB8888 and in DMA memory (the DMA can not convert the pixels).
+  libk::ScopedPointer<Buffer> m_wallpaper_dma_buffer;
 #endif  // CONFIG_USE_DMA && CONFIG_USE_DMA_FOR_WALLPAPER
-  uint32_t m_wallpaper_width, m_wallpaper_height;
 
 #ifdef CONFIG_USE_DMA
-  DMA::Channel m_dma_channel;
+  // With the DMA, the windows are copied into the screen by chains of control blocks taken
+  // from a preallocated ring. The copies of a frame are split between two channels and run
+  // asynchronously: the frame is finished by the DMA interrupt handler (see finish_frame()).
+  // This is experimental and off by default (see CONFIG_USE_DMA in CMakeLists.txt).
+  static constexpr size_t NB_DMA_CHANNELS = 2;
+  static constexpr size_t DMA_RING_CAPACITY = 256;
+  // Copies of at least this number of bytes are split between the channels.
+  static constexpr uint64_t DMA_SPLIT_THRESHOLD = 64 * 1024;
+
+  DMA::Channel m_dma_channels[NB_DMA_CHANNELS];
+  DMA::ControlBlockRing m_dma_ring{DMA_RING_CAPACITY};
+  DMA::ControlBlockChain m_dma_chains[NB_DMA_CHANNELS];
+  size_t m_dma_running_chains = 0;  // number of chains of the current frame not yet finished
+  // The framebuffers freed while the chains run, deleted once they are done (see retire_framebuffer()).
+  libk::LinkedList<Buffer*> m_retired_framebuffers;
 #endif  // CONFIG_USE_DMA
 
-  uint32_t* m_screen_buffer = nullptr;
+  // The screen may use another pixel format than the windows (ARGB8888). Everything written to the
+  // screen goes through the span converters of that format (see graphics::get_convert_span()).
+#ifdef CONFIG_SCREEN_DITHERING
+  static constexpr bool SCREEN_DITHERING = true;
+#else
+  static constexpr bool SCREEN_DITHERING = false;
+#endif  // CONFIG_SCREEN_DITHERING
+  graphics::PixelFormat m_screen_format = graphics::PixelFormat::ARGB8888;
+  uint8_t* m_screen_buffer = nullptr;  // the buffer the current frame is rendered into
 #ifdef CONFIG_USE_DMA
   VirtualAddress m_screen_buffer_dma_addr;
+  VirtualAddress m_screen_buffers_dma_addr;  // DMA address of the first buffer of the framebuffer
 #endif  // CONFIG_USE_DMA
+  // With double buffering, each frame is rendered into a buffer not displayed, then flipped.
+  // The stale region of a buffer is what changed on screen since it was last displayed: it is
+  // copied forward from the displayed buffer before rendering into it (see select_back_buffer()).
+  uint32_t m_back_buffer_index = 0;
+  Region m_stale_regions[FrameBuffer::MAX_BUFFER_COUNT];
   size_t m_screen_pitch;
   int32_t m_screen_width, m_screen_height;
 
 #ifdef CONFIG_HAS_CURSOR
+  static constexpr uint32_t CURSOR_WIDTH = 9;
+  static constexpr uint32_t CURSOR_HEIGHT = 16;
+
   int32_t m_cursor_x = 0, m_cursor_y = 0;
+  // The part of the screen where the cursor is currently drawn (empty if it is not drawn),
+  // and the pixels that were there before it was drawn (in the screen format, with a pitch
+  // of CURSOR_WIDTH pixels).
+  Rect m_cursor_drawn_rect = {0, 0, 0, 0};
+  uint32_t m_cursor_save_under[CURSOR_WIDTH * CURSOR_HEIGHT];
 #endif // CONFIG_HAS_CURSOR
 
+  Task* m_screen_owner = nullptr;  // task with the exclusive ownership of the screen, if any
+
+  Region m_damage;  // parts of the screen to redraw at the next frame
+
+  // A window only moved since the last frame, and where its pixels are on the screen. They are copied
+  // to its new position by the next frame instead of compositing the window again.
+  struct PendingMove {
+    Window* window = nullptr;
+    Rect from = {0, 0, 0, 0};
+  } m_pending_move;
+  Region m_uncovered;  // parts of the damage not covered by opaque windows (see compute_visible_rects())
+
+  // A part of the damage where a window (or the background if window is nullptr) is visible.
+  struct VisibleRect {
+    Window* window;
+    Rect rect;
+  };  // struct VisibleRect
+
+  // The visible parts of the windows for the current frame, from the top-most window to the
+  // background. The array is reused from one frame to the next, and only grows.
+  VisibleRect* m_visible_rects = nullptr;
+  size_t m_visible_rect_count = 0;
+  size_t m_visible_rect_capacity = 0;
+  // Incremented after each frame, the presents done before are visible since then.
+  uint64_t m_frame_sequence = 0;
+  WaitList m_present_wait_list;  // tasks waiting for the next frame (see block_task_until_presented())
+
+  // The state of the frame being composited, used by finish_frame().
+  struct Frame {
+    uint64_t start = 0;           // in microseconds
+    uint64_t damaged_pixels = 0;  // number of pixels redrawn
+    Window* focus_window = nullptr;
+    Rect focus_rect = {0, 0, 0, 0};  // geometry of focus_window (that may be destroyed before the frame ends)
+    bool redraw_cursor = false;
+    bool copy_move = false;  // are the pixels of a moved window copied from move_from to move_to?
+    Rect move_from = {0, 0, 0, 0}, move_to = {0, 0, 0, 0};
+    bool flip = false;  // has something been rendered into the back buffer?
+#ifdef CONFIG_USE_DMA
+    bool use_dma = true;  // are the windows copied by the DMA (see compute_visible_rects())?
+#endif  // CONFIG_USE_DMA
+    Region changes;     // parts of the screen changed by the frame
+  } m_frame;
+
+  // The input events received while the frame is rendered are handled once it is done, as they
+  // may modify the windows. The mouse moves are coalesced, and the events dropped if it is full.
+  static constexpr size_t MAX_DEFERRED_MESSAGES = 32;
+  bool m_rendering = false;
+  sys_message_t m_deferred_messages[MAX_DEFERRED_MESSAGES];
+  size_t m_deferred_message_count = 0;
+
+  sys_compositor_stats_t m_stats = {};
+  uint64_t m_stats_period_start = 0;  // start of the current statistics period, in microseconds
+  uint32_t m_stats_period_frames = 0;
+  uint64_t m_stats_period_composite_time = 0;
+  uint32_t m_stats_period_max_composite_time = 0;
+  uint32_t m_stats_period_frame_redraws = 0;
+
   bool m_is_supported = true;  // is the window manager supported (screen connected)?
 };  // class WindowManager
@@ -0,0 +1,81 @@
+#include "wm/window_stack.hpp"
+#include "wm/window.hpp"
+
+#include <libk/log.hpp>
+
+Window* WindowStack::get_below(const Window* window) {
+  return window->m_below;
+}
+
+Window* WindowStack::get_above(const Window* window) {
+  return window->m_above;
+}
+
+bool WindowStack::contains(const Window* window) const {
+  return window->m_stack == this;
+}
+
+void WindowStack::push_top(Window* window) {
+  KASSERT(window->m_stack == nullptr);
+
+  window->m_stack = this;
+  window->m_above = nullptr;
+  window->m_below = m_top;
+  if (m_top != nullptr)
+    m_top->m_above = window;
+  else
+    m_bottom = window;
+
+  m_top = window;
+  ++m_size;
+}
+
+void WindowStack::push_bottom(Window* window) {
+  KASSERT(window->m_stack == nullptr);
+
+  window->m_stack = this;
+  window->m_above = m_bottom;
+  window->m_below = nullptr;
+  if (m_bottom != nullptr)
+    m_bottom->m_below = window;
+  else
+    m_top = window;
+
+  m_bottom = window;
+  ++m_size;
+}
+
+void WindowStack::remove(Window* window) {
+  KASSERT(contains(window));
+
+  if (window->m_above != nullptr)
+    window->m_above->m_below = window->m_below;
+  else
+    m_top = window->m_below;
+
+  if (window->m_below != nullptr)
+    window->m_below->m_above = window->m_above;
+  else
+    m_bottom = window->m_above;
+
+  window->m_stack = nullptr;
+  window->m_above = nullptr;
+  window->m_below = nullptr;
+  --m_size;
+}
+
+void WindowStack::raise(Window* window) {
+  if (m_top == window)
+    return;
+
+  remove(window);
+  push_top(window);
+}
+
+void WindowStack::lower(Window* window) {
+  if (m_bottom == window)
+    return;
+
+  remove(window);
+  push_bottom(window);
+}
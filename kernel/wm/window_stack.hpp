@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+
+class Window;
+
+/**
+ * The windows of the window manager, sorted by depth (from the top-most to the bottom-most).
+ *
+ * The stack is intrusive: the links are stored in the windows themselves, so that checking
+ * if a window is in the stack, removing it or raising it to the top are all done in constant
+ * time (without searching the window in the stack).
+ */
+class WindowStack {
+ public:
+  [[nodiscard]] bool is_empty() const { return m_top == nullptr; }
+  [[nodiscard]] size_t get_size() const { return m_size; }
+
+  /** Gets the top-most window (the first one drawn from the user point of view), or nullptr. */
+  [[nodiscard]] Window* get_top() const { return m_top; }
+  /** Gets the bottom-most window, or nullptr. */
+  [[nodiscard]] Window* get_bottom() const { return m_bottom; }
+  /** Gets the window just below @a window, or nullptr if it is the bottom-most one. */
+  [[nodiscard]] static Window* get_below(const Window* window);
+  /** Gets the window just above @a window, or nullptr if it is the top-most one. */
+  [[nodiscard]] static Window* get_above(const Window* window);
+
+  /** Checks if @a window is in this stack. */
+  [[nodiscard]] bool contains(const Window* window) const;
+
+  /** Inserts @a window (not in any stack) above all the other windows. */
+  void push_top(Window* window);
+  /** Inserts @a window (not in any stack) below all the other windows. */
+  void push_bottom(Window* window);
+  /** Removes @a window from this stack. */
+  void remove(Window* window);
+  /** Moves @a window (already in this stack) above all the other windows. */
+  void raise(Window* window);
+  /** Moves @a window (already in this stack) below all the other windows. */
+  void lower(Window* window);
+
+ private:
+  Window* m_top = nullptr;
+  Window* m_bottom = nullptr;
+  size_t m_size = 0;
+};  // class WindowStack
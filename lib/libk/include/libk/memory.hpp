@@ -39,6 +39,13 @@ class ScopedPointer {
     m_data = ptr;
   }
 
+  /** Gives up the ownership of the pointer (without deleting it) and returns it. */
+  [[nodiscard]] T* release() {
+    T* data = m_data;
+    m_data = nullptr;
+    return data;
+  }
+
   [[nodiscard]] T* get() const { return m_data; }
   [[nodiscard]] operator bool() const { return m_data != nullptr; }
   [[nodiscard]] bool operator!() const { return m_data == nullptr; }
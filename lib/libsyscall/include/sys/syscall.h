@@ -34,6 +34,9 @@ enum {
   SYS_ERR_PIPE_FULL,
   SYS_ERR_PIPE_EMPTY,
   SYS_ERR_PIPE_CLOSED,
+  SYS_ERR_BUSY,
+  SYS_ERR_INVALID_SHM,
+  SYS_ERR_INVALID_GFX_COMMAND,
 };
 
 #define SYS_IS_OK(e) ((e) == SYS_ERR_OK)
@@ -51,7 +54,23 @@ sys_pid_t sys_getpid();
 sys_error_t sys_sched_set_priority(sys_pid_t pid, uint32_t priority);
 sys_error_t sys_sched_get_priority(sys_pid_t pid, uint32_t* priority);
 sys_error_t sys_debug(uint64_t x);
+/* Returns the time elapsed since boot, in microseconds. */
+uint64_t sys_get_time_us();
+
+/*
+ * Fullscreen API
+ *
+ * Requesting the pixels of the framebuffer gives the exclusive ownership of the screen to the
+ * calling process: the window manager stops drawing and the screen memory is directly mapped
+ * in the process (pixels are in 0xAARRGGBB format and rows are @a stride pixels apart).
+ * Fails with SYS_ERR_BUSY if another process already owns the screen, and with SYS_ERR_GENERIC
+ * if the screen does not store pixels in that format (16 bits per pixel screen).
+ *
+ * The screen is given back to the window manager by sys_release_framebuffer() or when the
+ * process exits. Any pointer to the pixels is invalid after that.
+ */
 sys_error_t sys_get_framebuffer(void** pixels, uint32_t* width, uint32_t* height, uint32_t* stride);
+sys_error_t sys_release_framebuffer();
 
 /*
  * Pipe API
@@ -68,6 +87,22 @@ sys_pipe_t* sys_pipe_get(sys_pid_t pid, const char* name);
 sys_error_t sys_pipe_read(sys_pipe_t* pipe, void* buffer, size_t size, size_t* read_bytes);
 sys_error_t sys_pipe_write(sys_pipe_t* pipe, const void* buffer, size_t size, size_t* written_bytes);
 
+/*
+ * Shared memory API
+ *
+ * A shared memory object is created by a process under a name (unique for that process).
+ * Other processes can find it using the PID of its creator and its name. Every process
+ * then maps it in its own address space, the same physical memory is seen by all of them.
+ * Unmapping releases the process handle, the memory is freed once no process uses it anymore.
+ */
+
+#define SYS_SHM_NAME_MAX 32
+typedef struct sys_shm_t sys_shm_t;
+sys_shm_t* sys_shm_create(const char* name, size_t size);
+sys_shm_t* sys_shm_get(sys_pid_t pid, const char* name);
+sys_error_t sys_shm_map(sys_shm_t* shm, void** address, size_t* size);
+sys_error_t sys_shm_unmap(sys_shm_t* shm);
+
 /*
  * Program arguments API
  */
@@ -82,6 +117,38 @@ const char** sys_get_argv();
 
 void* sys_sbrk(ptrdiff_t increment);
 
+/*
+ * Memory statistics API
+ */
+
+typedef struct sys_mem_stats_t {
+  /* Physical memory used by the task, in pages. */
+  uint64_t heap_pages;
+  uint64_t stack_pages;
+  uint64_t chunk_pages;   /* mapped memory chunks, the stack excluded */
+  uint64_t buffer_pages;  /* mapped contiguous buffers */
+  uint64_t table_pages;   /* MMU table */
+  uint64_t window_pages;  /* kernel side framebuffers of the task windows and surfaces */
+
+  /* Physical memory used by the whole system, in pages. */
+  uint64_t total_pages;
+  uint64_t used_pages;
+  uint64_t total_contiguous_pages;
+  uint64_t used_contiguous_pages;
+  uint64_t total_table_pages;
+
+  /* Kernel heap allocator (kmalloc). */
+  uint64_t kmalloc_allocations;
+  uint64_t kmalloc_used_bytes;
+  uint64_t kmalloc_heap_bytes;
+
+  uint32_t page_size;
+  sys_bool_t is_kernel;
+  sys_bool_t is_terminated;
+} sys_mem_stats_t;
+
+sys_error_t sys_mem_stats(sys_pid_t pid, sys_mem_stats_t* stats);
+
 __SYS_EXTERN_C_END
 
 #endif  // !PIKAOS_LIBC_SYS_SYSCALL_H
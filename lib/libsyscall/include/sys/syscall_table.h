@@ -56,7 +56,43 @@ enum {
   SYS_GFX_DRAW_RECT,
   SYS_GFX_FILL_RECT,
   SYS_GFX_DRAW_TEXT,
-  SYS_GFX_BLIT
+  SYS_GFX_BLIT,
+
+  /* Memory statistics system calls. */
+  SYS_MEM_STATS,
+
+  /* Window direct rendering system calls. */
+  SYS_WINDOW_MAP_SURFACE,
+
+  /* Fullscreen exclusive rendering system calls. */
+  SYS_RELEASE_FRAMEBUFFER,
+
+  /* Shared memory system calls. */
+  SYS_SHM_CREATE,
+  SYS_SHM_GET,
+  SYS_SHM_MAP,
+  SYS_SHM_UNMAP,
+
+  /* Time system calls. */
+  SYS_GET_TIME,
+
+  /* Compositor system calls. */
+  SYS_WINDOW_WAIT_PRESENT,
+  SYS_COMPOSITOR_STATS,
+  SYS_WINDOW_SET_OPAQUE_RECT,
+
+  /* Window graphics display list system calls. */
+  SYS_GFX_SUBMIT,
+
+  /* Window damage tracking system calls. */
+  SYS_WINDOW_MAP_TILES,
+
+  /* Offscreen surfaces system calls. */
+  SYS_SURFACE_CREATE,
+  SYS_SURFACE_DESTROY,
+
+  /* System font system calls. */
+  SYS_GFX_GET_FONT_METRICS
 };
 
 #endif  // !__PIKAOS_LIBC_SYS_SYSCALL_TABLE_H__
@@ -46,7 +46,14 @@ typedef enum sys_mouse_button_t {
   SYS_MOUSE_BUTTON_RIGHT = 2,
 } sys_mouse_button_t;
 
-enum { SYS_WF_DEFAULT = 0x0, SYS_WF_NO_FRAME = 0x1 };
+/* Window creation flags.
+ * SYS_WF_PREMULTIPLIED: the window surface stores premultiplied alpha colors (the gfx functions
+ *   still take straight alpha colors) and the window is blended over what is below it. */
+enum { SYS_WF_DEFAULT = 0x0, SYS_WF_NO_FRAME = 0x1, SYS_WF_PREMULTIPLIED = 0x2 };
+
+/* Height of the title bar of the windows with a frame (see SYS_WF_NO_FRAME). It covers the top of the
+ * window, so the client content starts below it. */
+#define SYS_WINDOW_TITLE_BAR_HEIGHT 30
 
 /* Window creation and destruction API. */
 sys_window_t* sys_window_create(const char* title,
@@ -73,9 +80,25 @@ sys_error_t sys_window_get_visibility(sys_window_t* window, sys_bool_t* visible)
 sys_error_t sys_window_set_geometry(sys_window_t* window, int32_t x, int32_t y, uint32_t width, uint32_t height);
 sys_error_t sys_window_get_geometry(sys_window_t* window, uint32_t* x, uint32_t* y, uint32_t* width, uint32_t* height);
 
-/* Window graphics API. */
+/* Declares the part of a SYS_WF_PREMULTIPLIED window (relative to its top-left corner) that is
+ * fully opaque, so the compositor does not draw what is below it. By default, such windows are
+ * considered entirely translucent. Other windows are always entirely opaque. */
+sys_error_t sys_window_set_opaque_rect(sys_window_t* window, uint32_t x, uint32_t y, uint32_t width, uint32_t height);
+
+/* Window graphics API.
+ *
+ * Presenting only marks the area as damaged: the compositor redraws all the damaged parts of the
+ * screen at most once per frame (60 Hz). sys_window_wait_present() blocks until all the previous
+ * presents of the window are visible on the screen, so applications can pace their rendering.
+ *
+ * The sys_gfx_xxx() drawing functions do not draw immediately: they record a command (with a copy of
+ * the text) into a display list kept by the window. The list is submitted at once, by a single system
+ * call, when it is full, by sys_gfx_flush(), and before the window is presented, resized or mapped.
+ * Errors of the commands are reported by the function that submits them. sys_gfx_blit() and
+ * sys_gfx_blit_scaled() are submitted immediately as the pixels are not copied. */
 sys_error_t sys_window_present(sys_window_t* window);
 sys_error_t sys_window_present2(sys_window_t* window, uint32_t x, uint32_t y, uint32_t width, uint32_t height);
+sys_error_t sys_window_wait_present(sys_window_t* window);
 sys_error_t sys_gfx_clear(sys_window_t* window, uint32_t argb);
 sys_error_t sys_gfx_draw_line(sys_window_t* window, uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y2, uint32_t argb);
 sys_error_t sys_gfx_draw_rect(sys_window_t* window,
@@ -99,6 +122,199 @@ sys_error_t sys_gfx_blit(sys_window_t* window,
                          uint32_t height,
                          const uint32_t* argb_buffer);
 
+typedef enum sys_gfx_filter_t {
+  SYS_GFX_FILTER_NEAREST,  /* fastest, blocky when enlarging and aliased when shrinking a lot */
+  SYS_GFX_FILTER_BILINEAR, /* interpolates the 4 nearest source pixels */
+} sys_gfx_filter_t;
+
+/* Draws the src_width * src_height ARGB pixels of argb_buffer scaled to fill the width * height
+ * rectangle at (x, y). Only the visible part of the rectangle is computed, so a large image can be
+ * drawn directly into a small window. */
+sys_error_t sys_gfx_blit_scaled(sys_window_t* window,
+                                int32_t x,
+                                int32_t y,
+                                uint32_t width,
+                                uint32_t height,
+                                const uint32_t* argb_buffer,
+                                uint32_t src_width,
+                                uint32_t src_height,
+                                sys_gfx_filter_t filter);
+/* Moves the pixels of the width * height rectangle at (x, y) by (dx, dy), the source and destination
+ * may overlap. This is the fast way to scroll: only the exposed part has to be drawn again. The
+ * destination is clipped, and the pixels whose source is outside of the window are left unchanged. */
+sys_error_t sys_gfx_copy_area(sys_window_t* window,
+                              int32_t x,
+                              int32_t y,
+                              uint32_t width,
+                              uint32_t height,
+                              int32_t dx,
+                              int32_t dy);
+/* The drawings are clipped to the intersection of all the pushed rectangles, until they are popped.
+ * At most SYS_GFX_MAX_CLIP_DEPTH rectangles can be pushed. */
+sys_error_t sys_gfx_push_clip(sys_window_t* window, int32_t x, int32_t y, uint32_t width, uint32_t height);
+sys_error_t sys_gfx_pop_clip(sys_window_t* window);
+sys_error_t sys_gfx_flush(sys_window_t* window);
+
+/* Offscreen surfaces API.
+ *
+ * A surface is an image kept by the kernel (ARGB pixels, transparent when created), owned by the task
+ * and destroyed with it. After sys_gfx_set_target(), the sys_gfx_xxx() functions of a window draw into
+ * the surface instead of the window, until the target is set back to the window (NULL surface). The
+ * target can only be changed without clipping. sys_gfx_blit_surface() draws a whole surface (push a
+ * clipping rectangle to draw only a part of it) into the current target: the pixels are copied inside
+ * the kernel, so an image uploaded once is drawn again without reading the task memory.
+ * When a surface is destroyed, the recorded commands not yet submitted that draw into it or blit it are
+ * dropped, and the windows drawing into it draw into themselves again. A task has a limited number of
+ * surfaces, of a limited total size: sys_surface_create() returns NULL past these limits.
+ *
+ * Surface creation flags.
+ * SYS_SF_TRANSLUCENT: the surface is blended over the destination when blit (it is copied otherwise). */
+typedef struct sys_surface_t sys_surface_t;
+
+enum { SYS_SF_DEFAULT = 0x0, SYS_SF_TRANSLUCENT = 0x1 };
+
+sys_surface_t* sys_surface_create(uint32_t width, uint32_t height, uint32_t flags);
+void sys_surface_destroy(sys_surface_t* surface);
+sys_error_t sys_gfx_set_target(sys_window_t* window, sys_surface_t* surface);
+sys_error_t sys_gfx_blit_surface(sys_window_t* window, sys_surface_t* surface, int32_t x, int32_t y);
+
+/* Window graphics display list API.
+ *
+ * A display list is an array of commands executed in order by sys_gfx_submit() (after the commands
+ * recorded by the sys_gfx_xxx() functions). The kernel checks the whole list before drawing anything,
+ * and rejects it if the edges of a rectangle (position + size) do not fit in an int32_t. Coordinates
+ * are relative to the top-left corner of the target (the window, or the surface set by
+ * SYS_GFX_CMD_SET_TARGET), colors are in 0xAARRGGBB format (straight alpha). The clipping and the target
+ * are reset at the end of each list, so a list can not pop what it did not push. */
+typedef enum sys_gfx_cmd_type_t {
+  SYS_GFX_CMD_CLEAR,        /* fills the whole window or surface (ignores the clipping) */
+  SYS_GFX_CMD_LINE,         /* line from (x0, y0) to (x1, y1) */
+  SYS_GFX_CMD_RECT,         /* rectangle outline */
+  SYS_GFX_CMD_FILL,         /* filled rectangle */
+  SYS_GFX_CMD_TEXT,         /* NUL-terminated UTF-8 text, whose top-left corner is (x, y) */
+  SYS_GFX_CMD_BLIT,         /* width * height ARGB pixels, stored row by row */
+  SYS_GFX_CMD_PUSH_CLIP,    /* clips the drawings to the rectangle (and the previous clipping) */
+  SYS_GFX_CMD_POP_CLIP,     /* restores the clipping before the last push */
+  SYS_GFX_CMD_BLIT_SCALED,  /* src_width * src_height ARGB pixels, scaled to width * height */
+  SYS_GFX_CMD_COPY_AREA,    /* moves the pixels of the rectangle by (dx, dy) */
+  SYS_GFX_CMD_SET_TARGET,   /* draws the next commands into the surface (or the window if NULL) */
+  SYS_GFX_CMD_BLIT_SURFACE, /* the whole surface, whose top-left corner is (x, y) */
+} sys_gfx_cmd_type_t;
+
+#define SYS_GFX_MAX_CLIP_DEPTH 16
+
+typedef struct sys_gfx_line_t {
+  int32_t x0, y0, x1, y1;
+} sys_gfx_line_t;
+
+typedef struct sys_gfx_rect_t {
+  int32_t x, y;
+  uint32_t width, height;
+} sys_gfx_rect_t;
+
+typedef struct sys_gfx_text_t {
+  int32_t x, y;
+  const char* text;
+} sys_gfx_text_t;
+
+typedef struct sys_gfx_blit_t {
+  int32_t x, y;
+  uint32_t width, height;
+  const uint32_t* pixels;
+} sys_gfx_blit_t;
+
+typedef struct sys_gfx_blit_scaled_t {
+  int32_t x, y;
+  uint32_t width, height;
+  const uint32_t* pixels;
+  uint32_t src_width, src_height;
+  uint32_t filter; /* one of sys_gfx_filter_t */
+} sys_gfx_blit_scaled_t;
+
+typedef struct sys_gfx_copy_area_t {
+  int32_t x, y;
+  uint32_t width, height;
+  int32_t dx, dy;
+} sys_gfx_copy_area_t;
+
+typedef struct sys_gfx_surface_t {
+  int32_t x, y;
+  sys_surface_t* surface;
+} sys_gfx_surface_t;
+
+typedef struct sys_gfx_cmd_t {
+  uint32_t type; /* one of sys_gfx_cmd_type_t */
+  uint32_t argb;
+  union {
+    sys_gfx_line_t line;               /* SYS_GFX_CMD_LINE */
+    sys_gfx_rect_t rect;               /* SYS_GFX_CMD_RECT, SYS_GFX_CMD_FILL and SYS_GFX_CMD_PUSH_CLIP */
+    sys_gfx_text_t text;               /* SYS_GFX_CMD_TEXT */
+    sys_gfx_blit_t blit;               /* SYS_GFX_CMD_BLIT */
+    sys_gfx_blit_scaled_t blit_scaled; /* SYS_GFX_CMD_BLIT_SCALED */
+    sys_gfx_copy_area_t copy_area;     /* SYS_GFX_CMD_COPY_AREA */
+    sys_gfx_surface_t surface;         /* SYS_GFX_CMD_SET_TARGET (x and y unused) and SYS_GFX_CMD_BLIT_SURFACE */
+  };
+} sys_gfx_cmd_t;
+
+sys_error_t sys_gfx_submit(sys_window_t* window, const sys_gfx_cmd_t* cmds, size_t n);
+
+/* Window direct rendering API.
+ *
+ * The window framebuffer (ARGB pixels, `pitch` being the number of pixels between two rows) is mapped
+ * read/write in the task memory. Once drawn, the pixels should be presented with sys_window_present2().
+ * The surface address stays valid across resizes, but the pitch may change: the surface generation is
+ * incremented each time the framebuffer layout changes, so the surface must be queried again. */
+sys_error_t sys_window_map_surface(sys_window_t* window, uint32_t** pixels, uint32_t* pitch);
+sys_error_t sys_window_map_surface2(sys_window_t* window, uint32_t** pixels, uint32_t* pitch, uint32_t* generation);
+
+/* Window dirty tiles API.
+ *
+ * The window framebuffer is divided into tiles of SYS_WINDOW_TILE_SIZE x SYS_WINDOW_TILE_SIZE pixels.
+ * The sys_gfx_xxx() functions mark the tiles they draw into as dirty, and a present only composites the
+ * dirty tiles of the presented area (or the whole area if no tile is dirty). Clients rendering directly
+ * into the surface and also using sys_gfx_xxx() functions must mark the tiles they draw with
+ * sys_window_mark_tiles(), otherwise their pixels may not be presented.
+ *
+ * The bitmap is shared with the compositor: the bit (x % 64) of bits[y * stride + x / 64] is set if the
+ * tile (x, y) is dirty. Like the surface, it must be queried again when the surface generation changes. */
+#define SYS_WINDOW_TILE_SIZE 32
+
+typedef struct sys_window_tiles_t {
+  uint64_t* bits;
+  uint32_t stride;  /* number of 64-bit words per row of tiles */
+  uint32_t columns; /* number of tiles per row */
+  uint32_t rows;    /* number of rows of tiles */
+} sys_window_tiles_t;
+
+sys_error_t sys_window_map_tiles(sys_window_t* window, sys_window_tiles_t* tiles);
+/* Marks the tiles covering the given rectangle (in pixels, relative to the window) as dirty. */
+void sys_window_mark_tiles(const sys_window_tiles_t* tiles, uint32_t x, uint32_t y, uint32_t width, uint32_t height);
+
+/* System font API.
+ *
+ * The texts are drawn with the system font, loaded by the kernel at boot (its size is not known in
+ * advance). It is monospace: all the characters have the same advance. */
+typedef struct sys_font_metrics_t {
+  uint32_t char_width;  /* advance of each character, in pixels */
+  uint32_t char_height; /* height of the characters, in pixels */
+  uint32_t line_height; /* distance between the tops of two consecutive lines, in pixels */
+} sys_font_metrics_t;
+
+sys_error_t sys_gfx_get_font_metrics(sys_font_metrics_t* metrics);
+
+/* Compositor statistics API. */
+typedef struct sys_compositor_stats_t {
+  uint64_t frame_count;              /* number of frames composited since boot */
+  uint64_t damaged_pixels;           /* number of pixels composited in the last frame */
+  uint32_t frames_per_second;        /* number of frames composited during the last second */
+  uint32_t last_composite_us;        /* time spent to composite the last frame, in microseconds */
+  uint32_t average_composite_us;     /* average composite time during the last second, in microseconds */
+  uint32_t max_composite_us;         /* maximal composite time during the last second, in microseconds */
+  uint32_t frame_redraws_per_second; /* number of window frame decorations redrawn during the last second */
+} sys_compositor_stats_t;
+
+sys_error_t sys_compositor_stats(sys_compositor_stats_t* stats);
+
 __SYS_EXTERN_C_END
 
 #endif  // !__PIKAOS_LIBC_SYS_WINDOW_H__
@@ -0,0 +1,26 @@
+#include <sys/syscall.h>
+#include <assert.h>
+#include <string.h>
+
+sys_shm_t* sys_shm_create(const char* name, size_t size) {
+  assert(name != NULL);
+  assert(strlen(name) < SYS_SHM_NAME_MAX);
+  return (sys_shm_t*)__syscall2(SYS_SHM_CREATE, (sys_word_t)name, (sys_word_t)size);
+}
+
+sys_shm_t* sys_shm_get(sys_pid_t pid, const char* name) {
+  assert(name != NULL);
+  assert(strlen(name) < SYS_SHM_NAME_MAX);
+  return (sys_shm_t*)__syscall2(SYS_SHM_GET, (sys_word_t)pid, (sys_word_t)name);
+}
+
+sys_error_t sys_shm_map(sys_shm_t* shm, void** address, size_t* size) {
+  assert(shm != NULL);
+  assert(address != NULL);
+  return __syscall3(SYS_SHM_MAP, (sys_word_t)shm, (sys_word_t)address, (sys_word_t)size);
+}
+
+sys_error_t sys_shm_unmap(sys_shm_t* shm) {
+  assert(shm != NULL);
+  return __syscall1(SYS_SHM_UNMAP, (sys_word_t)shm);
+}
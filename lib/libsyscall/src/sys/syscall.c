@@ -47,11 +47,23 @@ sys_error_t sys_debug(uint64_t x) {
   return __syscall1(SYS_DEBUG, x);
 }
 
+uint64_t sys_get_time_us() {
+  return __syscall0(SYS_GET_TIME);
+}
+
 void* sys_sbrk(ptrdiff_t __increment) {
   return (void*)__syscall1(SYS_SBRK, __increment);
 }
 
+sys_error_t sys_mem_stats(sys_pid_t pid, sys_mem_stats_t* stats) {
+  return __syscall2(SYS_MEM_STATS, pid, (sys_word_t)stats);
+}
+
 
 sys_error_t sys_get_framebuffer(void** pixels, uint32_t* width, uint32_t* height, uint32_t* stride) {
   return __syscall4(SYS_GET_FRAMEBUFFER, (sys_word_t)pixels, (sys_word_t)width, (sys_word_t)height, (sys_word_t)stride);
 }
+
+sys_error_t sys_release_framebuffer() {
+  return __syscall0(SYS_RELEASE_FRAMEBUFFER);
+}
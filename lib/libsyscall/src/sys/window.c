@@ -4,6 +4,9 @@
 #include <sys/syscall.h>
 #include <sys/window.h>
 
+#define GFX_MAX_COMMANDS 64
+#define GFX_MAX_TEXT_SIZE 2048
+
 struct __sys_window_t {
   // Internal handle to identify the window inside the kernel.
   sys_word_t kernel_handle;
@@ -11,8 +14,27 @@ struct __sys_window_t {
 
   // The saved window title (UTF-8 encoded).
   char* title;
+
+  // The display list of the commands recorded by the sys_gfx_xxx() functions, not yet
+  // submitted, and the copy of their texts.
+  sys_gfx_cmd_t gfx_commands[GFX_MAX_COMMANDS];
+  size_t gfx_command_count;
+  char gfx_texts[GFX_MAX_TEXT_SIZE];
+  size_t gfx_text_size;
+
+  // The clipping rectangles pushed, pushed again at the start of each display list.
+  sys_gfx_rect_t gfx_clip_stack[SYS_GFX_MAX_CLIP_DEPTH];
+  size_t gfx_clip_depth;
+  // The surface drawn into (NULL for the window), set again at the start of each display list.
+  sys_surface_t* gfx_target;
+
+  // The next window created by the task (see sys_surface_destroy()).
+  sys_window_t* next_window;
 };  // struct __sys_window_t
 
+// All the windows created by the task.
+static sys_window_t* g_windows = NULL;
+
 sys_window_t* sys_window_create(const char* title,
                                 int32_t x,
                                 int32_t y,
@@ -27,6 +49,8 @@ sys_window_t* sys_window_create(const char* title,
 
   memset(window, 0, sizeof(sys_window_t));
   window->flags = flags;
+  window->next_window = g_windows;
+  g_windows = window;
 
   window->kernel_handle = __syscall1(SYS_WINDOW_CREATE, flags);
   if (window->kernel_handle == 0)
@@ -56,6 +80,11 @@ void sys_window_destroy(sys_window_t* window) {
   if (window == NULL)
     return;
 
+  sys_window_t** link = &g_windows;
+  while (*link != window)
+    link = &(*link)->next_window;
+  *link = window->next_window;
+
   free(window->title);
 
   // Free the window inside the kernel.
@@ -127,9 +156,18 @@ sys_error_t sys_window_get_visibility(sys_window_t* window, sys_bool_t* visible)
 sys_error_t sys_window_set_geometry(sys_window_t* window, int32_t x, int32_t y, uint32_t width, uint32_t height) {
   assert(window != NULL);
 
+  // Draw the recorded commands with the old size.
+  sys_gfx_flush(window);
+
   return __syscall5(SYS_WINDOW_SET_GEOMETRY, window->kernel_handle, x, y, width, height);
 }
 
+sys_error_t sys_window_set_opaque_rect(sys_window_t* window, uint32_t x, uint32_t y, uint32_t width, uint32_t height) {
+  assert(window != NULL);
+
+  return __syscall5(SYS_WINDOW_SET_OPAQUE_RECT, window->kernel_handle, x, y, width, height);
+}
+
 sys_error_t sys_window_get_geometry(sys_window_t* window, uint32_t* x, uint32_t* y, uint32_t* width, uint32_t* height) {
   assert(window != NULL);
 
@@ -148,20 +186,83 @@ sys_error_t sys_window_present(sys_window_t* window) {
 sys_error_t sys_window_present2(sys_window_t* window, uint32_t x, uint32_t y, uint32_t width, uint32_t height) {
   assert(window != NULL);
 
+  const sys_error_t error = sys_gfx_flush(window);
+  if (!SYS_IS_OK(error))
+    return error;
+
   return __syscall5(SYS_WINDOW_PRESENT, window->kernel_handle, (sys_word_t)x, (sys_word_t)y, (sys_word_t)width, (sys_word_t)height);
 }
 
+sys_error_t sys_window_wait_present(sys_window_t* window) {
+  assert(window != NULL);
+  return __syscall1(SYS_WINDOW_WAIT_PRESENT, window->kernel_handle);
+}
+
+sys_error_t sys_compositor_stats(sys_compositor_stats_t* stats) {
+  return __syscall1(SYS_COMPOSITOR_STATS, (sys_word_t)stats);
+}
+
+sys_error_t sys_gfx_get_font_metrics(sys_font_metrics_t* metrics) {
+  return __syscall1(SYS_GFX_GET_FONT_METRICS, (sys_word_t)metrics);
+}
+
+sys_error_t sys_gfx_flush(sys_window_t* window) {
+  assert(window != NULL);
+
+  if (window->gfx_command_count == 0)
+    return SYS_ERR_OK;
+
+  const sys_error_t error = __syscall3(SYS_GFX_SUBMIT, window->kernel_handle, (sys_word_t)window->gfx_commands,
+                                       window->gfx_command_count);
+  window->gfx_command_count = 0;
+  window->gfx_text_size = 0;
+  return error;
+}
+
+static sys_gfx_cmd_t* record_command_no_clip(sys_window_t* window, uint32_t type, uint32_t argb) {
+  sys_gfx_cmd_t* command = &window->gfx_commands[window->gfx_command_count++];
+  command->type = type;
+  command->argb = argb;
+  return command;
+}
+
+// Gets the next command of the display list, submitting the list first if it is full.
+// A new display list draws into the window without clipping, so the target is set and the
+// clipping rectangles are pushed again.
+static sys_error_t record_command(sys_window_t* window, uint32_t type, uint32_t argb, sys_gfx_cmd_t** command) {
+  sys_error_t error = SYS_ERR_OK;
+  if (window->gfx_command_count == GFX_MAX_COMMANDS)
+    error = sys_gfx_flush(window);
+
+  if (window->gfx_command_count == 0) {
+    if (window->gfx_target != NULL) {
+      const sys_gfx_surface_t target = {0, 0, window->gfx_target};
+      record_command_no_clip(window, SYS_GFX_CMD_SET_TARGET, 0)->surface = target;
+    }
+
+    for (size_t i = 0; i < window->gfx_clip_depth; ++i) {
+      record_command_no_clip(window, SYS_GFX_CMD_PUSH_CLIP, 0)->rect = window->gfx_clip_stack[i];
+    }
+  }
+
+  *command = record_command_no_clip(window, type, argb);
+  return error;
+}
+
 sys_error_t sys_gfx_clear(sys_window_t* window, uint32_t argb) {
   assert(window != NULL);
-  return __syscall2(SYS_GFX_CLEAR, window->kernel_handle, argb);
+
+  sys_gfx_cmd_t* command;
+  return record_command(window, SYS_GFX_CMD_CLEAR, argb, &command);
 }
 
 sys_error_t sys_gfx_draw_line(sys_window_t* window, uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1, uint32_t argb) {
   assert(window != NULL);
 
-  const uint64_t param1 = (uint64_t)x0 | ((uint64_t)y0 << 32);
-  const uint64_t param2 = (uint64_t)x1 | ((uint64_t)y1 << 32);
-  return __syscall4(SYS_GFX_DRAW_LINE, window->kernel_handle, param1, param2, argb);
+  sys_gfx_cmd_t* command;
+  const sys_error_t error = record_command(window, SYS_GFX_CMD_LINE, argb, &command);
+  command->line = (sys_gfx_line_t){(int32_t)x0, (int32_t)y0, (int32_t)x1, (int32_t)y1};
+  return error;
 }
 
 sys_error_t sys_gfx_draw_rect(sys_window_t* window,
@@ -172,9 +273,10 @@ sys_error_t sys_gfx_draw_rect(sys_window_t* window,
                               uint32_t argb) {
   assert(window != NULL);
 
-  const uint64_t param1 = (uint64_t)x | ((uint64_t)y << 32);
-  const uint64_t param2 = (uint64_t)width | ((uint64_t)height << 32);
-  return __syscall4(SYS_GFX_DRAW_RECT, window->kernel_handle, param1, param2, argb);
+  sys_gfx_cmd_t* command;
+  const sys_error_t error = record_command(window, SYS_GFX_CMD_RECT, argb, &command);
+  command->rect = (sys_gfx_rect_t){(int32_t)x, (int32_t)y, width, height};
+  return error;
 }
 
 sys_error_t sys_gfx_fill_rect(sys_window_t* window,
@@ -185,16 +287,43 @@ sys_error_t sys_gfx_fill_rect(sys_window_t* window,
                               uint32_t argb) {
   assert(window != NULL);
 
-  const uint64_t param1 = (uint64_t)x | ((uint64_t)y << 32);
-  const uint64_t param2 = (uint64_t)width | ((uint64_t)height << 32);
-  return __syscall4(SYS_GFX_FILL_RECT, window->kernel_handle, param1, param2, argb);
+  sys_gfx_cmd_t* command;
+  const sys_error_t error = record_command(window, SYS_GFX_CMD_FILL, argb, &command);
+  command->rect = (sys_gfx_rect_t){(int32_t)x, (int32_t)y, width, height};
+  return error;
 }
 
 sys_error_t sys_gfx_draw_text(sys_window_t* window, uint32_t x, uint32_t y, const char* text, uint32_t argb) {
-  assert(window != NULL);
+  assert(window != NULL && text != NULL);
+
+  // The text is copied, as the caller may modify it before the display list is submitted.
+  // Texts too long to be copied are drawn immediately.
+  const size_t size = strlen(text) + 1 /* include NUL terminator */;
+  const sys_bool_t is_copied = size <= GFX_MAX_TEXT_SIZE;
+  sys_error_t error = SYS_ERR_OK;
+  if (!is_copied || window->gfx_text_size + size > GFX_MAX_TEXT_SIZE)
+    error = sys_gfx_flush(window);
+
+  sys_gfx_cmd_t* command;
+  const sys_error_t record_error = record_command(window, SYS_GFX_CMD_TEXT, argb, &command);
+  if (SYS_IS_OK(error))
+    error = record_error;
+
+  if (is_copied) {
+    char* copy = window->gfx_texts + window->gfx_text_size;
+    memcpy(copy, text, size);
+    window->gfx_text_size += size;
+    text = copy;
+  }
+
+  command->text = (sys_gfx_text_t){(int32_t)x, (int32_t)y, text};
+  if (!is_copied) {
+    const sys_error_t flush_error = sys_gfx_flush(window);
+    if (SYS_IS_OK(error))
+      error = flush_error;
+  }
 
-  const uint64_t param1 = (uint64_t)x | ((uint64_t)y << 32);
-  return __syscall4(SYS_GFX_DRAW_TEXT, window->kernel_handle, param1, (sys_word_t)text, argb);
+  return error;
 }
 
 sys_error_t sys_gfx_blit(sys_window_t* window,
@@ -203,9 +332,204 @@ sys_error_t sys_gfx_blit(sys_window_t* window,
                          uint32_t width,
                          uint32_t height,
                          const uint32_t* argb_buffer) {
+  assert(window != NULL && argb_buffer != NULL);
+
+  // The pixels are not copied, so the display list is submitted immediately.
+  sys_gfx_cmd_t* command;
+  const sys_error_t error = record_command(window, SYS_GFX_CMD_BLIT, 0, &command);
+  command->blit = (sys_gfx_blit_t){(int32_t)x, (int32_t)y, width, height, argb_buffer};
+  const sys_error_t flush_error = sys_gfx_flush(window);
+  return SYS_IS_OK(error) ? flush_error : error;
+}
+
+sys_error_t sys_gfx_blit_scaled(sys_window_t* window,
+                                int32_t x,
+                                int32_t y,
+                                uint32_t width,
+                                uint32_t height,
+                                const uint32_t* argb_buffer,
+                                uint32_t src_width,
+                                uint32_t src_height,
+                                sys_gfx_filter_t filter) {
+  assert(window != NULL && argb_buffer != NULL);
+
+  // Same as sys_gfx_blit(): the pixels are not copied.
+  sys_gfx_cmd_t* command;
+  const sys_error_t error = record_command(window, SYS_GFX_CMD_BLIT_SCALED, 0, &command);
+  command->blit_scaled =
+      (sys_gfx_blit_scaled_t){x, y, width, height, argb_buffer, src_width, src_height, (uint32_t)filter};
+  const sys_error_t flush_error = sys_gfx_flush(window);
+  return SYS_IS_OK(error) ? flush_error : error;
+}
+
+sys_error_t sys_gfx_copy_area(sys_window_t* window,
+                              int32_t x,
+                              int32_t y,
+                              uint32_t width,
+                              uint32_t height,
+                              int32_t dx,
+                              int32_t dy) {
+  assert(window != NULL);
+
+  sys_gfx_cmd_t* command;
+  const sys_error_t error = record_command(window, SYS_GFX_CMD_COPY_AREA, 0, &command);
+  command->copy_area = (sys_gfx_copy_area_t){x, y, width, height, dx, dy};
+  return error;
+}
+
+sys_error_t sys_gfx_push_clip(sys_window_t* window, int32_t x, int32_t y, uint32_t width, uint32_t height) {
+  assert(window != NULL);
+
+  if (window->gfx_clip_depth == SYS_GFX_MAX_CLIP_DEPTH)
+    return SYS_ERR_INVALID_GFX_COMMAND;
+
+  const sys_gfx_rect_t rect = {x, y, width, height};
+  sys_gfx_cmd_t* command;
+  const sys_error_t error = record_command(window, SYS_GFX_CMD_PUSH_CLIP, 0, &command);
+  command->rect = rect;
+  window->gfx_clip_stack[window->gfx_clip_depth++] = rect;
+  return error;
+}
+
+sys_error_t sys_gfx_pop_clip(sys_window_t* window) {
   assert(window != NULL);
 
-  const uint64_t param1 = (uint64_t)x | ((uint64_t)y << 32);
-  const uint64_t param2 = (uint64_t)width | ((uint64_t)height << 32);
-  return __syscall4(SYS_GFX_BLIT, window->kernel_handle, param1, param2, (sys_word_t)argb_buffer);
+  if (window->gfx_clip_depth == 0)
+    return SYS_ERR_INVALID_GFX_COMMAND;
+
+  sys_gfx_cmd_t* command;
+  const sys_error_t error = record_command(window, SYS_GFX_CMD_POP_CLIP, 0, &command);
+  --window->gfx_clip_depth;
+  return error;
+}
+
+sys_surface_t* sys_surface_create(uint32_t width, uint32_t height, uint32_t flags) {
+  return (sys_surface_t*)__syscall3(SYS_SURFACE_CREATE, width, height, flags);
+}
+
+// Drops the recorded commands of @a window that draw into @a surface or blit it, and draws into the
+// window again if it is the target. The clipping commands are kept, so the pushes and pops stay balanced.
+static void drop_surface_commands(sys_window_t* window, sys_surface_t* surface) {
+  sys_surface_t* target = NULL;  // a display list starts drawing into the window
+  size_t count = 0;
+  for (size_t i = 0; i < window->gfx_command_count; ++i) {
+    const sys_gfx_cmd_t* command = &window->gfx_commands[i];
+    sys_bool_t keep;
+    switch (command->type) {
+      case SYS_GFX_CMD_SET_TARGET:
+        target = command->surface.surface;
+        keep = target != surface;
+        break;
+      case SYS_GFX_CMD_PUSH_CLIP:
+      case SYS_GFX_CMD_POP_CLIP:
+        keep = sys_true;
+        break;
+      case SYS_GFX_CMD_BLIT_SURFACE:
+        keep = target != surface && command->surface.surface != surface;
+        break;
+      default:
+        keep = target != surface;
+        break;
+    }
+
+    if (keep)
+      window->gfx_commands[count++] = *command;
+  }
+
+  window->gfx_command_count = count;
+  if (window->gfx_target == surface)
+    window->gfx_target = NULL;
+}
+
+void sys_surface_destroy(sys_surface_t* surface) {
+  if (surface == NULL)
+    return;
+
+  for (sys_window_t* window = g_windows; window != NULL; window = window->next_window)
+    drop_surface_commands(window, surface);
+
+  __syscall1(SYS_SURFACE_DESTROY, (sys_word_t)surface);
+}
+
+sys_error_t sys_gfx_set_target(sys_window_t* window, sys_surface_t* surface) {
+  assert(window != NULL);
+
+  if (window->gfx_clip_depth != 0)
+    return SYS_ERR_INVALID_GFX_COMMAND;
+
+  if (surface == window->gfx_target)
+    return SYS_ERR_OK;
+
+  sys_gfx_cmd_t* command;
+  const sys_error_t error = record_command(window, SYS_GFX_CMD_SET_TARGET, 0, &command);
+  command->surface = (sys_gfx_surface_t){0, 0, surface};
+  window->gfx_target = surface;
+  return error;
+}
+
+sys_error_t sys_gfx_blit_surface(sys_window_t* window, sys_surface_t* surface, int32_t x, int32_t y) {
+  assert(window != NULL && surface != NULL);
+
+  // Unlike sys_gfx_blit(), the pixels are kept by the kernel, so the command is only recorded.
+  sys_gfx_cmd_t* command;
+  const sys_error_t error = record_command(window, SYS_GFX_CMD_BLIT_SURFACE, 0, &command);
+  command->surface = (sys_gfx_surface_t){x, y, surface};
+  return error;
+}
+
+sys_error_t sys_gfx_submit(sys_window_t* window, const sys_gfx_cmd_t* cmds, size_t n) {
+  assert(window != NULL && (cmds != NULL || n == 0));
+
+  // Keep the order with the recorded commands.
+  const sys_error_t error = sys_gfx_flush(window);
+  if (!SYS_IS_OK(error))
+    return error;
+
+  return __syscall3(SYS_GFX_SUBMIT, window->kernel_handle, (sys_word_t)cmds, n);
+}
+
+sys_error_t sys_window_map_surface(sys_window_t* window, uint32_t** pixels, uint32_t* pitch) {
+  return sys_window_map_surface2(window, pixels, pitch, NULL);
+}
+
+sys_error_t sys_window_map_surface2(sys_window_t* window, uint32_t** pixels, uint32_t* pitch, uint32_t* generation) {
+  assert(window != NULL && pixels != NULL);
+
+  // The pixels drawn directly must be drawn over the recorded commands.
+  sys_gfx_flush(window);
+  return __syscall4(SYS_WINDOW_MAP_SURFACE, window->kernel_handle, (sys_word_t)pixels, (sys_word_t)pitch,
+                    (sys_word_t)generation);
+}
+
+sys_error_t sys_window_map_tiles(sys_window_t* window, sys_window_tiles_t* tiles) {
+  assert(window != NULL && tiles != NULL);
+
+  // The tiles drawn by the recorded commands must be marked before the client reads the bitmap.
+  sys_gfx_flush(window);
+  return __syscall2(SYS_WINDOW_MAP_TILES, window->kernel_handle, (sys_word_t)tiles);
+}
+
+void sys_window_mark_tiles(const sys_window_tiles_t* tiles, uint32_t x, uint32_t y, uint32_t width, uint32_t height) {
+  assert(tiles != NULL);
+
+  if (width == 0 || height == 0)
+    return;
+
+  const uint32_t first_column = x / SYS_WINDOW_TILE_SIZE;
+  const uint32_t first_row = y / SYS_WINDOW_TILE_SIZE;
+  uint32_t last_column = (x + width - 1) / SYS_WINDOW_TILE_SIZE;
+  uint32_t last_row = (y + height - 1) / SYS_WINDOW_TILE_SIZE;
+  if (first_column >= tiles->columns || first_row >= tiles->rows)
+    return;
+  if (last_column >= tiles->columns)
+    last_column = tiles->columns - 1;
+  if (last_row >= tiles->rows)
+    last_row = tiles->rows - 1;
+
+  for (uint32_t row = first_row; row <= last_row; ++row) {
+    uint64_t* words = tiles->bits + (size_t)tiles->stride * row;
+    for (uint32_t column = first_column; column <= last_column; ++column) {
+      words[column / 64] |= 1ull << (column % 64);
+    }
+  }
 }
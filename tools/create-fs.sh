@@ -1,9 +1,11 @@
 #!/usr/bin/env sh
 
 # To create the ramfs image used by Pi-kachULM_OS, please call this script with the name of the file to produce:
-# ./create-fs.sh `target ramfs file path`
+# ./create-fs.sh `target ramfs file path` [`generated files directory`]
+# The files of the optional second directory (generated at build time) are also copied to the root of the ramfs.
 
 TARGET_RAM_FS_NAME="$1"
+GENERATED_DIR="$2"
 TARGET_RAM_FS_SIZE=10 #Mio
 
 if [ "$TARGET_RAM_FS_NAME" = "" ]; then
@@ -47,6 +49,9 @@ $MFORMAT_EXEC -i "$TARGET_RAM_FS_NAME" -M 512
 
 # Populate it
 $MCOPY_EXEC -s -i "$TARGET_RAM_FS_NAME" "$RAM_FS_DIR"/* ::
+if [ "$GENERATED_DIR" != "" ]; then
+    $MCOPY_EXEC -s -i "$TARGET_RAM_FS_NAME" "$GENERATED_DIR"/* ::
+fi
 
 # Check
 $MDIR_EXEC -s -i "$TARGET_RAM_FS_NAME" ::
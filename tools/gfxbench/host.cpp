@@ -0,0 +1,34 @@
+#include <cstdio>
+#include <cstdlib>
+
+#include <libk/assert.hpp>
+#include <libk/log.hpp>
+
+#include "hardware/framebuffer.hpp"
+
+// The kernel services used by the graphics code, implemented for the host.
+
+namespace libk {
+[[noreturn]] void panic(const char* message, std::source_location source_location) {
+  fprintf(stderr, "panic at %s:%u in `%s`: %s\n", source_location.file_name(), (unsigned)source_location.line(),
+          source_location.function_name(), message);
+  abort();
+}
+}  // namespace libk
+
+// There is no screen on the host: the painters always draw into their own buffer.
+FrameBuffer& FrameBuffer::get() {
+  libk::panic("no framebuffer on the host");
+}
+
+/** Writes the kernel logs (such as the glyph cache errors) to the standard error. */
+class StderrLogger : public libk::Logger {
+ public:
+  void writeln(const char* data, size_t length) override { fprintf(stderr, "%.*s\n", (int)length, data); }
+};  // class StderrLogger
+
+static StderrLogger g_logger;
+
+[[gnu::constructor]] static void register_stderr_logger() {
+  libk::register_logger(g_logger);
+}
@@ -0,0 +1,377 @@
+#include <chrono>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "graphics/graphics.hpp"
+#include "graphics/pixel_format.hpp"
+#include "wm/region.hpp"
+
+#define ERROR "\x1b[1;31merror:\x1b[0m "
+
+using namespace graphics;
+
+// The screen size of the kernel (see kernel/kernel.cpp).
+static constexpr uint32_t WIDTH = 1280;
+static constexpr uint32_t HEIGHT = 720;
+
+static constexpr const char* TEXT =
+    "The quick brown fox jumps over the lazy dog. 0123456789 {}[]()<>+-*/=!?;:,.'\"~#$%&@^_`|\\ ";
+
+/** Generates a deterministic image with gradients and varying (straight) alpha. */
+static std::vector<uint32_t> make_image(uint32_t width, uint32_t height, bool opaque) {
+  std::vector<uint32_t> pixels((size_t)width * height);
+  for (uint32_t y = 0; y < height; ++y) {
+    for (uint32_t x = 0; x < width; ++x) {
+      const uint32_t r = (x * 255) / width;
+      const uint32_t g = (y * 255) / height;
+      const uint32_t b = ((x ^ y) * 7) & 0xff;
+      const uint32_t a = opaque ? 0xff : ((x + y) * 3) & 0xff;
+      pixels[x + (size_t)width * y] = (a << 24) | (r << 16) | (g << 8) | b;
+    }
+  }
+
+  return pixels;
+}
+
+/** Damage as accumulated by the window manager: overlapping window-sized rectangles. */
+static Region make_damage() {
+  Region damage;
+  uint32_t seed = 12345;
+  for (int i = 0; i < 24; ++i) {
+    seed = seed * 1103515245 + 12345;
+    const int32_t x = (seed >> 8) % (WIDTH - 320);
+    seed = seed * 1103515245 + 12345;
+    const int32_t y = (seed >> 8) % (HEIGHT - 240);
+    damage.add(Rect::from_pos_and_size(x, y, 160 + i * 6, 120 + i * 4));
+  }
+
+  return damage;
+}
+
+/** Composites @a window (a full screen ARGB8888 buffer) into @a screen in the parts of @a damage. */
+static void composite(uint8_t* screen, PixelFormat format, const uint32_t* window, const Region& damage,
+                      ConvertSpanFn convert_span) {
+  const uint32_t bytes_per_pixel = get_bytes_per_pixel(format);
+  for (const auto& rect : damage) {
+    for (int32_t y = rect.top(); y < rect.bottom(); ++y) {
+      const size_t offset = rect.left() + (size_t)WIDTH * y;
+      convert_span(screen + bytes_per_pixel * offset, window + offset, rect.width(), rect.left(), y);
+    }
+  }
+}
+
+// ========================================================================
+// Benchmark
+
+static uint32_t g_nb_iterations = 20;
+
+template <class Fn>
+static void benchmark(const char* name, uint64_t nb_pixels_per_iteration, Fn fn) {
+  const auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < g_nb_iterations; ++i) {
+    fn(i);
+  }
+  const auto end = std::chrono::steady_clock::now();
+  const uint64_t elapsed =
+      std::max<uint64_t>(1, std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
+
+  // Pixels per microsecond is Mpixels per second.
+  const double mpixels_per_s = (double)nb_pixels_per_iteration * g_nb_iterations / elapsed;
+  printf("%-40s %9.1f Mpixels/s %9.1f us/iteration\n", name, mpixels_per_s, (double)elapsed / g_nb_iterations);
+}
+
+static void run_benchmark() {
+  std::vector<uint32_t> buffer((size_t)WIDTH * HEIGHT);
+  Painter painter(buffer.data(), WIDTH, HEIGHT, WIDTH);
+  const uint64_t screen_pixels = WIDTH * HEIGHT;
+
+  benchmark("clear", screen_pixels, [&](uint32_t i) { painter.clear(Color(0xff000000 | i)); });
+  benchmark("fill_rect (opaque)", screen_pixels,
+            [&](uint32_t i) { painter.fill_rect(0, 0, WIDTH, HEIGHT, Color(0xff102030 + i)); });
+  benchmark("fill_rect (translucent)", screen_pixels,
+            [&](uint32_t i) { painter.fill_rect(0, 0, WIDTH, HEIGHT, Color(0x80102030 + i)); });
+
+  // Concentric rectangles covering the whole buffer.
+  uint64_t rect_pixels = 0;
+  for (uint32_t k = 0; k < HEIGHT / 2; ++k) {
+    rect_pixels += 2 * (WIDTH - 2 * k) + 2 * (HEIGHT - 2 * k - 2);
+  }
+
+  benchmark("draw_rect (opaque)", rect_pixels, [&](uint32_t i) {
+    for (uint32_t k = 0; k < HEIGHT / 2; ++k) {
+      painter.draw_rect(k, k, WIDTH - 2 * k, HEIGHT - 2 * k, Color(0xff000000 | (i + k)));
+    }
+  });
+
+  // Lines from the center to every 4th pixel of the borders.
+  uint64_t line_pixels = 0;
+  for (uint32_t x = 0; x < WIDTH; x += 4) {
+    line_pixels += 2 * (HEIGHT / 2);
+  }
+
+  benchmark("draw_line", line_pixels, [&](uint32_t i) {
+    for (uint32_t x = 0; x < WIDTH; x += 4) {
+      painter.draw_line(WIDTH / 2, HEIGHT / 2, x, 0, Color(0xff000000 | (i + x)));
+      painter.draw_line(WIDTH / 2, HEIGHT / 2, x, HEIGHT - 1, Color(0xff000000 | (i + x)));
+    }
+  });
+
+  // A screen full of text, drawn with the glyph cache.
+  const PKFont font = painter.get_font();
+  const uint32_t nb_lines = HEIGHT / font.get_line_height();
+  const uint64_t text_pixels = (uint64_t)font.get_char_width() * font.get_char_height() * strlen(TEXT) * nb_lines;
+  const TextLayout layout(font, TEXT, WIDTH);
+  benchmark("draw_text", text_pixels, [&](uint32_t i) {
+    for (uint32_t k = 0; k < nb_lines; ++k) {
+      painter.draw_text(0, k * font.get_line_height(), layout, Color(0xff000000 | (i & 1) * 0xffffff));
+    }
+  });
+
+  const std::vector<uint32_t> opaque_image = make_image(WIDTH, HEIGHT, true);
+  const std::vector<uint32_t> translucent_image = make_image(WIDTH, HEIGHT, false);
+  benchmark("blit (copy)", screen_pixels, [&](uint32_t) { painter.blit(0, 0, WIDTH, HEIGHT, opaque_image.data()); });
+  benchmark("blit (blend)", screen_pixels, [&](uint32_t) {
+    painter.blit(0, 0, WIDTH, HEIGHT, translucent_image.data(), BlendMode::SourceOver);
+  });
+
+  // Upscaling a quarter sized image to the whole buffer.
+  const std::vector<uint32_t> small_image = make_image(WIDTH / 2, HEIGHT / 2, true);
+  benchmark("blit_scaled (nearest)", screen_pixels, [&](uint32_t) {
+    painter.blit_scaled(0, 0, WIDTH, HEIGHT, small_image.data(), WIDTH / 2, HEIGHT / 2, ScaleFilter::Nearest);
+  });
+  benchmark("blit_scaled (bilinear)", screen_pixels, [&](uint32_t) {
+    painter.blit_scaled(0, 0, WIDTH, HEIGHT, small_image.data(), WIDTH / 2, HEIGHT / 2, ScaleFilter::Bilinear);
+  });
+
+  // The damage computation, measured in damaged pixels.
+  benchmark("region (24 overlapping rects)", make_damage().get_area(), [&](uint32_t) {
+    Region damage = make_damage();
+    damage.subtract(Rect::from_pos_and_size(WIDTH / 4, HEIGHT / 4, WIDTH / 2, HEIGHT / 2));
+  });
+
+  // The composite of the damage into a screen of each pixel format.
+  struct ScreenMode {
+    PixelFormat format;
+    bool dither;
+    const char* copy_name;
+    const char* blend_name;
+  };  // struct ScreenMode
+
+  static constexpr ScreenMode MODES[] = {
+      {PixelFormat::ARGB8888, false, "composite damage copy (ARGB8888)", "composite damage blend (ARGB8888)"},
+      {PixelFormat::RGB565, false, "composite damage copy (RGB565)", "composite damage blend (RGB565)"},
+      {PixelFormat::RGB565, true, "composite damage copy (RGB565, dither)", "composite damage blend (RGB565, dither)"},
+  };
+
+  const Region damage = make_damage();
+  std::vector<uint32_t> screen((size_t)WIDTH * HEIGHT);  // large enough for any format
+  for (const auto& mode : MODES) {
+    for (const auto blend_mode : {BlendMode::Copy, BlendMode::SourceOver}) {
+      const auto convert_span =
+          get_convert_span(mode.format, PixelFormat::ARGB8888, blend_mode, AlphaFormat::Premultiplied, mode.dither);
+      benchmark(blend_mode == BlendMode::Copy ? mode.copy_name : mode.blend_name, damage.get_area(), [&](uint32_t) {
+        composite((uint8_t*)screen.data(), mode.format, buffer.data(), damage, convert_span);
+      });
+    }
+  }
+}
+
+// ========================================================================
+// Golden images
+
+static constexpr uint32_t GOLDEN_WIDTH = 320;
+static constexpr uint32_t GOLDEN_HEIGHT = 240;
+
+/** FNV-1a hash of the @a size bytes of @a data. */
+static uint64_t checksum(const void* data, size_t size) {
+  uint64_t hash = 0xcbf29ce484222325;
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= ((const uint8_t*)data)[i];
+    hash *= 0x100000001b3;
+  }
+
+  return hash;
+}
+
+static void draw_shapes(Painter& painter) {
+  painter.clear(Color(0xff203040));
+  painter.fill_rect(10, 10, 100, 60, Color(0xffc04020));
+  painter.fill_rect(60, 40, 100, 60, Color(0x8020c040));
+  painter.fill_rect(-20, 200, 80, 80, Color(0xff4080ff));  // partially outside
+  painter.draw_rect(180, 20, 120, 80, Color(0xffffffff));
+  painter.draw_rect(190, 30, 100, 60, 5, Color(0xc0ff8000));
+  painter.draw_line(0, 0, GOLDEN_WIDTH - 1, GOLDEN_HEIGHT - 1, Color(0xffffff00));
+  painter.draw_line(-50, 230, 400, 120, Color(0xff00ffff));  // clipped
+  painter.draw_line(160, 100, 170, 239, Color(0x80ff00ff));
+}
+
+static void draw_text(Painter& painter) {
+  painter.clear(Color(0xff000000));
+  painter.draw_text(4, 4, TEXT, Color(0xffffffff));
+  painter.draw_text(4, 80, GOLDEN_WIDTH - 8, TEXT, Color(0xc080c0ff));
+  painter.draw_text(-10, 200, "Clipped text, partially outside", Color(0xffff8040));
+}
+
+static void draw_blits(Painter& painter) {
+  const std::vector<uint32_t> opaque_image = make_image(64, 48, true);
+  const std::vector<uint32_t> translucent_image = make_image(64, 48, false);
+  painter.clear(Color(0xff406080));
+  painter.blit(8, 8, 64, 48, opaque_image.data());
+  painter.blit(40, 30, 64, 48, translucent_image.data(), BlendMode::SourceOver);
+  painter.blit(290, 220, 64, 48, opaque_image.data());  // clipped
+  painter.blit_scaled(120, 8, 190, 100, opaque_image.data(), 64, 48, ScaleFilter::Nearest);
+  painter.blit_scaled(120, 120, 190, 100, translucent_image.data(), 64, 48, ScaleFilter::Bilinear,
+                      BlendMode::SourceOver);
+  painter.blit_scaled(8, 120, 32, 24, opaque_image.data(), 64, 48, ScaleFilter::Bilinear);  // downscaled
+}
+
+static void draw_clipped(Painter& painter) {
+  painter.clear(Color(0xff000000));
+  painter.set_clipping(40, 30, 280, 210);
+  painter.fill_rect(0, 0, GOLDEN_WIDTH, GOLDEN_HEIGHT, Color(0x80ff0000));
+  painter.draw_line(0, GOLDEN_HEIGHT, GOLDEN_WIDTH, 0, Color(0xff00ff00));
+  painter.draw_text(20, 100, TEXT, Color(0xffffffff));
+  painter.revert_clipping();
+  painter.draw_rect(40, 30, 240, 180, Color(0xff0000ff));
+}
+
+static void draw_premultiplied(Painter& painter) {
+  painter.set_alpha_format(AlphaFormat::Premultiplied);
+  painter.clear(Color(0x00000000));
+  painter.fill_rect(20, 20, 200, 150, Color(0x80ff8000));
+  painter.fill_rect(100, 80, 200, 150, Color(0x400080ff));
+  painter.draw_text(30, 30, "Premultiplied", Color(0xc0ffffff));
+}
+
+/** Loads the face of @a pixel_size pixels of the PKF v2 font of the ramdisk (see PKF2_FONT_PATH). */
+static bool load_pkf2_font(uint32_t pixel_size, PKFont& font) {
+  static std::vector<uint8_t> data;
+  if (data.empty()) {
+    FILE* file = fopen(PKF2_FONT_PATH, "rb");
+    if (file == nullptr)
+      return false;
+
+    uint8_t buffer[4096];
+    size_t read_bytes;
+    while ((read_bytes = fread(buffer, 1, sizeof(buffer), file)) > 0)
+      data.insert(data.end(), buffer, buffer + read_bytes);
+    fclose(file);
+  }
+
+  // The vector storage is aligned enough for the PKF v2 structures.
+  return PKFont::load(data.data(), data.size(), pixel_size, font);
+}
+
+/** The text drawn with the 16 pixels face of the PKF v2 font, whose glyphs are decoded by the glyph cache. */
+static void draw_pkf2_text(Painter& painter) {
+  PKFont font = painter.get_font();
+  if (!load_pkf2_font(16, font))
+    return;  // the checksum will not match
+
+  painter.set_font(font);
+  draw_text(painter);
+  painter.set_font(get_default_font());
+}
+
+/** The window manager composite: a translucent premultiplied window blended over an opaque one, into
+ * each screen format, in the parts of a damage region. The region rectangles are checksummed too. */
+static uint64_t composite_golden(PixelFormat format, bool dither) {
+  std::vector<uint32_t> opaque((size_t)WIDTH * HEIGHT);
+  std::vector<uint32_t> translucent((size_t)WIDTH * HEIGHT);
+  Painter opaque_painter(opaque.data(), WIDTH, HEIGHT, WIDTH);
+  draw_shapes(opaque_painter);
+  Painter translucent_painter(translucent.data(), WIDTH, HEIGHT, WIDTH);
+  draw_premultiplied(translucent_painter);
+
+  Region damage = make_damage();
+  damage.subtract(Rect::from_pos_and_size(WIDTH / 4, HEIGHT / 4, WIDTH / 2, HEIGHT / 2));
+
+  std::vector<uint32_t> screen((size_t)WIDTH * HEIGHT, 0);
+  auto* screen_bytes = (uint8_t*)screen.data();
+  composite(screen_bytes, format, opaque.data(), damage,
+            get_convert_span(format, PixelFormat::ARGB8888, BlendMode::Copy, AlphaFormat::Premultiplied, dither));
+  composite(screen_bytes, format, translucent.data(), damage,
+            get_convert_span(format, PixelFormat::ARGB8888, BlendMode::SourceOver, AlphaFormat::Premultiplied, dither));
+
+  std::vector<Rect> rects(damage.begin(), damage.end());
+  return checksum(screen.data(), (size_t)WIDTH * HEIGHT * get_bytes_per_pixel(format)) ^
+         checksum(rects.data(), rects.size() * sizeof(Rect));
+}
+
+struct GoldenImage {
+  const char* name;
+  uint64_t (*render)();
+  uint64_t expected_checksum;
+};  // struct GoldenImage
+
+template <void (*Draw)(Painter&)>
+static uint64_t render_golden() {
+  std::vector<uint32_t> pixels((size_t)GOLDEN_WIDTH * GOLDEN_HEIGHT);
+  Painter painter(pixels.data(), GOLDEN_WIDTH, GOLDEN_HEIGHT, GOLDEN_WIDTH);
+  Draw(painter);
+  return checksum(pixels.data(), pixels.size() * sizeof(uint32_t));
+}
+
+// The expected checksums, to be updated (with the --print option) when a rendering change is intended.
+static const GoldenImage GOLDEN_IMAGES[] = {
+    {"shapes", render_golden<draw_shapes>, 0xb3dae7a204c269bb},
+    {"text", render_golden<draw_text>, 0x7731763840f054e1},
+    {"blits", render_golden<draw_blits>, 0xcb4de26d5efc509e},
+    {"clipped", render_golden<draw_clipped>, 0x87534bc584fd7387},
+    {"premultiplied", render_golden<draw_premultiplied>, 0xef8e4f9ed7658a07},
+    {"text (PKF v2)", render_golden<draw_pkf2_text>, 0xc70afec63363bf32},
+    {"composite (ARGB8888)", [] { return composite_golden(PixelFormat::ARGB8888, false); }, 0x841dcab1e229ab54},
+    {"composite (RGB565)", [] { return composite_golden(PixelFormat::RGB565, false); }, 0x02145e13ed0ecec3},
+    {"composite (RGB565, dither)", [] { return composite_golden(PixelFormat::RGB565, true); }, 0x17990e4a8d4444ce},
+};
+
+/** Renders all the golden images. Returns false if a checksum does not match the expected one. */
+static bool check_golden_images(bool print) {
+  bool success = true;
+  for (const auto& image : GOLDEN_IMAGES) {
+    const uint64_t result = image.render();
+    if (print) {
+      printf("{\"%s\", ..., 0x%016" PRIx64 "},\n", image.name, result);
+    } else if (result != image.expected_checksum) {
+      printf("FAIL %s: checksum 0x%016" PRIx64 ", expected 0x%016" PRIx64 "\n", image.name, result,
+             image.expected_checksum);
+      success = false;
+    } else {
+      printf("PASS %s\n", image.name);
+    }
+  }
+
+  return success;
+}
+
+int main(int argc, char* argv[]) {
+  bool check = false;
+  bool print = false;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--check") == 0) {
+      check = true;
+    } else if (strcmp(argv[i], "--print") == 0) {
+      print = true;
+    } else if (strcmp(argv[i], "-n") == 0) {
+      if (i + 1 >= argc || sscanf(argv[i + 1], "%u", &g_nb_iterations) != 1 || g_nb_iterations == 0) {
+        fprintf(stderr, ERROR "missing or invalid argument after the option -n\n");
+        return EXIT_FAILURE;
+      }
+
+      ++i;
+    } else {
+      fprintf(stderr, ERROR "unknown option '%s'\n", argv[i]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (check || print)
+    return check_golden_images(print) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+  run_benchmark();
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,226 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#define ERROR "\x1b[1;31merror:\x1b[0m "
+
+// Must be kept in sync with kernel/graphics/raw_image.hpp.
+constexpr uint32_t RAW_IMAGE_MAGIC = 0x57524b50;  // "PKRW"
+constexpr uint32_t ROW_ALIGNMENT = 64;            // a cache line
+
+enum class PixelFormat : uint32_t { ARGB8888, RGB565 };
+
+struct RawImageHeader {
+  uint32_t magic;
+  uint32_t width;   // in pixels
+  uint32_t height;  // in pixels
+  uint32_t pitch;   // in bytes
+  uint32_t format;  // a PixelFormat value
+  uint32_t data_offset;
+  uint32_t reserved[10];
+};  // struct RawImageHeader
+
+static_assert(sizeof(RawImageHeader) == 64);
+
+// The same thresholds as the window manager (see kernel/graphics/pixel_format.cpp).
+static constexpr uint8_t BAYER_MATRIX[4][4] = {{0, 8, 2, 10}, {12, 4, 14, 6}, {3, 11, 1, 9}, {15, 7, 13, 5}};
+
+static std::vector<uint8_t> read_file(const char* path) {
+  std::vector<uint8_t> content;
+  FILE* file = fopen(path, "rb");
+  if (file == nullptr)
+    return content;
+
+  uint8_t buffer[4096];
+  size_t read_bytes;
+  while ((read_bytes = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    content.insert(content.end(), buffer, buffer + read_bytes);
+  }
+
+  fclose(file);
+  return content;
+}
+
+/** Scales the RGB @a src image to cover @a width x @a height pixels (cropping the sides that do not fit),
+ * averaging the source pixels covered by each destination pixel. Returns 0x00RRGGBB pixels. */
+static std::vector<uint32_t> scale_to_cover(const uint8_t* src,
+                                            uint32_t src_width,
+                                            uint32_t src_height,
+                                            uint32_t width,
+                                            uint32_t height) {
+  // The same scale on both axes, the largest one so the image covers the destination.
+  const double scale = std::max((double)width / src_width, (double)height / src_height);
+  const double step = 1.0 / scale;
+  const double x_origin = (src_width - width * step) / 2;
+  const double y_origin = (src_height - height * step) / 2;
+
+  std::vector<uint32_t> pixels(width * height);
+  for (uint32_t y = 0; y < height; ++y) {
+    // At least one source pixel, when upscaling.
+    const uint32_t sy1 = std::min<uint32_t>(y_origin + y * step, src_height - 1);
+    const uint32_t sy2 = std::clamp<uint32_t>(y_origin + (y + 1) * step, sy1 + 1, src_height);
+    for (uint32_t x = 0; x < width; ++x) {
+      const uint32_t sx1 = std::min<uint32_t>(x_origin + x * step, src_width - 1);
+      const uint32_t sx2 = std::clamp<uint32_t>(x_origin + (x + 1) * step, sx1 + 1, src_width);
+
+      uint64_t sum[3] = {0, 0, 0};
+      for (uint32_t sy = sy1; sy < sy2; ++sy) {
+        for (uint32_t sx = sx1; sx < sx2; ++sx) {
+          const uint8_t* pixel = src + 3 * (sx + (size_t)src_width * sy);
+          sum[0] += pixel[0];
+          sum[1] += pixel[1];
+          sum[2] += pixel[2];
+        }
+      }
+
+      const uint64_t count = (uint64_t)(sx2 - sx1) * (sy2 - sy1);
+      const uint32_t r = (sum[0] + count / 2) / count;
+      const uint32_t g = (sum[1] + count / 2) / count;
+      const uint32_t b = (sum[2] + count / 2) / count;
+      pixels[x + (size_t)width * y] = (r << 16) | (g << 8) | b;
+    }
+  }
+
+  return pixels;
+}
+
+static void write_row(uint8_t* dst, const uint32_t* src, uint32_t width, uint32_t y, PixelFormat format) {
+  for (uint32_t x = 0; x < width; ++x) {
+    const uint32_t r = (src[x] >> 16) & 0xff;
+    const uint32_t g = (src[x] >> 8) & 0xff;
+    const uint32_t b = src[x] & 0xff;
+
+    // The pixels are stored in little endian.
+    if (format == PixelFormat::ARGB8888) {
+      const uint32_t argb = 0xff000000 | (r << 16) | (g << 8) | b;
+      memcpy(dst + 4 * x, &argb, sizeof(argb));
+    } else {
+      // Red and blue lose 3 bits (a step of 8), green loses 2 bits (a step of 4).
+      const uint32_t threshold = BAYER_MATRIX[y % 4][x % 4];
+      const uint32_t r5 = std::min<uint32_t>(r + (threshold >> 1), 0xff) >> 3;
+      const uint32_t g6 = std::min<uint32_t>(g + (threshold >> 2), 0xff) >> 2;
+      const uint32_t b5 = std::min<uint32_t>(b + (threshold >> 1), 0xff) >> 3;
+      const uint16_t rgb565 = (r5 << 11) | (g6 << 5) | b5;
+      memcpy(dst + 2 * x, &rgb565, sizeof(rgb565));
+    }
+  }
+}
+
+static bool convert(const char* input_path, const char* output_path, uint32_t width, uint32_t height,
+                    PixelFormat format) {
+  if (input_path == nullptr) {
+    fprintf(stderr, ERROR "no input file\n");
+    return false;
+  }
+
+  if (output_path == nullptr) {
+    fprintf(stderr, ERROR "no output file\n");
+    return false;
+  }
+
+  if (width == 0 || height == 0) {
+    fprintf(stderr, ERROR "invalid image size\n");
+    return false;
+  }
+
+  const std::vector<uint8_t> content = read_file(input_path);
+  if (content.empty()) {
+    fprintf(stderr, ERROR "failed to read file '%s'\n", input_path);
+    return false;
+  }
+
+  int src_width, src_height;
+  uint8_t* src = stbi_load_from_memory(content.data(), content.size(), &src_width, &src_height, nullptr, 3);
+  if (src == nullptr) {
+    fprintf(stderr, ERROR "failed to decode '%s': %s\n", input_path, stbi_failure_reason());
+    return false;
+  }
+
+  const std::vector<uint32_t> pixels = scale_to_cover(src, src_width, src_height, width, height);
+  stbi_image_free(src);
+
+  const uint32_t bytes_per_pixel = format == PixelFormat::RGB565 ? 2 : 4;
+  const uint32_t pitch = (width * bytes_per_pixel + ROW_ALIGNMENT - 1) / ROW_ALIGNMENT * ROW_ALIGNMENT;
+
+  RawImageHeader header = {};
+  header.magic = RAW_IMAGE_MAGIC;
+  header.width = width;
+  header.height = height;
+  header.pitch = pitch;
+  header.format = (uint32_t)format;
+  header.data_offset = sizeof(RawImageHeader);
+
+  std::vector<uint8_t> output(header.data_offset + (size_t)pitch * height, 0);
+  memcpy(output.data(), &header, sizeof(header));
+  for (uint32_t y = 0; y < height; ++y) {
+    write_row(output.data() + header.data_offset + (size_t)pitch * y, pixels.data() + (size_t)width * y, width, y,
+              format);
+  }
+
+  FILE* output_file = fopen(output_path, "wb");
+  if (output_file == nullptr) {
+    fprintf(stderr, ERROR "failed to save into file '%s'\n", output_path);
+    return false;
+  }
+
+  fwrite(output.data(), sizeof(uint8_t), output.size(), output_file);
+  fclose(output_file);
+  return true;
+}
+
+int main(int argc, char* argv[]) {
+  const char* output_file = nullptr;
+  const char* input_file = nullptr;
+  uint32_t width = 1280, height = 720;
+  PixelFormat format = PixelFormat::ARGB8888;
+  bool stop_parsing_options = false;
+  for (int i = 1; i < argc; ++i) {
+    if (!stop_parsing_options && strcmp(argv[i], "-o") == 0) {
+      if (i + 1 >= argc) {
+        fprintf(stderr, ERROR "missing argument after the option -o\n");
+        return EXIT_FAILURE;
+      }
+
+      output_file = argv[i + 1];
+      ++i;
+    } else if (!stop_parsing_options && strcmp(argv[i], "-s") == 0) {
+      if (i + 1 >= argc || sscanf(argv[i + 1], "%ux%u", &width, &height) != 2) {
+        fprintf(stderr, ERROR "missing or invalid argument after the option -s (expected WIDTHxHEIGHT)\n");
+        return EXIT_FAILURE;
+      }
+
+      ++i;
+    } else if (!stop_parsing_options && strcmp(argv[i], "-f") == 0) {
+      if (i + 1 < argc && strcmp(argv[i + 1], "argb8888") == 0) {
+        format = PixelFormat::ARGB8888;
+      } else if (i + 1 < argc && strcmp(argv[i + 1], "rgb565") == 0) {
+        format = PixelFormat::RGB565;
+      } else {
+        fprintf(stderr, ERROR "missing or invalid argument after the option -f (expected argb8888 or rgb565)\n");
+        return EXIT_FAILURE;
+      }
+
+      ++i;
+    } else if (!stop_parsing_options && strcmp(argv[i], "--") == 0) {
+      stop_parsing_options = true;
+    } else {
+      if (input_file != nullptr) {
+        fprintf(stderr, ERROR "multiple input files provided\n");
+        return EXIT_FAILURE;
+      }
+
+      input_file = argv[i];
+    }
+  }
+
+  if (!convert(input_file, output_file, width, height, format))
+    return EXIT_FAILURE;
+
+  return EXIT_SUCCESS;
+}
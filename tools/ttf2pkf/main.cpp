@@ -2,16 +2,21 @@
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
+#include <string>
 #include <vector>
 
+#ifdef PKF_HAS_FREETYPE
 #include <ft2build.h>
 #include FT_FREETYPE_H
+#endif  // PKF_HAS_FREETYPE
 
-#define ERROR "\x1b[1;31merror:\xb[0m "
+#define ERROR "\x1b[1;31merror:\x1b[0m "
 
 constexpr uint32_t FIRST_CHARACTER = 0x21;
 constexpr uint32_t LAST_CHARACTER = 0x7e;
 
+// The structures of the PKF formats, see kernel/graphics/pkfont.hpp (the files are little endian).
+
 struct alignas(16) PKFHeader {
   uint32_t char_width;
   uint32_t char_height;
@@ -19,10 +24,43 @@ struct alignas(16) PKFHeader {
   uint32_t line_height;
 };  // struct PKFHeader
 
-bool handle_ft_error(FT_Error error, const char* context) {
-  fprintf(stderr, ERROR "%s: %s\n", context, FT_Error_String(error));
-  return false;
-}
+constexpr uint32_t PKF2_MAGIC = 0x32464b50;
+
+struct PKF2Header {
+  uint32_t magic;
+  uint32_t face_count;
+  uint32_t range_count;
+  uint32_t glyph_count;
+  uint32_t ranges_offset;
+  uint32_t faces_offset;
+  uint32_t reserved[2];
+};  // struct PKF2Header
+
+struct PKF2Range {
+  uint32_t first_code_point;
+  uint32_t last_code_point;
+  uint32_t first_glyph;
+};  // struct PKF2Range
+
+struct PKF2Face {
+  PKFHeader metrics;
+  uint32_t pixel_size;
+  uint32_t glyphs_offset;
+  uint32_t rows_offset;
+  uint32_t rows_size;
+};  // struct PKF2Face
+
+struct PKF2Glyph {
+  uint8_t x, y, width, height;
+  uint32_t rows_offset;
+};  // struct PKF2Glyph
+
+/** A face (size) of the font, with the alpha maps (char_width x char_height) of its glyphs. */
+struct Face {
+  PKFHeader metrics;
+  uint32_t pixel_size;
+  std::vector<std::vector<uint8_t>> glyphs;
+};  // struct Face
 
 static bool write_to_file(const char* output_path, const uint8_t* buffer, size_t buffer_size) {
   FILE* output_file = fopen(output_path, "wb");
@@ -36,40 +74,108 @@ static bool write_to_file(const char* output_path, const uint8_t* buffer, size_t
   return true;
 }
 
-static uint8_t* render_ascii_code(FT_Face face, char ch, uint8_t* output_buffer) {
-  const FT_UInt char_width = face->size->metrics.x_ppem;
-  const FT_UInt char_height = (face->size->metrics.ascender - face->size->metrics.descender) / 64;
-  const FT_UInt ascender = face->size->metrics.ascender / 64;
+static bool ends_with(const char* str, const char* suffix) {
+  const size_t str_length = strlen(str);
+  const size_t suffix_length = strlen(suffix);
+  return str_length >= suffix_length && strcmp(str + str_length - suffix_length, suffix) == 0;
+}
 
-  const FT_UInt glyph_index = FT_Get_Char_Index(face, (uint32_t)ch);
-  FT_Error error = FT_Load_Glyph(face, glyph_index, FT_LOAD_RENDER);
-  if (error) {
-    handle_ft_error(error, "failed to load or render glyph");
-    return nullptr;
+/** Parses Unicode ranges such as "0x21-0x7e,0xa1-0xff" into the list of their code points. */
+static bool parse_ranges(const char* text, std::vector<uint32_t>& code_points) {
+  code_points.clear();
+  const char* it = text;
+  while (*it != '\0') {
+    char* end;
+    const uint32_t first = strtoul(it, &end, 0);
+    uint32_t last = first;
+    if (end == it)
+      return false;
+
+    if (*end == '-') {
+      it = end + 1;
+      last = strtoul(it, &end, 0);
+      if (end == it)
+        return false;
+    }
+
+    if (first > last || last > 0x10ffff || (*end != ',' && *end != '\0'))
+      return false;
+
+    for (uint32_t code_point = first; code_point <= last; ++code_point) {
+      if (!code_points.empty() && code_point <= code_points.back())
+        return false;  // not sorted
+      code_points.push_back(code_point);
+    }
+
+    it = *end == ',' ? end + 1 : end;
   }
 
-#if 0
-    std::cout << "Glyph " << (char)(i) << "\n";
-    std::cout << face->glyph->advance.x / 64 << " " << face->glyph->advance.x / 64 << "\n";
-    std::cout << face->glyph->bitmap_left << " " << face->glyph->bitmap_top << "\n";
-    std::cout << face->glyph->metrics.width / 64 << " " << face->glyph->metrics.height / 64 << "\n";
-#endif
+  return !code_points.empty();
+}
+
+/** Reads a PKF v1 file (ASCII glyphs only) as a face. */
+static bool read_pkf_v1(const char* input_path, Face& face) {
+  FILE* input_file = fopen(input_path, "rb");
+  if (input_file == nullptr) {
+    fprintf(stderr, ERROR "failed to open '%s'\n", input_path);
+    return false;
+  }
 
-  FT_Bitmap& bitmap = face->glyph->bitmap;
-  memset(output_buffer, 0, sizeof(uint8_t) * char_width * char_height);
+  bool ok = fread(&face.metrics, sizeof(PKFHeader), 1, input_file) == 1;
+  if (ok && face.metrics.char_width == PKF2_MAGIC) {
+    fprintf(stderr, ERROR "'%s' is already a PKF v2 file\n", input_path);
+    ok = false;
+  }
+
+  // The v1 files do not store the requested size, but it is the character width.
+  face.pixel_size = face.metrics.char_width;
+  const size_t glyph_size = face.metrics.char_width * face.metrics.char_height;
+  for (uint32_t i = FIRST_CHARACTER; ok && i <= LAST_CHARACTER; ++i) {
+    std::vector<uint8_t> alpha_map(glyph_size);
+    ok = fread(alpha_map.data(), sizeof(uint8_t), glyph_size, input_file) == glyph_size;
+    face.glyphs.push_back(std::move(alpha_map));
+  }
+
+  fclose(input_file);
+  if (!ok)
+    fprintf(stderr, ERROR "'%s' is not a valid PKF v1 file\n", input_path);
+  return ok;
+}
 
+#ifdef PKF_HAS_FREETYPE
+static bool handle_ft_error(FT_Error error, const char* context) {
+  fprintf(stderr, ERROR "%s: %s\n", context, FT_Error_String(error));
+  return false;
+}
+
+static bool render_code_point(FT_Face face, uint32_t code_point, const PKFHeader& metrics, uint8_t* output_buffer) {
+  const FT_Int ascender = face->size->metrics.ascender / 64;
+
+  const FT_UInt glyph_index = FT_Get_Char_Index(face, code_point);
+  FT_Error error = FT_Load_Glyph(face, glyph_index, FT_LOAD_RENDER);
+  if (error)
+    return handle_ft_error(error, "failed to load or render glyph");
+
+  // The texels outside the character cell are lost.
+  FT_Bitmap& bitmap = face->glyph->bitmap;
+  memset(output_buffer, 0, sizeof(uint8_t) * metrics.char_width * metrics.char_height);
   for (uint32_t y = 0; y < bitmap.rows; ++y) {
     for (uint32_t x = 0; x < bitmap.width; ++x) {
-      uint8_t alpha = bitmap.buffer[x + y * bitmap.width];
-      output_buffer[(face->glyph->bitmap_left + x) + char_width * (ascender - face->glyph->bitmap_top + y)] = alpha;
+      const int32_t cell_x = face->glyph->bitmap_left + x;
+      const int32_t cell_y = ascender - face->glyph->bitmap_top + y;
+      if (cell_x < 0 || cell_y < 0 || cell_x >= (int32_t)metrics.char_width || cell_y >= (int32_t)metrics.char_height)
+        continue;
+
+      output_buffer[cell_x + metrics.char_width * cell_y] = bitmap.buffer[x + y * bitmap.pitch];
     }
   }
 
-  output_buffer += char_width * char_height;
-  return output_buffer;
+  return true;
 }
 
-bool convert(const char* input_path, const char* output_path, uint32_t requested_size_in_pixels = 10) {
+/** Renders the face of @a size pixels of the font @a input_path, with the glyphs of @a code_points (the ones
+ * missing from the font are removed from the list). */
+static bool read_ttf(const char* input_path, uint32_t size, std::vector<uint32_t>& code_points, Face& output) {
   FT_Library library;
   FT_Error error = FT_Init_FreeType(&library);
   if (error)
@@ -81,100 +187,309 @@ bool convert(const char* input_path, const char* output_path, uint32_t requested
     return handle_ft_error(error, "failed to open font");
 
   if (!FT_IS_FIXED_WIDTH(face)) {
-    fprintf(stderr, ERROR "the PKF format only support monospace fonts, but the provided one is not monospace");
+    fprintf(stderr, ERROR "the PKF format only support monospace fonts, but the provided one is not monospace\n");
     return false;
   }
-  error = FT_Set_Pixel_Sizes(face, 0, requested_size_in_pixels);
+
+  error = FT_Set_Pixel_Sizes(face, 0, size);
   if (error)
     return handle_ft_error(error, "failed to set font size");
 
-  uint32_t real_char_height = (face->size->metrics.ascender - face->size->metrics.descender) / 64;
-
-  const size_t char_count = LAST_CHARACTER - FIRST_CHARACTER + 1;
-  const size_t pkf_buffer_size = sizeof(PKFHeader) + (requested_size_in_pixels * real_char_height) * char_count;
-  uint8_t* pkf_buffer = new uint8_t[pkf_buffer_size];
-
-  // Fill in the header:
-  PKFHeader* pkf_header = reinterpret_cast<PKFHeader*>(pkf_buffer);
-  pkf_header->char_width = requested_size_in_pixels;
-  pkf_header->char_height = real_char_height;
-  pkf_header->line_height = face->size->metrics.height / 64;
+  output.pixel_size = size;
+  output.metrics.char_width = size;
+  output.metrics.char_height = (face->size->metrics.ascender - face->size->metrics.descender) / 64;
+  output.metrics.line_height = face->size->metrics.height / 64;
 
   // We need to access M to retrieve its advance value. See the comment below.
-  const FT_UInt glyph_index = FT_Get_Char_Index(face, (uint32_t)'M');
-  error = FT_Load_Glyph(face, glyph_index, FT_LOAD_DEFAULT);
-  if (error) {
-    handle_ft_error(error, "failed to load the 'M' glyph");
-    return false;
-  }
+  error = FT_Load_Glyph(face, FT_Get_Char_Index(face, (uint32_t)'M'), FT_LOAD_DEFAULT);
+  if (error)
+    return handle_ft_error(error, "failed to load the 'M' glyph");
 
   // We cannot use face->size->metrics.max_advance because some monospace fonts (like Fira Code)
   // have glyphs with a bigger advance (like ligatures). So instead, we retrieve the advance of
   // a basic ASCII letter like M.
-  pkf_header->advance = face->glyph->advance.x / 64;
-
-#if 0
-  printf("Header:\n");
-  printf("  - char_width: %u\n", pkf_header->char_width);
-  printf("  - char_height: %u\n", pkf_header->char_height);
-  printf("  - advance: %u\n", pkf_header->advance);
-  printf("  - line_height: %u\n", pkf_header->line_height);
-#endif
-
-  // Render each glyphs:
-  uint8_t* glyph_buffer = pkf_buffer + sizeof(PKFHeader);
-  for (uint32_t i = FIRST_CHARACTER; i <= LAST_CHARACTER; ++i) {
-    glyph_buffer = render_ascii_code(face, i, glyph_buffer);
-    if (glyph_buffer == nullptr)
+  output.metrics.advance = face->glyph->advance.x / 64;
+
+  std::vector<uint32_t> available_code_points;
+  for (uint32_t code_point : code_points) {
+    if (FT_Get_Char_Index(face, code_point) == 0)
+      continue;
+
+    std::vector<uint8_t> alpha_map(output.metrics.char_width * output.metrics.char_height);
+    if (!render_code_point(face, code_point, output.metrics, alpha_map.data()))
       return false;
-  }
 
-  if (!write_to_file(output_path, pkf_buffer, pkf_buffer_size))
-    return false;
+    output.glyphs.push_back(std::move(alpha_map));
+    available_code_points.push_back(code_point);
+  }
 
+  code_points = std::move(available_code_points);
   FT_Done_FreeType(library);
   return true;
 }
+#endif  // PKF_HAS_FREETYPE
+
+template <class T>
+static void append(std::vector<uint8_t>& buffer, const T& value) {
+  const auto* bytes = reinterpret_cast<const uint8_t*>(&value);
+  buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+}
+
+static void align(std::vector<uint8_t>& buffer, size_t alignment) {
+  buffer.resize((buffer.size() + alignment - 1) / alignment * alignment, 0);
+}
+
+/** Quantizes an 8-bit alpha to 4 bits (the kernel expands it back by multiplying by 0x11). */
+static uint8_t quantize(uint8_t alpha) {
+  return (alpha * 15 + 127) / 255;
+}
+
+/** Encodes the bounding box and the rows of the @a alpha_map glyph (see the PKF v2 format). */
+static PKF2Glyph encode_glyph(const PKFHeader& metrics, const uint8_t* alpha_map, std::vector<uint8_t>& rows) {
+  uint32_t x_min = metrics.char_width, y_min = metrics.char_height, x_max = 0, y_max = 0;
+  for (uint32_t y = 0; y < metrics.char_height; ++y) {
+    for (uint32_t x = 0; x < metrics.char_width; ++x) {
+      if (quantize(alpha_map[x + metrics.char_width * y]) == 0)
+        continue;
+
+      x_min = std::min(x_min, x);
+      x_max = std::max(x_max, x + 1);
+      y_min = std::min(y_min, y);
+      y_max = y + 1;
+    }
+  }
+
+  PKF2Glyph glyph = {0, 0, 0, 0, (uint32_t)rows.size()};
+  if (x_min >= x_max)
+    return glyph;  // empty glyph (such as a space)
+
+  glyph.x = x_min;
+  glyph.y = y_min;
+  glyph.width = x_max - x_min;
+  glyph.height = y_max - y_min;
+
+  for (uint32_t y = y_min; y < y_max; ++y) {
+    const uint8_t* row = alpha_map + metrics.char_width * y;
+    const size_t run_count_offset = rows.size();
+    rows.push_back(0);
+
+    uint32_t x = x_min;
+    uint32_t previous_end = x_min;
+    while (x < x_max) {
+      if (quantize(row[x]) == 0) {
+        ++x;
+        continue;
+      }
+
+      const uint32_t start = x;
+      while (x < x_max && quantize(row[x]) != 0) {
+        ++x;
+      }
+
+      rows.push_back(start - previous_end);
+      rows.push_back(x - start);
+      for (uint32_t i = start; i < x; i += 2) {
+        const uint8_t high = quantize(row[i]);
+        const uint8_t low = i + 1 < x ? quantize(row[i + 1]) : 0;
+        rows.push_back((high << 4) | low);
+      }
+
+      ++rows[run_count_offset];
+      previous_end = x;
+    }
+  }
+
+  return glyph;
+}
+
+static bool write_pkf_v2(const char* output_path, const std::vector<Face>& faces, const std::vector<uint32_t>& code_points) {
+  std::vector<PKF2Range> ranges;
+  for (size_t i = 0; i < code_points.size(); ++i) {
+    if (!ranges.empty() && ranges.back().last_code_point + 1 == code_points[i])
+      ranges.back().last_code_point = code_points[i];
+    else
+      ranges.push_back({code_points[i], code_points[i], (uint32_t)i});
+  }
+
+  std::vector<uint8_t> buffer;
+  PKF2Header header = {};
+  header.magic = PKF2_MAGIC;
+  header.face_count = faces.size();
+  header.range_count = ranges.size();
+  header.glyph_count = code_points.size();
+  append(buffer, header);
+
+  header.ranges_offset = buffer.size();
+  for (const auto& range : ranges) {
+    append(buffer, range);
+  }
+
+  align(buffer, alignof(PKF2Face));
+  header.faces_offset = buffer.size();
+  buffer.resize(buffer.size() + sizeof(PKF2Face) * faces.size(), 0);
+
+  size_t uncompressed_size = 0;
+  for (size_t i = 0; i < faces.size(); ++i) {
+    const Face& face = faces[i];
+    if (face.metrics.char_width > UINT8_MAX || face.metrics.char_height > UINT8_MAX) {
+      fprintf(stderr, ERROR "the characters of the face of size %u are too large\n", face.pixel_size);
+      return false;
+    }
+
+    PKF2Face face_header = {face.metrics, face.pixel_size, 0, 0, 0};
+    std::vector<PKF2Glyph> glyphs;
+    std::vector<uint8_t> rows;
+    for (const auto& alpha_map : face.glyphs) {
+      glyphs.push_back(encode_glyph(face.metrics, alpha_map.data(), rows));
+      uncompressed_size += alpha_map.size();
+    }
+
+    align(buffer, alignof(PKF2Glyph));
+    face_header.glyphs_offset = buffer.size();
+    for (const auto& glyph : glyphs) {
+      append(buffer, glyph);
+    }
+
+    face_header.rows_offset = buffer.size();
+    face_header.rows_size = rows.size();
+    buffer.insert(buffer.end(), rows.begin(), rows.end());
+    memcpy(buffer.data() + header.faces_offset + sizeof(PKF2Face) * i, &face_header, sizeof(PKF2Face));
+  }
+
+  memcpy(buffer.data(), &header, sizeof(PKF2Header));
+  printf("%zu glyphs in %zu faces: %zu bytes (%zu bytes of uncompressed glyphs)\n", code_points.size(), faces.size(),
+         buffer.size(), uncompressed_size);
+  return write_to_file(output_path, buffer.data(), buffer.size());
+}
+
+static bool write_pkf_v1(const char* output_path, const Face& face, const std::vector<uint32_t>& code_points) {
+  if (code_points.size() != LAST_CHARACTER - FIRST_CHARACTER + 1 || code_points.front() != FIRST_CHARACTER) {
+    fprintf(stderr, ERROR "the PKF v1 format only stores the ASCII characters from 0x21 to 0x7e\n");
+    return false;
+  }
+
+  std::vector<uint8_t> buffer;
+  append(buffer, face.metrics);
+  for (const auto& alpha_map : face.glyphs) {
+    buffer.insert(buffer.end(), alpha_map.begin(), alpha_map.end());
+  }
+
+  return write_to_file(output_path, buffer.data(), buffer.size());
+}
+
+static std::vector<uint32_t> parse_sizes(const char* text) {
+  std::vector<uint32_t> sizes;
+  for (const char* it = text; *it != '\0';) {
+    char* end;
+    const uint32_t size = strtoul(it, &end, 10);
+    if (end == it || size == 0 || (*end != ',' && *end != '\0'))
+      return {};
+
+    sizes.push_back(size);
+    it = *end == ',' ? end + 1 : end;
+  }
+
+  return sizes;
+}
 
 int main(int argc, char* argv[]) {
   bool convert_to_cxx = false;
+  bool output_v1 = false;
   const char* output_file = nullptr;
-  const char* input_file = nullptr;
-  uint32_t font_size = 12;
+  std::vector<const char*> input_files;
+  std::vector<uint32_t> font_sizes = {12};
+  std::vector<uint32_t> code_points;
+  parse_ranges("0x21-0x7e,0xa1-0xff", code_points);  // ASCII and Latin-1 by default
   bool stop_parsing_options = false;
   for (int i = 1; i < argc; ++i) {
     if (!stop_parsing_options && strcmp(argv[i], "-c++") == 0) {
       convert_to_cxx = true;
-    } else if (!stop_parsing_options && strcmp(argv[i], "-o") == 0) {
+    } else if (!stop_parsing_options && strcmp(argv[i], "-v1") == 0) {
+      output_v1 = true;
+    } else if (!stop_parsing_options &&
+               (strcmp(argv[i], "-o") == 0 || strcmp(argv[i], "-s") == 0 || strcmp(argv[i], "-r") == 0)) {
       if (i + 1 >= argc) {
-        fprintf(stderr, ERROR "missing argument after the option -o\n");
+        fprintf(stderr, ERROR "missing argument after the option %s\n", argv[i]);
         return EXIT_FAILURE;
       }
 
-      output_file = argv[i + 1];
-      ++i;
-    } else if (!stop_parsing_options && strcmp(argv[i], "-s") == 0) {
-      if (i + 1 >= argc) {
-        fprintf(stderr, ERROR "missing argument after the option -s\n");
+      if (argv[i][1] == 'o') {
+        output_file = argv[i + 1];
+      } else if (argv[i][1] == 's') {
+        font_sizes = parse_sizes(argv[i + 1]);
+        if (font_sizes.empty()) {
+          fprintf(stderr, ERROR "invalid font sizes '%s'\n", argv[i + 1]);
+          return EXIT_FAILURE;
+        }
+      } else if (!parse_ranges(argv[i + 1], code_points)) {
+        fprintf(stderr, ERROR "invalid Unicode ranges '%s'\n", argv[i + 1]);
         return EXIT_FAILURE;
       }
 
-      font_size = strtol(argv[i + 1], nullptr, 10);
       ++i;
     } else if (!stop_parsing_options && strcmp(argv[i], "--") == 0) {
       stop_parsing_options = true;
     } else {
-      if (input_file != nullptr) {
-        fprintf(stderr, ERROR "multiple input files provided\n");
+      input_files.push_back(argv[i]);
+    }
+  }
+
+  (void)convert_to_cxx;
+  if (input_files.empty() || output_file == nullptr) {
+    fprintf(stderr, ERROR "missing input or output file\n");
+    return EXIT_FAILURE;
+  }
+
+  // Each PKF v1 input gives a face (of the ASCII characters). Otherwise, a single font file gives
+  // a face of each requested size.
+  std::vector<Face> faces;
+  if (ends_with(input_files[0], ".pkf")) {
+    for (const char* input_file : input_files) {
+      Face face;
+      if (!ends_with(input_file, ".pkf") || !read_pkf_v1(input_file, face)) {
+        fprintf(stderr, ERROR "'%s': all the inputs must be PKF v1 files\n", input_file);
         return EXIT_FAILURE;
       }
 
-      input_file = argv[i];
+      faces.push_back(std::move(face));
     }
-  }
 
-  if (!convert(input_file, output_file, font_size))
+    code_points.clear();
+    for (uint32_t code_point = FIRST_CHARACTER; code_point <= LAST_CHARACTER; ++code_point)
+      code_points.push_back(code_point);
+  } else {
+#ifdef PKF_HAS_FREETYPE
+    if (input_files.size() != 1) {
+      fprintf(stderr, ERROR "multiple input files provided\n");
+      return EXIT_FAILURE;
+    }
+
+    for (uint32_t size : font_sizes) {
+      Face face;
+      if (!read_ttf(input_files[0], size, code_points, face))
+        return EXIT_FAILURE;
+
+      faces.push_back(std::move(face));
+    }
+
+    // The characters missing from the font were removed by the first face, the faces have the same glyphs.
+    for (auto& face : faces) {
+      face.glyphs.resize(code_points.size());
+    }
+#else
+    fprintf(stderr, ERROR "built without FreeType, only PKF v1 files can be converted\n");
     return EXIT_FAILURE;
+#endif  // PKF_HAS_FREETYPE
+  }
+
+  if (output_v1) {
+    if (faces.size() != 1) {
+      fprintf(stderr, ERROR "the PKF v1 format only stores a single size\n");
+      return EXIT_FAILURE;
+    }
+
+    return write_pkf_v1(output_file, faces[0], code_points) ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
 
-  return EXIT_SUCCESS;
+  return write_pkf_v2(output_file, faces, code_points) ? EXIT_SUCCESS : EXIT_FAILURE;
 }